@@ -0,0 +1,217 @@
+#include "campaign.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace CamSim::Campaign {
+
+namespace {
+
+uint64_t splitmix64(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+uint64_t rotate_left(const uint64_t value, const int shift)
+{
+    return (value << shift) | (value >> (64 - shift));
+}
+
+}
+
+Random::Random(const uint64_t seed, const uint64_t stream)
+{
+    // Hash the seed first so that nearby seeds and streams do not share state.
+    uint64_t seed_state = seed;
+    uint64_t stream_state = splitmix64(seed_state) ^ (stream * 0xD1B54A32D192ED03ULL);
+    for (uint64_t& word : state)
+    {
+        word = splitmix64(stream_state);
+    }
+}
+
+uint64_t Random::next()
+{
+    const uint64_t result = rotate_left(state[1] * 5, 7) * 9;
+    const uint64_t t = state[1] << 17;
+
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotate_left(state[3], 45);
+
+    return result;
+}
+
+double Random::uniform()
+{
+    return (double)(next() >> 11) * 0x1.0p-53;
+}
+
+double Random::normal()
+{
+    if (has_spare_normal)
+    {
+        has_spare_normal = false;
+        return spare_normal;
+    }
+
+    double u, v, s;
+    do
+    {
+        u = 2.0 * uniform() - 1.0;
+        v = 2.0 * uniform() - 1.0;
+        s = u * u + v * v;
+    } while (s >= 1.0 || s == 0.0);
+
+    const double scale = std::sqrt(-2.0 * std::log(s) / s);
+    spare_normal = v * scale;
+    has_spare_normal = true;
+
+    return u * scale;
+}
+
+void RunningStatistics::add(const double value)
+{
+    count++;
+    const double delta = value - mean;
+    mean += delta / (double)count;
+    sum_of_squares += delta * (value - mean);
+    min = std::min(min, value);
+    max = std::max(max, value);
+}
+
+void RunningStatistics::merge(const RunningStatistics& other)
+{
+    if (other.count == 0)
+    {
+        return;
+    }
+    if (count == 0)
+    {
+        *this = other;
+        return;
+    }
+
+    const size_t total = count + other.count;
+    const double delta = other.mean - mean;
+    mean += delta * (double)other.count / (double)total;
+    sum_of_squares += other.sum_of_squares +
+                      delta * delta * (double)count * (double)other.count / (double)total;
+    count = total;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+}
+
+double RunningStatistics::get_standard_deviation() const
+{
+    return std::sqrt(get_variance());
+}
+
+CampaignRunner::CampaignRunner(const size_t output_count, const size_t thread_count)
+    : output_count(output_count),
+      thread_count(thread_count != 0 ? thread_count
+                                     : std::max(1u, std::thread::hardware_concurrency()))
+{
+    if (output_count == 0)
+    {
+        throw std::invalid_argument("Campaign must have at least one output");
+    }
+}
+
+std::vector<RunningStatistics> CampaignRunner::run(
+    const SimulationFactory& factory,
+    const size_t run_count,
+    const uint64_t seed) const
+{
+    // Chunks depend only on the run count, never on the thread count, to keep the merge order
+    // fixed.
+    const size_t runs_per_chunk =
+        chunk_size != 0 ? chunk_size : std::max<size_t>(1, std::min<size_t>(64, run_count / 256));
+    const size_t chunk_count = (run_count + runs_per_chunk - 1) / runs_per_chunk;
+    std::vector<std::vector<RunningStatistics>> chunk_statistics(
+        chunk_count, std::vector<RunningStatistics>(output_count));
+
+    std::atomic<size_t> next_chunk{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr first_exception;
+    std::mutex exception_mutex;
+
+    const auto worker = [&](const size_t thread_idx)
+    {
+        try
+        {
+            const std::unique_ptr<Simulation> simulation = factory(thread_idx);
+            std::vector<double> outputs(output_count);
+            for (;;)
+            {
+                const size_t chunk = next_chunk.fetch_add(1, std::memory_order_relaxed);
+                if (chunk >= chunk_count || failed.load(std::memory_order_relaxed))
+                {
+                    return;
+                }
+
+                std::vector<RunningStatistics>& statistics = chunk_statistics[chunk];
+                const size_t last_run = std::min(run_count, (chunk + 1) * runs_per_chunk);
+                for (size_t run_index = chunk * runs_per_chunk; run_index < last_run; run_index++)
+                {
+                    Random random(seed, run_index);
+                    simulation->run(run_index, random, outputs.data());
+                    for (size_t i = 0; i < output_count; i++)
+                    {
+                        statistics[i].add(outputs[i]);
+                    }
+                }
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(exception_mutex);
+            if (!first_exception)
+            {
+                first_exception = std::current_exception();
+            }
+            failed.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    const size_t worker_count = std::min(thread_count, std::max<size_t>(1, chunk_count));
+    std::vector<std::thread> workers;
+    workers.reserve(worker_count);
+    for (size_t thread_idx = 0; thread_idx < worker_count; thread_idx++)
+    {
+        workers.emplace_back(worker, thread_idx);
+    }
+    for (std::thread& thread : workers)
+    {
+        thread.join();
+    }
+
+    if (first_exception)
+    {
+        std::rethrow_exception(first_exception);
+    }
+
+    std::vector<RunningStatistics> statistics(output_count);
+    for (const std::vector<RunningStatistics>& chunk : chunk_statistics)
+    {
+        for (size_t i = 0; i < output_count; i++)
+        {
+            statistics[i].merge(chunk[i]);
+        }
+    }
+
+    return statistics;
+}
+
+}
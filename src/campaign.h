@@ -0,0 +1,143 @@
+#ifndef CAMPAIGN_H
+#define CAMPAIGN_H
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace CamSim::Campaign {
+
+// xoshiro256** seeded through splitmix64, one independent stream per run.  The normal deviates
+// come from the Marsaglia polar method rather than std::normal_distribution, whose output differs
+// between standard libraries, so campaigns reproduce across toolchains.
+class Random
+{
+public:
+    Random(const uint64_t seed, const uint64_t stream);
+
+    uint64_t next();
+
+    // Uniform on [0, 1).
+    double uniform();
+
+    double uniform(const double low, const double high)
+    {
+        return low + (high - low) * uniform();
+    }
+
+    double normal();
+
+    double normal(const double mean, const double standard_deviation)
+    {
+        return mean + standard_deviation * normal();
+    }
+
+private:
+    uint64_t state[4];
+    bool has_spare_normal = false;
+    double spare_normal = 0.0;
+};
+
+// Count, mean, variance and range of a sample, updated one value at a time with Welford's method
+// and merged with Chan's parallel formula.
+class RunningStatistics
+{
+public:
+    void add(const double value);
+    void merge(const RunningStatistics& other);
+
+    size_t get_count() const
+    {
+        return count;
+    }
+
+    double get_mean() const
+    {
+        return mean;
+    }
+
+    // The sample variance, 0 for fewer than two values.
+    double get_variance() const
+    {
+        return count > 1 ? sum_of_squares / (double)(count - 1) : 0.0;
+    }
+
+    double get_standard_deviation() const;
+
+    double get_min() const
+    {
+        return min;
+    }
+
+    double get_max() const
+    {
+        return max;
+    }
+
+private:
+    size_t count = 0;
+    double mean = 0.0;
+    double sum_of_squares = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+};
+
+// One worker's simulation context, holding everything a run mutates: arenas, MultiRigidbody,
+// integrator buffers.  Read only resources such as a WorldMagneticModel, whose evaluations are
+// const, are shared between contexts through the factory instead of loaded per context.
+class Simulation
+{
+public:
+    virtual ~Simulation() = default;
+
+    // Performs run run_index, drawing every dispersion from random, and writes the runner's
+    // output count of values to outputs.
+    virtual void run(const size_t run_index, Random& random, double* outputs) = 0;
+};
+
+// Creates the context of worker thread_idx.  Called concurrently from the worker threads, so the
+// context's memory is first touched by the thread using it.
+using SimulationFactory = std::function<std::unique_ptr<Simulation>(size_t thread_idx)>;
+
+// Runs a campaign of dispersed runs on a pool of worker threads, one Simulation per worker.
+// Workers claim fixed chunks of consecutive runs, and run i always draws from Random(seed, i), so
+// the statistics are bitwise identical for any thread count: each chunk accumulates in run order
+// and the chunks are merged in order at the end.
+class CampaignRunner
+{
+public:
+    // A thread_count of 0 uses every hardware thread.  Throws std::invalid_argument if
+    // output_count is 0.
+    explicit CampaignRunner(const size_t output_count, const size_t thread_count = 0);
+
+    size_t get_output_count() const
+    {
+        return output_count;
+    }
+
+    size_t get_thread_count() const
+    {
+        return thread_count;
+    }
+
+    // Returns the statistics of each output over run_count runs.  The first exception thrown by a
+    // factory or run stops the campaign and is rethrown here once every worker has stopped.
+    std::vector<RunningStatistics> run(
+        const SimulationFactory& factory,
+        const size_t run_count,
+        const uint64_t seed) const;
+
+    // Runs per chunk, 0 to pick one giving each worker several chunks to balance uneven runs.
+    size_t chunk_size = 0;
+
+private:
+    size_t output_count;
+    size_t thread_count;
+};
+
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include "campaign.h"
+#include "integrators.h"
+
+#include <atomic>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace CamSim::Campaign {
+
+TEST(random_test, streams_are_reproducible_and_distinct)
+{
+    Random a(42, 7);
+    Random b(42, 7);
+    Random other_stream(42, 8);
+    Random other_seed(43, 7);
+    size_t matches_other_stream = 0;
+    size_t matches_other_seed = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        const uint64_t value = a.next();
+        EXPECT_EQ(value, b.next());
+        matches_other_stream += value == other_stream.next();
+        matches_other_seed += value == other_seed.next();
+    }
+    EXPECT_EQ(matches_other_stream, 0u);
+    EXPECT_EQ(matches_other_seed, 0u);
+}
+
+TEST(random_test, distributions)
+{
+    Random random(1, 0);
+    RunningStatistics uniform;
+    RunningStatistics normal;
+    for (int i = 0; i < 200000; i++)
+    {
+        uniform.add(random.uniform(-1.0, 3.0));
+        normal.add(random.normal(5.0, 2.0));
+    }
+
+    EXPECT_GE(uniform.get_min(), -1.0);
+    EXPECT_LT(uniform.get_max(), 3.0);
+    EXPECT_NEAR(uniform.get_mean(), 1.0, 0.02);
+    EXPECT_NEAR(uniform.get_variance(), 16.0 / 12.0, 0.02);
+    EXPECT_NEAR(normal.get_mean(), 5.0, 0.02);
+    EXPECT_NEAR(normal.get_standard_deviation(), 2.0, 0.02);
+}
+
+TEST(running_statistics_test, merge_matches_sequential)
+{
+    RunningStatistics all;
+    RunningStatistics first;
+    RunningStatistics second;
+    RunningStatistics empty;
+    for (int i = 0; i < 100; i++)
+    {
+        const double value = 1e6 + std::sin((double)i);
+        all.add(value);
+        (i < 30 ? first : second).add(value);
+    }
+    first.merge(second);
+    first.merge(empty);
+    empty.merge(first);
+
+    for (const RunningStatistics& merged : {first, empty})
+    {
+        EXPECT_EQ(merged.get_count(), all.get_count());
+        EXPECT_NEAR(merged.get_mean(), all.get_mean(), 1e-9);
+        EXPECT_NEAR(merged.get_variance(), all.get_variance(), 1e-9);
+        EXPECT_EQ(merged.get_min(), all.get_min());
+        EXPECT_EQ(merged.get_max(), all.get_max());
+    }
+}
+
+// A damped oscillator with dispersed initial conditions and a damping ratio from a shared table,
+// reporting the final position and velocity.
+class DampedOscillator : public Simulation
+{
+public:
+    explicit DampedOscillator(std::shared_ptr<const std::vector<double>> damping_ratios)
+        : damping_ratios(std::move(damping_ratios)),
+          integrator(2),
+          owner(std::this_thread::get_id())
+    {
+    }
+
+    void run(const size_t run_index, Random& random, double* outputs) override
+    {
+        EXPECT_EQ(std::this_thread::get_id(), owner);
+        const double damping_ratio = (*damping_ratios)[run_index % damping_ratios->size()];
+        const Integrators::Derivative derivative =
+            [damping_ratio](double, const double* state, double* state_derivative)
+        {
+            state_derivative[0] = state[1];
+            state_derivative[1] = -state[0] - 2.0 * damping_ratio * state[1];
+        };
+
+        double t = 0.0;
+        double state[2] = {random.normal(1.0, 0.1), random.uniform(-0.5, 0.5)};
+        integrator.integrate(derivative, t, state, 5.0, 0.01);
+        outputs[0] = state[0];
+        outputs[1] = state[1];
+    }
+
+private:
+    std::shared_ptr<const std::vector<double>> damping_ratios;
+    Integrators::RK4 integrator;
+    std::thread::id owner;
+};
+
+TEST(campaign_runner_test, reproducible_for_any_thread_count)
+{
+    const auto damping_ratios =
+        std::make_shared<const std::vector<double>>(std::vector<double>{0.05, 0.1, 0.2});
+    std::atomic<size_t> contexts{0};
+    const SimulationFactory factory = [&](size_t)
+    {
+        contexts++;
+        return std::make_unique<DampedOscillator>(damping_ratios);
+    };
+
+    const size_t run_count = 1000;
+    const std::vector<RunningStatistics> reference =
+        CampaignRunner(2, 1).run(factory, run_count, 2024);
+    EXPECT_EQ(contexts.load(), 1u);
+    ASSERT_EQ(reference.size(), 2u);
+    EXPECT_EQ(reference[0].get_count(), run_count);
+
+    // The same runs done by hand.
+    DampedOscillator sequential(damping_ratios);
+    RunningStatistics position;
+    for (size_t run_index = 0; run_index < run_count; run_index++)
+    {
+        Random random(2024, run_index);
+        double outputs[2];
+        sequential.run(run_index, random, outputs);
+        position.add(outputs[0]);
+    }
+    EXPECT_NEAR(reference[0].get_mean(), position.get_mean(), 1e-12);
+    EXPECT_NEAR(reference[0].get_variance(), position.get_variance(), 1e-12);
+    EXPECT_EQ(reference[0].get_min(), position.get_min());
+    EXPECT_EQ(reference[0].get_max(), position.get_max());
+
+    for (const size_t thread_count : {2, 3, 8})
+    {
+        contexts = 0;
+        CampaignRunner runner(2, thread_count);
+        const std::vector<RunningStatistics> statistics = runner.run(factory, run_count, 2024);
+        EXPECT_EQ(contexts.load(), thread_count);
+        for (size_t i = 0; i < 2; i++)
+        {
+            EXPECT_EQ(statistics[i].get_count(), run_count);
+            EXPECT_EQ(statistics[i].get_mean(), reference[i].get_mean());
+            EXPECT_EQ(statistics[i].get_variance(), reference[i].get_variance());
+        }
+    }
+
+    const std::vector<RunningStatistics> other_seed =
+        CampaignRunner(2, 4).run(factory, run_count, 2025);
+    EXPECT_NE(other_seed[0].get_mean(), reference[0].get_mean());
+}
+
+class FailingSimulation : public Simulation
+{
+public:
+    void run(const size_t run_index, Random&, double* outputs) override
+    {
+        if (run_index == 37)
+        {
+            throw std::runtime_error("Run 37 failed");
+        }
+        outputs[0] = (double)run_index;
+    }
+};
+
+TEST(campaign_runner_test, rethrows_failures)
+{
+    EXPECT_THROW(CampaignRunner(0), std::invalid_argument);
+
+    CampaignRunner runner(1, 4);
+    runner.chunk_size = 4;
+    const SimulationFactory factory = [](size_t) { return std::make_unique<FailingSimulation>(); };
+    EXPECT_THROW(runner.run(factory, 100, 0), std::runtime_error);
+    EXPECT_EQ(runner.run(factory, 30, 0)[0].get_mean(), 14.5);
+
+    const SimulationFactory failing_factory = [](size_t) -> std::unique_ptr<Simulation>
+    { throw std::runtime_error("No context"); };
+    EXPECT_THROW(runner.run(failing_factory, 10, 0), std::runtime_error);
+}
+
+}
@@ -1,8 +1,119 @@
 #include "conversions.h"
 
+#include <algorithm>
 #include <cmath>
 
-namespace CamSim::Math {
+namespace CamSim::Conversions {
+
+namespace {
+
+// sin and cos of one argument, sharing the range reduction, within about 1 ulp of std::sin and
+// std::cos for |angle_rad| < 1e6.  Unlike the libm calls it has no branches or errno, so loops
+// calling it vectorize.  The rounding trick below relies on strict IEEE arithmetic, so do not build
+// this file with -ffast-math.
+inline void sin_cos(const double angle_rad, double& sin_angle, double& cos_angle)
+{
+    // Cody-Waite reduction to r in [-pi/4, pi/4].  pio2_1 has 33 significant bits, so k * pio2_1 is
+    // exact for any k reached here.
+    constexpr double round_magic = 6755399441055744.0;
+    constexpr double pio2_1 = 1.57079632673412561417e+00;
+    constexpr double pio2_2 = 6.07710050630396597660e-11;
+    constexpr double pio2_3 = 2.02226624871116645580e-21;
+    const double k = (angle_rad * M_2_PI + round_magic) - round_magic;
+    const double r = ((angle_rad - k * pio2_1) - k * pio2_2) - k * pio2_3;
+    const int quadrant = (int)k & 3;
+
+    // fdlibm's __kernel_sin and __kernel_cos polynomials.
+    const double z = r * r;
+    const double sin_r =
+        r + r * z *
+                (-1.66666666666666324348e-01 +
+                 z * (8.33333333332248946124e-03 +
+                      z * (-1.98412698298579493134e-04 +
+                           z * (2.75573137070700676789e-06 +
+                                z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+    const double half_z = 0.5 * z;
+    const double w = 1.0 - half_z;
+    const double cos_r =
+        w + (((1.0 - w) - half_z) +
+             z * z *
+                 (4.16666666666666019037e-02 +
+                  z * (-1.38888888888741095749e-03 +
+                       z * (2.48015872894767294178e-05 +
+                            z * (-2.75573143513906633035e-07 +
+                                 z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11))))));
+
+    // Rotate by the quadrant without branches.
+    const double sin_quadrant = (quadrant & 1) ? cos_r : sin_r;
+    const double cos_quadrant = (quadrant & 1) ? sin_r : cos_r;
+    sin_angle = (quadrant & 2) ? -sin_quadrant : sin_quadrant;
+    cos_angle = ((quadrant + 1) & 2) ? -cos_quadrant : cos_quadrant;
+}
+
+// Cube root of a value in [1, 1.1], which is all Vermeille's method needs.  Newton's method from a
+// second order guess converges to full precision in two steps and, unlike std::cbrt, vectorizes.
+inline double cbrt_near_one(const double value)
+{
+    const double x = value - 1.0;
+    double root = 1.0 + x * (1.0 / 3.0 - x * (1.0 / 9.0));
+    for (int i = 0; i < 2; i++)
+    {
+        root -= (root * root * root - value) / (3.0 * root * root);
+    }
+
+    return root;
+}
+
+// The algebraic part of Vermeille's ECEF to geodetic conversion.  Returns the geodetic altitude and
+// the denominator of the half angle formula for latitude, latitude = 2 atan2(z, denominator).
+inline void ecef_to_geodetic_meridian(
+    const double x_m,
+    const double y_m,
+    const double z_m,
+    double& latitude_denominator,
+    double& altitude_m)
+{
+    constexpr double a = Model::WGS84Ellipsoid::semi_major_axis;
+    constexpr double e2 = Model::WGS84Ellipsoid::eccentricity_squared;
+    constexpr double e4 = e2 * e2;
+
+    const double p2 = x_m * x_m + y_m * y_m;
+    const double p = p2 / (a * a);
+    const double q = (1 - e2) * z_m * z_m / (a * a);
+    const double r = (p + q - e4) / 6.0;
+    const double s = e4 * p * q / (4.0 * r * r * r);
+    const double t = cbrt_near_one(1.0 + s + std::sqrt(s * (2.0 + s)));
+    const double u = r * (1.0 + t + 1.0 / t);
+    const double v = std::sqrt(u * u + e4 * q);
+    const double w = e2 * (u + v - q) / (2.0 * v);
+    const double k = std::sqrt(u + v + w * w) - w;
+    const double d = k * std::sqrt(p2) / (k + e2);
+    const double hypotenuse = std::sqrt(d * d + z_m * z_m);
+
+    latitude_denominator = d + hypotenuse;
+    altitude_m = (k + e2 - 1.0) / k * hypotenuse;
+}
+
+// Points converted per block by the batch kernels.  The vectorized part of each block fills small
+// arrays that the atan2 pass then reads, as atan2 only vectorizes with a vector math library.
+constexpr size_t batch_block_size = 64;
+
+// Distance from the polar axis and height above the equatorial plane of a geodetic point.
+inline void geodetic_to_meridian(
+    const double sin_lattitude,
+    const double cos_lattitude,
+    const double altitude_m,
+    double& p_m,
+    double& z_m)
+{
+    const double radius_of_curvature =
+        Model::WGS84Ellipsoid::radius_of_curvature_from_sin(sin_lattitude);
+    p_m = (radius_of_curvature + altitude_m) * cos_lattitude;
+    z_m = (radius_of_curvature * (1 - Model::WGS84Ellipsoid::eccentricity_squared) + altitude_m) *
+          sin_lattitude;
+}
+
+}
 
 double deg_to_rad(const double angle_deg)
 {
@@ -19,13 +130,10 @@ std::tuple<const double, const double, const double> lla_to_geocentric_rad(
     const double longitude_rad,
     const double altitude_m)
 {
-    const double radius_of_curvature = Model::WGS84Ellipsoid::radius_of_curvature(lattitude_rad);
-    const double p = (radius_of_curvature + altitude_m) * std::cos(lattitude_rad);
-    const double z =
-        (radius_of_curvature * (1 - Model::WGS84Ellipsoid::eccentricity_squared) + altitude_m) *
-        std::sin(lattitude_rad);
+    double p, z;
+    geodetic_to_meridian(std::sin(lattitude_rad), std::cos(lattitude_rad), altitude_m, p, z);
     const double radius_m = std::sqrt(p * p + z * z);
-    const double phi_rad = std::asin(z / radius_m);
+    const double phi_rad = std::atan2(z, p);
 
     return std::tuple<const double, const double, const double>{longitude_rad, phi_rad, radius_m};
 }
@@ -46,4 +154,158 @@ std::tuple<const double, const double, const double> lla_to_geocentric_deg(
     return std::tuple<const double, const double, const double>{longitude_deg, phi_deg, radius_m};
 }
 
+std::tuple<const double, const double, const double> lla_to_ecef_rad(
+    const double lattitude_rad,
+    const double longitude_rad,
+    const double altitude_m)
+{
+    double p, z;
+    geodetic_to_meridian(std::sin(lattitude_rad), std::cos(lattitude_rad), altitude_m, p, z);
+
+    return std::tuple<const double, const double, const double>{
+        p * std::cos(longitude_rad), p * std::sin(longitude_rad), z};
+}
+
+std::tuple<const double, const double, const double> ecef_to_geocentric_rad(
+    const double x_m,
+    const double y_m,
+    const double z_m)
+{
+    const double p = std::sqrt(x_m * x_m + y_m * y_m);
+
+    return std::tuple<const double, const double, const double>{
+        std::atan2(y_m, x_m), std::atan2(z_m, p), std::sqrt(p * p + z_m * z_m)};
+}
+
+std::tuple<const double, const double, const double> ecef_to_lla_rad(
+    const double x_m,
+    const double y_m,
+    const double z_m)
+{
+    double latitude_denominator, altitude_m;
+    ecef_to_geodetic_meridian(x_m, y_m, z_m, latitude_denominator, altitude_m);
+
+    return std::tuple<const double, const double, const double>{
+        2.0 * std::atan2(z_m, latitude_denominator), std::atan2(y_m, x_m), altitude_m};
+}
+
+void lla_to_geocentric_rad_batch(
+    const double* __restrict lattitude_rad,
+    const double* __restrict longitude_rad,
+    const double* __restrict altitude_m,
+    double* __restrict theta_rad,
+    double* __restrict phi_rad,
+    double* __restrict radius_m,
+    const size_t count)
+{
+    double p[batch_block_size];
+    double z[batch_block_size];
+    for (size_t start = 0; start < count; start += batch_block_size)
+    {
+        const size_t size = std::min(batch_block_size, count - start);
+
+        CAMSIM_SIMD_LOOP
+        for (size_t j = 0; j < size; j++)
+        {
+            const size_t i = start + j;
+            double sin_lattitude, cos_lattitude;
+            sin_cos(lattitude_rad[i], sin_lattitude, cos_lattitude);
+            geodetic_to_meridian(sin_lattitude, cos_lattitude, altitude_m[i], p[j], z[j]);
+
+            theta_rad[i] = longitude_rad[i];
+            radius_m[i] = std::sqrt(p[j] * p[j] + z[j] * z[j]);
+        }
+
+        for (size_t j = 0; j < size; j++)
+        {
+            phi_rad[start + j] = std::atan2(z[j], p[j]);
+        }
+    }
+}
+
+void lla_to_ecef_rad_batch(
+    const double* __restrict lattitude_rad,
+    const double* __restrict longitude_rad,
+    const double* __restrict altitude_m,
+    double* __restrict x_m,
+    double* __restrict y_m,
+    double* __restrict z_m,
+    const size_t count)
+{
+    CAMSIM_SIMD_LOOP
+    for (size_t i = 0; i < count; i++)
+    {
+        double sin_lattitude, cos_lattitude, sin_longitude, cos_longitude;
+        sin_cos(lattitude_rad[i], sin_lattitude, cos_lattitude);
+        sin_cos(longitude_rad[i], sin_longitude, cos_longitude);
+
+        double p;
+        geodetic_to_meridian(sin_lattitude, cos_lattitude, altitude_m[i], p, z_m[i]);
+        x_m[i] = p * cos_longitude;
+        y_m[i] = p * sin_longitude;
+    }
+}
+
+void ecef_to_geocentric_rad_batch(
+    const double* __restrict x_m,
+    const double* __restrict y_m,
+    const double* __restrict z_m,
+    double* __restrict theta_rad,
+    double* __restrict phi_rad,
+    double* __restrict radius_m,
+    const size_t count)
+{
+    double p[batch_block_size];
+    for (size_t start = 0; start < count; start += batch_block_size)
+    {
+        const size_t size = std::min(batch_block_size, count - start);
+
+        CAMSIM_SIMD_LOOP
+        for (size_t j = 0; j < size; j++)
+        {
+            const size_t i = start + j;
+            p[j] = std::sqrt(x_m[i] * x_m[i] + y_m[i] * y_m[i]);
+            radius_m[i] = std::sqrt(p[j] * p[j] + z_m[i] * z_m[i]);
+        }
+
+        for (size_t j = 0; j < size; j++)
+        {
+            const size_t i = start + j;
+            theta_rad[i] = std::atan2(y_m[i], x_m[i]);
+            phi_rad[i] = std::atan2(z_m[i], p[j]);
+        }
+    }
+}
+
+void ecef_to_lla_rad_batch(
+    const double* __restrict x_m,
+    const double* __restrict y_m,
+    const double* __restrict z_m,
+    double* __restrict lattitude_rad,
+    double* __restrict longitude_rad,
+    double* __restrict altitude_m,
+    const size_t count)
+{
+    double latitude_denominator[batch_block_size];
+    for (size_t start = 0; start < count; start += batch_block_size)
+    {
+        const size_t size = std::min(batch_block_size, count - start);
+
+        CAMSIM_SIMD_LOOP
+        for (size_t j = 0; j < size; j++)
+        {
+            const size_t i = start + j;
+            ecef_to_geodetic_meridian(
+                x_m[i], y_m[i], z_m[i], latitude_denominator[j], altitude_m[i]);
+        }
+
+        for (size_t j = 0; j < size; j++)
+        {
+            const size_t i = start + j;
+            lattitude_rad[i] = 2.0 * std::atan2(z_m[i], latitude_denominator[j]);
+            longitude_rad[i] = std::atan2(y_m[i], x_m[i]);
+        }
+    }
+}
+
 }
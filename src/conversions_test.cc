@@ -1,6 +1,7 @@
 #include "conversions.h"
 
 #include <gtest/gtest.h>
+#include <random>
 #include <vector>
 
 namespace CamSim::Conversions {
@@ -16,12 +17,140 @@ TEST(lla_to_geocentric_deg_test, latitude_comparison)
 
     for (const double& lattitude_deg : latitude_deg_values)
     {
+        // On the ellipsoid tan(phi) = (1 - f)^2 tan(latitude).
         const double expected_phi_deg =
-            rad_to_deg(std::atan((1 - f * f) * std::tan(deg_to_rad(lattitude_deg))));
+            rad_to_deg(std::atan((1 - f) * (1 - f) * std::tan(deg_to_rad(lattitude_deg))));
         const auto& [theta_deg, test_phi_deg, radius_m] = lla_to_geocentric_deg(lattitude_deg, 6.7, 0.0);
 
-        ASSERT_EQ(expected_phi_deg, test_phi_deg);
+        EXPECT_NEAR(expected_phi_deg, test_phi_deg, 1e-12) << lattitude_deg;
     }
 }
 
+TEST(lla_to_ecef_rad_test, known_points)
+{
+    const double a = Model::WGS84Ellipsoid::semi_major_axis;
+    const double b = a * (1 - Model::WGS84Ellipsoid::flattening);
+
+    const auto [x0, y0, z0] = lla_to_ecef_rad(0.0, 0.0, 0.0);
+    EXPECT_NEAR(x0, a, 1e-6);
+    EXPECT_NEAR(y0, 0.0, 1e-6);
+    EXPECT_NEAR(z0, 0.0, 1e-6);
+
+    const auto [x1, y1, z1] = lla_to_ecef_rad(0.0, M_PI / 2, 100.0);
+    EXPECT_NEAR(x1, 0.0, 1e-6);
+    EXPECT_NEAR(y1, a + 100.0, 1e-6);
+    EXPECT_NEAR(z1, 0.0, 1e-6);
+
+    const auto [x2, y2, z2] = lla_to_ecef_rad(M_PI / 2, 0.3, 0.0);
+    EXPECT_NEAR(x2, 0.0, 1e-6);
+    EXPECT_NEAR(y2, 0.0, 1e-6);
+    EXPECT_NEAR(z2, b, 1e-6);
+}
+
+TEST(batch_conversion_test, matches_scalar)
+{
+    std::mt19937_64 generator(32);
+    std::uniform_real_distribution<double> lattitude(-M_PI / 2, M_PI / 2);
+    std::uniform_real_distribution<double> longitude(-M_PI, M_PI);
+    std::uniform_real_distribution<double> altitude(-500.0, 2000000.0);
+
+    const size_t count = 1001;
+    std::vector<double> lattitude_rad(count), longitude_rad(count), altitude_m(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        lattitude_rad[i] = lattitude(generator);
+        longitude_rad[i] = longitude(generator);
+        altitude_m[i] = altitude(generator);
+    }
+
+    std::vector<double> theta_rad(count), phi_rad(count), radius_m(count);
+    lla_to_geocentric_rad_batch(lattitude_rad.data(), longitude_rad.data(), altitude_m.data(),
+                                theta_rad.data(), phi_rad.data(), radius_m.data(), count);
+
+    std::vector<double> x_m(count), y_m(count), z_m(count);
+    lla_to_ecef_rad_batch(lattitude_rad.data(), longitude_rad.data(), altitude_m.data(), x_m.data(),
+                          y_m.data(), z_m.data(), count);
+
+    std::vector<double> ecef_theta_rad(count), ecef_phi_rad(count), ecef_radius_m(count);
+    ecef_to_geocentric_rad_batch(x_m.data(), y_m.data(), z_m.data(), ecef_theta_rad.data(),
+                                 ecef_phi_rad.data(), ecef_radius_m.data(), count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto [theta, phi, radius] =
+            lla_to_geocentric_rad(lattitude_rad[i], longitude_rad[i], altitude_m[i]);
+        EXPECT_DOUBLE_EQ(theta_rad[i], theta);
+        EXPECT_NEAR(phi_rad[i], phi, 1e-14);
+        EXPECT_NEAR(radius_m[i], radius, 1e-8);
+
+        const auto [x, y, z] = lla_to_ecef_rad(lattitude_rad[i], longitude_rad[i], altitude_m[i]);
+        EXPECT_NEAR(x_m[i], x, 1e-8);
+        EXPECT_NEAR(y_m[i], y, 1e-8);
+        EXPECT_NEAR(z_m[i], z, 1e-8);
+
+        // Going through ECEF gives the same geocentric coordinates.
+        EXPECT_NEAR(ecef_theta_rad[i], longitude_rad[i], 1e-14);
+        EXPECT_NEAR(ecef_phi_rad[i], phi, 1e-14);
+        EXPECT_NEAR(ecef_radius_m[i], radius, 1e-8);
+    }
+}
+
+TEST(ecef_to_lla_rad_test, round_trip)
+{
+    std::mt19937_64 generator(33);
+    std::uniform_real_distribution<double> lattitude(-M_PI / 2, M_PI / 2);
+    std::uniform_real_distribution<double> longitude(-M_PI, M_PI);
+
+    // From below the surface through LEO, GPS and GEO altitudes.
+    const std::vector<std::pair<double, double>> altitudes_m = {
+        {-100e3, 5e-9}, {0.0, 5e-9}, {400e3, 5e-9}, {20200e3, 2e-8}, {35786e3, 3e-8}};
+
+    const size_t count = 2000;
+    for (const auto& [altitude_m, tolerance_m] : altitudes_m)
+    {
+        std::vector<double> x_m(count), y_m(count), z_m(count);
+        std::vector<double> lattitude_rad(count), longitude_rad(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            lattitude_rad[i] = lattitude(generator);
+            longitude_rad[i] = longitude(generator);
+            std::tie(x_m[i], y_m[i], z_m[i]) =
+                lla_to_ecef_rad(lattitude_rad[i], longitude_rad[i], altitude_m);
+        }
+
+        std::vector<double> batch_lattitude_rad(count), batch_longitude_rad(count),
+            batch_altitude_m(count);
+        ecef_to_lla_rad_batch(x_m.data(), y_m.data(), z_m.data(), batch_lattitude_rad.data(),
+                              batch_longitude_rad.data(), batch_altitude_m.data(), count);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const auto [lattitude_rad_out, longitude_rad_out, altitude_m_out] =
+                ecef_to_lla_rad(x_m[i], y_m[i], z_m[i]);
+            EXPECT_NEAR(lattitude_rad_out, lattitude_rad[i], 1e-15);
+            EXPECT_NEAR(longitude_rad_out, longitude_rad[i], 1e-14);
+            EXPECT_NEAR(altitude_m_out, altitude_m, tolerance_m);
+
+            EXPECT_NEAR(batch_lattitude_rad[i], lattitude_rad_out, 1e-15);
+            EXPECT_NEAR(batch_longitude_rad[i], longitude_rad_out, 1e-15);
+            EXPECT_NEAR(batch_altitude_m[i], altitude_m_out, 1e-8);
+        }
+    }
+}
+
+TEST(ecef_to_lla_rad_test, poles_and_equator)
+{
+    const double a = Model::WGS84Ellipsoid::semi_major_axis;
+    const double b = a * (1 - Model::WGS84Ellipsoid::flattening);
+
+    const auto [lattitude0, longitude0, altitude0] = ecef_to_lla_rad(a + 1000.0, 0.0, 0.0);
+    EXPECT_NEAR(lattitude0, 0.0, 1e-15);
+    EXPECT_NEAR(longitude0, 0.0, 1e-15);
+    EXPECT_NEAR(altitude0, 1000.0, 1e-8);
+
+    const auto [lattitude1, longitude1, altitude1] = ecef_to_lla_rad(0.0, 0.0, -(b + 500.0));
+    EXPECT_NEAR(lattitude1, -M_PI / 2, 1e-15);
+    EXPECT_NEAR(altitude1, 500.0, 1e-8);
+}
+
 }
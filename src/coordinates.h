@@ -1,10 +1,836 @@
 #ifndef COORDINATES_H
 #define COORDINATES_H
-#include <gsl/gsl_vector.h>
-#include <stdio.h>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
 
 namespace CamSim::Coordinate {
 
+// Fixed size vectors and matrices for rigid body math.  They are aggregates held by value, so a
+// Vector3 or Matrix3 lives in registers or on the stack, and every loop runs over a compile time
+// bound that the compiler unrolls into straight-line code.  Everything that does not need a square
+// root or a throw is constexpr.
+
+template <size_t N, typename Scalar = double>
+struct Vector
+{
+    Scalar values[N];
+
+    constexpr Scalar& operator[](const size_t i)
+    {
+        return values[i];
+    }
+
+    constexpr Scalar operator[](const size_t i) const
+    {
+        return values[i];
+    }
+
+    constexpr Vector& operator+=(const Vector& other)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            values[i] += other.values[i];
+        }
+
+        return *this;
+    }
+
+    constexpr Vector& operator-=(const Vector& other)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            values[i] -= other.values[i];
+        }
+
+        return *this;
+    }
+
+    constexpr Vector& operator*=(const Scalar& scale)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            values[i] *= scale;
+        }
+
+        return *this;
+    }
+};
+
+template <size_t Rows, size_t Columns, typename Scalar = double>
+struct Matrix
+{
+    Scalar values[Rows][Columns];
+
+    static constexpr Matrix identity()
+    {
+        static_assert(Rows == Columns, "Only square matrices have an identity");
+        Matrix out{};
+        for (size_t i = 0; i < Rows; i++)
+        {
+            out.values[i][i] = 1.0;
+        }
+
+        return out;
+    }
+
+    constexpr Scalar& operator()(const size_t row, const size_t column)
+    {
+        return values[row][column];
+    }
+
+    constexpr Scalar operator()(const size_t row, const size_t column) const
+    {
+        return values[row][column];
+    }
+
+    template <size_t BlockRows, size_t BlockColumns>
+    constexpr Matrix<BlockRows, BlockColumns, Scalar> get_block(
+        const size_t row,
+        const size_t column) const
+    {
+        Matrix<BlockRows, BlockColumns, Scalar> out{};
+        for (size_t i = 0; i < BlockRows; i++)
+        {
+            for (size_t j = 0; j < BlockColumns; j++)
+            {
+                out.values[i][j] = values[row + i][column + j];
+            }
+        }
+
+        return out;
+    }
+
+    template <size_t BlockRows, size_t BlockColumns>
+    constexpr void set_block(
+        const size_t row,
+        const size_t column,
+        const Matrix<BlockRows, BlockColumns, Scalar>& block)
+    {
+        for (size_t i = 0; i < BlockRows; i++)
+        {
+            for (size_t j = 0; j < BlockColumns; j++)
+            {
+                values[row + i][column + j] = block.values[i][j];
+            }
+        }
+    }
+
+    constexpr Matrix& operator+=(const Matrix& other)
+    {
+        for (size_t i = 0; i < Rows; i++)
+        {
+            for (size_t j = 0; j < Columns; j++)
+            {
+                values[i][j] += other.values[i][j];
+            }
+        }
+
+        return *this;
+    }
+
+    constexpr Matrix& operator-=(const Matrix& other)
+    {
+        for (size_t i = 0; i < Rows; i++)
+        {
+            for (size_t j = 0; j < Columns; j++)
+            {
+                values[i][j] -= other.values[i][j];
+            }
+        }
+
+        return *this;
+    }
+
+    constexpr Matrix& operator*=(const Scalar& scale)
+    {
+        for (size_t i = 0; i < Rows; i++)
+        {
+            for (size_t j = 0; j < Columns; j++)
+            {
+                values[i][j] *= scale;
+            }
+        }
+
+        return *this;
+    }
+};
+
+using Vector3 = Vector<3>;
+using Vector6 = Vector<6>;
+using Matrix3 = Matrix<3, 3>;
+using Matrix6 = Matrix<6, 6>;
+
+// Keeps a parameter out of template argument deduction, so the scalar type comes from the vector
+// and matrix arguments and 2.0 * a converts 2.0 to it.
+template <typename T>
+struct TypeIdentity
+{
+    using type = T;
+};
+
+template <typename T>
+using NonDeduced = typename TypeIdentity<T>::type;
+
+template <size_t N, typename Scalar>
+constexpr Vector<N, Scalar> operator+(Vector<N, Scalar> a, const Vector<N, Scalar>& b)
+{
+    return a += b;
+}
+
+template <size_t N, typename Scalar>
+constexpr Vector<N, Scalar> operator-(Vector<N, Scalar> a, const Vector<N, Scalar>& b)
+{
+    return a -= b;
+}
+
+template <size_t N, typename Scalar>
+constexpr Vector<N, Scalar> operator-(Vector<N, Scalar> a)
+{
+    return a *= -1.0;
+}
+
+template <size_t N, typename Scalar>
+constexpr Vector<N, Scalar> operator*(const NonDeduced<Scalar>& scale, Vector<N, Scalar> a)
+{
+    return a *= scale;
+}
+
+template <size_t N, typename Scalar>
+constexpr Scalar dot(const Vector<N, Scalar>& a, const Vector<N, Scalar>& b)
+{
+    Scalar sum{};
+    for (size_t i = 0; i < N; i++)
+    {
+        sum += a[i] * b[i];
+    }
+
+    return sum;
+}
+
+template <size_t N, typename Scalar>
+constexpr Scalar squared_norm(const Vector<N, Scalar>& a)
+{
+    return dot(a, a);
+}
+
+template <size_t N, typename Scalar>
+inline Scalar norm(const Vector<N, Scalar>& a)
+{
+    using std::sqrt;
+    return sqrt(squared_norm(a));
+}
+
+template <size_t N, typename Scalar>
+inline Vector<N, Scalar> normalized(const Vector<N, Scalar>& a)
+{
+    return (1.0 / norm(a)) * a;
+}
+
+// The M entries of a starting at start.
+template <size_t M, size_t N, typename Scalar>
+constexpr Vector<M, Scalar> get_segment(const Vector<N, Scalar>& a, const size_t start)
+{
+    Vector<M, Scalar> out{};
+    for (size_t i = 0; i < M; i++)
+    {
+        out[i] = a[start + i];
+    }
+
+    return out;
+}
+
+template <size_t M, size_t N, typename Scalar>
+constexpr void set_segment(
+    Vector<N, Scalar>& a,
+    const size_t start,
+    const Vector<M, Scalar>& segment)
+{
+    for (size_t i = 0; i < M; i++)
+    {
+        a[start + i] = segment[i];
+    }
+}
+
+// [a; b]
+template <typename Scalar>
+constexpr Vector<6, Scalar> stack(const Vector<3, Scalar>& a, const Vector<3, Scalar>& b)
+{
+    return Vector<6, Scalar>{a[0], a[1], a[2], b[0], b[1], b[2]};
+}
+
+template <size_t Rows, size_t Columns, typename Scalar>
+constexpr Matrix<Rows, Columns, Scalar> operator+(
+    Matrix<Rows, Columns, Scalar> a,
+    const Matrix<Rows, Columns, Scalar>& b)
+{
+    return a += b;
+}
+
+template <size_t Rows, size_t Columns, typename Scalar>
+constexpr Matrix<Rows, Columns, Scalar> operator-(
+    Matrix<Rows, Columns, Scalar> a,
+    const Matrix<Rows, Columns, Scalar>& b)
+{
+    return a -= b;
+}
+
+template <size_t Rows, size_t Columns, typename Scalar>
+constexpr Matrix<Rows, Columns, Scalar> operator-(Matrix<Rows, Columns, Scalar> a)
+{
+    return a *= -1.0;
+}
+
+template <size_t Rows, size_t Columns, typename Scalar>
+constexpr Matrix<Rows, Columns, Scalar> operator*(
+    const NonDeduced<Scalar>& scale,
+    Matrix<Rows, Columns, Scalar> a)
+{
+    return a *= scale;
+}
+
+template <size_t Rows, size_t Columns, typename Scalar>
+constexpr Vector<Rows, Scalar> operator*(
+    const Matrix<Rows, Columns, Scalar>& a,
+    const Vector<Columns, Scalar>& b)
+{
+    Vector<Rows, Scalar> out{};
+    for (size_t i = 0; i < Rows; i++)
+    {
+        for (size_t j = 0; j < Columns; j++)
+        {
+            out[i] += a(i, j) * b[j];
+        }
+    }
+
+    return out;
+}
+
+template <size_t Rows, size_t Inner, size_t Columns, typename Scalar>
+constexpr Matrix<Rows, Columns, Scalar> operator*(
+    const Matrix<Rows, Inner, Scalar>& a,
+    const Matrix<Inner, Columns, Scalar>& b)
+{
+    Matrix<Rows, Columns, Scalar> out{};
+    for (size_t i = 0; i < Rows; i++)
+    {
+        for (size_t k = 0; k < Inner; k++)
+        {
+            for (size_t j = 0; j < Columns; j++)
+            {
+                out(i, j) += a(i, k) * b(k, j);
+            }
+        }
+    }
+
+    return out;
+}
+
+template <size_t Rows, size_t Columns, typename Scalar>
+constexpr Matrix<Columns, Rows, Scalar> transpose(const Matrix<Rows, Columns, Scalar>& a)
+{
+    Matrix<Columns, Rows, Scalar> out{};
+    for (size_t i = 0; i < Rows; i++)
+    {
+        for (size_t j = 0; j < Columns; j++)
+        {
+            out(j, i) = a(i, j);
+        }
+    }
+
+    return out;
+}
+
+// a * b^T
+template <size_t M, size_t N, typename Scalar>
+constexpr Matrix<M, N, Scalar> outer(const Vector<M, Scalar>& a, const Vector<N, Scalar>& b)
+{
+    Matrix<M, N, Scalar> out{};
+    for (size_t i = 0; i < M; i++)
+    {
+        for (size_t j = 0; j < N; j++)
+        {
+            out(i, j) = a[i] * b[j];
+        }
+    }
+
+    return out;
+}
+
+template <size_t N, typename Scalar>
+constexpr Scalar trace(const Matrix<N, N, Scalar>& a)
+{
+    Scalar sum{};
+    for (size_t i = 0; i < N; i++)
+    {
+        sum += a(i, i);
+    }
+
+    return sum;
+}
+
+template <typename Scalar>
+constexpr Scalar determinant(const Matrix<3, 3, Scalar>& a)
+{
+    return a(0, 0) * (a(1, 1) * a(2, 2) - a(1, 2) * a(2, 1)) +
+           a(0, 1) * (a(1, 2) * a(2, 0) - a(1, 0) * a(2, 2)) +
+           a(0, 2) * (a(1, 0) * a(2, 1) - a(1, 1) * a(2, 0));
+}
+
+// Throws std::invalid_argument if the matrix is singular.
+inline Matrix3 inverse(const Matrix3& a)
+{
+    const double c00 = a(1, 1) * a(2, 2) - a(1, 2) * a(2, 1);
+    const double c01 = a(1, 2) * a(2, 0) - a(1, 0) * a(2, 2);
+    const double c02 = a(1, 0) * a(2, 1) - a(1, 1) * a(2, 0);
+    const double determinant = a(0, 0) * c00 + a(0, 1) * c01 + a(0, 2) * c02;
+    if (determinant == 0.0 || !std::isfinite(determinant))
+    {
+        throw std::invalid_argument("Matrix is singular");
+    }
+    const double scale = 1.0 / determinant;
+
+    return Matrix3{{{c00 * scale, (a(0, 2) * a(2, 1) - a(0, 1) * a(2, 2)) * scale,
+                     (a(0, 1) * a(1, 2) - a(0, 2) * a(1, 1)) * scale},
+                    {c01 * scale, (a(0, 0) * a(2, 2) - a(0, 2) * a(2, 0)) * scale,
+                     (a(0, 2) * a(1, 0) - a(0, 0) * a(1, 2)) * scale},
+                    {c02 * scale, (a(0, 1) * a(2, 0) - a(0, 0) * a(2, 1)) * scale,
+                     (a(0, 0) * a(1, 1) - a(0, 1) * a(1, 0)) * scale}}};
+}
+
+// The skew symmetric matrix with tilde(a) * b = a x b.
+template <typename Scalar>
+constexpr Matrix<3, 3, Scalar> tilde(const Vector<3, Scalar>& a)
+{
+    return Matrix<3, 3, Scalar>{{{0.0, -a[2], a[1]}, {a[2], 0.0, -a[0]}, {-a[1], a[0], 0.0}}};
+}
+
+template <typename Scalar>
+constexpr Vector<3, Scalar> cross(const Vector<3, Scalar>& a, const Vector<3, Scalar>& b)
+{
+    return Vector<3, Scalar>{a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2],
+                             a[0] * b[1] - a[1] * b[0]};
+}
+
+// Modified Rodrigues parameters, following Schaub and Junkins and experimentation/uk_revolute.py.
+// sigma = e tan(phi / 4) for a rotation of phi about e, and mrp_to_dcm gives the matrix taking
+// vectors from the reference frame to the body frame.
+
+template <typename Scalar>
+constexpr Matrix<3, 3, Scalar> mrp_to_dcm(const Vector<3, Scalar>& sigma)
+{
+    const Matrix<3, 3, Scalar> sigma_tilde = tilde(sigma);
+    const Scalar sigma_squared = dot(sigma, sigma);
+    const Scalar denominator = (1.0 + sigma_squared) * (1.0 + sigma_squared);
+
+    return Matrix<3, 3, Scalar>::identity() +
+           (1.0 / denominator) *
+               (8.0 * (sigma_tilde * sigma_tilde) - 4.0 * (1.0 - sigma_squared) * sigma_tilde);
+}
+
+// sigma_dot = 1 / 4 * B * omega
+template <typename Scalar>
+constexpr Matrix<3, 3, Scalar> mrp_b_matrix(const Vector<3, Scalar>& sigma)
+{
+    return (1.0 - dot(sigma, sigma)) * Matrix<3, 3, Scalar>::identity() + 2.0 * tilde(sigma) +
+           2.0 * outer(sigma, sigma);
+}
+
+template <typename Scalar>
+constexpr Matrix<3, 3, Scalar> mrp_b_dot_matrix(
+    const Vector<3, Scalar>& sigma,
+    const Vector<3, Scalar>& sigma_dot)
+{
+    return (-2.0 * dot(sigma, sigma_dot)) * Matrix<3, 3, Scalar>::identity() +
+           2.0 * tilde(sigma_dot) + 2.0 * outer(sigma_dot, sigma) + 2.0 * outer(sigma, sigma_dot);
+}
+
+// omega = 4 * B^-1 * sigma_dot
+template <typename Scalar>
+constexpr Matrix<3, 3, Scalar> mrp_b_inv_matrix(const Vector<3, Scalar>& sigma)
+{
+    const Scalar sigma_squared = dot(sigma, sigma);
+
+    return (1.0 / ((1.0 + sigma_squared) * (1.0 + sigma_squared))) *
+           ((1.0 - sigma_squared) * Matrix<3, 3, Scalar>::identity() - 2.0 * tilde(sigma) +
+            2.0 * outer(sigma, sigma));
+}
+
+template <typename Scalar>
+constexpr Matrix<3, 3, Scalar> mrp_b_inv_dot_matrix(
+    const Vector<3, Scalar>& sigma,
+    const Vector<3, Scalar>& sigma_dot)
+{
+    const Scalar sigma_squared = dot(sigma, sigma);
+    const Scalar sigma_dot_sigma = dot(sigma, sigma_dot);
+    const Scalar one_plus = 1.0 + sigma_squared;
+
+    const Matrix<3, 3, Scalar> derivative_term =
+        (-2.0 * sigma_dot_sigma) * Matrix<3, 3, Scalar>::identity() - 2.0 * tilde(sigma_dot) +
+        2.0 * outer(sigma_dot, sigma) + 2.0 * outer(sigma, sigma_dot);
+    const Matrix<3, 3, Scalar> b_inv_numerator = (1.0 - sigma_squared) *
+                                                     Matrix<3, 3, Scalar>::identity() -
+                                                 2.0 * tilde(sigma) + 2.0 * outer(sigma, sigma);
+
+    return (1.0 / (one_plus * one_plus * one_plus)) *
+           (one_plus * derivative_term - (4.0 * sigma_dot_sigma) * b_inv_numerator);
+}
+
+// Switches sigma to its shadow set when |sigma| > 1, along with its rate, so the attitude stays
+// away from the singularity at 360 degrees.  Returns whether it switched.
+constexpr bool mrp_switch_to_shadow(Vector3& sigma, Vector3& sigma_dot)
+{
+    const double sigma_squared = dot(sigma, sigma);
+    if (sigma_squared <= 1.0)
+    {
+        return false;
+    }
+
+    // d/dt (-sigma / |sigma|^2)
+    const double sigma_dot_sigma = dot(sigma, sigma_dot);
+    sigma_dot = (-1.0 / sigma_squared) * sigma_dot +
+                (2.0 * sigma_dot_sigma / (sigma_squared * sigma_squared)) * sigma;
+    sigma = (-1.0 / sigma_squared) * sigma;
+
+    return true;
+}
+
+// Euler parameters, scalar first, in the same convention as the MRPs: beta = (cos(phi / 2),
+// e sin(phi / 2)).  Products compose like their matrices, so
+// quaternion_to_dcm(a * b) == quaternion_to_dcm(a) * quaternion_to_dcm(b).
+struct Quaternion
+{
+    double w;
+    double x;
+    double y;
+    double z;
+
+    static constexpr Quaternion identity()
+    {
+        return Quaternion{1.0, 0.0, 0.0, 0.0};
+    }
+
+    constexpr Vector3 vector() const
+    {
+        return Vector3{x, y, z};
+    }
+};
+
+constexpr Quaternion operator*(const Quaternion& a, const Quaternion& b)
+{
+    return Quaternion{a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+                      a.x * b.w + a.w * b.x + a.z * b.y - a.y * b.z,
+                      a.y * b.w - a.z * b.x + a.w * b.y + a.x * b.z,
+                      a.z * b.w + a.y * b.x - a.x * b.y + a.w * b.z};
+}
+
+// The inverse rotation of a unit quaternion.
+constexpr Quaternion conjugate(const Quaternion& q)
+{
+    return Quaternion{q.w, -q.x, -q.y, -q.z};
+}
+
+inline Quaternion normalized(const Quaternion& q)
+{
+    const double scale = 1.0 / std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+
+    return Quaternion{scale * q.w, scale * q.x, scale * q.y, scale * q.z};
+}
+
+constexpr Matrix3 quaternion_to_dcm(const Quaternion& q)
+{
+    const double w2 = q.w * q.w;
+    const double x2 = q.x * q.x;
+    const double y2 = q.y * q.y;
+    const double z2 = q.z * q.z;
+
+    return Matrix3{{{w2 + x2 - y2 - z2, 2.0 * (q.x * q.y + q.w * q.z),
+                     2.0 * (q.x * q.z - q.w * q.y)},
+                    {2.0 * (q.x * q.y - q.w * q.z), w2 - x2 + y2 - z2,
+                     2.0 * (q.y * q.z + q.w * q.x)},
+                    {2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x),
+                     w2 - x2 - y2 + z2}}};
+}
+
+// Sheppard's method, taking the square root of the largest of the squared parameters so the
+// result stays accurate for every rotation.  Returns w >= 0.
+inline Quaternion dcm_to_quaternion(const Matrix3& dcm)
+{
+    const double t = trace(dcm);
+    const double squares[4] = {(1.0 + t) / 4.0, (1.0 + 2.0 * dcm(0, 0) - t) / 4.0,
+                               (1.0 + 2.0 * dcm(1, 1) - t) / 4.0,
+                               (1.0 + 2.0 * dcm(2, 2) - t) / 4.0};
+    int largest = 0;
+    for (int i = 1; i < 4; i++)
+    {
+        largest = squares[i] > squares[largest] ? i : largest;
+    }
+
+    const double wx = (dcm(1, 2) - dcm(2, 1)) / 4.0;
+    const double wy = (dcm(2, 0) - dcm(0, 2)) / 4.0;
+    const double wz = (dcm(0, 1) - dcm(1, 0)) / 4.0;
+    const double yz = (dcm(1, 2) + dcm(2, 1)) / 4.0;
+    const double zx = (dcm(2, 0) + dcm(0, 2)) / 4.0;
+    const double xy = (dcm(0, 1) + dcm(1, 0)) / 4.0;
+
+    Quaternion q{};
+    const double root = std::sqrt(squares[largest]);
+    switch (largest)
+    {
+    case 0:
+        q = Quaternion{root, wx / root, wy / root, wz / root};
+        break;
+    case 1:
+        q = Quaternion{wx / root, root, xy / root, zx / root};
+        break;
+    case 2:
+        q = Quaternion{wy / root, xy / root, root, yz / root};
+        break;
+    default:
+        q = Quaternion{wz / root, zx / root, yz / root, root};
+        break;
+    }
+
+    return q.w < 0.0 ? Quaternion{-q.w, -q.x, -q.y, -q.z} : q;
+}
+
+constexpr Quaternion mrp_to_quaternion(const Vector3& sigma)
+{
+    const double sigma_squared = dot(sigma, sigma);
+    const double scale = 2.0 / (1.0 + sigma_squared);
+
+    return Quaternion{(1.0 - sigma_squared) / (1.0 + sigma_squared), scale * sigma[0],
+                      scale * sigma[1], scale * sigma[2]};
+}
+
+// The MRPs with |sigma| <= 1, taking the short way round.
+constexpr Vector3 quaternion_to_mrp(const Quaternion& q)
+{
+    const double sign = q.w < 0.0 ? -1.0 : 1.0;
+
+    return (sign / (1.0 + sign * q.w)) * q.vector();
+}
+
+inline Vector3 dcm_to_mrp(const Matrix3& dcm)
+{
+    return quaternion_to_mrp(dcm_to_quaternion(dcm));
+}
+
+// One value from each of Count independent simulations, for evaluating the same formula for all of
+// them at once.  Every operation is a loop over the lanes that the compiler turns into SIMD
+// instructions, and Vector<3, Lanes<8>> or Matrix<3, 3, Lanes<8>> work like Vector3 and Matrix3
+// with each entry held for eight simulations side by side.  Doubles convert implicitly by filling
+// every lane.
+template <size_t Count>
+struct Lanes
+{
+    double values[Count];
+
+    constexpr Lanes() : values{}
+    {
+    }
+
+    constexpr Lanes(const double value) : values{}
+    {
+        for (size_t lane = 0; lane < Count; lane++)
+        {
+            values[lane] = value;
+        }
+    }
+
+    constexpr double& operator[](const size_t lane)
+    {
+        return values[lane];
+    }
+
+    constexpr double operator[](const size_t lane) const
+    {
+        return values[lane];
+    }
+
+    constexpr Lanes& operator+=(const Lanes& other)
+    {
+        for (size_t lane = 0; lane < Count; lane++)
+        {
+            values[lane] += other.values[lane];
+        }
+
+        return *this;
+    }
+
+    constexpr Lanes& operator-=(const Lanes& other)
+    {
+        for (size_t lane = 0; lane < Count; lane++)
+        {
+            values[lane] -= other.values[lane];
+        }
+
+        return *this;
+    }
+
+    constexpr Lanes& operator*=(const Lanes& other)
+    {
+        for (size_t lane = 0; lane < Count; lane++)
+        {
+            values[lane] *= other.values[lane];
+        }
+
+        return *this;
+    }
+
+    constexpr Lanes& operator/=(const Lanes& other)
+    {
+        for (size_t lane = 0; lane < Count; lane++)
+        {
+            values[lane] /= other.values[lane];
+        }
+
+        return *this;
+    }
+
+    friend constexpr Lanes operator+(Lanes a, const Lanes& b)
+    {
+        return a += b;
+    }
+
+    friend constexpr Lanes operator-(Lanes a, const Lanes& b)
+    {
+        return a -= b;
+    }
+
+    friend constexpr Lanes operator*(Lanes a, const Lanes& b)
+    {
+        return a *= b;
+    }
+
+    friend constexpr Lanes operator/(Lanes a, const Lanes& b)
+    {
+        return a /= b;
+    }
+
+    friend constexpr Lanes operator-(Lanes a)
+    {
+        for (size_t lane = 0; lane < Count; lane++)
+        {
+            a.values[lane] = -a.values[lane];
+        }
+
+        return a;
+    }
+
+    friend Lanes sqrt(Lanes a)
+    {
+        for (size_t lane = 0; lane < Count; lane++)
+        {
+            a.values[lane] = std::sqrt(a.values[lane]);
+        }
+
+        return a;
+    }
+
+    friend Lanes cos(Lanes a)
+    {
+        for (size_t lane = 0; lane < Count; lane++)
+        {
+            a.values[lane] = std::cos(a.values[lane]);
+        }
+
+        return a;
+    }
+
+    friend Lanes sin(Lanes a)
+    {
+        for (size_t lane = 0; lane < Count; lane++)
+        {
+            a.values[lane] = std::sin(a.values[lane]);
+        }
+
+        return a;
+    }
+};
+
+// The number of simulations a scalar type holds, 1 for double.
+template <typename Scalar>
+constexpr size_t lane_count = 1;
+
+template <size_t Count>
+constexpr size_t lane_count<Lanes<Count>> = Count;
+
+// Lane access that treats a double as a single lane, so code written for any scalar type can move
+// values between one simulation and a set of lanes.
+constexpr double get_lane(const double value, const size_t)
+{
+    return value;
+}
+
+template <size_t Count>
+constexpr double get_lane(const Lanes<Count>& value, const size_t lane)
+{
+    return value[lane];
+}
+
+constexpr void set_lane(double& value, const size_t, const double lane_value)
+{
+    value = lane_value;
+}
+
+template <size_t Count>
+constexpr void set_lane(Lanes<Count>& value, const size_t lane, const double lane_value)
+{
+    value[lane] = lane_value;
+}
+
+template <size_t N, typename Scalar>
+constexpr Vector<N> get_lane(const Vector<N, Scalar>& a, const size_t lane)
+{
+    Vector<N> out{};
+    for (size_t i = 0; i < N; i++)
+    {
+        out[i] = get_lane(a[i], lane);
+    }
+
+    return out;
+}
+
+template <size_t N, typename Scalar>
+constexpr void set_lane(Vector<N, Scalar>& a, const size_t lane, const Vector<N>& lane_value)
+{
+    for (size_t i = 0; i < N; i++)
+    {
+        set_lane(a[i], lane, lane_value[i]);
+    }
+}
+
+template <size_t Rows, size_t Columns, typename Scalar>
+constexpr Matrix<Rows, Columns> get_lane(const Matrix<Rows, Columns, Scalar>& a, const size_t lane)
+{
+    Matrix<Rows, Columns> out{};
+    for (size_t i = 0; i < Rows; i++)
+    {
+        for (size_t j = 0; j < Columns; j++)
+        {
+            out(i, j) = get_lane(a(i, j), lane);
+        }
+    }
+
+    return out;
+}
+
+template <size_t Rows, size_t Columns, typename Scalar>
+constexpr void set_lane(
+    Matrix<Rows, Columns, Scalar>& a,
+    const size_t lane,
+    const Matrix<Rows, Columns>& lane_value)
+{
+    for (size_t i = 0; i < Rows; i++)
+    {
+        for (size_t j = 0; j < Columns; j++)
+        {
+            set_lane(a(i, j), lane, lane_value(i, j));
+        }
+    }
+}
+
 }
 
 #endif
@@ -0,0 +1,122 @@
+#include "coordinates.h"
+
+#include <gtest/gtest.h>
+
+namespace CamSim::Coordinate {
+
+template <size_t Rows, size_t Columns>
+void expect_matrix_near(
+    const Matrix<Rows, Columns>& actual,
+    const Matrix<Rows, Columns>& expected,
+    const double tolerance)
+{
+    for (size_t i = 0; i < Rows; i++)
+    {
+        for (size_t j = 0; j < Columns; j++)
+        {
+            EXPECT_NEAR(actual(i, j), expected(i, j), tolerance) << i << ", " << j;
+        }
+    }
+}
+
+void expect_quaternion_near(
+    const Quaternion& actual,
+    const Quaternion& expected,
+    const double tolerance)
+{
+    EXPECT_NEAR(actual.w, expected.w, tolerance);
+    EXPECT_NEAR(actual.x, expected.x, tolerance);
+    EXPECT_NEAR(actual.y, expected.y, tolerance);
+    EXPECT_NEAR(actual.z, expected.z, tolerance);
+}
+
+// A rotation of angle about axis, as Euler parameters.
+Quaternion axis_angle(const Vector3& axis, const double angle)
+{
+    const Vector3 e = std::sin(angle / 2.0) * normalized(axis);
+
+    return Quaternion{std::cos(angle / 2.0), e[0], e[1], e[2]};
+}
+
+TEST(coordinates_test, constant_expressions)
+{
+    constexpr Vector3 a{1.0, 2.0, 3.0};
+    constexpr Vector3 b{-2.0, 0.5, 4.0};
+    static_assert(dot(a, b) == 11.0);
+    static_assert(cross(a, b)[0] == 6.5 && cross(a, b)[1] == -10.0 && cross(a, b)[2] == 4.5);
+    static_assert((tilde(a) * b)[0] == cross(a, b)[0]);
+    static_assert(determinant(Matrix3::identity()) == 1.0);
+    static_assert(transpose(outer(a, b))(2, 0) == 4.0);
+
+    constexpr Matrix3 dcm = mrp_to_dcm(Vector3{0.0, 0.0, 0.0});
+    static_assert(dcm(0, 0) == 1.0 && dcm(0, 1) == 0.0);
+    constexpr Quaternion q = mrp_to_quaternion(Vector3{0.0, 0.0, 1.0});
+    static_assert(q.w == 0.0 && q.z == 1.0);
+
+    constexpr Vector6 stacked = stack(a, b);
+    static_assert(get_segment<3>(stacked, 3)[2] == 4.0);
+}
+
+TEST(coordinates_test, matrix_algebra)
+{
+    const Matrix3 a{{{2.0, 0.1, 0.0}, {0.1, 3.0, 0.2}, {0.0, 0.2, 4.0}}};
+    expect_matrix_near(a * inverse(a), Matrix3::identity(), 1e-15);
+    EXPECT_NEAR(determinant(a), 2.0 * (12.0 - 0.04) - 0.1 * 0.4, 1e-14);
+    EXPECT_THROW(inverse(Matrix3{}), std::invalid_argument);
+
+    // Block access on a 6 x 6 matrix.
+    Matrix6 m = Matrix6::identity();
+    m.set_block(0, 3, a);
+    m.set_block(3, 0, transpose(a));
+    const Vector6 x{1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+    const Vector6 y = m * x;
+    const Vector3 top = get_segment<3>(x, 0) + a * get_segment<3>(x, 3);
+    const Vector3 bottom = transpose(a) * get_segment<3>(x, 0) + get_segment<3>(x, 3);
+    for (size_t i = 0; i < 3; i++)
+    {
+        EXPECT_DOUBLE_EQ(y[i], top[i]);
+        EXPECT_DOUBLE_EQ(y[3 + i], bottom[i]);
+    }
+    expect_matrix_near(m.get_block<3, 3>(0, 3), a, 0.0);
+    expect_matrix_near(transpose(m) * m - m * m, Matrix6{}, 0.0);
+}
+
+TEST(coordinates_test, attitude_representations_agree)
+{
+    const Quaternion a = axis_angle(Vector3{1.0, -2.0, 0.5}, 0.7);
+    const Quaternion b = axis_angle(Vector3{0.3, 0.2, -1.0}, 2.9);
+
+    // Euler parameters and MRPs give the same matrix, and convert back.
+    const Vector3 sigma = quaternion_to_mrp(a);
+    expect_matrix_near(quaternion_to_dcm(a), mrp_to_dcm(sigma), 1e-15);
+    expect_quaternion_near(mrp_to_quaternion(sigma), a, 1e-15);
+    expect_quaternion_near(dcm_to_quaternion(quaternion_to_dcm(a)), a, 1e-15);
+
+    // Products compose like matrices, and the conjugate undoes a rotation.
+    expect_matrix_near(
+        quaternion_to_dcm(a * b), quaternion_to_dcm(a) * quaternion_to_dcm(b), 1e-15);
+    expect_quaternion_near(a * conjugate(a), Quaternion::identity(), 1e-15);
+
+    // A rotation of 90 degrees about z takes the reference x axis to the body -y axis.
+    const Matrix3 quarter_turn = quaternion_to_dcm(axis_angle(Vector3{0.0, 0.0, 1.0}, M_PI / 2.0));
+    const Vector3 x_in_body = quarter_turn * Vector3{1.0, 0.0, 0.0};
+    EXPECT_NEAR(x_in_body[0], 0.0, 1e-15);
+    EXPECT_NEAR(x_in_body[1], -1.0, 1e-15);
+
+    // Half turns, where the scalar part vanishes and Sheppard's method picks a vector part.
+    for (const Vector3& axis : {Vector3{1.0, 0.0, 0.0}, Vector3{0.0, 1.0, 0.0},
+                                Vector3{0.0, 0.0, 1.0}, Vector3{1.0, 1.0, 1.0}})
+    {
+        const Matrix3 half_turn = quaternion_to_dcm(axis_angle(axis, M_PI));
+        expect_matrix_near(quaternion_to_dcm(dcm_to_quaternion(half_turn)), half_turn, 1e-15);
+        EXPECT_NEAR(squared_norm(dcm_to_mrp(half_turn)), 1.0, 1e-15);
+    }
+
+    // The short way round keeps |sigma| <= 1.
+    const Quaternion long_way = axis_angle(Vector3{0.0, 1.0, 0.0}, 1.5 * M_PI);
+    const Vector3 short_sigma = quaternion_to_mrp(long_way);
+    EXPECT_LT(squared_norm(short_sigma), 1.0);
+    expect_matrix_near(mrp_to_dcm(short_sigma), quaternion_to_dcm(long_way), 1e-15);
+}
+
+}
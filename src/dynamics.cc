@@ -0,0 +1,1485 @@
+#include "dynamics.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace CamSim::Dynamics {
+
+namespace {
+
+constexpr size_t block_size = 6;
+constexpr size_t block_entries = block_size * block_size;
+
+// Factors P^T block P = L L^T for a symmetric positive semidefinite block in place, keeping L in
+// the lower triangle and pivoting on the largest remaining diagonal.  Pivots at or below tolerance
+// are dropped, along with every later one, and the rank is returned.
+int factor_block(double* block, int* permutation, const double tolerance)
+{
+    for (int i = 0; i < (int)block_size; i++)
+    {
+        permutation[i] = i;
+    }
+
+    const int n = block_size;
+    int rank = 0;
+    for (; rank < n; rank++)
+    {
+        const int k = rank;
+        int pivot = k;
+        for (int i = k + 1; i < n; i++)
+        {
+            pivot = block[i * n + i] > block[pivot * n + pivot] ? i : pivot;
+        }
+        if (!(block[pivot * n + pivot] > tolerance))
+        {
+            break;
+        }
+
+        if (pivot != k)
+        {
+            std::swap(permutation[k], permutation[pivot]);
+            for (int i = 0; i < n; i++)
+            {
+                std::swap(block[k * n + i], block[pivot * n + i]);
+            }
+            for (int i = 0; i < n; i++)
+            {
+                std::swap(block[i * n + k], block[i * n + pivot]);
+            }
+        }
+
+        const double diagonal = std::sqrt(block[k * n + k]);
+        block[k * n + k] = diagonal;
+        for (int i = k + 1; i < n; i++)
+        {
+            block[i * n + k] /= diagonal;
+        }
+        // Update the whole trailing block, as later pivot swaps read both of its triangles.
+        for (int i = k + 1; i < n; i++)
+        {
+            for (int j = k + 1; j < n; j++)
+            {
+                block[i * n + j] -= block[i * n + k] * block[j * n + k];
+            }
+        }
+    }
+
+    return rank;
+}
+
+// values = L^-1 (P^T values) on the leading rank rows of a 6 x columns row major array, with the
+// rows from rank on zeroed, for a factor from factor_block.
+void forward_substitute(
+    const double* factor,
+    const int* permutation,
+    const int rank,
+    double* values,
+    const size_t columns)
+{
+    double permuted[block_entries];
+    for (size_t i = 0; i < block_size; i++)
+    {
+        for (size_t j = 0; j < columns; j++)
+        {
+            permuted[i * columns + j] = values[permutation[i] * columns + j];
+        }
+    }
+
+    for (int i = 0; i < rank; i++)
+    {
+        for (size_t j = 0; j < columns; j++)
+        {
+            double sum = permuted[i * columns + j];
+            for (int k = 0; k < i; k++)
+            {
+                sum -= factor[i * block_size + k] * values[k * columns + j];
+            }
+            values[i * columns + j] = sum / factor[i * block_size + i];
+        }
+    }
+    std::fill(values + rank * columns, values + block_size * columns, 0.0);
+}
+
+// Solves L^T w = z on the leading rank entries and writes P w to solution, with the dropped
+// unknowns set to zero.
+void backward_substitute(
+    const double* factor,
+    const int* permutation,
+    const int rank,
+    double* z,
+    double* solution)
+{
+    for (int i = rank; i-- > 0;)
+    {
+        double sum = z[i];
+        for (int k = i + 1; k < rank; k++)
+        {
+            sum -= factor[k * block_size + i] * z[k];
+        }
+        z[i] = sum / factor[i * block_size + i];
+    }
+
+    for (int i = 0; i < (int)block_size; i++)
+    {
+        solution[permutation[i]] = i < rank ? z[i] : 0.0;
+    }
+}
+
+// out += a b^T
+template <typename Scalar>
+void add_product_transpose(const Scalar* a, const Scalar* b, Scalar* out)
+{
+    for (size_t i = 0; i < block_size; i++)
+    {
+        for (size_t j = 0; j < block_size; j++)
+        {
+            Scalar sum{};
+            for (size_t k = 0; k < block_size; k++)
+            {
+                sum += a[i * block_size + k] * b[j * block_size + k];
+            }
+            out[i * block_size + j] += sum;
+        }
+    }
+}
+
+// out -= a^T b
+template <typename Scalar>
+void subtract_transpose_product(const Scalar* a, const Scalar* b, Scalar* out)
+{
+    for (size_t k = 0; k < block_size; k++)
+    {
+        for (size_t i = 0; i < block_size; i++)
+        {
+            const Scalar a_ki = a[k * block_size + i];
+            for (size_t j = 0; j < block_size; j++)
+            {
+                out[i * block_size + j] -= a_ki * b[k * block_size + j];
+            }
+        }
+    }
+}
+
+// out += scale * a x
+template <typename Scalar>
+void add_product(const Scalar* a, const Scalar* x, const double scale, Scalar* out)
+{
+    for (size_t i = 0; i < block_size; i++)
+    {
+        Scalar sum{};
+        for (size_t j = 0; j < block_size; j++)
+        {
+            sum += a[i * block_size + j] * x[j];
+        }
+        out[i] += scale * sum;
+    }
+}
+
+// out += a^T x
+template <typename Scalar>
+void add_transpose_product(const Scalar* a, const Scalar* x, Scalar* out)
+{
+    for (size_t k = 0; k < block_size; k++)
+    {
+        for (size_t j = 0; j < block_size; j++)
+        {
+            out[j] += a[k * block_size + j] * x[k];
+        }
+    }
+}
+
+template <typename Scalar>
+void set_block(
+    Scalar* block,
+    const size_t row,
+    const size_t column,
+    const BasicMatrix3<Scalar>& value)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            block[(row + i) * block_size + column + j] = value(i, j);
+        }
+    }
+}
+
+template <typename Scalar>
+void set_segment(Scalar* vector, const size_t start, const BasicVector3<Scalar>& segment)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        vector[start + i] = segment[i];
+    }
+}
+
+template <typename Scalar>
+BasicVector3<Scalar> get_segment(const Scalar* vector, const size_t start)
+{
+    return BasicVector3<Scalar>{vector[start], vector[start + 1], vector[start + 2]};
+}
+
+// Entries of a double array holding lane_count doubles per coordinate, lane by lane.
+template <typename Scalar>
+void store_segment(double* values, const size_t start, const BasicVector3<Scalar>& segment)
+{
+    constexpr size_t lane_count = Coordinate::lane_count<Scalar>;
+    for (size_t i = 0; i < 3; i++)
+    {
+        for (size_t lane = 0; lane < lane_count; lane++)
+        {
+            values[lane_count * (start + i) + lane] = Coordinate::get_lane(segment[i], lane);
+        }
+    }
+}
+
+template <typename Scalar>
+BasicVector3<Scalar> load_segment(const double* values, const size_t start)
+{
+    constexpr size_t lane_count = Coordinate::lane_count<Scalar>;
+    BasicVector3<Scalar> segment{};
+    for (size_t i = 0; i < 3; i++)
+    {
+        for (size_t lane = 0; lane < lane_count; lane++)
+        {
+            Coordinate::set_lane(segment[i], lane, values[lane_count * (start + i) + lane]);
+        }
+    }
+
+    return segment;
+}
+
+// Bitwise equality, true only if every lane holds the same value.
+template <typename Scalar>
+bool same_values(const BasicVector3<Scalar>& a, const BasicVector3<Scalar>& b)
+{
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+double maximum(const double a, const double b)
+{
+    return std::max(a, b);
+}
+
+template <size_t Count>
+Lanes<Count> maximum(Lanes<Count> a, const Lanes<Count>& b)
+{
+    for (size_t lane = 0; lane < Count; lane++)
+    {
+        a[lane] = std::max(a[lane], b[lane]);
+    }
+
+    return a;
+}
+
+// The steps of the block Cholesky solve that touch a diagonal block's pivots.  With one lane they
+// factor the block in place and substitute with it.  With several, each lane's pivots differ, so
+// each lane is factored on its own and the block replaced by G = L^-1 P^T, zero below the rank,
+// after which substituting is multiplying by G or G^T in every lane at once.
+
+void factor_diagonal_block(double* block, int* permutation, int& rank, const double tolerance)
+{
+    rank = factor_block(block, permutation, tolerance);
+}
+
+// factor_block for every lane at once.  The lanes pick different pivots, so instead of swapping
+// rows each lane keeps the columns of L in the block's own order, zero at the indices already
+// pivoted on, and picks entries out by its pivot index with selects rather than branches.  G is
+// built a row per pivot by the same forward substitution that forward_substitute does.
+template <size_t Count>
+void factor_diagonal_block(Lanes<Count>* block, int*, int&, const Lanes<Count>& tolerance)
+{
+    double factor_columns[block_size][block_size][Count];
+    double inverse_factor[block_size][block_size][Count];
+    double pivoted[block_size][Count] = {};
+    double pivot[Count];
+    double active[Count];
+    double scale[Count];
+    std::fill_n(active, Count, 1.0);
+
+    for (size_t k = 0; k < block_size; k++)
+    {
+        // The largest diagonal not yet pivoted on, and 1 / sqrt of it while above tolerance.
+        for (size_t lane = 0; lane < Count; lane++)
+        {
+            double largest = -std::numeric_limits<double>::infinity();
+            double largest_idx = 0.0;
+            for (size_t i = 0; i < block_size; i++)
+            {
+                const double diagonal = block[(block_size + 1) * i][lane];
+                const bool better = pivoted[i][lane] == 0.0 && diagonal > largest;
+                largest = better ? diagonal : largest;
+                largest_idx = better ? (double)i : largest_idx;
+            }
+            active[lane] = active[lane] != 0.0 && largest > tolerance[lane] ? 1.0 : 0.0;
+            scale[lane] = active[lane] != 0.0 ? 1.0 / std::sqrt(largest) : 0.0;
+            pivot[lane] = largest_idx;
+        }
+
+        // Column k of L is the pivot's column of the trailing block over its square root.
+        double* column = &factor_columns[k][0][0];
+        for (size_t i = 0; i < block_size; i++)
+        {
+            for (size_t lane = 0; lane < Count; lane++)
+            {
+                double entry = 0.0;
+                for (size_t j = 0; j < block_size; j++)
+                {
+                    entry = pivot[lane] == (double)j ? block[i * block_size + j][lane] : entry;
+                }
+                column[i * Count + lane] = pivoted[i][lane] == 0.0 ? entry * scale[lane] : 0.0;
+            }
+        }
+        for (size_t i = 0; i < block_size; i++)
+        {
+            for (size_t lane = 0; lane < Count; lane++)
+            {
+                pivoted[i][lane] = pivot[lane] == (double)i ? 1.0 : pivoted[i][lane];
+            }
+        }
+        for (size_t i = 0; i < block_size; i++)
+        {
+            for (size_t j = 0; j < block_size; j++)
+            {
+                for (size_t lane = 0; lane < Count; lane++)
+                {
+                    block[i * block_size + j][lane] -=
+                        column[i * Count + lane] * column[j * Count + lane];
+                }
+            }
+        }
+
+        // Row k of G = (e_pivot^T - sum over earlier rows j of L_pivot,j G_j) / L_pivot,k.
+        double* row = &inverse_factor[k][0][0];
+        for (size_t m = 0; m < block_size; m++)
+        {
+            for (size_t lane = 0; lane < Count; lane++)
+            {
+                row[m * Count + lane] = pivot[lane] == (double)m ? 1.0 : 0.0;
+            }
+        }
+        for (size_t j = 0; j < k; j++)
+        {
+            double l_pivot_j[Count];
+            for (size_t lane = 0; lane < Count; lane++)
+            {
+                double entry = 0.0;
+                for (size_t i = 0; i < block_size; i++)
+                {
+                    entry = pivot[lane] == (double)i ? factor_columns[j][i][lane] : entry;
+                }
+                l_pivot_j[lane] = entry;
+            }
+            for (size_t m = 0; m < block_size; m++)
+            {
+                for (size_t lane = 0; lane < Count; lane++)
+                {
+                    row[m * Count + lane] -= l_pivot_j[lane] * inverse_factor[j][m][lane];
+                }
+            }
+        }
+        for (size_t m = 0; m < block_size; m++)
+        {
+            for (size_t lane = 0; lane < Count; lane++)
+            {
+                row[m * Count + lane] *= scale[lane];
+            }
+        }
+    }
+
+    for (size_t i = 0; i < block_size; i++)
+    {
+        for (size_t j = 0; j < block_size; j++)
+        {
+            for (size_t lane = 0; lane < Count; lane++)
+            {
+                block[i * block_size + j][lane] = inverse_factor[i][j][lane];
+            }
+        }
+    }
+}
+
+// values = L^-1 P^T values for a 6 x columns row major array.
+void apply_factor_inverse(
+    const double* factor,
+    const int* permutation,
+    const int rank,
+    double* values,
+    const size_t columns)
+{
+    forward_substitute(factor, permutation, rank, values, columns);
+}
+
+template <size_t Count>
+void apply_factor_inverse(
+    const Lanes<Count>* factor,
+    const int*,
+    const int,
+    Lanes<Count>* values,
+    const size_t columns)
+{
+    Lanes<Count> original[block_entries];
+    std::copy_n(values, block_size * columns, original);
+    for (size_t i = 0; i < block_size; i++)
+    {
+        for (size_t j = 0; j < columns; j++)
+        {
+            Lanes<Count> sum{};
+            for (size_t k = 0; k < block_size; k++)
+            {
+                sum += factor[i * block_size + k] * original[k * columns + j];
+            }
+            values[i * columns + j] = sum;
+        }
+    }
+}
+
+// solution = P L^-T z
+void apply_factor_inverse_transpose(
+    const double* factor,
+    const int* permutation,
+    const int rank,
+    double* z,
+    double* solution)
+{
+    backward_substitute(factor, permutation, rank, z, solution);
+}
+
+template <size_t Count>
+void apply_factor_inverse_transpose(
+    const Lanes<Count>* factor,
+    const int*,
+    const int,
+    Lanes<Count>* z,
+    Lanes<Count>* solution)
+{
+    std::fill_n(solution, block_size, 0.0);
+    add_transpose_product(factor, z, solution);
+}
+
+}
+
+template <typename Scalar>
+BasicRigidbody<Scalar>::BasicRigidbody(
+    const Scalar& m_body,
+    const BasicMatrix3<Scalar>& inertia_body_wrt_cm_in_body,
+    const BasicVector3<Scalar>& r_body_wrt_0_in_0,
+    const BasicVector3<Scalar>& sigma_0_to_body,
+    const BasicVector3<Scalar>& v_body_wrt_0_in_0,
+    const BasicVector3<Scalar>& sigma_dot_0_to_body)
+    : m_body(m_body),
+      inertia_body_wrt_cm_in_body(inertia_body_wrt_cm_in_body),
+      inertia_inv_body_wrt_cm_in_body(),
+      r_body_wrt_0_in_0(r_body_wrt_0_in_0),
+      sigma_0_to_body(sigma_0_to_body),
+      v_body_wrt_0_in_0(v_body_wrt_0_in_0),
+      sigma_dot_0_to_body(sigma_dot_0_to_body),
+      kinematics()
+{
+    for (size_t lane = 0; lane < Coordinate::lane_count<Scalar>; lane++)
+    {
+        if (!(Coordinate::get_lane(m_body, lane) > 0.0))
+        {
+            throw std::invalid_argument("Rigidbody mass must be positive");
+        }
+        Coordinate::set_lane(inertia_inv_body_wrt_cm_in_body, lane,
+                             inverse(Coordinate::get_lane(inertia_body_wrt_cm_in_body, lane)));
+    }
+}
+
+template <typename Scalar>
+void BasicRigidbody<Scalar>::populate_kinematics()
+{
+    kinematics.attitude_updated =
+        !kinematics.populated || !same_values(kinematics.sigma_0_to_body, sigma_0_to_body);
+    kinematics.rates_updated =
+        kinematics.attitude_updated ||
+        !same_values(kinematics.sigma_dot_0_to_body, sigma_dot_0_to_body);
+    kinematics.populated = true;
+
+    if (kinematics.attitude_updated)
+    {
+        kinematics.sigma_0_to_body = sigma_0_to_body;
+        kinematics.c_0_to_body = mrp_to_dcm(sigma_0_to_body);
+        kinematics.c_body_to_0 = transpose(kinematics.c_0_to_body);
+        kinematics.b = mrp_b_matrix(sigma_0_to_body);
+        kinematics.b_inv = mrp_b_inv_matrix(sigma_0_to_body);
+    }
+    if (kinematics.rates_updated)
+    {
+        kinematics.sigma_dot_0_to_body = sigma_dot_0_to_body;
+        kinematics.b_dot = mrp_b_dot_matrix(sigma_0_to_body, sigma_dot_0_to_body);
+        kinematics.b_inv_dot = mrp_b_inv_dot_matrix(sigma_0_to_body, sigma_dot_0_to_body);
+        kinematics.b_inv_dot_sigma_dot = kinematics.b_inv_dot * sigma_dot_0_to_body;
+        kinematics.omega_body_wrt_0_in_body = 4.0 * (kinematics.b_inv * sigma_dot_0_to_body);
+        kinematics.tilde_omega_body_wrt_0_in_body = tilde(kinematics.omega_body_wrt_0_in_body);
+        kinematics.tilde_omega_body_wrt_0_in_body_squared =
+            kinematics.tilde_omega_body_wrt_0_in_body * kinematics.tilde_omega_body_wrt_0_in_body;
+    }
+}
+
+template <typename Scalar>
+void BasicRigidbody<Scalar>::unconstrained_dynamics(
+    const BasicVector3<Scalar>& force_body_wrt_0_in_0,
+    const BasicVector3<Scalar>& moment_body_wrt_0_in_body,
+    Scalar* scaled_state_ddot) const
+{
+    const BasicVector3<Scalar>& omega = kinematics.omega_body_wrt_0_in_body;
+    const BasicVector3<Scalar> scaled_sigma_ddot_0_to_body =
+        kinematics.b_dot * omega +
+        kinematics.b * (inertia_inv_body_wrt_cm_in_body *
+                        (moment_body_wrt_0_in_body -
+                         kinematics.tilde_omega_body_wrt_0_in_body *
+                             (inertia_body_wrt_cm_in_body * omega)));
+
+    set_segment(scaled_state_ddot, 0, force_body_wrt_0_in_0);
+    set_segment(scaled_state_ddot, 3, scaled_sigma_ddot_0_to_body);
+}
+
+template <typename Scalar>
+void BasicRevoluteJoint<Scalar>::populate_kinematics(
+    const BasicRigidbody<Scalar>& body1,
+    const BasicRigidbody<Scalar>& body2)
+{
+    kinematics.body1_joint_direction_in_0 = body1.kinematics.c_body_to_0 * joint_direction_in_1;
+    kinematics.body2_joint_direction_in_0 = body2.kinematics.c_body_to_0 * joint_direction_in_2;
+    kinematics.tilde_body1_joint_direction_in_0 = tilde(kinematics.body1_joint_direction_in_0);
+    kinematics.tilde_body2_joint_direction_in_0 = tilde(kinematics.body2_joint_direction_in_0);
+    kinematics.body1_joint_direction_dot_in_0 =
+        body1.kinematics.c_body_to_0 *
+        (body1.kinematics.tilde_omega_body_wrt_0_in_body * joint_direction_in_1);
+    kinematics.body2_joint_direction_dot_in_0 =
+        body2.kinematics.c_body_to_0 *
+        (body2.kinematics.tilde_omega_body_wrt_0_in_body * joint_direction_in_2);
+}
+
+template <typename Scalar>
+void BasicForceGenerator<Scalar>::compute_forces(
+    const BasicRigidbody<Scalar>& body,
+    BasicVector3<Scalar>& force_body_wrt_0_in_0,
+    BasicVector3<Scalar>& moment_body_wrt_0_in_body) const
+{
+    force_body_wrt_0_in_0 =
+        force_body_wrt_0_in_0 + f_wrt_0_in_0 + body.kinematics.c_body_to_0 * f_wrt_0_in_body;
+    moment_body_wrt_0_in_body = moment_body_wrt_0_in_body + tau_body_wrt_0_in_body +
+                                cross(r_f_wrt_body_in_body, f_wrt_0_in_body);
+}
+
+template <typename Scalar>
+size_t BasicMultiRigidbody<Scalar>::add_body(
+    const Scalar& m_body,
+    const BasicMatrix3<Scalar>& inertia_body_wrt_cm_in_body,
+    const BasicVector3<Scalar>& r_body_wrt_0_in_0,
+    const BasicVector3<Scalar>& sigma_0_to_body,
+    const BasicVector3<Scalar>& v_body_wrt_0_in_0,
+    const BasicVector3<Scalar>& sigma_dot_0_to_body)
+{
+    if (initialized)
+    {
+        throw std::logic_error("Cannot add a body after initialize");
+    }
+    bodies.emplace_back(m_body, inertia_body_wrt_cm_in_body, r_body_wrt_0_in_0, sigma_0_to_body,
+                        v_body_wrt_0_in_0, sigma_dot_0_to_body);
+
+    return bodies.size() - 1;
+}
+
+template <typename Scalar>
+size_t BasicMultiRigidbody<Scalar>::add_revolute_joint(
+    const size_t body1_idx,
+    const size_t body2_idx,
+    const BasicVector3<Scalar>& r_joint_wrt_1_in_1,
+    const BasicVector3<Scalar>& r_joint_wrt_2_in_2,
+    const BasicVector3<Scalar>& joint_direction_in_1,
+    const BasicVector3<Scalar>& joint_direction_in_2)
+{
+    if (initialized)
+    {
+        throw std::logic_error("Cannot add a joint after initialize");
+    }
+    if (body1_idx >= bodies.size() || body2_idx >= bodies.size() || body1_idx == body2_idx)
+    {
+        throw std::invalid_argument("Revolute joint must join two different existing bodies");
+    }
+
+    BasicRevoluteJoint<Scalar> joint{};
+    joint.body1_idx = body1_idx;
+    joint.body2_idx = body2_idx;
+    joint.r_joint_wrt_1_in_1 = r_joint_wrt_1_in_1;
+    joint.r_joint_wrt_2_in_2 = r_joint_wrt_2_in_2;
+    joint.joint_direction_in_1 = joint_direction_in_1;
+    joint.joint_direction_in_2 = joint_direction_in_2;
+    joint.tilde_r_joint_wrt_1_in_1 = tilde(r_joint_wrt_1_in_1);
+    joint.tilde_r_joint_wrt_2_in_2 = tilde(r_joint_wrt_2_in_2);
+    joint.tilde_joint_direction_in_1 = tilde(joint_direction_in_1);
+    joint.tilde_joint_direction_in_2 = tilde(joint_direction_in_2);
+    joints.push_back(joint);
+
+    return joints.size() - 1;
+}
+
+template <typename Scalar>
+size_t BasicMultiRigidbody<Scalar>::add_force(const BasicForceGenerator<Scalar>& force)
+{
+    if (initialized)
+    {
+        throw std::logic_error("Cannot add a force after initialize");
+    }
+    if (force.body_idx >= bodies.size())
+    {
+        throw std::invalid_argument("Force generator must act on an existing body");
+    }
+    forces.push_back(force);
+
+    return forces.size() - 1;
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::initialize()
+{
+    if (initialized)
+    {
+        throw std::logic_error("MultiRigidbody is already initialized");
+    }
+
+    const size_t state_size = get_state_size();
+    const size_t constraint_size = 6 * joints.size();
+
+    force_wrt_0_in_0.resize(bodies.size());
+    moment_wrt_0_in_body.resize(bodies.size());
+    q_vector.resize(state_size);
+    scaled_state_dot.resize(state_size);
+    scaled_state_ddot.resize(state_size);
+    a_blocks.resize(2 * block_entries * joints.size());
+    populate_mass_matrix();
+    b_vector.resize(constraint_size);
+    phi_vector.resize(constraint_size);
+    phi_dot_vector.resize(constraint_size);
+    residual.resize(constraint_size);
+    lambda_vector.resize(constraint_size);
+
+    order_joints();
+    analyze_k_structure();
+    k_pivot_permutation.resize(constraint_size);
+    k_block_rank.resize(joints.size());
+    solve_work.resize(constraint_size);
+
+    initialized = true;
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::populate_mass_matrix()
+{
+    using std::sqrt;
+
+    mass_matrix_inv_sqrt_diagonal.resize(get_state_size());
+    for (size_t body_idx = 0; body_idx < bodies.size(); body_idx++)
+    {
+        const Scalar position_scale = 1.0 / sqrt(bodies[body_idx].m_body);
+        for (size_t i = 0; i < 3; i++)
+        {
+            mass_matrix_inv_sqrt_diagonal[6 * body_idx + i] = position_scale;
+            mass_matrix_inv_sqrt_diagonal[6 * body_idx + 3 + i] = 1.0 / 2.0;
+        }
+    }
+
+    // The position columns of A M^-1/2, which no attitude changes.
+    for (size_t joint_idx = 0; joint_idx < joints.size(); joint_idx++)
+    {
+        const BasicRevoluteJoint<Scalar>& joint = joints[joint_idx];
+        Scalar* a1 = &a_blocks[block_entries * 2 * joint_idx];
+        Scalar* a2 = a1 + block_entries;
+        set_block(a1, 0, 0,
+                  mass_matrix_inv_sqrt_diagonal[6 * joint.body1_idx] *
+                      BasicMatrix3<Scalar>::identity());
+        set_block(a2, 0, 0,
+                  -mass_matrix_inv_sqrt_diagonal[6 * joint.body2_idx] *
+                      BasicMatrix3<Scalar>::identity());
+    }
+    k_factored = false;
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::order_joints()
+{
+    std::vector<std::vector<size_t>> body_joints(bodies.size());
+    for (size_t joint_idx = 0; joint_idx < joints.size(); joint_idx++)
+    {
+        body_joints[joints[joint_idx].body1_idx].push_back(joint_idx);
+        body_joints[joints[joint_idx].body2_idx].push_back(joint_idx);
+    }
+
+    // Breadth first over each connected set of bodies, recording the depth of the body each
+    // spanning tree joint leads to.  Joints closing a loop keep depth 0.
+    const size_t unvisited = std::numeric_limits<size_t>::max();
+    std::vector<size_t> body_depth(bodies.size(), unvisited);
+    std::vector<size_t> joint_depth(joints.size(), 0);
+    std::vector<size_t> queue;
+    queue.reserve(bodies.size());
+    for (size_t root = 0; root < bodies.size(); root++)
+    {
+        if (body_depth[root] != unvisited)
+        {
+            continue;
+        }
+        body_depth[root] = 0;
+        queue.push_back(root);
+        for (size_t head = queue.size() - 1; head < queue.size(); head++)
+        {
+            const size_t body_idx = queue[head];
+            for (const size_t joint_idx : body_joints[body_idx])
+            {
+                const BasicRevoluteJoint<Scalar>& joint = joints[joint_idx];
+                const size_t other_idx =
+                    joint.body1_idx == body_idx ? joint.body2_idx : joint.body1_idx;
+                if (body_depth[other_idx] == unvisited)
+                {
+                    body_depth[other_idx] = body_depth[body_idx] + 1;
+                    joint_depth[joint_idx] = body_depth[other_idx];
+                    queue.push_back(other_idx);
+                }
+            }
+        }
+    }
+
+    // Eliminating a joint before the one above it only couples joints that already share a body,
+    // so leaves go first and loop closures last.
+    elimination_order.resize(joints.size());
+    for (size_t joint_idx = 0; joint_idx < joints.size(); joint_idx++)
+    {
+        elimination_order[joint_idx] = joint_idx;
+    }
+    std::stable_sort(elimination_order.begin(), elimination_order.end(),
+                     [&joint_depth](const size_t a, const size_t b)
+                     { return joint_depth[a] > joint_depth[b]; });
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::analyze_k_structure()
+{
+    const size_t joint_count = joints.size();
+    std::vector<size_t> position(joint_count);
+    for (size_t i = 0; i < joint_count; i++)
+    {
+        position[elimination_order[i]] = i;
+    }
+
+    std::vector<std::vector<size_t>> body_joints(bodies.size());
+    for (size_t joint_idx = 0; joint_idx < joint_count; joint_idx++)
+    {
+        body_joints[joints[joint_idx].body1_idx].push_back(joint_idx);
+        body_joints[joints[joint_idx].body2_idx].push_back(joint_idx);
+    }
+
+    // Blocks of K right of the diagonal, then the fill from eliminating each position in turn.
+    std::vector<std::vector<size_t>> later_neighbors(joint_count);
+    for (const std::vector<size_t>& shared : body_joints)
+    {
+        for (const size_t a : shared)
+        {
+            for (const size_t b : shared)
+            {
+                if (position[a] < position[b])
+                {
+                    later_neighbors[position[a]].push_back(position[b]);
+                }
+            }
+        }
+    }
+    for (size_t k = 0; k < joint_count; k++)
+    {
+        std::vector<size_t>& neighbors = later_neighbors[k];
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        for (const size_t l : neighbors)
+        {
+            for (const size_t m : neighbors)
+            {
+                if (m > l)
+                {
+                    later_neighbors[l].push_back(m);
+                }
+            }
+        }
+    }
+
+    k_neighbor_start.assign(1, 0);
+    k_neighbor.clear();
+    for (const std::vector<size_t>& neighbors : later_neighbors)
+    {
+        k_neighbor.insert(k_neighbor.end(), neighbors.begin(), neighbors.end());
+        k_neighbor_start.push_back(k_neighbor.size());
+    }
+    k_blocks.resize(block_entries * (joint_count + k_neighbor.size()));
+
+    // K = sum over bodies of the products of the A M^-1/2 blocks of every pair of its joints.
+    k_terms.clear();
+    for (size_t body_idx = 0; body_idx < bodies.size(); body_idx++)
+    {
+        for (const size_t a : body_joints[body_idx])
+        {
+            for (const size_t b : body_joints[body_idx])
+            {
+                if (position[a] > position[b])
+                {
+                    continue;
+                }
+
+                KTerm term{};
+                term.row_a_offset =
+                    block_entries * (2 * a + (joints[a].body1_idx == body_idx ? 0 : 1));
+                term.column_a_offset =
+                    block_entries * (2 * b + (joints[b].body1_idx == body_idx ? 0 : 1));
+                if (a == b)
+                {
+                    term.k_offset = block_entries * position[a];
+                }
+                else
+                {
+                    const auto first = k_neighbor.begin() + k_neighbor_start[position[a]];
+                    const auto last = k_neighbor.begin() + k_neighbor_start[position[a] + 1];
+                    const size_t idx =
+                        std::lower_bound(first, last, position[b]) - k_neighbor.begin();
+                    term.k_offset = block_entries * (joint_count + idx);
+                }
+                k_terms.push_back(term);
+            }
+        }
+    }
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::get_state(double* state) const
+{
+    for (size_t body_idx = 0; body_idx < bodies.size(); body_idx++)
+    {
+        store_segment(state, 6 * body_idx, bodies[body_idx].r_body_wrt_0_in_0);
+        store_segment(state, 6 * body_idx + 3, bodies[body_idx].sigma_0_to_body);
+    }
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::set_state(const double* state)
+{
+    for (size_t body_idx = 0; body_idx < bodies.size(); body_idx++)
+    {
+        bodies[body_idx].r_body_wrt_0_in_0 = load_segment<Scalar>(state, 6 * body_idx);
+        bodies[body_idx].sigma_0_to_body = load_segment<Scalar>(state, 6 * body_idx + 3);
+    }
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::get_state_dot(double* state_dot) const
+{
+    for (size_t body_idx = 0; body_idx < bodies.size(); body_idx++)
+    {
+        store_segment(state_dot, 6 * body_idx, bodies[body_idx].v_body_wrt_0_in_0);
+        store_segment(state_dot, 6 * body_idx + 3, bodies[body_idx].sigma_dot_0_to_body);
+    }
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::set_state_dot(const double* state_dot)
+{
+    for (size_t body_idx = 0; body_idx < bodies.size(); body_idx++)
+    {
+        bodies[body_idx].v_body_wrt_0_in_0 = load_segment<Scalar>(state_dot, 6 * body_idx);
+        bodies[body_idx].sigma_dot_0_to_body = load_segment<Scalar>(state_dot, 6 * body_idx + 3);
+    }
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::populate_kinematics()
+{
+    for (BasicRigidbody<Scalar>& body : bodies)
+    {
+        body.populate_kinematics();
+    }
+
+    for (BasicRevoluteJoint<Scalar>& joint : joints)
+    {
+        const BasicRigidbodyKinematics<Scalar>& kinematics1 = bodies[joint.body1_idx].kinematics;
+        const BasicRigidbodyKinematics<Scalar>& kinematics2 = bodies[joint.body2_idx].kinematics;
+        if (kinematics1.rates_updated || kinematics2.rates_updated)
+        {
+            joint.populate_kinematics(bodies[joint.body1_idx], bodies[joint.body2_idx]);
+        }
+    }
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::calculate_forces()
+{
+    std::fill(force_wrt_0_in_0.begin(), force_wrt_0_in_0.end(), BasicVector3<Scalar>{});
+    std::fill(moment_wrt_0_in_body.begin(), moment_wrt_0_in_body.end(), BasicVector3<Scalar>{});
+
+    for (const BasicForceGenerator<Scalar>& force : forces)
+    {
+        force.compute_forces(bodies[force.body_idx], force_wrt_0_in_0[force.body_idx],
+                             moment_wrt_0_in_body[force.body_idx]);
+    }
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::unconstrained_dynamics()
+{
+    for (size_t body_idx = 0; body_idx < bodies.size(); body_idx++)
+    {
+        bodies[body_idx].unconstrained_dynamics(
+            force_wrt_0_in_0[body_idx], moment_wrt_0_in_body[body_idx], &q_vector[6 * body_idx]);
+    }
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::uk_a_matrix_b_vector_with_baumgarte()
+{
+    for (size_t joint_idx = 0; joint_idx < joints.size(); joint_idx++)
+    {
+        const BasicRevoluteJoint<Scalar>& joint = joints[joint_idx];
+        const BasicRigidbody<Scalar>& body1 = bodies[joint.body1_idx];
+        const BasicRigidbody<Scalar>& body2 = bodies[joint.body2_idx];
+        const BasicRigidbodyKinematics<Scalar>& kinematics1 = body1.kinematics;
+        const BasicRigidbodyKinematics<Scalar>& kinematics2 = body2.kinematics;
+
+        const size_t position_row = 6 * joint_idx;
+        const size_t rotation_row = 6 * joint_idx + 3;
+
+        // Products shared between the A matrix and the b vector.
+        const BasicMatrix3<Scalar> c1_r1 =
+            kinematics1.c_body_to_0 * joint.tilde_r_joint_wrt_1_in_1;
+        const BasicMatrix3<Scalar> c2_r2 =
+            kinematics2.c_body_to_0 * joint.tilde_r_joint_wrt_2_in_2;
+        const BasicMatrix3<Scalar> v_c1_j1 = joint.kinematics.tilde_body2_joint_direction_in_0 *
+                                             kinematics1.c_body_to_0 *
+                                             joint.tilde_joint_direction_in_1;
+        const BasicMatrix3<Scalar> u_c2_j2 = joint.kinematics.tilde_body1_joint_direction_in_0 *
+                                             kinematics2.c_body_to_0 *
+                                             joint.tilde_joint_direction_in_2;
+        const BasicVector3<Scalar>& b_inv_dot_sigma_dot1 = kinematics1.b_inv_dot_sigma_dot;
+        const BasicVector3<Scalar>& b_inv_dot_sigma_dot2 = kinematics2.b_inv_dot_sigma_dot;
+
+        // Populate the attitude columns of A M^-1/2, where the MRP columns of A carry a factor 4
+        // and of M^-1/2 one half.  populate_mass_matrix writes the position columns.
+        if (kinematics1.attitude_updated || kinematics2.attitude_updated)
+        {
+            Scalar* a1 = &a_blocks[block_entries * 2 * joint_idx];
+            Scalar* a2 = a1 + block_entries;
+            set_block(a1, 0, 3, -2.0 * (c1_r1 * kinematics1.b_inv));
+            set_block(a2, 0, 3, 2.0 * (c2_r2 * kinematics2.b_inv));
+            set_block(a1, 3, 3, 2.0 * (v_c1_j1 * kinematics1.b_inv));
+            set_block(a2, 3, 3, -2.0 * (u_c2_j2 * kinematics2.b_inv));
+            k_factored = false;
+        }
+        // Populate b vector
+        const BasicVector3<Scalar> b_position =
+            4.0 * (c1_r1 * b_inv_dot_sigma_dot1) -
+            kinematics1.c_body_to_0 *
+                (kinematics1.tilde_omega_body_wrt_0_in_body_squared * joint.r_joint_wrt_1_in_1) -
+            4.0 * (c2_r2 * b_inv_dot_sigma_dot2) +
+            kinematics2.c_body_to_0 *
+                (kinematics2.tilde_omega_body_wrt_0_in_body_squared * joint.r_joint_wrt_2_in_2);
+        const BasicVector3<Scalar> b_rotation =
+            -4.0 * (v_c1_j1 * b_inv_dot_sigma_dot1) +
+            joint.kinematics.tilde_body2_joint_direction_in_0 *
+                (kinematics1.c_body_to_0 * (kinematics1.tilde_omega_body_wrt_0_in_body_squared *
+                                            joint.joint_direction_in_1)) -
+            2.0 * cross(joint.kinematics.body1_joint_direction_dot_in_0,
+                        joint.kinematics.body2_joint_direction_dot_in_0) +
+            4.0 * (u_c2_j2 * b_inv_dot_sigma_dot2) -
+            joint.kinematics.tilde_body1_joint_direction_in_0 *
+                (kinematics2.c_body_to_0 * (kinematics2.tilde_omega_body_wrt_0_in_body_squared *
+                                            joint.joint_direction_in_2));
+
+        // Baumgarte stabilization uses the constraint violation phi here and phi_dot = A x_dot
+        // below.
+        const BasicVector3<Scalar> phi_position =
+            body1.r_body_wrt_0_in_0 + kinematics1.c_body_to_0 * joint.r_joint_wrt_1_in_1 -
+            body2.r_body_wrt_0_in_0 - kinematics2.c_body_to_0 * joint.r_joint_wrt_2_in_2;
+        const BasicVector3<Scalar> phi_rotation =
+            cross(joint.kinematics.body1_joint_direction_in_0,
+                  joint.kinematics.body2_joint_direction_in_0);
+
+        set_segment(phi_vector.data(), position_row, phi_position);
+        set_segment(phi_vector.data(), rotation_row, phi_rotation);
+        set_segment(b_vector.data(), position_row, b_position - (beta * beta) * phi_position);
+        set_segment(b_vector.data(), rotation_row, b_rotation - (beta * beta) * phi_rotation);
+    }
+
+    // phi_dot = A x_dot = (A M^-1/2) (M^1/2 x_dot)
+    for (size_t body_idx = 0; body_idx < bodies.size(); body_idx++)
+    {
+        set_segment(scaled_state_dot.data(), 6 * body_idx, bodies[body_idx].v_body_wrt_0_in_0);
+        set_segment(scaled_state_dot.data(), 6 * body_idx + 3,
+                    bodies[body_idx].sigma_dot_0_to_body);
+    }
+    for (size_t i = 0; i < scaled_state_dot.size(); i++)
+    {
+        scaled_state_dot[i] /= mass_matrix_inv_sqrt_diagonal[i];
+    }
+    std::fill(phi_dot_vector.begin(), phi_dot_vector.end(), Scalar{});
+    for (size_t joint_idx = 0; joint_idx < joints.size(); joint_idx++)
+    {
+        const Scalar* a1 = &a_blocks[block_entries * 2 * joint_idx];
+        Scalar* phi_dot = &phi_dot_vector[6 * joint_idx];
+        add_product(a1, &scaled_state_dot[6 * joints[joint_idx].body1_idx], 1.0, phi_dot);
+        add_product(a1 + block_entries, &scaled_state_dot[6 * joints[joint_idx].body2_idx], 1.0,
+                    phi_dot);
+        for (size_t i = 0; i < 6; i++)
+        {
+            b_vector[6 * joint_idx + i] -= (2.0 * alpha) * phi_dot[i];
+        }
+    }
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::factor_k()
+{
+    const size_t joint_count = joints.size();
+
+    std::fill(k_blocks.begin(), k_blocks.end(), 0.0);
+    for (const KTerm& term : k_terms)
+    {
+        add_product_transpose(&a_blocks[term.row_a_offset], &a_blocks[term.column_a_offset],
+                              &k_blocks[term.k_offset]);
+    }
+
+    // Drop pivots below lstsq's default cutoff.
+    Scalar max_diagonal{};
+    for (size_t k = 0; k < joint_count; k++)
+    {
+        for (size_t i = 0; i < block_size; i++)
+        {
+            max_diagonal =
+                maximum(max_diagonal, k_blocks[block_entries * k + (block_size + 1) * i]);
+        }
+    }
+    const Scalar tolerance =
+        std::numeric_limits<double>::epsilon() * (double)residual.size() * max_diagonal;
+
+    // Right looking block Cholesky, replacing each block right of the diagonal with
+    // W = L^-1 P^T K_kl as it goes.
+    for (size_t k = 0; k < joint_count; k++)
+    {
+        Scalar* factor = &k_blocks[block_entries * k];
+        int* permutation = &k_pivot_permutation[block_size * k];
+        int& rank = k_block_rank[k];
+        factor_diagonal_block(factor, permutation, rank, tolerance);
+
+        const size_t first = k_neighbor_start[k];
+        const size_t last = k_neighbor_start[k + 1];
+        for (size_t idx = first; idx < last; idx++)
+        {
+            apply_factor_inverse(factor, permutation, rank,
+                                 &k_blocks[block_entries * (joint_count + idx)], block_size);
+        }
+
+        // K_lm -= W_l^T W_m for every pair of later neighbors.
+        for (size_t idx = first; idx < last; idx++)
+        {
+            const size_t l = k_neighbor[idx];
+            const Scalar* w_l = &k_blocks[block_entries * (joint_count + idx)];
+            subtract_transpose_product(w_l, w_l, &k_blocks[block_entries * l]);
+            size_t target = k_neighbor_start[l];
+            for (size_t idx_m = idx + 1; idx_m < last; idx_m++)
+            {
+                const size_t m = k_neighbor[idx_m];
+                while (k_neighbor[target] != m)
+                {
+                    target++;
+                }
+                subtract_transpose_product(w_l, &k_blocks[block_entries * (joint_count + idx_m)],
+                                           &k_blocks[block_entries * (joint_count + target)]);
+            }
+        }
+    }
+
+    k_factored = true;
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::solve_k()
+{
+    const size_t joint_count = joints.size();
+
+    for (size_t k = 0; k < joint_count; k++)
+    {
+        std::copy_n(&residual[block_size * elimination_order[k]], block_size,
+                    &solve_work[block_size * k]);
+    }
+
+    // y = L^-1 P^T r in place, then r_l -= W_l^T y for every later neighbor.
+    for (size_t k = 0; k < joint_count; k++)
+    {
+        Scalar* y = &solve_work[block_size * k];
+        apply_factor_inverse(&k_blocks[block_entries * k], &k_pivot_permutation[block_size * k],
+                             k_block_rank[k], y, 1);
+        for (size_t idx = k_neighbor_start[k]; idx < k_neighbor_start[k + 1]; idx++)
+        {
+            const size_t l = k_neighbor[idx];
+            const Scalar* w_l = &k_blocks[block_entries * (joint_count + idx)];
+            for (size_t i = 0; i < block_size; i++)
+            {
+                for (size_t j = 0; j < block_size; j++)
+                {
+                    solve_work[block_size * l + i] -= w_l[j * block_size + i] * y[j];
+                }
+            }
+        }
+    }
+
+    // L^T w = y - W lambda_later, from the last position back.
+    for (size_t k = joint_count; k-- > 0;)
+    {
+        Scalar* z = &solve_work[block_size * k];
+        for (size_t idx = k_neighbor_start[k]; idx < k_neighbor_start[k + 1]; idx++)
+        {
+            add_product(&k_blocks[block_entries * (joint_count + idx)],
+                        &lambda_vector[block_size * elimination_order[k_neighbor[idx]]], -1.0, z);
+        }
+        apply_factor_inverse_transpose(
+            &k_blocks[block_entries * k], &k_pivot_permutation[block_size * k], k_block_rank[k], z,
+            &lambda_vector[block_size * elimination_order[k]]);
+    }
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::uk_dynamics(double* state_ddot)
+{
+    if (!initialized)
+    {
+        throw std::logic_error("MultiRigidbody has not been initialized");
+    }
+
+    populate_kinematics();
+    calculate_forces();
+    unconstrained_dynamics();
+    uk_a_matrix_b_vector_with_baumgarte();
+
+    const size_t state_size = get_state_size();
+
+    // Unconstrained accelerations M^-1/2 q in scaled coordinates, and how far they are from
+    // satisfying the constraints.
+    for (size_t i = 0; i < state_size; i++)
+    {
+        scaled_state_ddot[i] = mass_matrix_inv_sqrt_diagonal[i] * q_vector[i];
+    }
+    for (size_t joint_idx = 0; joint_idx < joints.size(); joint_idx++)
+    {
+        const Scalar* a1 = &a_blocks[block_entries * 2 * joint_idx];
+        Scalar* r = &residual[6 * joint_idx];
+        std::copy_n(&b_vector[6 * joint_idx], 6, r);
+        add_product(a1, &scaled_state_ddot[6 * joints[joint_idx].body1_idx], -1.0, r);
+        add_product(a1 + block_entries, &scaled_state_ddot[6 * joints[joint_idx].body2_idx], -1.0,
+                    r);
+    }
+
+    // lambda = K^+ residual, refactoring K only if an attitude changed.
+    if (!k_factored)
+    {
+        factor_k();
+    }
+    solve_k();
+
+    // x_ddot = M^-1/2 (M^-1/2 q + (A M^-1/2)^T lambda)
+    for (size_t joint_idx = 0; joint_idx < joints.size(); joint_idx++)
+    {
+        const Scalar* a1 = &a_blocks[block_entries * 2 * joint_idx];
+        const Scalar* lambda = &lambda_vector[6 * joint_idx];
+        add_transpose_product(a1, lambda, &scaled_state_ddot[6 * joints[joint_idx].body1_idx]);
+        add_transpose_product(a1 + block_entries, lambda,
+                              &scaled_state_ddot[6 * joints[joint_idx].body2_idx]);
+    }
+    for (size_t i = 0; i < state_size; i++)
+    {
+        const Scalar value = mass_matrix_inv_sqrt_diagonal[i] * scaled_state_ddot[i];
+        for (size_t lane = 0; lane < lane_count; lane++)
+        {
+            state_ddot[lane_count * i + lane] = Coordinate::get_lane(value, lane);
+        }
+    }
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::get_derivative(
+    const double* full_state,
+    double* full_state_derivative)
+{
+    const size_t state_size = lane_count * get_state_size();
+    set_state(full_state);
+    set_state_dot(full_state + state_size);
+
+    std::copy(full_state + state_size, full_state + 2 * state_size, full_state_derivative);
+    uk_dynamics(full_state_derivative + state_size);
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::switch_attitudes_to_shadow()
+{
+    for (BasicRigidbody<Scalar>& body : bodies)
+    {
+        for (size_t lane = 0; lane < lane_count; lane++)
+        {
+            Vector3 sigma = Coordinate::get_lane(body.sigma_0_to_body, lane);
+            Vector3 sigma_dot = Coordinate::get_lane(body.sigma_dot_0_to_body, lane);
+            if (mrp_switch_to_shadow(sigma, sigma_dot))
+            {
+                Coordinate::set_lane(body.sigma_0_to_body, lane, sigma);
+                Coordinate::set_lane(body.sigma_dot_0_to_body, lane, sigma_dot);
+            }
+        }
+    }
+}
+
+template <typename Scalar>
+ConstraintDrift BasicMultiRigidbody<Scalar>::measure_constraint_drift(const double* full_state)
+{
+    if (!initialized)
+    {
+        throw std::logic_error("MultiRigidbody has not been initialized");
+    }
+
+    set_state(full_state);
+    set_state_dot(full_state + lane_count * get_state_size());
+    populate_kinematics();
+    uk_a_matrix_b_vector_with_baumgarte();
+
+    const auto lane_norm =
+        [](const std::vector<Scalar>& vector, const size_t row, const size_t lane)
+    {
+        return norm(Coordinate::get_lane(get_segment(vector.data(), row), lane));
+    };
+    ConstraintDrift drift{};
+    for (size_t joint_idx = 0; joint_idx < joints.size(); joint_idx++)
+    {
+        const size_t row = 6 * joint_idx;
+        for (size_t lane = 0; lane < lane_count; lane++)
+        {
+            drift.position = std::max(drift.position, lane_norm(phi_vector, row, lane));
+            drift.position_rate =
+                std::max(drift.position_rate, lane_norm(phi_dot_vector, row, lane));
+            drift.rotation = std::max(drift.rotation, lane_norm(phi_vector, row + 3, lane));
+            drift.rotation_rate =
+                std::max(drift.rotation_rate, lane_norm(phi_dot_vector, row + 3, lane));
+        }
+    }
+
+    return drift;
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::add_constraint_correction(double* values)
+{
+    if (!k_factored)
+    {
+        factor_k();
+    }
+    solve_k();
+
+    std::fill(scaled_state_ddot.begin(), scaled_state_ddot.end(), Scalar{});
+    for (size_t joint_idx = 0; joint_idx < joints.size(); joint_idx++)
+    {
+        const Scalar* a1 = &a_blocks[block_entries * 2 * joint_idx];
+        const Scalar* lambda = &lambda_vector[6 * joint_idx];
+        add_transpose_product(a1, lambda, &scaled_state_ddot[6 * joints[joint_idx].body1_idx]);
+        add_transpose_product(a1 + block_entries, lambda,
+                              &scaled_state_ddot[6 * joints[joint_idx].body2_idx]);
+    }
+    for (size_t i = 0; i < get_state_size(); i++)
+    {
+        const Scalar value = mass_matrix_inv_sqrt_diagonal[i] * scaled_state_ddot[i];
+        for (size_t lane = 0; lane < lane_count; lane++)
+        {
+            values[lane_count * i + lane] += Coordinate::get_lane(value, lane);
+        }
+    }
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::project_onto_constraints(double* full_state)
+{
+    // Gauss-Newton converges quadratically from the small drifts this is meant for, so a few
+    // steps reach a hundredth of the tolerances or stop making progress.
+    constexpr size_t max_position_steps = 4;
+    constexpr double target = 0.01;
+
+    for (size_t step = 0; step < max_position_steps; step++)
+    {
+        const ConstraintDrift drift = measure_constraint_drift(full_state);
+        if (drift.position <= target * drift_control.position_tolerance &&
+            drift.rotation <= target * drift_control.rotation_tolerance)
+        {
+            break;
+        }
+        for (size_t i = 0; i < residual.size(); i++)
+        {
+            residual[i] = -phi_vector[i];
+        }
+        add_constraint_correction(full_state);
+    }
+
+    // A is linear in x_dot, so one projection at the final positions removes the rate drift.
+    measure_constraint_drift(full_state);
+    for (size_t i = 0; i < residual.size(); i++)
+    {
+        residual[i] = -phi_dot_vector[i];
+    }
+    add_constraint_correction(full_state + lane_count * get_state_size());
+}
+
+template <typename Scalar>
+bool BasicMultiRigidbody<Scalar>::control_constraint_drift(double* full_state)
+{
+    const DriftControl& control = drift_control;
+    const ConstraintDrift drift = measure_constraint_drift(full_state);
+    const double ratio = std::max(drift.position / control.position_tolerance,
+                                  drift.rotation / control.rotation_tolerance);
+
+    if (ratio > 1.0)
+    {
+        if (alpha < control.max_gain || beta < control.max_gain)
+        {
+            alpha = std::min(control.max_gain, alpha * control.gain_factor);
+            beta = std::min(control.max_gain, beta * control.gain_factor);
+        }
+        else
+        {
+            project_onto_constraints(full_state);
+        }
+        return true;
+    }
+
+    if (ratio * control.gain_factor * control.gain_factor < 1.0 &&
+        (alpha > control.min_gain || beta > control.min_gain))
+    {
+        alpha = std::max(control.min_gain, alpha / control.gain_factor);
+        beta = std::max(control.min_gain, beta / control.gain_factor);
+        return true;
+    }
+
+    return false;
+}
+
+template <typename Scalar>
+void BasicMultiRigidbody<Scalar>::set_lane(
+    const size_t lane,
+    const BasicMultiRigidbody<double>& scenario)
+{
+    if (lane >= lane_count)
+    {
+        throw std::out_of_range("Lane is out of range");
+    }
+    bool same_topology = scenario.bodies.size() == bodies.size() &&
+                         scenario.joints.size() == joints.size() &&
+                         scenario.forces.size() == forces.size();
+    for (size_t joint_idx = 0; same_topology && joint_idx < joints.size(); joint_idx++)
+    {
+        same_topology = scenario.joints[joint_idx].body1_idx == joints[joint_idx].body1_idx &&
+                        scenario.joints[joint_idx].body2_idx == joints[joint_idx].body2_idx;
+    }
+    for (size_t force_idx = 0; same_topology && force_idx < forces.size(); force_idx++)
+    {
+        same_topology = scenario.forces[force_idx].body_idx == forces[force_idx].body_idx;
+    }
+    if (!same_topology)
+    {
+        throw std::invalid_argument("Scenario must have the same bodies, joints and forces");
+    }
+
+    for (size_t body_idx = 0; body_idx < bodies.size(); body_idx++)
+    {
+        const Rigidbody& from = scenario.bodies[body_idx];
+        BasicRigidbody<Scalar>& to = bodies[body_idx];
+        Coordinate::set_lane(to.m_body, lane, from.m_body);
+        Coordinate::set_lane(to.inertia_body_wrt_cm_in_body, lane,
+                             from.inertia_body_wrt_cm_in_body);
+        Coordinate::set_lane(to.inertia_inv_body_wrt_cm_in_body, lane,
+                             from.inertia_inv_body_wrt_cm_in_body);
+        Coordinate::set_lane(to.r_body_wrt_0_in_0, lane, from.r_body_wrt_0_in_0);
+        Coordinate::set_lane(to.sigma_0_to_body, lane, from.sigma_0_to_body);
+        Coordinate::set_lane(to.v_body_wrt_0_in_0, lane, from.v_body_wrt_0_in_0);
+        Coordinate::set_lane(to.sigma_dot_0_to_body, lane, from.sigma_dot_0_to_body);
+    }
+    for (size_t joint_idx = 0; joint_idx < joints.size(); joint_idx++)
+    {
+        const RevoluteJoint& from = scenario.joints[joint_idx];
+        BasicRevoluteJoint<Scalar>& to = joints[joint_idx];
+        Coordinate::set_lane(to.r_joint_wrt_1_in_1, lane, from.r_joint_wrt_1_in_1);
+        Coordinate::set_lane(to.r_joint_wrt_2_in_2, lane, from.r_joint_wrt_2_in_2);
+        Coordinate::set_lane(to.joint_direction_in_1, lane, from.joint_direction_in_1);
+        Coordinate::set_lane(to.joint_direction_in_2, lane, from.joint_direction_in_2);
+        Coordinate::set_lane(to.tilde_r_joint_wrt_1_in_1, lane, from.tilde_r_joint_wrt_1_in_1);
+        Coordinate::set_lane(to.tilde_r_joint_wrt_2_in_2, lane, from.tilde_r_joint_wrt_2_in_2);
+        Coordinate::set_lane(to.tilde_joint_direction_in_1, lane, from.tilde_joint_direction_in_1);
+        Coordinate::set_lane(to.tilde_joint_direction_in_2, lane, from.tilde_joint_direction_in_2);
+    }
+    for (size_t force_idx = 0; force_idx < forces.size(); force_idx++)
+    {
+        const ForceGenerator& from = scenario.forces[force_idx];
+        BasicForceGenerator<Scalar>& to = forces[force_idx];
+        Coordinate::set_lane(to.f_wrt_0_in_0, lane, from.f_wrt_0_in_0);
+        Coordinate::set_lane(to.f_wrt_0_in_body, lane, from.f_wrt_0_in_body);
+        Coordinate::set_lane(to.r_f_wrt_body_in_body, lane, from.r_f_wrt_body_in_body);
+        Coordinate::set_lane(to.tau_body_wrt_0_in_body, lane, from.tau_body_wrt_0_in_body);
+    }
+
+    for (BasicRigidbody<Scalar>& body : bodies)
+    {
+        body.kinematics.populated = false;
+    }
+    if (initialized)
+    {
+        populate_mass_matrix();
+    }
+}
+
+template <size_t LaneCount>
+LockstepMultiRigidbody<LaneCount> make_lockstep(const MultiRigidbody& model)
+{
+    // Placeholder bodies, joints and forces that set_lane then overwrites in every lane.
+    LockstepMultiRigidbody<LaneCount> lockstep;
+    for (size_t body_idx = 0; body_idx < model.bodies.size(); body_idx++)
+    {
+        lockstep.add_body(1.0, BasicMatrix3<Lanes<LaneCount>>::identity());
+    }
+    for (const RevoluteJoint& joint : model.joints)
+    {
+        lockstep.add_revolute_joint(joint.body1_idx, joint.body2_idx);
+    }
+    for (const ForceGenerator& force : model.forces)
+    {
+        BasicForceGenerator<Lanes<LaneCount>> lane_force{};
+        lane_force.body_idx = force.body_idx;
+        lockstep.add_force(lane_force);
+    }
+    for (size_t lane = 0; lane < LaneCount; lane++)
+    {
+        lockstep.set_lane(lane, model);
+    }
+    lockstep.alpha = model.alpha;
+    lockstep.beta = model.beta;
+    lockstep.drift_control = model.drift_control;
+    if (model.is_initialized())
+    {
+        lockstep.initialize();
+    }
+
+    return lockstep;
+}
+
+template struct BasicRigidbody<double>;
+template struct BasicRevoluteJoint<double>;
+template struct BasicForceGenerator<double>;
+template class BasicMultiRigidbody<double>;
+template struct BasicRigidbody<Lanes<4>>;
+template struct BasicRevoluteJoint<Lanes<4>>;
+template struct BasicForceGenerator<Lanes<4>>;
+template class BasicMultiRigidbody<Lanes<4>>;
+template struct BasicRigidbody<Lanes<8>>;
+template struct BasicRevoluteJoint<Lanes<8>>;
+template struct BasicForceGenerator<Lanes<8>>;
+template class BasicMultiRigidbody<Lanes<8>>;
+template LockstepMultiRigidbody<4> make_lockstep<4>(const MultiRigidbody& model);
+template LockstepMultiRigidbody<8> make_lockstep<8>(const MultiRigidbody& model);
+
+}
@@ -0,0 +1,377 @@
+#ifndef DYNAMICS_H
+#define DYNAMICS_H
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "coordinates.h"
+
+namespace CamSim::Dynamics {
+
+using Coordinate::Lanes;
+using Coordinate::Matrix3;
+using Coordinate::Vector3;
+
+using Coordinate::cross;
+using Coordinate::dot;
+using Coordinate::inverse;
+using Coordinate::outer;
+using Coordinate::tilde;
+using Coordinate::transpose;
+
+using Coordinate::mrp_b_dot_matrix;
+using Coordinate::mrp_b_inv_dot_matrix;
+using Coordinate::mrp_b_inv_matrix;
+using Coordinate::mrp_b_matrix;
+using Coordinate::mrp_switch_to_shadow;
+using Coordinate::mrp_to_dcm;
+
+// Every type below is written for a scalar type, double for one simulation or Lanes<N> for N
+// simulations of the same bodies and joints evaluated in lockstep, one SIMD lane each.
+template <typename Scalar>
+using BasicVector3 = Coordinate::Vector<3, Scalar>;
+
+template <typename Scalar>
+using BasicMatrix3 = Coordinate::Matrix<3, 3, Scalar>;
+
+// Derived kinematic properties of a Rigidbody, shared by every joint and force on the body.  The
+// attitude terms depend on sigma alone and the rate terms on sigma and sigma_dot, so each half is
+// only recomputed when its inputs change.
+template <typename Scalar>
+struct BasicRigidbodyKinematics
+{
+    // Functions of sigma_0_to_body.
+    BasicMatrix3<Scalar> c_0_to_body;
+    BasicMatrix3<Scalar> c_body_to_0;
+    BasicMatrix3<Scalar> b;
+    BasicMatrix3<Scalar> b_inv;
+    // Functions of sigma_0_to_body and sigma_dot_0_to_body.
+    BasicMatrix3<Scalar> b_dot;
+    BasicMatrix3<Scalar> b_inv_dot;
+    BasicVector3<Scalar> b_inv_dot_sigma_dot;
+    BasicVector3<Scalar> omega_body_wrt_0_in_body;
+    BasicMatrix3<Scalar> tilde_omega_body_wrt_0_in_body;
+    BasicMatrix3<Scalar> tilde_omega_body_wrt_0_in_body_squared;
+
+    // The attitude and rates the terms above were populated for, valid once populated is set.
+    BasicVector3<Scalar> sigma_0_to_body;
+    BasicVector3<Scalar> sigma_dot_0_to_body;
+    bool populated = false;
+    // Whether the last populate_kinematics recomputed the attitude terms and the rate terms.
+    bool attitude_updated = false;
+    bool rates_updated = false;
+};
+
+template <typename Scalar>
+struct BasicRigidbody
+{
+    // Throws std::invalid_argument if the mass is not positive or the inertia is singular.
+    BasicRigidbody(
+        const Scalar& m_body,
+        const BasicMatrix3<Scalar>& inertia_body_wrt_cm_in_body,
+        const BasicVector3<Scalar>& r_body_wrt_0_in_0,
+        const BasicVector3<Scalar>& sigma_0_to_body,
+        const BasicVector3<Scalar>& v_body_wrt_0_in_0,
+        const BasicVector3<Scalar>& sigma_dot_0_to_body);
+
+    // Recomputes the kinematics that depend on an attitude or rate changed since the last call.
+    void populate_kinematics();
+
+    // Writes M * x_ddot of the free body, translation then attitude, to scaled_state_ddot[0..6).
+    void unconstrained_dynamics(
+        const BasicVector3<Scalar>& force_body_wrt_0_in_0,
+        const BasicVector3<Scalar>& moment_body_wrt_0_in_body,
+        Scalar* scaled_state_ddot) const;
+
+    Scalar m_body;
+    BasicMatrix3<Scalar> inertia_body_wrt_cm_in_body;
+    BasicMatrix3<Scalar> inertia_inv_body_wrt_cm_in_body;
+    BasicVector3<Scalar> r_body_wrt_0_in_0;
+    BasicVector3<Scalar> sigma_0_to_body;
+    BasicVector3<Scalar> v_body_wrt_0_in_0;
+    BasicVector3<Scalar> sigma_dot_0_to_body;
+    BasicRigidbodyKinematics<Scalar> kinematics;
+};
+
+// Derived kinematic properties of a RevoluteJoint, populated when either body's kinematics change.
+template <typename Scalar>
+struct BasicRevoluteJointKinematics
+{
+    BasicVector3<Scalar> body1_joint_direction_in_0;
+    BasicVector3<Scalar> body2_joint_direction_in_0;
+    BasicMatrix3<Scalar> tilde_body1_joint_direction_in_0;
+    BasicMatrix3<Scalar> tilde_body2_joint_direction_in_0;
+    BasicVector3<Scalar> body1_joint_direction_dot_in_0;
+    BasicVector3<Scalar> body2_joint_direction_dot_in_0;
+};
+
+// Joins two bodies at a point, leaving one rotational degree of freedom about the joint direction.
+template <typename Scalar>
+struct BasicRevoluteJoint
+{
+    void populate_kinematics(
+        const BasicRigidbody<Scalar>& body1,
+        const BasicRigidbody<Scalar>& body2);
+
+    size_t body1_idx;
+    size_t body2_idx;
+    BasicVector3<Scalar> r_joint_wrt_1_in_1;
+    BasicVector3<Scalar> r_joint_wrt_2_in_2;
+    BasicVector3<Scalar> joint_direction_in_1;
+    BasicVector3<Scalar> joint_direction_in_2;
+    BasicMatrix3<Scalar> tilde_r_joint_wrt_1_in_1;
+    BasicMatrix3<Scalar> tilde_r_joint_wrt_2_in_2;
+    BasicMatrix3<Scalar> tilde_joint_direction_in_1;
+    BasicMatrix3<Scalar> tilde_joint_direction_in_2;
+    BasicRevoluteJointKinematics<Scalar> kinematics;
+};
+
+// Constant forces and torques applied to one body.
+template <typename Scalar>
+struct BasicForceGenerator
+{
+    // Adds the force in frame 0 and the moment in the body frame to the accumulators.
+    void compute_forces(
+        const BasicRigidbody<Scalar>& body,
+        BasicVector3<Scalar>& force_body_wrt_0_in_0,
+        BasicVector3<Scalar>& moment_body_wrt_0_in_body) const;
+
+    size_t body_idx;
+    BasicVector3<Scalar> f_wrt_0_in_0;
+    BasicVector3<Scalar> f_wrt_0_in_body;
+    BasicVector3<Scalar> r_f_wrt_body_in_body;
+    BasicVector3<Scalar> tau_body_wrt_0_in_body;
+};
+
+// The largest constraint violation over a model's joints, and over its lanes.
+struct ConstraintDrift
+{
+    // Distance between the two bodies' joint points, and its rate.
+    double position;
+    double position_rate;
+    // Sine of the angle between the two bodies' joint directions, and its rate.
+    double rotation;
+    double rotation_rate;
+};
+
+// How BasicMultiRigidbody::control_constraint_drift keeps the violation within tolerances between
+// steps.  Drift above a tolerance multiplies the Baumgarte gains by gain_factor, up to max_gain,
+// and once they are there projects the state onto the constraints instead.  Drift below the
+// tolerance over gain_factor squared divides them again, down to min_gain, so the gains stay as
+// soft, and the steps as long, as the run allows.
+struct DriftControl
+{
+    double position_tolerance = 1e-6;
+    double rotation_tolerance = 1e-6;
+    double min_gain = 1.0;
+    double max_gain = 100.0;
+    double gain_factor = 2.0;
+};
+
+// Rigid bodies joined by revolute joints, with the constrained accelerations from the
+// Udwadia-Kalaba equation
+//
+//     x_ddot = M^-1 q + M^-1 A^T (A M^-1 A^T)^+ (b - A M^-1 q)
+//
+// where x holds each body's position and MRP attitude and M = diag(m, m, m, 4, 4, 4) per body.
+// Every revolute joint adds three position and three rotation constraint equations, the rotation
+// ones being rank deficient, so the solve drops dependent equations like the prototype's lstsq.
+//
+// A joint only touches the columns of its two bodies, so A M^-1/2 is kept as two 6 x 6 blocks per
+// joint and K = A M^-1 A^T as 6 x 6 blocks between joints sharing a body.  initialize orders the
+// joints leaf first over a spanning tree of the bodies, so the block Cholesky factorization of K
+// creates no fill for trees and costs O(n) for chains.  Closed loops still work, with fill.
+// Add bodies, joints and forces, then call initialize once; after that evaluations do not allocate.
+//
+// Evaluations reuse whatever the state change leaves valid.  Body kinematics are recomputed only
+// for bodies whose attitude or rates changed, joints only next to those bodies, and A M^-1/2 and
+// the factorization of K, which depend on the attitudes alone, only when an attitude changed.
+// Parameters of bodies, joints and forces are read as constants after initialize: change them
+// through set_lane, which invalidates everything derived from them.
+//
+// With Scalar = Lanes<N> every lane is its own simulation with its own state, mass properties,
+// joint geometry and forces, sharing only the topology and the Baumgarte gains.  State arrays then
+// hold N doubles per coordinate, value i of lane l at [N * i + l], so the integrators in
+// integrators.h step all lanes at once.  Each lane drops its own dependent constraints, and the
+// result matches evaluating the lanes one by one as MultiRigidbody to rounding.
+template <typename Scalar>
+class BasicMultiRigidbody
+{
+public:
+    // Simulations evaluated at once, 1 for double.
+    static constexpr size_t lane_count = Coordinate::lane_count<Scalar>;
+
+    size_t add_body(
+        const Scalar& m_body,
+        const BasicMatrix3<Scalar>& inertia_body_wrt_cm_in_body,
+        const BasicVector3<Scalar>& r_body_wrt_0_in_0 = BasicVector3<Scalar>{0.0, 0.0, 0.0},
+        const BasicVector3<Scalar>& sigma_0_to_body = BasicVector3<Scalar>{0.0, 0.0, 0.0},
+        const BasicVector3<Scalar>& v_body_wrt_0_in_0 = BasicVector3<Scalar>{0.0, 0.0, 0.0},
+        const BasicVector3<Scalar>& sigma_dot_0_to_body = BasicVector3<Scalar>{0.0, 0.0, 0.0});
+
+    size_t add_revolute_joint(
+        const size_t body1_idx,
+        const size_t body2_idx,
+        const BasicVector3<Scalar>& r_joint_wrt_1_in_1 = BasicVector3<Scalar>{0.0, 0.0, 0.0},
+        const BasicVector3<Scalar>& r_joint_wrt_2_in_2 = BasicVector3<Scalar>{0.0, 0.0, 0.0},
+        const BasicVector3<Scalar>& joint_direction_in_1 = BasicVector3<Scalar>{0.0, 0.0, 1.0},
+        const BasicVector3<Scalar>& joint_direction_in_2 = BasicVector3<Scalar>{0.0, 0.0, 1.0});
+
+    size_t add_force(const BasicForceGenerator<Scalar>& force);
+
+    // Sizes every buffer used by uk_dynamics.  Throws std::logic_error if called twice.
+    void initialize();
+
+    bool is_initialized() const
+    {
+        return initialized;
+    }
+
+    // Number of generalized coordinates, 6 per body.
+    size_t get_state_size() const
+    {
+        return 6 * bodies.size();
+    }
+
+    void get_state(double* state) const;
+    void set_state(const double* state);
+    void get_state_dot(double* state_dot) const;
+    void set_state_dot(const double* state_dot);
+
+    // Copies the state and every body, joint and force parameter of scenario into one lane.
+    // Throws std::out_of_range if lane >= lane_count and std::invalid_argument if scenario's
+    // bodies, joints and forces are not connected the same way.
+    void set_lane(const size_t lane, const BasicMultiRigidbody<double>& scenario);
+
+    // Writes x_ddot for the current state and state_dot.  Throws std::logic_error if not
+    // initialized.
+    void uk_dynamics(double* state_ddot);
+
+    // The first order form for integrators: full_state = [x, x_dot] and
+    // full_state_derivative = [x_dot, x_ddot], each 2 * get_state_size() * lane_count long.
+    void get_derivative(const double* full_state, double* full_state_derivative);
+
+    // Switches every body's attitude to its shadow set where needed, lane by lane.  Call between
+    // integration steps, never within one.
+    void switch_attitudes_to_shadow();
+
+    // The constraint violation of full_state.  Builds the constraint equations but solves nothing,
+    // and leaves the kinematics cached for evaluating the same state next.  Throws
+    // std::logic_error if not initialized.
+    ConstraintDrift measure_constraint_drift(const double* full_state);
+
+    // Moves full_state onto the constraints along the smallest correction in the metric of M:
+    // Gauss-Newton steps x -= M^-1 A^T (A M^-1 A^T)^+ phi until the violation is well within
+    // drift_control's tolerances, then the same projection of x_dot onto A x_dot = 0.  Each step
+    // refactors K, so call it only when drift calls for it.
+    void project_onto_constraints(double* full_state);
+
+    // Applies drift_control to full_state, between integration steps like
+    // switch_attitudes_to_shadow.  Returns whether the gains or the state changed, in which case
+    // reset integrators that reuse derivatives, like DormandPrince54.
+    bool control_constraint_drift(double* full_state);
+
+    // Baumgarte stabilization gains.
+    double alpha = 10.0;
+    double beta = 10.0;
+    DriftControl drift_control;
+
+    std::vector<BasicRigidbody<Scalar>> bodies;
+    std::vector<BasicRevoluteJoint<Scalar>> joints;
+    std::vector<BasicForceGenerator<Scalar>> forces;
+
+private:
+    // K += (A M^-1/2)_row (A M^-1/2)_column^T for one body shared by two joints, the offsets
+    // indexing a_blocks and k_blocks.
+    struct KTerm
+    {
+        size_t row_a_offset;
+        size_t column_a_offset;
+        size_t k_offset;
+    };
+
+    void populate_mass_matrix();
+    void populate_kinematics();
+    void calculate_forces();
+    void unconstrained_dynamics();
+    void uk_a_matrix_b_vector_with_baumgarte();
+    void order_joints();
+    void analyze_k_structure();
+    void factor_k();
+    void solve_k();
+    // values += M^-1/2 (A M^-1/2)^T K^+ residual, for values laid out like the state.
+    void add_constraint_correction(double* values);
+
+    bool initialized = false;
+
+    // Buffers sized by initialize.  Blocks are 6 x 6 row major.
+    std::vector<Scalar> mass_matrix_inv_sqrt_diagonal;
+    std::vector<BasicVector3<Scalar>> force_wrt_0_in_0;
+    std::vector<BasicVector3<Scalar>> moment_wrt_0_in_body;
+    std::vector<Scalar> q_vector;
+    std::vector<Scalar> scaled_state_dot;
+    std::vector<Scalar> scaled_state_ddot;
+    // Two blocks per joint, body1 then body2.  The position block of each body only depends on
+    // its mass and the attitude blocks on the two attitudes, so only changed blocks are rewritten.
+    std::vector<Scalar> a_blocks;
+    // Six entries per joint, in joint order.  phi_vector and phi_dot_vector hold the violation
+    // of the last evaluated state.
+    std::vector<Scalar> b_vector;
+    std::vector<Scalar> phi_vector;
+    std::vector<Scalar> phi_dot_vector;
+    std::vector<Scalar> residual;
+    std::vector<Scalar> lambda_vector;
+
+    // K in elimination order: diagonal blocks first, then the blocks right of the diagonal listed
+    // by k_neighbor_start / k_neighbor, the union of K's own structure and its Cholesky fill.
+    // With lanes, each factored diagonal block is replaced by the lanes' L^-1 P^T instead, and the
+    // pivots and ranks are not kept.
+    std::vector<size_t> elimination_order;
+    std::vector<size_t> k_neighbor_start;
+    std::vector<size_t> k_neighbor;
+    std::vector<KTerm> k_terms;
+    std::vector<Scalar> k_blocks;
+    std::vector<int> k_pivot_permutation;
+    std::vector<int> k_block_rank;
+    std::vector<Scalar> solve_work;
+    // Whether k_blocks holds the factorization for the current A M^-1/2.
+    bool k_factored = false;
+};
+
+using RigidbodyKinematics = BasicRigidbodyKinematics<double>;
+using Rigidbody = BasicRigidbody<double>;
+using RevoluteJointKinematics = BasicRevoluteJointKinematics<double>;
+using RevoluteJoint = BasicRevoluteJoint<double>;
+using ForceGenerator = BasicForceGenerator<double>;
+using MultiRigidbody = BasicMultiRigidbody<double>;
+
+// LaneCount copies of one multibody topology integrated in lockstep.  Forces are the lanes' own
+// ForceGenerators; no field model is evaluated here, but WorldMagneticModel::get_field takes
+// positions as Lanes<LaneCount> too, for callers that turn the lanes' fields into forces.
+template <size_t LaneCount>
+using LockstepMultiRigidbody = BasicMultiRigidbody<Lanes<LaneCount>>;
+
+// A lockstep model with every lane a copy of model, initialized if model is.  Use set_lane to
+// give the lanes their own scenarios.
+template <size_t LaneCount>
+LockstepMultiRigidbody<LaneCount> make_lockstep(const MultiRigidbody& model);
+
+// Defined in dynamics.cc for one lane and for 4 and 8 lanes, an AVX2 or an AVX-512 register of
+// doubles.
+extern template struct BasicRigidbody<double>;
+extern template struct BasicRevoluteJoint<double>;
+extern template struct BasicForceGenerator<double>;
+extern template class BasicMultiRigidbody<double>;
+extern template struct BasicRigidbody<Lanes<4>>;
+extern template struct BasicRevoluteJoint<Lanes<4>>;
+extern template struct BasicForceGenerator<Lanes<4>>;
+extern template class BasicMultiRigidbody<Lanes<4>>;
+extern template struct BasicRigidbody<Lanes<8>>;
+extern template struct BasicRevoluteJoint<Lanes<8>>;
+extern template struct BasicForceGenerator<Lanes<8>>;
+extern template class BasicMultiRigidbody<Lanes<8>>;
+
+}
+
+#endif
@@ -0,0 +1,499 @@
+#include "dynamics.h"
+
+#include <cmath>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace CamSim::Dynamics {
+
+// Reference values in these tests come from experimentation/uk_revolute.py.
+
+// Masses and inertias are multiplied by mass_scale.
+MultiRigidbody make_chain(const double mass_scale = 1.0)
+{
+    MultiRigidbody system;
+    system.add_body(2.0 * mass_scale,
+                    mass_scale * Matrix3{{{2.0, 0.1, 0.0}, {0.1, 3.0, 0.2}, {0.0, 0.2, 4.0}}},
+                    Vector3{0.0, 0.0, 0.0}, Vector3{0.1, -0.2, 0.05}, Vector3{0.1, 0.2, -0.3},
+                    Vector3{0.01, 0.02, -0.03});
+    system.add_body(1.5 * mass_scale,
+                    mass_scale * Matrix3{{{1.0, 0.0, 0.0}, {0.0, 1.5, 0.0}, {0.0, 0.0, 0.5}}},
+                    Vector3{1.1, 0.05, -0.02}, Vector3{-0.05, 0.1, 0.2}, Vector3{0.0, -0.1, 0.2},
+                    Vector3{-0.02, 0.04, 0.01});
+    system.add_body(0.7 * mass_scale,
+                    mass_scale * Matrix3{{{0.3, 0.0, 0.0}, {0.0, 0.4, 0.0}, {0.0, 0.0, 0.5}}},
+                    Vector3{2.0, 0.1, 0.1}, Vector3{0.3, 0.0, -0.1}, Vector3{0.05, 0.05, 0.05},
+                    Vector3{0.0, -0.01, 0.02});
+    system.add_revolute_joint(0, 1, Vector3{0.5, 0.0, 0.0}, Vector3{-0.5, 0.0, 0.0},
+                              Vector3{0.0, 0.0, 1.0}, Vector3{0.0, 0.0, 1.0});
+    system.add_revolute_joint(1, 2, Vector3{0.5, 0.0, 0.0}, Vector3{-0.4, 0.0, 0.0},
+                              Vector3{0.0, 1.0, 0.0}, Vector3{0.0, 1.0, 0.0});
+    system.add_force(ForceGenerator{0, Vector3{0.0, 0.0, -9.8}, Vector3{0.0, 0.0, 0.0},
+                                    Vector3{0.0, 0.0, 0.0}, Vector3{0.0, 0.0, 0.0}});
+    system.add_force(ForceGenerator{2, Vector3{0.1, 0.0, 0.0}, Vector3{0.0, 0.5, 0.0},
+                                    Vector3{0.2, 0.0, 0.1}, Vector3{0.0, 0.0, 0.3}});
+    system.initialize();
+
+    return system;
+}
+
+MultiRigidbody make_spinning_pair()
+{
+    MultiRigidbody system;
+    system.add_body(1.0, Matrix3::identity(), Vector3{0.0, 0.0, 0.0}, Vector3{0.0, 0.0, 0.0},
+                    Vector3{0.0, -1.0, 0.0}, Vector3{0.0, 0.0, 0.5});
+    system.add_body(1.0, Matrix3::identity(), Vector3{1.0, 0.0, 0.0}, Vector3{0.0, 0.0, 0.0},
+                    Vector3{0.0, 1.0, 0.0}, Vector3{0.0, 0.0, 0.5});
+    system.add_revolute_joint(0, 1, Vector3{0.5, 0.0, 0.0}, Vector3{-0.5, 0.0, 0.0});
+    system.initialize();
+
+    return system;
+}
+
+TEST(mrp_test, kinematic_identities)
+{
+    const Vector3 sigma{0.1, -0.3, 0.2};
+    const Vector3 sigma_dot{0.05, 0.01, -0.02};
+
+    const Matrix3 dcm = mrp_to_dcm(sigma);
+    const Matrix3 dcm_dcm_t = dcm * transpose(dcm);
+    const Matrix3 b_b_inv = mrp_b_matrix(sigma) * mrp_b_inv_matrix(sigma);
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            EXPECT_NEAR(dcm_dcm_t(i, j), i == j ? 1.0 : 0.0, 1e-15);
+            EXPECT_NEAR(b_b_inv(i, j), i == j ? 1.0 : 0.0, 1e-15);
+        }
+    }
+
+    // The derivatives match finite differences.
+    const double h = 1e-6;
+    const Vector3 sigma_plus = sigma + h * sigma_dot;
+    const Vector3 sigma_minus = sigma - h * sigma_dot;
+    const Matrix3 b_dot = (1.0 / (2.0 * h)) * (mrp_b_matrix(sigma_plus) - mrp_b_matrix(sigma_minus));
+    const Matrix3 b_inv_dot =
+        (1.0 / (2.0 * h)) * (mrp_b_inv_matrix(sigma_plus) - mrp_b_inv_matrix(sigma_minus));
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            EXPECT_NEAR(mrp_b_dot_matrix(sigma, sigma_dot)(i, j), b_dot(i, j), 1e-9);
+            EXPECT_NEAR(mrp_b_inv_dot_matrix(sigma, sigma_dot)(i, j), b_inv_dot(i, j), 1e-9);
+        }
+    }
+}
+
+TEST(mrp_test, shadow_switch_keeps_attitude_and_rate)
+{
+    Vector3 sigma{0.9, -0.6, 0.3};
+    Vector3 sigma_dot{0.1, 0.2, -0.1};
+    const Matrix3 dcm = mrp_to_dcm(sigma);
+    const Vector3 omega = 4.0 * (mrp_b_inv_matrix(sigma) * sigma_dot);
+
+    ASSERT_TRUE(mrp_switch_to_shadow(sigma, sigma_dot));
+    EXPECT_LT(dot(sigma, sigma), 1.0);
+    EXPECT_FALSE(mrp_switch_to_shadow(sigma, sigma_dot));
+
+    const Matrix3 shadow_dcm = mrp_to_dcm(sigma);
+    const Vector3 shadow_omega = 4.0 * (mrp_b_inv_matrix(sigma) * sigma_dot);
+    for (int i = 0; i < 3; i++)
+    {
+        EXPECT_NEAR(shadow_omega[i], omega[i], 1e-14);
+        for (int j = 0; j < 3; j++)
+        {
+            EXPECT_NEAR(shadow_dcm(i, j), dcm(i, j), 1e-14);
+        }
+    }
+}
+
+TEST(multi_rigidbody_test, matches_prototype_accelerations)
+{
+    // The prototype's own example, where the initial velocities violate the joint.
+    MultiRigidbody pair;
+    pair.add_body(1.0, Matrix3::identity(), Vector3{0.0, 0.0, 0.0}, Vector3{0.0, 0.0, 0.0},
+                  Vector3{0.0, -1.0, 0.0});
+    pair.add_body(1.0, Matrix3::identity(), Vector3{1.0, 0.0, 0.0}, Vector3{0.0, 0.0, 0.0},
+                  Vector3{0.0, 1.0, 0.0});
+    pair.add_revolute_joint(0, 1, Vector3{0.5, 0.0, 0.0}, Vector3{-0.5, 0.0, 0.0});
+    pair.initialize();
+
+    const std::vector<double> expected_pair = {0.0, 10.0, 0.0, 0.0, 0.0, 5.0,
+                                               0.0, -10.0, 0.0, 0.0, 0.0, 5.0};
+    std::vector<double> state_ddot(pair.get_state_size());
+    pair.uk_dynamics(state_ddot.data());
+    for (size_t i = 0; i < expected_pair.size(); i++)
+    {
+        EXPECT_NEAR(state_ddot[i], expected_pair[i], 1e-12) << i;
+    }
+
+    // Three bodies with full inertias, skewed joints and forces.
+    MultiRigidbody chain = make_chain();
+    const std::vector<double> expected_chain = {
+        772.5796502208302,   439.08587206931634,  -561.6158250696695,  632.9526232254937,
+        -975.8486237908684,  39.471869796718316,  83.03702414353052,   423.5731053665505,
+        2836.6458326480833,  291.4945072415218,   -1215.716563546938,  123.02683394059338,
+        -2384.9515376091113, -2161.9456867155077, -4487.272596915786,  4351.346091277084,
+        3316.811057964056,   -6152.391273937574};
+    state_ddot.resize(chain.get_state_size());
+    chain.uk_dynamics(state_ddot.data());
+    for (size_t i = 0; i < expected_chain.size(); i++)
+    {
+        EXPECT_NEAR(state_ddot[i], expected_chain[i], 1e-9 * std::fabs(expected_chain[i])) << i;
+    }
+}
+
+TEST(multi_rigidbody_test, matches_prototype_trajectory)
+{
+    // Two bodies spinning about their shared joint at 2 rad/s, integrated with RK4 at 0.01 s for
+    // 1 s.
+    MultiRigidbody pair = make_spinning_pair();
+    const size_t size = 2 * pair.get_state_size();
+    std::vector<double> y(size), k1(size), k2(size), k3(size), k4(size), stage(size);
+    pair.get_state(y.data());
+    pair.get_state_dot(y.data() + pair.get_state_size());
+
+    const double dt = 0.01;
+    for (int step = 0; step < 100; step++)
+    {
+        pair.get_derivative(y.data(), k1.data());
+        for (size_t i = 0; i < size; i++)
+        {
+            stage[i] = y[i] + dt / 2 * k1[i];
+        }
+        pair.get_derivative(stage.data(), k2.data());
+        for (size_t i = 0; i < size; i++)
+        {
+            stage[i] = y[i] + dt / 2 * k2[i];
+        }
+        pair.get_derivative(stage.data(), k3.data());
+        for (size_t i = 0; i < size; i++)
+        {
+            stage[i] = y[i] + dt * k3[i];
+        }
+        pair.get_derivative(stage.data(), k4.data());
+        for (size_t i = 0; i < size; i++)
+        {
+            y[i] += dt / 6 * (k1[i] + 2 * k2[i] + 2 * k3[i] + k4[i]);
+        }
+    }
+
+    const std::vector<double> expected = {
+        0.7080734010447017,  -0.4546487450544837, 0.0, 0.0, 0.0, 0.5463024610354389,
+        0.29192659895529793, 0.4546487450544837,  0.0, 0.0, 0.0, 0.5463024610354389,
+        0.9092971534752793,  0.4161470537686073,  0.0, 0.0, 0.0, 0.6492232333945187,
+        -0.9092971534752793, -0.4161470537686073, 0.0, 0.0, 0.0, 0.6492232333945187};
+    for (size_t i = 0; i < size; i++)
+    {
+        EXPECT_NEAR(y[i], expected[i], 1e-12) << i;
+    }
+}
+
+TEST(multi_rigidbody_test, matches_prototype_on_branches_and_loops)
+{
+    // A hub with three arms, one of them two bodies long, joined out of elimination order.
+    MultiRigidbody tree;
+    tree.add_body(3.0, Matrix3{{{2.0, 0.1, 0.0}, {0.1, 3.0, 0.2}, {0.0, 0.2, 4.0}}},
+                  Vector3{0.0, 0.0, 0.0}, Vector3{0.0, 0.0, 0.1}, Vector3{0.1, 0.2, -0.3},
+                  Vector3{0.0, 0.0, 0.02});
+    tree.add_body(1.0, Matrix3{{{0.5, 0.0, 0.0}, {0.0, 0.6, 0.0}, {0.0, 0.0, 0.7}}},
+                  Vector3{1.0, 0.1, 0.0}, Vector3{0.0, 0.0, -0.2}, Vector3{0.0, -0.1, 0.2},
+                  Vector3{0.0, 0.0, 0.03});
+    tree.add_body(1.2, Matrix3{{{0.4, 0.0, 0.0}, {0.0, 0.6, 0.0}, {0.0, 0.0, 0.5}}},
+                  Vector3{-1.0, 0.2, 0.1}, Vector3{0.0, 0.0, 0.3}, Vector3{0.05, 0.0, 0.1},
+                  Vector3{0.0, 0.0, -0.01});
+    tree.add_body(0.8, Matrix3{{{0.3, 0.0, 0.0}, {0.0, 0.3, 0.0}, {0.0, 0.0, 0.2}}},
+                  Vector3{0.0, 1.1, 0.0}, Vector3{0.0, 0.0, 0.05}, Vector3{0.2, 0.0, 0.0},
+                  Vector3{0.0, 0.0, 0.04});
+    tree.add_body(0.5, Matrix3{{{0.2, 0.0, 0.0}, {0.0, 0.1, 0.0}, {0.0, 0.0, 0.2}}},
+                  Vector3{1.9, 0.3, 0.0}, Vector3{0.0, 0.0, -0.1}, Vector3{0.0, 0.3, 0.1});
+    tree.add_revolute_joint(0, 1, Vector3{0.5, 0.0, 0.0}, Vector3{-0.5, 0.0, 0.0});
+    tree.add_revolute_joint(2, 0, Vector3{0.5, 0.0, 0.0}, Vector3{-0.5, 0.0, 0.0});
+    tree.add_revolute_joint(0, 3, Vector3{0.0, 0.5, 0.0}, Vector3{0.0, -0.5, 0.0});
+    tree.add_revolute_joint(1, 4, Vector3{0.5, 0.0, 0.0}, Vector3{-0.4, 0.0, 0.0});
+    tree.add_force(ForceGenerator{0, Vector3{0.0, 0.0, -9.8}, Vector3{0.0, 0.0, 0.0},
+                                  Vector3{0.0, 0.0, 0.0}, Vector3{0.1, 0.0, 0.0}});
+    tree.add_force(ForceGenerator{4, Vector3{0.1, 0.0, 0.0}, Vector3{0.0, 0.5, 0.0},
+                                  Vector3{0.2, 0.0, 0.1}, Vector3{0.0, 0.0, 0.3}});
+    tree.initialize();
+
+    const std::vector<double> expected_tree = {
+        -2.671952689892082, 19.080741505318407, 4.487370563736517,    -0.9888894192500574,
+        0.5695226902323385, -9.752671911997169, 5.2591071867342025,   -0.7590492992268736,
+        -5.989698293755245, -1.1720504777687168, -0.08406472790982389, 12.188532029138337,
+        6.201535943195866,  -37.001186268743695, -9.76725090993384,    -0.7596449953304782,
+        0.9693639399953025, -11.162165665341305, -11.918868258956483,  16.354748515966342,
+        -5.166366735600385, -1.0328083937832595, 0.46507691583345356,  -3.3654898293849205,
+        10.28820195210952,  -49.40952469797053,  -2.837237834106788,   -1.1324242019105804,
+        0.14097448393726325, 8.944294185976085};
+    std::vector<double> state_ddot(tree.get_state_size());
+    tree.uk_dynamics(state_ddot.data());
+    for (size_t i = 0; i < expected_tree.size(); i++)
+    {
+        EXPECT_NEAR(state_ddot[i], expected_tree[i], 1e-9 * std::fabs(expected_tree[i])) << i;
+    }
+
+    // A planar four bar loop, whose redundant out of plane constraints are consistent.
+    MultiRigidbody loop;
+    loop.add_body(1.0, Matrix3{{{0.5, 0.0, 0.0}, {0.0, 0.6, 0.0}, {0.0, 0.0, 0.7}}},
+                  Vector3{0.0, 0.0, 0.0}, Vector3{0.0, 0.0, 0.0}, Vector3{0.1, 0.2, 0.0},
+                  Vector3{0.0, 0.0, 0.02});
+    loop.add_body(2.0, Matrix3{{{0.4, 0.0, 0.0}, {0.0, 0.6, 0.0}, {0.0, 0.0, 0.5}}},
+                  Vector3{1.0, 0.0, 0.0}, Vector3{0.0, 0.0, 0.0}, Vector3{0.0, -0.1, 0.0},
+                  Vector3{0.0, 0.0, -0.03});
+    loop.add_body(1.5, Matrix3{{{0.3, 0.0, 0.0}, {0.0, 0.3, 0.0}, {0.0, 0.0, 0.2}}},
+                  Vector3{1.0, 1.0, 0.0}, Vector3{0.0, 0.0, 0.0}, Vector3{0.2, 0.0, 0.0},
+                  Vector3{0.0, 0.0, 0.01});
+    loop.add_body(0.5, Matrix3{{{0.2, 0.0, 0.0}, {0.0, 0.1, 0.0}, {0.0, 0.0, 0.2}}},
+                  Vector3{0.0, 1.0, 0.0}, Vector3{0.0, 0.0, 0.0}, Vector3{-0.1, 0.1, 0.0});
+    loop.add_revolute_joint(0, 1, Vector3{0.5, 0.0, 0.0}, Vector3{-0.5, 0.0, 0.0});
+    loop.add_revolute_joint(1, 2, Vector3{0.0, 0.5, 0.0}, Vector3{0.0, -0.5, 0.0});
+    loop.add_revolute_joint(2, 3, Vector3{-0.5, 0.0, 0.0}, Vector3{0.5, 0.0, 0.0});
+    loop.add_revolute_joint(3, 0, Vector3{0.0, -0.5, 0.0}, Vector3{0.0, 0.5, 0.0});
+    loop.add_force(ForceGenerator{2, Vector3{0.3, -0.2, 0.0}, Vector3{0.0, 0.0, 0.0},
+                                  Vector3{0.0, 0.0, 0.0}, Vector3{0.0, 0.0, 0.1}});
+    loop.initialize();
+
+    const std::vector<double> expected_loop = {
+        -1.3968430769230764, -2.3284246153846189, 0.0, 0.0, 0.0, -0.60642692307692259,
+        0.59275692307692052, 1.5160676923076957,  0.0, 0.0, 0.0, -0.27132692307692241,
+        -1.2445353846153853, -0.49193230769230922, 0.0, 0.0, 0.0, -0.41002692307692334,
+        4.7562646153846275,  -0.33162461538461718, 0.0, 0.0, 0.0, -0.87012692307692352};
+    state_ddot.resize(loop.get_state_size());
+    loop.uk_dynamics(state_ddot.data());
+    for (size_t i = 0; i < expected_loop.size(); i++)
+    {
+        EXPECT_NEAR(state_ddot[i], expected_loop[i], 1e-12) << i;
+    }
+}
+
+TEST(multi_rigidbody_test, cached_kinematics_follow_state_changes)
+{
+    MultiRigidbody chain = make_chain();
+    const size_t state_size = chain.get_state_size();
+    std::vector<double> state(state_size);
+    std::vector<double> state_dot(state_size);
+    chain.get_state(state.data());
+    chain.get_state_dot(state_dot.data());
+    std::vector<double> original(state_size);
+    chain.uk_dynamics(original.data());
+
+    // Rates alone, one attitude, then a position, each checked against a model evaluating the
+    // new state from scratch.
+    std::vector<double> state_ddot(state_size);
+    std::vector<double> expected(state_size);
+    for (const size_t changed : {size_t{0}, size_t{1}, size_t{2}})
+    {
+        std::vector<double> new_state = state;
+        std::vector<double> new_state_dot = state_dot;
+        if (changed == 0)
+        {
+            new_state_dot[10] += 0.05;
+        }
+        else if (changed == 1)
+        {
+            new_state[15] -= 0.1;
+        }
+        else
+        {
+            new_state[7] += 0.01;
+        }
+        chain.set_state(new_state.data());
+        chain.set_state_dot(new_state_dot.data());
+        chain.uk_dynamics(state_ddot.data());
+
+        MultiRigidbody fresh = make_chain();
+        fresh.set_state(new_state.data());
+        fresh.set_state_dot(new_state_dot.data());
+        fresh.uk_dynamics(expected.data());
+        for (size_t i = 0; i < state_size; i++)
+        {
+            EXPECT_EQ(state_ddot[i], expected[i]) << changed << ", " << i;
+        }
+    }
+
+    // Going back gives the original accelerations exactly, also when evaluated twice.
+    chain.set_state(state.data());
+    chain.set_state_dot(state_dot.data());
+    for (int repeat = 0; repeat < 2; repeat++)
+    {
+        chain.uk_dynamics(state_ddot.data());
+        for (size_t i = 0; i < state_size; i++)
+        {
+            EXPECT_EQ(state_ddot[i], original[i]) << i;
+        }
+    }
+}
+
+TEST(multi_rigidbody_test, lockstep_lanes_match_independent_models)
+{
+    // Four dispersed copies of the chain: masses, inertias, states and forces differ per lane.
+    std::vector<MultiRigidbody> scenarios;
+    for (size_t lane = 0; lane < 4; lane++)
+    {
+        const double dispersion = 0.1 * (double)lane;
+        MultiRigidbody scenario = make_chain(1.0 + dispersion);
+        for (Rigidbody& body : scenario.bodies)
+        {
+            body.sigma_0_to_body[0] += dispersion;
+            body.v_body_wrt_0_in_0[2] -= dispersion;
+        }
+        scenario.forces[1].f_wrt_0_in_0[0] += dispersion;
+        scenarios.push_back(std::move(scenario));
+    }
+    // Lane 3 starts past |sigma| = 1.
+    scenarios[3].bodies[1].sigma_0_to_body = Vector3{0.9, -0.6, 0.3};
+
+    LockstepMultiRigidbody<4> lockstep = make_lockstep<4>(scenarios[0]);
+    for (size_t lane = 1; lane < 4; lane++)
+    {
+        lockstep.set_lane(lane, scenarios[lane]);
+    }
+
+    const size_t state_size = scenarios[0].get_state_size();
+    std::vector<double> lane_state_ddot(4 * state_size);
+    lockstep.uk_dynamics(lane_state_ddot.data());
+    std::vector<double> state_ddot(state_size);
+    for (size_t lane = 0; lane < 4; lane++)
+    {
+        scenarios[lane].uk_dynamics(state_ddot.data());
+        for (size_t i = 0; i < state_size; i++)
+        {
+            EXPECT_NEAR(lane_state_ddot[4 * i + lane], state_ddot[i],
+                        1e-10 * (1.0 + std::fabs(state_ddot[i])))
+                << lane << ", " << i;
+        }
+    }
+
+    // The first order form interleaves the same way, and each lane switches on its own.
+    std::vector<double> full_state(8 * state_size);
+    lockstep.get_state(full_state.data());
+    lockstep.get_state_dot(full_state.data() + 4 * state_size);
+    std::vector<double> full_state_derivative(8 * state_size);
+    lockstep.get_derivative(full_state.data(), full_state_derivative.data());
+    for (size_t i = 0; i < 4 * state_size; i++)
+    {
+        EXPECT_EQ(full_state_derivative[i], full_state[4 * state_size + i]);
+        EXPECT_EQ(full_state_derivative[4 * state_size + i], lane_state_ddot[i]);
+    }
+
+    lockstep.switch_attitudes_to_shadow();
+    std::vector<double> state(4 * state_size);
+    lockstep.get_state(state.data());
+    for (size_t lane = 0; lane < 4; lane++)
+    {
+        for (size_t i = 0; i < state_size; i++)
+        {
+            const bool switched = lane == 3 && i >= 9 && i < 12;
+            EXPECT_EQ(state[4 * i + lane] == full_state[4 * i + lane], !switched)
+                << lane << ", " << i;
+        }
+    }
+
+    EXPECT_THROW(lockstep.set_lane(4, scenarios[0]), std::out_of_range);
+    EXPECT_THROW(lockstep.set_lane(0, make_spinning_pair()), std::invalid_argument);
+}
+
+std::vector<double> get_full_state(const MultiRigidbody& system)
+{
+    std::vector<double> full_state(2 * system.get_state_size());
+    system.get_state(full_state.data());
+    system.get_state_dot(full_state.data() + system.get_state_size());
+    return full_state;
+}
+
+TEST(multi_rigidbody_test, projection_removes_drift)
+{
+    // The spinning pair starts on its joint; knock every coordinate off it.
+    MultiRigidbody pair = make_spinning_pair();
+    const std::vector<double> exact = get_full_state(pair);
+    const ConstraintDrift exact_drift = pair.measure_constraint_drift(exact.data());
+    EXPECT_LT(exact_drift.position, 1e-15);
+    EXPECT_LT(exact_drift.rotation_rate, 1e-15);
+
+    std::vector<double> full_state = exact;
+    for (size_t i = 0; i < full_state.size(); i++)
+    {
+        full_state[i] += 1e-3 * std::sin(1.0 + i);
+    }
+    const ConstraintDrift before = pair.measure_constraint_drift(full_state.data());
+    EXPECT_GT(before.position, 1e-4);
+    EXPECT_GT(before.rotation, 1e-4);
+    EXPECT_GT(before.position_rate, 1e-4);
+    EXPECT_GT(before.rotation_rate, 1e-4);
+
+    pair.drift_control.position_tolerance = 1e-9;
+    pair.drift_control.rotation_tolerance = 1e-9;
+    pair.project_onto_constraints(full_state.data());
+    const ConstraintDrift after = pair.measure_constraint_drift(full_state.data());
+    EXPECT_LT(after.position, 1e-11);
+    EXPECT_LT(after.rotation, 1e-11);
+    EXPECT_LT(after.position_rate, 1e-12);
+    EXPECT_LT(after.rotation_rate, 1e-12);
+    for (size_t i = 0; i < full_state.size(); i++)
+    {
+        EXPECT_NEAR(full_state[i], exact[i], 1e-2) << i;
+    }
+
+    // The projected state evaluates like any other.
+    std::vector<double> derivative(full_state.size());
+    pair.get_derivative(full_state.data(), derivative.data());
+    for (const double value : derivative)
+    {
+        EXPECT_TRUE(std::isfinite(value));
+    }
+}
+
+TEST(multi_rigidbody_test, drift_control_adapts_gains)
+{
+    MultiRigidbody pair = make_spinning_pair();
+    std::vector<double> full_state = get_full_state(pair);
+    const std::vector<double> exact = full_state;
+    pair.drift_control.position_tolerance = 1e-6;
+    pair.drift_control.rotation_tolerance = 1e-6;
+    pair.drift_control.min_gain = 2.5;
+    pair.drift_control.max_gain = 40.0;
+
+    // Well within tolerance: the gains soften to the minimum and the state is left alone.
+    EXPECT_TRUE(pair.control_constraint_drift(full_state.data()));
+    EXPECT_EQ(pair.alpha, 5.0);
+    EXPECT_EQ(pair.beta, 5.0);
+    EXPECT_TRUE(pair.control_constraint_drift(full_state.data()));
+    EXPECT_EQ(pair.alpha, 2.5);
+    EXPECT_FALSE(pair.control_constraint_drift(full_state.data()));
+    EXPECT_EQ(pair.beta, 2.5);
+    EXPECT_EQ(full_state, exact);
+
+    // Drifted: the gains stiffen to the maximum, then the state is projected.
+    full_state[6] += 1e-5;
+    for (const double gain : {5.0, 10.0, 20.0, 40.0})
+    {
+        EXPECT_TRUE(pair.control_constraint_drift(full_state.data()));
+        EXPECT_EQ(pair.alpha, gain);
+        EXPECT_EQ(pair.beta, gain);
+    }
+    EXPECT_NEAR(pair.measure_constraint_drift(full_state.data()).position, 1e-5, 1e-12);
+    EXPECT_TRUE(pair.control_constraint_drift(full_state.data()));
+    EXPECT_EQ(pair.alpha, 40.0);
+    EXPECT_LT(pair.measure_constraint_drift(full_state.data()).position, 1e-8);
+    EXPECT_NEAR(full_state[6], exact[6], 1e-5);
+}
+
+TEST(multi_rigidbody_test, invalid_use_throws)
+{
+    MultiRigidbody system;
+    EXPECT_THROW(system.add_body(0.0, Matrix3::identity()), std::invalid_argument);
+    EXPECT_THROW(system.add_body(1.0, Matrix3{}), std::invalid_argument);
+
+    system.add_body(1.0, Matrix3::identity());
+    EXPECT_THROW(system.add_revolute_joint(0, 0), std::invalid_argument);
+    EXPECT_THROW(system.add_revolute_joint(0, 1), std::invalid_argument);
+
+    std::vector<double> state_ddot(system.get_state_size());
+    EXPECT_THROW(system.uk_dynamics(state_ddot.data()), std::logic_error);
+    system.initialize();
+    EXPECT_THROW(system.initialize(), std::logic_error);
+    EXPECT_THROW(system.add_body(1.0, Matrix3::identity()), std::logic_error);
+}
+
+}
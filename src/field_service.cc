@@ -0,0 +1,587 @@
+#include "field_service.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace CamSim::FieldService {
+
+namespace {
+
+sockaddr_un make_address(const std::string& socket_path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path))
+    {
+        throw std::invalid_argument("Invalid socket path " + socket_path);
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    return address;
+}
+
+// Queries evaluated at once, across the SIMD lanes of WorldMagneticModel::get_field.  Four lanes
+// gain at the default flags as well as with AVX2 and AVX-512.
+constexpr size_t field_lane_count = 4;
+
+Time::Timestamp get_timestamp(const FieldQuery& query)
+{
+    return Time::Timestamp::from_utc_since_epoch(
+        Time::Duration::from_nanoseconds(query.utc_nanoseconds));
+}
+
+// Evaluates queries that share model and order field_lane_count at a time, and the rest one by
+// one.
+void evaluate_run(
+    const Model::WorldMagneticModel& model,
+    const FieldQuery* queries,
+    const size_t count,
+    FieldValue* fields)
+{
+    using Lanes = Coordinate::Lanes<field_lane_count>;
+    const int order = queries[0].order;
+    size_t i = 0;
+    for (; i + field_lane_count <= count; i += field_lane_count)
+    {
+        Lanes theta, phi, radius, decimal_year;
+        for (size_t lane = 0; lane < field_lane_count; lane++)
+        {
+            const FieldQuery& query = queries[i + lane];
+            theta[lane] = query.theta;
+            phi[lane] = query.phi;
+            radius[lane] = query.radius;
+            decimal_year[lane] = get_timestamp(query).get_decimal_year();
+        }
+        Model::BasicMagneticField<Lanes> field;
+        model.get_field(theta, phi, radius, decimal_year, order, field);
+        for (size_t lane = 0; lane < field_lane_count; lane++)
+        {
+            fields[i + lane] =
+                FieldValue{field.field[0][lane], field.field[1][lane], field.field[2][lane]};
+        }
+    }
+    for (; i < count; i++)
+    {
+        const FieldQuery& query = queries[i];
+        Model::MagneticField field;
+        model.get_field(query.theta, query.phi, query.radius, get_timestamp(query), order, field);
+        fields[i] = FieldValue{field.field[0], field.field[1], field.field[2]};
+    }
+}
+
+// Removes the socket file a server that is no longer running left at socket_path.  Throws
+// std::runtime_error if something else is there: a file that is not a socket, or a socket that a
+// running server still accepts on.
+void remove_stale_socket(const std::string& socket_path, const sockaddr_un& address)
+{
+    struct stat status;
+    if (::lstat(socket_path.c_str(), &status) != 0)
+    {
+        return;
+    }
+    if (!S_ISSOCK(status.st_mode))
+    {
+        throw std::runtime_error("Cannot listen on " + socket_path + ": not a socket");
+    }
+
+    const int descriptor = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (descriptor < 0)
+    {
+        throw std::runtime_error("Cannot check " + socket_path + ": " + std::strerror(errno));
+    }
+    const bool refused =
+        ::connect(descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 &&
+        errno == ECONNREFUSED;
+    ::close(descriptor);
+    if (!refused)
+    {
+        throw std::runtime_error("Cannot listen on " + socket_path + ": in use");
+    }
+    ::unlink(socket_path.c_str());
+}
+
+// Blocking send of every byte, false if the peer is gone.
+bool send_all(const int descriptor, const void* data, const size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    size_t sent = 0;
+    while (sent < size)
+    {
+        const ssize_t result = ::send(descriptor, bytes + sent, size - sent, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result <= 0)
+        {
+            return false;
+        }
+        sent += result;
+    }
+
+    return true;
+}
+
+// Blocking receive of exactly size bytes, false if the peer is gone.
+bool receive_all(const int descriptor, void* data, const size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    size_t received = 0;
+    while (received < size)
+    {
+        const ssize_t result = ::recv(descriptor, bytes + received, size - received, 0);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result <= 0)
+        {
+            return false;
+        }
+        received += result;
+    }
+
+    return true;
+}
+
+}
+
+Evaluator make_evaluator(const Model::WorldMagneticModel& model)
+{
+    return [&model](const FieldQuery* queries, const size_t count, FieldValue* fields)
+    {
+        size_t first = 0;
+        while (first < count)
+        {
+            size_t end = first + 1;
+            while (end < count && queries[end].order == queries[first].order)
+            {
+                end++;
+            }
+            evaluate_run(model, queries + first, end - first, fields + first);
+            first = end;
+        }
+    };
+}
+
+Evaluator make_evaluator(const Model::WorldMagneticModelRegistry& registry)
+{
+    return [&registry](const FieldQuery* queries, const size_t count, FieldValue* fields)
+    {
+        size_t first = 0;
+        while (first < count)
+        {
+            const Model::WorldMagneticModel& model = registry.select(get_timestamp(queries[first]));
+            size_t end = first + 1;
+            while (end < count && queries[end].order == queries[first].order &&
+                   &registry.select(get_timestamp(queries[end])) == &model)
+            {
+                end++;
+            }
+            evaluate_run(model, queries + first, end - first, fields + first);
+            first = end;
+        }
+    };
+}
+
+Evaluator make_parallel_evaluator(
+    const Evaluator& evaluator, size_t thread_count, const size_t min_points_per_thread)
+{
+    if (thread_count == 0)
+    {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    return [evaluator, thread_count, min_points_per_thread](
+               const FieldQuery* queries, const size_t count, FieldValue* fields)
+    {
+        const size_t max_slice_count =
+            std::max<size_t>(1, count / std::max<size_t>(1, min_points_per_thread));
+        const size_t slice_count = std::min(thread_count, max_slice_count);
+        if (slice_count <= 1)
+        {
+            evaluator(queries, count, fields);
+            return;
+        }
+
+        // The calling thread evaluates the first slice.
+        std::vector<std::exception_ptr> errors(slice_count);
+        std::vector<std::thread> threads;
+        threads.reserve(slice_count - 1);
+        const auto evaluate_slice = [&](const size_t slice)
+        {
+            const size_t begin = count * slice / slice_count;
+            const size_t end = count * (slice + 1) / slice_count;
+            try
+            {
+                evaluator(queries + begin, end - begin, fields + begin);
+            }
+            catch (...)
+            {
+                errors[slice] = std::current_exception();
+            }
+        };
+        for (size_t slice = 1; slice < slice_count; slice++)
+        {
+            threads.emplace_back(evaluate_slice, slice);
+        }
+        evaluate_slice(0);
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        for (const std::exception_ptr& error : errors)
+        {
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+    };
+}
+
+Server::Server(
+    const std::string& socket_path,
+    const Evaluator& evaluator,
+    const ServerOptions& options)
+    : socket_path(socket_path), evaluator(evaluator), options(options)
+{
+    const sockaddr_un address = make_address(socket_path);
+    remove_stale_socket(socket_path, address);
+
+    if (::pipe2(wake_descriptors, O_CLOEXEC | O_NONBLOCK) != 0)
+    {
+        throw std::runtime_error("Cannot create the field service wake pipe");
+    }
+    listen_descriptor = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listen_descriptor < 0 ||
+        ::bind(listen_descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) !=
+            0 ||
+        ::listen(listen_descriptor, options.listen_backlog) != 0)
+    {
+        const std::string reason = std::strerror(errno);
+        if (listen_descriptor >= 0)
+        {
+            ::close(listen_descriptor);
+        }
+        ::close(wake_descriptors[0]);
+        ::close(wake_descriptors[1]);
+        throw std::runtime_error("Cannot listen on " + socket_path + ": " + reason);
+    }
+}
+
+Server::~Server()
+{
+    for (const Connection& connection : connections)
+    {
+        ::close(connection.descriptor);
+    }
+    ::close(listen_descriptor);
+    ::close(wake_descriptors[0]);
+    ::close(wake_descriptors[1]);
+    ::unlink(socket_path.c_str());
+}
+
+void Server::stop()
+{
+    stopping = true;
+    const char byte = 0;
+    // A full pipe already wakes poll.
+    [[maybe_unused]] const ssize_t result = ::write(wake_descriptors[1], &byte, 1);
+}
+
+void Server::run()
+{
+    std::vector<pollfd> descriptors;
+    while (!stopping)
+    {
+        descriptors.clear();
+        descriptors.push_back(pollfd{wake_descriptors[0], POLLIN, 0});
+        descriptors.push_back(pollfd{listen_descriptor, POLLIN, 0});
+        for (const Connection& connection : connections)
+        {
+            // A connection with output queued is not read until the output is sent.
+            descriptors.push_back(pollfd{connection.descriptor,
+                                         short(connection.output.empty() ? POLLIN : POLLOUT), 0});
+        }
+        if (::poll(descriptors.data(), descriptors.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw std::runtime_error("Field service poll failed");
+        }
+
+        if (descriptors[0].revents != 0)
+        {
+            char bytes[64];
+            while (::read(wake_descriptors[0], bytes, sizeof(bytes)) > 0)
+            {
+            }
+        }
+
+        // Every request that arrived this round goes into one batch.
+        for (size_t i = 0; i < connections.size(); i++)
+        {
+            if (descriptors[2 + i].revents == 0)
+            {
+                continue;
+            }
+            if (connections[i].output.empty())
+            {
+                read_requests(connections[i], i);
+            }
+            else
+            {
+                send_output(connections[i]);
+            }
+        }
+        evaluate_batch();
+        send_responses();
+
+        connections.erase(std::remove_if(connections.begin(), connections.end(),
+                                         [](const Connection& connection)
+                                         {
+                                             const bool done =
+                                                 connection.broken ||
+                                                 (connection.closing && connection.output.empty());
+                                             if (done)
+                                             {
+                                                 ::close(connection.descriptor);
+                                             }
+                                             return done;
+                                         }),
+                          connections.end());
+        if (descriptors[1].revents != 0)
+        {
+            accept_connections();
+        }
+    }
+}
+
+void Server::accept_connections()
+{
+    for (;;)
+    {
+        const int descriptor = ::accept4(listen_descriptor, nullptr, nullptr, SOCK_CLOEXEC);
+        if (descriptor < 0)
+        {
+            // EAGAIN once the backlog is empty; anything else is the client's problem.
+            return;
+        }
+        connections.push_back(Connection{descriptor, {}, {}, 0, false, false});
+    }
+}
+
+void Server::read_requests(Connection& connection, const size_t connection_idx)
+{
+    char bytes[1 << 16];
+    for (;;)
+    {
+        const ssize_t result = ::recv(connection.descriptor, bytes, sizeof(bytes), MSG_DONTWAIT);
+        if (result > 0)
+        {
+            connection.input.insert(connection.input.end(), bytes, bytes + result);
+            continue;
+        }
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            connection.closing = true;
+        }
+        break;
+    }
+
+    size_t offset = 0;
+    while (connection.input.size() - offset >= sizeof(RequestHeader))
+    {
+        RequestHeader header;
+        std::memcpy(&header, connection.input.data() + offset, sizeof(header));
+        if (header.magic != request_magic || header.point_count > options.max_request_points)
+        {
+            pending.push_back(PendingRequest{connection_idx, 0, 0, Status::invalid_request});
+            connection.closing = true;
+            offset = connection.input.size();
+            break;
+        }
+
+        const size_t size = sizeof(header) + header.point_count * sizeof(FieldQuery);
+        if (connection.input.size() - offset < size)
+        {
+            break;
+        }
+        const size_t first_point = batch_queries.size();
+        batch_queries.resize(first_point + header.point_count);
+        std::memcpy(batch_queries.data() + first_point,
+                    connection.input.data() + offset + sizeof(header),
+                    header.point_count * sizeof(FieldQuery));
+        pending.push_back(
+            PendingRequest{connection_idx, first_point, header.point_count, Status::ok});
+        offset += size;
+    }
+    connection.input.erase(connection.input.begin(), connection.input.begin() + offset);
+}
+
+void Server::evaluate_batch()
+{
+    if (pending.empty())
+    {
+        return;
+    }
+
+    batch_fields.assign(batch_queries.size(), FieldValue{});
+    if (!batch_queries.empty())
+    {
+        try
+        {
+            evaluator(batch_queries.data(), batch_queries.size(), batch_fields.data());
+            batch_count++;
+        }
+        catch (...)
+        {
+            // Find the requests at fault by evaluating each alone.
+            for (PendingRequest& request : pending)
+            {
+                if (request.status != Status::ok || request.point_count == 0)
+                {
+                    continue;
+                }
+                try
+                {
+                    evaluator(&batch_queries[request.first_point], request.point_count,
+                              &batch_fields[request.first_point]);
+                }
+                catch (...)
+                {
+                    request.status = Status::evaluation_failed;
+                    std::fill_n(&batch_fields[request.first_point], request.point_count,
+                                FieldValue{});
+                }
+                batch_count++;
+            }
+        }
+    }
+    request_count += pending.size();
+}
+
+void Server::send_responses()
+{
+    for (const PendingRequest& request : pending)
+    {
+        Connection& connection = connections[request.connection];
+        const ResponseHeader header{response_magic, (uint32_t)request.point_count, request.status,
+                                    0};
+        const char* header_bytes = reinterpret_cast<const char*>(&header);
+        const char* field_bytes =
+            reinterpret_cast<const char*>(batch_fields.data() + request.first_point);
+        connection.output.insert(connection.output.end(), header_bytes,
+                                 header_bytes + sizeof(header));
+        connection.output.insert(connection.output.end(), field_bytes,
+                                 field_bytes + request.point_count * sizeof(FieldValue));
+    }
+    for (Connection& connection : connections)
+    {
+        if (!connection.output.empty() && !connection.broken)
+        {
+            send_output(connection);
+        }
+    }
+    pending.clear();
+    batch_queries.clear();
+}
+
+void Server::send_output(Connection& connection)
+{
+    while (connection.output_sent < connection.output.size())
+    {
+        const ssize_t result = ::send(connection.descriptor,
+                                      connection.output.data() + connection.output_sent,
+                                      connection.output.size() - connection.output_sent,
+                                      MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (result > 0)
+        {
+            connection.output_sent += result;
+            continue;
+        }
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            connection.broken = true;
+        }
+        return;
+    }
+    connection.output.clear();
+    connection.output_sent = 0;
+}
+
+Client::Client(const std::string& socket_path)
+{
+    const sockaddr_un address = make_address(socket_path);
+    descriptor = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (descriptor < 0 ||
+        ::connect(descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        const std::string reason = std::strerror(errno);
+        if (descriptor >= 0)
+        {
+            ::close(descriptor);
+        }
+        throw std::runtime_error("Cannot connect to " + socket_path + ": " + reason);
+    }
+}
+
+Client::~Client()
+{
+    ::close(descriptor);
+}
+
+void Client::query(const FieldQuery* queries, const size_t count, FieldValue* fields)
+{
+    if (count > UINT32_MAX)
+    {
+        throw std::runtime_error("Too many points for one field service request");
+    }
+    const RequestHeader request{request_magic, (uint32_t)count};
+    if (!send_all(descriptor, &request, sizeof(request)) ||
+        !send_all(descriptor, queries, count * sizeof(FieldQuery)))
+    {
+        throw std::runtime_error("Cannot send a field service request");
+    }
+
+    // Failed requests still carry their zeroed values, except invalid ones.
+    ResponseHeader response;
+    if (!receive_all(descriptor, &response, sizeof(response)) ||
+        response.magic != response_magic ||
+        (response.point_count == count &&
+         !receive_all(descriptor, fields, count * sizeof(FieldValue))))
+    {
+        throw std::runtime_error("Invalid field service response");
+    }
+    if (response.status != Status::ok)
+    {
+        throw std::runtime_error("Field service request failed with status " +
+                                 std::to_string((int)response.status));
+    }
+    if (response.point_count != count)
+    {
+        throw std::runtime_error("Invalid field service response");
+    }
+}
+
+}
@@ -0,0 +1,201 @@
+#ifndef FIELD_SERVICE_H
+#define FIELD_SERVICE_H
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "spherical_harmonic_models.h"
+
+namespace CamSim::FieldService {
+
+// A long lived process loads the field model once and answers many short lived clients over a
+// Unix domain socket.  Messages are native endian, as client and server share a machine:
+//
+//     request:  RequestHeader, FieldQuery[point_count]
+//     response: ResponseHeader, FieldValue[point_count]
+//
+// A connection may send any number of requests, each answered in order.  The server evaluates
+// every request that arrived in the same poll round as one batch, so concurrent clients share the
+// cost of waking up and walking the model.
+
+constexpr uint32_t request_magic = 0x51464D43;   // "CMFQ"
+constexpr uint32_t response_magic = 0x52464D43;  // "CMFR"
+
+struct RequestHeader
+{
+    uint32_t magic;
+    uint32_t point_count;
+};
+
+// A point to evaluate, with the model's longitude theta, latitude phi and radius.
+struct FieldQuery
+{
+    double theta;
+    double phi;
+    double radius;
+    int64_t utc_nanoseconds;
+    int32_t order;
+    uint32_t reserved;
+};
+
+enum class Status : int32_t
+{
+    ok = 0,
+    // A bad magic number or too many points.  The server closes the connection after answering.
+    invalid_request = 1,
+    // The evaluator threw, for example for an order above the model's.
+    evaluation_failed = 2,
+};
+
+struct ResponseHeader
+{
+    uint32_t magic;
+    uint32_t point_count;
+    Status status;
+    uint32_t reserved;
+};
+
+// x', y' and z' as WorldMagneticModel gives them, zero unless the status is ok.
+struct FieldValue
+{
+    double x_prime;
+    double y_prime;
+    double z_prime;
+};
+
+// Writes fields[i] for queries[i], i < count.  May throw to fail the batch.
+using Evaluator = std::function<void(const FieldQuery* queries, size_t count, FieldValue* fields)>;
+
+// Evaluates model with WorldMagneticModel::get_field, four consecutive queries of the same order
+// at a time across SIMD lanes, so a batch is split into lane-sized groups.  model must outlive
+// the evaluator.
+Evaluator make_evaluator(const Model::WorldMagneticModel& model);
+
+// Evaluates each point with the release the registry selects for its time, so one server answers
+// queries across releases, grouping consecutive queries of one release and order across lanes as
+// above.  registry must outlive the evaluator.
+Evaluator make_evaluator(const Model::WorldMagneticModelRegistry& registry);
+
+// Splits each call of evaluator into contiguous slices of at least min_points_per_thread points,
+// evaluated on up to thread_count threads, 0 meaning one per hardware thread.  evaluator must be
+// safe to call concurrently, as the model evaluators are.  Rethrows the first slice's error.
+Evaluator make_parallel_evaluator(
+    const Evaluator& evaluator, size_t thread_count = 0, const size_t min_points_per_thread = 256);
+
+struct ServerOptions
+{
+    // Larger requests are answered with Status::invalid_request.
+    size_t max_request_points = 1 << 20;
+    int listen_backlog = 64;
+};
+
+// Serves an evaluator on a Unix domain socket.  run blocks in a poll loop on the calling thread
+// until stop is called.  Responses are queued per connection and sent as the socket takes them,
+// so a client that stops reading only holds up itself.
+class Server
+{
+public:
+    // Binds and listens on socket_path, replacing a stale socket file there, one that refuses
+    // connections.  Throws std::invalid_argument if the path is too long for a socket address and
+    // std::runtime_error if another file or a running server's socket is there or it cannot be
+    // bound.
+    Server(const std::string& socket_path, const Evaluator& evaluator,
+           const ServerOptions& options = ServerOptions{});
+
+    // Closes every connection and removes the socket file.
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    // Serves until stop.  Throws std::runtime_error if polling fails.
+    void run();
+
+    // Makes run return after its current round.  Safe from any thread and from signal handlers.
+    void stop();
+
+    // Evaluator calls, and the requests they answered.
+    uint64_t get_batch_count() const
+    {
+        return batch_count;
+    }
+
+    uint64_t get_request_count() const
+    {
+        return request_count;
+    }
+
+private:
+    struct Connection
+    {
+        int descriptor;
+        std::vector<char> input;
+        // Responses the socket has not taken yet, from output_sent on.  The connection is not read
+        // while this is not empty, so a client that stops reading cannot grow it.
+        std::vector<char> output;
+        size_t output_sent;
+        // Closed once output is sent, after the peer hangs up or sends an invalid request.
+        bool closing;
+        // Closed at once, as sending failed.
+        bool broken;
+    };
+
+    // A request in the current batch.
+    struct PendingRequest
+    {
+        size_t connection;
+        size_t first_point;
+        size_t point_count;
+        Status status;
+    };
+
+    void accept_connections();
+    void read_requests(Connection& connection, const size_t connection_idx);
+    void evaluate_batch();
+    void send_responses();
+    void send_output(Connection& connection);
+
+    std::string socket_path;
+    Evaluator evaluator;
+    ServerOptions options;
+    int listen_descriptor = -1;
+    // stop writes to wake_descriptors[1] to interrupt poll.
+    int wake_descriptors[2] = {-1, -1};
+    std::atomic<bool> stopping{false};
+
+    std::vector<Connection> connections;
+    std::vector<PendingRequest> pending;
+    std::vector<FieldQuery> batch_queries;
+    std::vector<FieldValue> batch_fields;
+    std::atomic<uint64_t> batch_count{0};
+    std::atomic<uint64_t> request_count{0};
+};
+
+// A connection to a Server.
+class Client
+{
+public:
+    // Throws std::invalid_argument if the path is too long for a socket address and
+    // std::runtime_error if nothing is listening there.
+    explicit Client(const std::string& socket_path);
+
+    ~Client();
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    // Writes fields[i] for queries[i], i < count.  Throws std::runtime_error if the connection
+    // fails or the server answers with an error status.
+    void query(const FieldQuery* queries, const size_t count, FieldValue* fields);
+
+private:
+    int descriptor;
+};
+
+}
+
+#endif
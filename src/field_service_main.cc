@@ -0,0 +1,51 @@
+#include <csignal>
+#include <cstdio>
+#include <exception>
+
+#include "field_service.h"
+#include "spherical_harmonic_models.h"
+
+namespace {
+
+CamSim::FieldService::Server* server = nullptr;
+
+void stop_server(int)
+{
+    server->stop();
+}
+
+}
+
+// Serves the World Magnetic Model releases in the coefficients directory, such as coeffs, on the
+// socket path until SIGINT or SIGTERM.  Each query is answered by the release for its time.
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        std::fprintf(stderr, "Usage: %s SOCKET_PATH COEFFICIENTS_DIRECTORY\n", argv[0]);
+        return 2;
+    }
+
+    try
+    {
+        const CamSim::Model::WorldMagneticModelRegistry registry(argv[2]);
+        if (registry.get_release_count() == 0)
+        {
+            std::fprintf(stderr, "No World Magnetic Model coefficients in %s\n", argv[2]);
+            return 1;
+        }
+        CamSim::FieldService::Server field_server(argv[1],
+                                                  CamSim::FieldService::make_evaluator(registry));
+        server = &field_server;
+        std::signal(SIGINT, stop_server);
+        std::signal(SIGTERM, stop_server);
+        field_server.run();
+    }
+    catch (const std::exception& error)
+    {
+        std::fprintf(stderr, "%s\n", error.what());
+        return 1;
+    }
+
+    return 0;
+}
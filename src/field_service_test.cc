@@ -0,0 +1,259 @@
+#include "field_service.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace CamSim::FieldService {
+
+namespace {
+
+// Echoes the point back, failing for negative orders.
+void echo(const FieldQuery* queries, const size_t count, FieldValue* fields)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (queries[i].order < 0)
+        {
+            throw std::invalid_argument("Negative order");
+        }
+        fields[i] = FieldValue{queries[i].theta, queries[i].phi,
+                               queries[i].radius * queries[i].order};
+    }
+}
+
+FieldQuery make_query(const double value, const int32_t order = 12)
+{
+    return FieldQuery{value, -value, 7000e3 + value, 0, order, 0};
+}
+
+// A raw connection, for sending requests before the server runs.
+int connect_raw(const std::string& path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    const int descriptor = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    EXPECT_EQ(::connect(descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)),
+              0);
+    return descriptor;
+}
+
+void read_exactly(const int descriptor, void* data, const size_t size)
+{
+    size_t received = 0;
+    while (received < size)
+    {
+        const ssize_t result =
+            ::recv(descriptor, static_cast<char*>(data) + received, size - received, 0);
+        ASSERT_GT(result, 0);
+        received += result;
+    }
+}
+
+}
+
+TEST(field_service_test, answers_queries)
+{
+    const std::string path = ::testing::TempDir() + "field_service_test_answers.sock";
+    Server server(path, echo);
+    std::thread serving([&server] { server.run(); });
+
+    {
+        Client client(path);
+        const std::vector<FieldQuery> queries = {make_query(0.1), make_query(0.2), make_query(0.3)};
+        std::vector<FieldValue> fields(queries.size());
+        client.query(queries.data(), queries.size(), fields.data());
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            EXPECT_EQ(fields[i].x_prime, queries[i].theta);
+            EXPECT_EQ(fields[i].y_prime, queries[i].phi);
+            EXPECT_EQ(fields[i].z_prime, 12.0 * queries[i].radius);
+        }
+
+        // The connection stays open, and a failed request does not close it.
+        const FieldQuery bad = make_query(0.4, -1);
+        FieldValue field;
+        EXPECT_THROW(client.query(&bad, 1, &field), std::runtime_error);
+        const FieldQuery good = make_query(0.5);
+        client.query(&good, 1, &field);
+        EXPECT_EQ(field.x_prime, 0.5);
+        client.query(nullptr, 0, nullptr);
+    }
+
+    server.stop();
+    serving.join();
+    EXPECT_EQ(server.get_request_count(), 4u);
+}
+
+TEST(field_service_test, batches_concurrent_requests)
+{
+    const std::string path = ::testing::TempDir() + "field_service_test_batches.sock";
+    Server server(path, echo);
+
+    // Both requests are waiting before the server starts, so they arrive in the same round.
+    const int first = connect_raw(path);
+    const int second = connect_raw(path);
+    for (const int descriptor : {first, second})
+    {
+        const RequestHeader header{request_magic, 2};
+        const FieldQuery queries[2] = {make_query(descriptor), make_query(-descriptor)};
+        ASSERT_EQ(::send(descriptor, &header, sizeof(header), 0), (ssize_t)sizeof(header));
+        ASSERT_EQ(::send(descriptor, queries, sizeof(queries), 0), (ssize_t)sizeof(queries));
+    }
+    std::thread serving([&server] { server.run(); });
+
+    for (const int descriptor : {first, second})
+    {
+        ResponseHeader header;
+        FieldValue fields[2];
+        read_exactly(descriptor, &header, sizeof(header));
+        read_exactly(descriptor, fields, sizeof(fields));
+        EXPECT_EQ(header.magic, response_magic);
+        EXPECT_EQ(header.point_count, 2u);
+        EXPECT_EQ(header.status, Status::ok);
+        EXPECT_EQ(fields[0].x_prime, descriptor);
+        EXPECT_EQ(fields[1].x_prime, -descriptor);
+    }
+    EXPECT_EQ(server.get_batch_count(), 1u);
+    EXPECT_EQ(server.get_request_count(), 2u);
+
+    // A malformed request is refused and the connection closed.
+    const RequestHeader bad{0, 1};
+    ASSERT_EQ(::send(first, &bad, sizeof(bad), 0), (ssize_t)sizeof(bad));
+    ResponseHeader header;
+    read_exactly(first, &header, sizeof(header));
+    EXPECT_EQ(header.status, Status::invalid_request);
+    EXPECT_EQ(header.point_count, 0u);
+    char byte;
+    EXPECT_EQ(::recv(first, &byte, 1, 0), 0);
+
+    ::close(first);
+    ::close(second);
+    server.stop();
+    serving.join();
+}
+
+TEST(field_service_test, slow_reader_does_not_stall_others)
+{
+    const std::string path = ::testing::TempDir() + "field_service_test_slow_reader.sock";
+    Server server(path, echo);
+    std::thread serving([&server] { server.run(); });
+
+    // A response far larger than the socket buffer, which the client does not read yet.
+    const int slow = connect_raw(path);
+    const RequestHeader request{request_magic, 1 << 18};
+    std::vector<FieldQuery> queries(request.point_count);
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        queries[i] = make_query(i);
+    }
+    ASSERT_EQ(::send(slow, &request, sizeof(request), 0), (ssize_t)sizeof(request));
+    const size_t query_bytes = queries.size() * sizeof(FieldQuery);
+    ASSERT_EQ(::send(slow, queries.data(), query_bytes, 0), (ssize_t)query_bytes);
+    while (server.get_request_count() == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+    {
+        Client client(path);
+        const FieldQuery query = make_query(0.5);
+        FieldValue field;
+        client.query(&query, 1, &field);
+        EXPECT_EQ(field.x_prime, 0.5);
+    }
+    EXPECT_LT(std::chrono::duration<double>(Clock::now() - start).count(), 0.5);
+
+    // The slow client still gets all of its response.
+    ResponseHeader header;
+    std::vector<FieldValue> fields(queries.size());
+    read_exactly(slow, &header, sizeof(header));
+    read_exactly(slow, fields.data(), fields.size() * sizeof(FieldValue));
+    EXPECT_EQ(header.status, Status::ok);
+    EXPECT_EQ(header.point_count, request.point_count);
+    EXPECT_EQ(fields.back().x_prime, queries.back().theta);
+
+    ::close(slow);
+    server.stop();
+    serving.join();
+}
+
+TEST(field_service_test, parallel_evaluator_matches_serial)
+{
+    std::vector<FieldQuery> queries;
+    for (int i = 0; i < 1000; i++)
+    {
+        queries.push_back(make_query(i));
+    }
+    std::vector<FieldValue> fields(queries.size());
+    const Evaluator parallel = make_parallel_evaluator(echo, 4, 100);
+    parallel(queries.data(), queries.size(), fields.data());
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        EXPECT_EQ(fields[i].x_prime, queries[i].theta);
+        EXPECT_EQ(fields[i].z_prime, 12.0 * queries[i].radius);
+    }
+
+    // A failure in any slice fails the call, and small calls stay on the calling thread.
+    queries[900].order = -1;
+    EXPECT_THROW(parallel(queries.data(), queries.size(), fields.data()), std::invalid_argument);
+    parallel(queries.data(), 10, fields.data());
+    EXPECT_EQ(fields[9].x_prime, 9.0);
+}
+
+TEST(field_service_test, invalid_paths_throw)
+{
+    EXPECT_THROW(Client(::testing::TempDir() + "field_service_test_missing.sock"),
+                 std::runtime_error);
+    EXPECT_THROW(Client(std::string(200, 'x')), std::invalid_argument);
+    EXPECT_THROW(Server(std::string(200, 'x'), echo), std::invalid_argument);
+    EXPECT_THROW(Server(::testing::TempDir() + "missing/field_service.sock", echo),
+                 std::runtime_error);
+}
+
+TEST(field_service_test, replaces_only_stale_sockets)
+{
+    const std::string path = ::testing::TempDir() + "field_service_test_stale.sock";
+
+    // Another file is left alone.
+    FILE* file = std::fopen(path.c_str(), "w");
+    ASSERT_NE(file, nullptr);
+    std::fclose(file);
+    EXPECT_THROW(Server(path, echo), std::runtime_error);
+    EXPECT_EQ(::access(path.c_str(), F_OK), 0);
+    std::remove(path.c_str());
+
+    // So is a running server's socket.
+    {
+        Server server(path, echo);
+        std::thread serving([&server] { server.run(); });
+        EXPECT_THROW(Server(path, echo), std::runtime_error);
+        Client client(path);
+        const FieldQuery query = make_query(0.5);
+        FieldValue field;
+        client.query(&query, 1, &field);
+        EXPECT_EQ(field.x_prime, 0.5);
+        server.stop();
+        serving.join();
+    }
+
+    // A socket nothing listens on is replaced.
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    const int descriptor = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_EQ(::bind(descriptor, reinterpret_cast<const sockaddr*>(&address), sizeof(address)), 0);
+    ::close(descriptor);
+    Server server(path, echo);
+}
+
+}
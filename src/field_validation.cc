@@ -0,0 +1,156 @@
+#include "field_validation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+#include "conversions.h"
+#include "time.h"
+
+namespace CamSim::FieldValidation {
+
+namespace {
+
+constexpr size_t test_value_field_count = 19;
+
+}
+
+std::vector<TestPoint> read_test_points(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Could not open test values file at '" + path + "'");
+    }
+
+    std::vector<TestPoint> points;
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(file, line))
+    {
+        line_number++;
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+        {
+            continue;
+        }
+
+        // strtod, unlike stream extraction, reads the NaN grid variations.
+        double values[test_value_field_count];
+        const char* cursor = line.c_str();
+        size_t count = 0;
+        for (; count < test_value_field_count; count++)
+        {
+            char* end;
+            values[count] = std::strtod(cursor, &end);
+            if (end == cursor)
+            {
+                break;
+            }
+            cursor = end;
+        }
+        const size_t rest = line.find_first_not_of(" \t\r", cursor - line.c_str());
+        if (count != test_value_field_count || rest != std::string::npos)
+        {
+            throw std::runtime_error("Test values file at '" + path +
+                                     "' has a malformed row on line " +
+                                     std::to_string(line_number));
+        }
+
+        points.push_back(TestPoint{values[0],
+                                   values[1],
+                                   values[2],
+                                   values[3],
+                                   {values[4], values[5], values[6]},
+                                   {values[12], values[13], values[14]}});
+    }
+
+    return points;
+}
+
+std::vector<FieldService::FieldQuery> make_queries(
+    const std::vector<TestPoint>& points, const int order)
+{
+    std::vector<FieldService::FieldQuery> queries;
+    queries.reserve(points.size());
+    for (const TestPoint& point : points)
+    {
+        const auto [theta, phi, radius] =
+            Conversions::lla_to_geocentric_rad(Conversions::deg_to_rad(point.latitude_deg),
+                                               Conversions::deg_to_rad(point.longitude_deg),
+                                               1000.0 * point.height_km);
+        const Time::Timestamp timestamp = Time::Timestamp::from_decimal_year(point.decimal_year);
+        queries.push_back(FieldService::FieldQuery{
+            theta, phi, radius, timestamp.get_utc_since_epoch().get_nanoseconds(), order, 0});
+    }
+
+    return queries;
+}
+
+void rotate_to_geodetic(
+    const FieldService::FieldQuery& query,
+    const TestPoint& point,
+    const FieldService::FieldValue& value,
+    double* field)
+{
+    const double angle = query.phi - Conversions::deg_to_rad(point.latitude_deg);
+    const double cos_angle = std::cos(angle);
+    const double sin_angle = std::sin(angle);
+    field[0] = value.x_prime * cos_angle - value.z_prime * sin_angle;
+    field[1] = value.y_prime;
+    field[2] = value.x_prime * sin_angle + value.z_prime * cos_angle;
+}
+
+PathResult measure_path(
+    const std::string& name,
+    const FieldService::Evaluator& evaluator,
+    const std::vector<TestPoint>& points,
+    const PathOptions& options)
+{
+    if (points.empty() || options.batch_size == 0)
+    {
+        throw std::invalid_argument("Measuring a field path needs test points and a batch size");
+    }
+
+    const std::vector<FieldService::FieldQuery> point_queries = make_queries(points, options.order);
+    std::vector<FieldService::FieldQuery> queries(options.batch_size);
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        queries[i] = point_queries[i % points.size()];
+    }
+    std::vector<FieldService::FieldValue> fields(queries.size());
+
+    PathResult result{name, {0.0, 0.0, 0.0}, 0.0};
+    evaluator(queries.data(), queries.size(), fields.data());
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        const TestPoint& point = points[i % points.size()];
+        double field[3];
+        rotate_to_geodetic(queries[i], point, fields[i], field);
+        for (int k = 0; k < 3; k++)
+        {
+            // NaN fails every tolerance.
+            const double error = std::abs(field[k] - point.field[k]);
+            result.max_error[k] = std::isnan(error) ? error : std::max(result.max_error[k], error);
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+    size_t evaluated = 0;
+    const Clock::time_point start = Clock::now();
+    double elapsed = 0.0;
+    do
+    {
+        evaluator(queries.data(), queries.size(), fields.data());
+        evaluated += queries.size();
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < options.min_seconds);
+    result.points_per_second = evaluated / elapsed;
+
+    return result;
+}
+
+}
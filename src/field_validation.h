@@ -0,0 +1,74 @@
+#ifndef FIELD_VALIDATION_H
+#define FIELD_VALIDATION_H
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "field_service.h"
+
+namespace CamSim::FieldValidation {
+
+// Checks field evaluation paths against the test values NOAA publishes with each WMM release, such
+// as info/WMM2025COF/WMM2025_TEST_VALUES.txt, and measures their throughput on the same points.
+// Every path is a FieldService::Evaluator, so the model's evaluation functions, a parallel
+// evaluator and the socket service are all measured alike.
+
+// A row of a test values file.
+struct TestPoint
+{
+    double decimal_year;
+    // Above the WGS84 ellipsoid.
+    double height_km;
+    double latitude_deg;  // Geodetic
+    double longitude_deg;
+    // X, Y and Z, north, east and down, in nT.
+    double field[3];
+    // Their rates in nT per year.
+    double field_rate[3];
+};
+
+// Reads the rows of the test values file at path, skipping # comments.  Throws
+// std::runtime_error if the file cannot be opened or a row does not have 19 numbers.
+std::vector<TestPoint> read_test_points(const std::string& path);
+
+// The query for each point, in the model's geocentric coordinates, up to order.
+std::vector<FieldService::FieldQuery> make_queries(
+    const std::vector<TestPoint>& points, const int order);
+
+// X, Y and Z at point from the geocentric x', y' and z' a path gives for it, by rotating through
+// the difference of the geocentric and geodetic latitudes.
+void rotate_to_geodetic(
+    const FieldService::FieldQuery& query,
+    const TestPoint& point,
+    const FieldService::FieldValue& value,
+    double* field);
+
+struct PathOptions
+{
+    int order = 12;
+    // Points per evaluator call, cycling through the test points, so batching paths see batches
+    // of a realistic size.
+    size_t batch_size = 4096;
+    // Calls are repeated for at least this long to measure throughput.
+    double min_seconds = 0.2;
+};
+
+struct PathResult
+{
+    std::string name;
+    // The largest |X - X_ref|, |Y - Y_ref| and |Z - Z_ref| over the batch, in nT.
+    double max_error[3];
+    double points_per_second;
+};
+
+// Evaluates the test points with evaluator, compares one batch to the reference values and times
+// repeated batches.  Throws whatever evaluator throws.
+PathResult measure_path(
+    const std::string& name,
+    const FieldService::Evaluator& evaluator,
+    const std::vector<TestPoint>& points,
+    const PathOptions& options = PathOptions{});
+
+}
+
+#endif
@@ -0,0 +1,113 @@
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "field_service.h"
+#include "field_validation.h"
+#include "spherical_harmonic_models.h"
+#include "time.h"
+
+// Checks every field evaluation path against a WMM test values file and measures its throughput,
+// e.g.
+//
+//     field_validation_main coeffs/WMM2025.COF info/WMM2025COF/WMM2025_TEST_VALUES.txt
+//
+// Prints the largest error of each component and the points per second of each path, and exits
+// with status 1 if any error is above the tolerance, 0.1 nT unless given.  The published values
+// are rounded to 0.1 nT, so a correct path is within about 0.05 nT.
+int main(int argc, char** argv)
+{
+    if (argc != 3 && argc != 4)
+    {
+        std::fprintf(stderr, "Usage: %s COEFFICIENTS_FILE TEST_VALUES_FILE [TOLERANCE_NT]\n",
+                     argv[0]);
+        return 2;
+    }
+    const double tolerance = argc == 4 ? std::atof(argv[3]) : 0.1;
+
+    try
+    {
+        using namespace CamSim;
+        const Model::WorldMagneticModel model(argv[1]);
+        const std::vector<FieldValidation::TestPoint> points =
+            FieldValidation::read_test_points(argv[2]);
+        const FieldService::Evaluator fused = FieldService::make_evaluator(model);
+        // The model's one component at a time functions, each walking the coefficients.
+        const FieldService::Evaluator components =
+            [&model](const FieldService::FieldQuery* queries, const size_t count,
+                     FieldService::FieldValue* fields)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                const FieldService::FieldQuery& query = queries[i];
+                const Time::Timestamp timestamp = Time::Timestamp::from_utc_since_epoch(
+                    Time::Duration::from_nanoseconds(query.utc_nanoseconds));
+                fields[i].x_prime = model.get_x_prime(query.theta, query.phi, query.radius,
+                                                      timestamp, query.order);
+                fields[i].y_prime = model.get_y_prime(query.theta, query.phi, query.radius,
+                                                      timestamp, query.order);
+                fields[i].z_prime = model.get_z_prime(query.theta, query.phi, query.radius,
+                                                      timestamp, query.order);
+            }
+        };
+
+        // The service path pays for the socket round trip on top of the fused evaluator.
+        const std::string socket_path =
+            "/tmp/camsim_field_validation_" + std::to_string(::getpid()) + ".sock";
+        FieldService::Server server(socket_path, fused);
+        std::thread serving([&server] { server.run(); });
+        FieldService::Client client(socket_path);
+
+        std::vector<FieldValidation::PathResult> results;
+        try
+        {
+            results.push_back(FieldValidation::measure_path("components", components, points));
+            results.push_back(FieldValidation::measure_path("fused", fused, points));
+            results.push_back(FieldValidation::measure_path(
+                "parallel", FieldService::make_parallel_evaluator(fused), points));
+            const FieldService::Evaluator service =
+                [&client](const FieldService::FieldQuery* queries, const size_t count,
+                          FieldService::FieldValue* fields)
+            {
+                client.query(queries, count, fields);
+            };
+            results.push_back(FieldValidation::measure_path("service", service, points));
+        }
+        catch (...)
+        {
+            server.stop();
+            serving.join();
+            throw;
+        }
+        server.stop();
+        serving.join();
+
+        std::printf("%s, %zu test points, tolerance %g nT\n", model.get_name().c_str(),
+                    points.size(), tolerance);
+        std::printf("%-12s %12s %12s %12s %14s\n", "path", "max |dX| nT", "max |dY| nT",
+                    "max |dZ| nT", "points/s");
+        bool passed = true;
+        for (const FieldValidation::PathResult& result : results)
+        {
+            std::printf("%-12s %12.4f %12.4f %12.4f %14.0f\n", result.name.c_str(),
+                        result.max_error[0], result.max_error[1], result.max_error[2],
+                        result.points_per_second);
+            for (const double error : result.max_error)
+            {
+                // Written so that NaN fails.
+                passed = passed && error <= tolerance;
+            }
+        }
+
+        return passed ? 0 : 1;
+    }
+    catch (const std::exception& error)
+    {
+        std::fprintf(stderr, "%s\n", error.what());
+        return 1;
+    }
+}
@@ -0,0 +1,143 @@
+#include "field_validation.h"
+#include "tools/cpp/runfiles/runfiles.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <memory>
+
+namespace CamSim::FieldValidation {
+
+namespace {
+
+std::string get_runfiles_path(const std::string& filename)
+{
+    using bazel::tools::cpp::runfiles::Runfiles;
+    std::string error;
+    static std::unique_ptr<Runfiles> runfiles(Runfiles::Create("", &error));
+    if (!runfiles)
+    {
+        throw std::runtime_error("Failed to init Bazel runfiles: " + error);
+    }
+
+    return runfiles->Rlocation("camsim/" + filename);
+}
+
+std::string write_temporary_file(const std::string& name, const std::string& contents)
+{
+    const std::string path = testing::TempDir() + name;
+    std::ofstream file(path);
+    file << contents;
+
+    return path;
+}
+
+}
+
+TEST(field_validation_test, reads_test_points)
+{
+    const std::string path = write_temporary_file(
+        "field_validation_test_values.txt",
+        "# Field 1: Date\n"
+        "\n"
+        "  2025.0    0.0    0.0  120.0    39677.8     -109.6   -10580.2    39677.9    41064.3  "
+        "-14.93   -0.16     NaN        9.5      -23.1       79.4        9.6      -11.2    0.11   "
+        "-0.03\n");
+    const std::vector<TestPoint> points = read_test_points(path);
+    ASSERT_EQ(points.size(), 1u);
+    EXPECT_EQ(points[0].decimal_year, 2025.0);
+    EXPECT_EQ(points[0].longitude_deg, 120.0);
+    EXPECT_EQ(points[0].field[1], -109.6);
+    EXPECT_EQ(points[0].field_rate[2], 79.4);
+
+    write_temporary_file("field_validation_test_values.txt", "  2025.0    0.0    0.0  120.0\n");
+    EXPECT_THROW(read_test_points(path), std::runtime_error);
+    std::remove(path.c_str());
+    EXPECT_THROW(read_test_points(path), std::runtime_error);
+}
+
+TEST(field_validation_test, paths_match_official_values)
+{
+    const Model::WorldMagneticModel model(get_runfiles_path("coeffs/WMM2025.COF"));
+    const std::vector<TestPoint> points =
+        read_test_points(get_runfiles_path("info/WMM2025COF/WMM2025_TEST_VALUES.txt"));
+    ASSERT_EQ(points.size(), 12u);
+
+    PathOptions options;
+    options.batch_size = 1024;
+    options.min_seconds = 0.0;
+    const FieldService::Evaluator fused = FieldService::make_evaluator(model);
+    for (const PathResult& result :
+         {measure_path("fused", fused, points, options),
+          measure_path("parallel", FieldService::make_parallel_evaluator(fused, 4), points,
+                       options)})
+    {
+        // The published values are rounded to 0.1 nT.
+        for (const double error : result.max_error)
+        {
+            EXPECT_LE(error, 0.06) << result.name;
+        }
+        EXPECT_GT(result.points_per_second, 0.0) << result.name;
+    }
+}
+
+TEST(field_validation_test, evaluators_match_points)
+{
+    const Model::WorldMagneticModel model(get_runfiles_path("coeffs/WMM2025.COF"));
+    Model::WorldMagneticModelRegistry registry;
+    registry.add(get_runfiles_path("coeffs/WMM2025.COF"));
+    const std::vector<TestPoint> points =
+        read_test_points(get_runfiles_path("info/WMM2025COF/WMM2025_TEST_VALUES.txt"));
+
+    // Runs of one order that fill lanes and leave a remainder, and a run too short for lanes.
+    std::vector<FieldService::FieldQuery> queries = make_queries(points, 12);
+    queries.resize(11);
+    queries[5].order = 6;
+    queries[6].order = 6;
+    for (const FieldService::Evaluator& evaluator :
+         {FieldService::make_evaluator(model), FieldService::make_evaluator(registry)})
+    {
+        std::vector<FieldService::FieldValue> fields(queries.size());
+        evaluator(queries.data(), queries.size(), fields.data());
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            const FieldService::FieldQuery& query = queries[i];
+            Model::MagneticField field;
+            model.get_field(query.theta, query.phi, query.radius,
+                            Time::Timestamp::from_utc_since_epoch(
+                                Time::Duration::from_nanoseconds(query.utc_nanoseconds)),
+                            query.order, field);
+            EXPECT_NEAR(fields[i].x_prime, field.field[0], 1e-9) << i;
+            EXPECT_NEAR(fields[i].y_prime, field.field[1], 1e-9) << i;
+            EXPECT_NEAR(fields[i].z_prime, field.field[2], 1e-9) << i;
+        }
+    }
+}
+
+TEST(field_validation_test, rates_match_official_values)
+{
+    const Model::WorldMagneticModel model(get_runfiles_path("coeffs/WMM2025.COF"));
+    const std::vector<TestPoint> points =
+        read_test_points(get_runfiles_path("info/WMM2025COF/WMM2025_TEST_VALUES.txt"));
+    const std::vector<FieldService::FieldQuery> queries = make_queries(points, 12);
+
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        const FieldService::FieldQuery& query = queries[i];
+        Model::MagneticField field;
+        model.get_field(query.theta, query.phi, query.radius,
+                        Time::Timestamp::from_decimal_year(points[i].decimal_year), query.order,
+                        field, true);
+        double rate[3];
+        rotate_to_geodetic(query, points[i],
+                           FieldService::FieldValue{field.rate[0], field.rate[1], field.rate[2]},
+                           rate);
+        for (int k = 0; k < 3; k++)
+        {
+            EXPECT_NEAR(rate[k], points[i].field_rate[k], 0.06) << i << " " << k;
+        }
+    }
+}
+
+}
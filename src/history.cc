@@ -0,0 +1,541 @@
+#include "history.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "json.h"
+
+namespace CamSim::History {
+
+namespace {
+
+constexpr size_t header_alignment = 64;
+
+}
+
+Recorder::Recorder(
+    const std::string& path,
+    const std::vector<Channel>& channels,
+    const RecorderOptions& options)
+    : channels(channels),
+      column_count(0),
+      options(options),
+      chunk_bytes(0),
+      file(nullptr),
+      last_utc_nanoseconds(0)
+{
+    if (channels.empty())
+    {
+        throw std::invalid_argument("Recorder must have at least one channel");
+    }
+    for (const Channel& channel : channels)
+    {
+        if (channel.name.empty() || channel.name.size() > max_channel_name_size)
+        {
+            throw std::invalid_argument("Recorder channel names must have 1 to 47 characters");
+        }
+        if (channel.width == 0)
+        {
+            throw std::invalid_argument("Recorder channel " + channel.name + " has width 0");
+        }
+        column_count += channel.width;
+    }
+    if (options.decimation == 0 || options.rows_per_chunk == 0 || options.buffer_count == 0)
+    {
+        throw std::invalid_argument(
+            "Recorder decimation, rows per chunk and buffer count must be positive");
+    }
+
+    chunk_bytes =
+        sizeof(ChunkHeader) + sizeof(int64_t) * options.rows_per_chunk * (1 + column_count);
+    buffers.resize(options.buffer_count);
+    for (Buffer& buffer : buffers)
+    {
+        buffer.bytes.assign(chunk_bytes, 0);
+    }
+
+    // The header, padded so chunks stay aligned.
+    const size_t header_size = sizeof(FileHeader) + channels.size() * sizeof(ChannelHeader);
+    std::vector<char> header((header_size + header_alignment - 1) / header_alignment *
+                             header_alignment);
+    FileHeader file_header{};
+    std::memcpy(file_header.magic, file_magic, sizeof(file_magic));
+    file_header.channel_count = (uint32_t)channels.size();
+    file_header.column_count = (uint32_t)column_count;
+    file_header.rows_per_chunk = options.rows_per_chunk;
+    file_header.header_bytes = header.size();
+    file_header.chunk_bytes = chunk_bytes;
+    std::memcpy(header.data(), &file_header, sizeof(file_header));
+    size_t first_column = 0;
+    for (size_t i = 0; i < channels.size(); i++)
+    {
+        ChannelHeader channel_header{};
+        std::memcpy(channel_header.name, channels[i].name.data(), channels[i].name.size());
+        channel_header.first_column = first_column;
+        channel_header.width = channels[i].width;
+        std::memcpy(header.data() + sizeof(FileHeader) + i * sizeof(ChannelHeader),
+                    &channel_header, sizeof(channel_header));
+        first_column += channels[i].width;
+    }
+
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        throw std::runtime_error("Cannot open history file " + path);
+    }
+    // Chunks are written whole, so the stream's own buffer would only add a copy.
+    std::setvbuf(file, nullptr, _IONBF, 0);
+    try
+    {
+        write_or_throw(header.data(), header.size());
+    }
+    catch (...)
+    {
+        std::fclose(file);
+        throw;
+    }
+
+    writer = std::thread(&Recorder::write_chunks, this);
+}
+
+Recorder::~Recorder()
+{
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+    }
+}
+
+bool Recorder::record(const Time::Timestamp& time, const double* const* channel_values)
+{
+    if (closed)
+    {
+        throw std::logic_error("Recorder is closed");
+    }
+
+    const bool keep = decimation_phase == 0;
+    decimation_phase = decimation_phase + 1 == options.decimation ? 0 : decimation_phase + 1;
+    if (!keep)
+    {
+        return false;
+    }
+
+    const int64_t utc_nanoseconds = time.get_utc_since_epoch().get_nanoseconds();
+    if (row_count != 0 && utc_nanoseconds < last_utc_nanoseconds)
+    {
+        throw std::invalid_argument("Recorder rows must be recorded in time order");
+    }
+
+    const size_t rows = options.rows_per_chunk;
+    const size_t row = row_count % rows;
+    char* bytes = buffers[filling].bytes.data();
+    int64_t* times = reinterpret_cast<int64_t*>(bytes + sizeof(ChunkHeader));
+    double* columns = reinterpret_cast<double*>(times + rows);
+    times[row] = utc_nanoseconds;
+    double* column = columns + row;
+    for (size_t i = 0; i < channels.size(); i++)
+    {
+        const double* values = channel_values[i];
+        for (size_t j = 0; j < channels[i].width; j++, column += rows)
+        {
+            *column = values[j];
+        }
+    }
+
+    last_utc_nanoseconds = utc_nanoseconds;
+    row_count++;
+    if (row + 1 == rows)
+    {
+        submit_current_chunk();
+    }
+
+    return true;
+}
+
+void Recorder::close()
+{
+    if (closed)
+    {
+        return;
+    }
+    closed = true;
+
+    // Zero the unused rows of the last chunk, which may hold an earlier chunk's values.
+    const size_t rows = options.rows_per_chunk;
+    const size_t used_rows = row_count % rows;
+    if (used_rows != 0)
+    {
+        char* bytes = buffers[filling].bytes.data() + sizeof(ChunkHeader);
+        for (size_t column = 0; column <= column_count; column++)
+        {
+            std::memset(bytes + sizeof(int64_t) * (column * rows + used_rows), 0,
+                        sizeof(int64_t) * (rows - used_rows));
+        }
+        try
+        {
+            submit_current_chunk();
+        }
+        catch (...)
+        {
+            // Reported below, once the writer has stopped.
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    chunk_queued.notify_one();
+    writer.join();
+
+    std::exception_ptr error = writer_error;
+    if (!error)
+    {
+        try
+        {
+            FileTrailer trailer{};
+            trailer.chunk_count = index.size();
+            trailer.row_count = row_count;
+            trailer.index_offset = std::ftell(file);
+            std::memcpy(trailer.magic, file_magic, sizeof(file_magic));
+            write_or_throw(index.data(), index.size() * sizeof(IndexEntry));
+            write_or_throw(&trailer, sizeof(trailer));
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+    }
+    if (std::fclose(file) != 0 && !error)
+    {
+        error = std::make_exception_ptr(std::runtime_error("Cannot close history file"));
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void Recorder::submit_current_chunk()
+{
+    const size_t rows = options.rows_per_chunk;
+    const size_t used_rows = row_count - rows * index.size();
+    Buffer& buffer = buffers[filling];
+    const int64_t* times =
+        reinterpret_cast<const int64_t*>(buffer.bytes.data() + sizeof(ChunkHeader));
+
+    ChunkHeader header{};
+    header.magic = chunk_magic;
+    header.row_count = used_rows;
+    header.first_utc_nanoseconds = times[0];
+    header.last_utc_nanoseconds = times[used_rows - 1];
+    std::memcpy(buffer.bytes.data(), &header, sizeof(header));
+    index.push_back(IndexEntry{header.first_utc_nanoseconds, header.last_utc_nanoseconds,
+                               rows * index.size(), used_rows});
+
+    std::unique_lock<std::mutex> lock(mutex);
+    queued++;
+    filling = (filling + 1) % buffers.size();
+    chunk_queued.notify_one();
+    chunk_written.wait(lock, [this] { return queued < buffers.size(); });
+    if (writer_error)
+    {
+        std::rethrow_exception(writer_error);
+    }
+}
+
+void Recorder::write_chunks()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        chunk_queued.wait(lock, [this] { return queued != 0 || stopping; });
+        if (queued == 0)
+        {
+            return;
+        }
+
+        // After a failure, keep taking chunks so recording never waits, but drop them.
+        const Buffer& buffer = buffers[writing];
+        if (!writer_error)
+        {
+            lock.unlock();
+            std::exception_ptr error;
+            try
+            {
+                write_or_throw(buffer.bytes.data(), buffer.bytes.size());
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            lock.lock();
+            writer_error = error;
+        }
+        writing = (writing + 1) % buffers.size();
+        queued--;
+        chunk_written.notify_one();
+    }
+}
+
+void Recorder::write_or_throw(const void* data, const size_t size)
+{
+    // An empty index has no data pointer, which fwrite does not accept even for zero bytes.
+    if (size == 0)
+    {
+        return;
+    }
+    if (std::fwrite(data, 1, size, file) != size)
+    {
+        throw std::runtime_error("Cannot write history file");
+    }
+}
+
+Reader::Reader(const std::string& path)
+    : bytes(nullptr),
+      size(0),
+      header(nullptr),
+      channels(nullptr),
+      index(nullptr),
+      chunk_count(0),
+      row_count(0)
+{
+    const int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+    {
+        throw std::runtime_error("Cannot open history file " + path);
+    }
+    struct stat status;
+    if (::fstat(descriptor, &status) != 0 || (size_t)status.st_size < sizeof(FileHeader))
+    {
+        ::close(descriptor);
+        throw std::runtime_error(path + " is not a history file");
+    }
+    size = status.st_size;
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+    ::close(descriptor);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("Cannot map history file " + path);
+    }
+    bytes = static_cast<const char*>(mapping);
+
+    try
+    {
+        const auto check = [&path](const bool valid)
+        {
+            if (!valid)
+            {
+                throw std::runtime_error(path + " is not a history file");
+            }
+        };
+
+        header = reinterpret_cast<const FileHeader*>(bytes);
+        check(std::memcmp(header->magic, file_magic, sizeof(file_magic)) == 0);
+        check(header->header_bytes % alignof(double) == 0 && header->header_bytes <= size);
+        check(header->header_bytes >=
+              sizeof(FileHeader) + header->channel_count * sizeof(ChannelHeader));
+        check(header->rows_per_chunk != 0 && header->chunk_bytes > sizeof(ChunkHeader));
+        check((header->chunk_bytes - sizeof(ChunkHeader)) / sizeof(int64_t) /
+                  (1 + (uint64_t)header->column_count) ==
+              header->rows_per_chunk);
+        check(header->chunk_bytes ==
+              sizeof(ChunkHeader) +
+                  sizeof(int64_t) * header->rows_per_chunk * (1 + (uint64_t)header->column_count));
+
+        channels = reinterpret_cast<const ChannelHeader*>(bytes + sizeof(FileHeader));
+        for (size_t i = 0; i < header->channel_count; i++)
+        {
+            const ChannelHeader& channel = channels[i];
+            check(std::memchr(channel.name, '\0', sizeof(channel.name)) != nullptr);
+            check(channel.width != 0 && channel.first_column < header->column_count &&
+                  channel.width <= header->column_count - channel.first_column);
+        }
+
+        const size_t whole_chunks = (size - header->header_bytes) / header->chunk_bytes;
+        FileTrailer trailer{};
+        if (size >= header->header_bytes + sizeof(FileTrailer))
+        {
+            std::memcpy(&trailer, bytes + size - sizeof(FileTrailer), sizeof(trailer));
+        }
+        if (std::memcmp(trailer.magic, file_magic, sizeof(file_magic)) == 0 &&
+            trailer.chunk_count <= whole_chunks &&
+            trailer.index_offset ==
+                header->header_bytes + trailer.chunk_count * header->chunk_bytes &&
+            trailer.index_offset + trailer.chunk_count * sizeof(IndexEntry) + sizeof(FileTrailer) ==
+                size)
+        {
+            index = reinterpret_cast<const IndexEntry*>(bytes + trailer.index_offset);
+            chunk_count = trailer.chunk_count;
+            row_count = trailer.row_count;
+            // The entries must describe the chunks as the recovery below would find them.
+            uint64_t indexed_rows = 0;
+            for (size_t i = 0; i < chunk_count; i++)
+            {
+                const IndexEntry& entry = index[i];
+                check(entry.first_row == i * header->rows_per_chunk && entry.row_count != 0 &&
+                      entry.row_count <= header->rows_per_chunk);
+                check(i + 1 == chunk_count || entry.row_count == header->rows_per_chunk);
+                indexed_rows += entry.row_count;
+            }
+            check(indexed_rows == row_count);
+        }
+        else
+        {
+            // Cut short: every whole chunk up to the first partial or unwritten one.
+            for (size_t i = 0; i < whole_chunks; i++)
+            {
+                const ChunkHeader& chunk = *reinterpret_cast<const ChunkHeader*>(get_chunk(i));
+                if (chunk.magic != chunk_magic || chunk.row_count == 0 ||
+                    chunk.row_count > header->rows_per_chunk)
+                {
+                    break;
+                }
+                recovered_index.push_back(IndexEntry{chunk.first_utc_nanoseconds,
+                                                     chunk.last_utc_nanoseconds, row_count,
+                                                     chunk.row_count});
+                row_count += chunk.row_count;
+                if (chunk.row_count < header->rows_per_chunk)
+                {
+                    break;
+                }
+            }
+            index = recovered_index.data();
+            chunk_count = recovered_index.size();
+        }
+    }
+    catch (...)
+    {
+        ::munmap(const_cast<char*>(bytes), size);
+        throw;
+    }
+}
+
+Reader::~Reader()
+{
+    ::munmap(const_cast<char*>(bytes), size);
+}
+
+const ChannelHeader& Reader::find_channel(const std::string& name) const
+{
+    for (size_t i = 0; i < header->channel_count; i++)
+    {
+        if (name == channels[i].name)
+        {
+            return channels[i];
+        }
+    }
+    throw std::out_of_range("History has no channel " + name);
+}
+
+ColumnView<int64_t> Reader::get_times(const size_t chunk) const
+{
+    return ColumnView<int64_t>{
+        reinterpret_cast<const int64_t*>(get_chunk(chunk) + sizeof(ChunkHeader)),
+        index[chunk].row_count};
+}
+
+ColumnView<double> Reader::get_column(const size_t chunk, const size_t column) const
+{
+    const size_t offset =
+        sizeof(ChunkHeader) + sizeof(int64_t) * header->rows_per_chunk * (1 + column);
+    return ColumnView<double>{reinterpret_cast<const double*>(get_chunk(chunk) + offset),
+                              index[chunk].row_count};
+}
+
+Time::Timestamp Reader::get_time(const uint64_t row) const
+{
+    const size_t chunk = get_chunk_of_row(row);
+    return Time::Timestamp::from_utc_since_epoch(
+        Time::Duration::from_nanoseconds(get_times(chunk)[row - index[chunk].first_row]));
+}
+
+double Reader::get_value(const uint64_t row, const size_t column) const
+{
+    const size_t chunk = get_chunk_of_row(row);
+    return get_column(chunk, column)[row - index[chunk].first_row];
+}
+
+uint64_t Reader::find_row(const Time::Timestamp& time) const
+{
+    const int64_t utc_nanoseconds = time.get_utc_since_epoch().get_nanoseconds();
+    const IndexEntry* entry = std::partition_point(
+        index, index + chunk_count,
+        [utc_nanoseconds](const IndexEntry& entry)
+        { return entry.last_utc_nanoseconds < utc_nanoseconds; });
+    if (entry == index + chunk_count)
+    {
+        return row_count;
+    }
+
+    const ColumnView<int64_t> times = get_times(entry - index);
+    return entry->first_row +
+           (std::lower_bound(times.begin(), times.end(), utc_nanoseconds) - times.begin());
+}
+
+void Reader::write_json(std::FILE* file, const std::vector<std::string>& channel_names,
+                        const Time::Timestamp& begin, const Time::Timestamp& end) const
+{
+    std::vector<const ChannelHeader*> selected;
+    std::vector<String> names;
+    for (const std::string& name : channel_names)
+    {
+        const ChannelHeader& channel = find_channel(name);
+        selected.push_back(&channel);
+        names.push_back(String{const_cast<char*>(channel.name), std::strlen(channel.name)});
+    }
+
+    const auto check = [](const bool written)
+    {
+        if (!written)
+        {
+            throw std::runtime_error("Cannot write history JSON");
+        }
+    };
+
+    const uint64_t first_row = find_row(begin);
+    const uint64_t end_row = std::max(first_row, find_row(end));
+    check(std::fputc('[', file) != EOF);
+    for (uint64_t row = first_row; row < end_row;)
+    {
+        // A chunk at a time, so each row only indexes into columns.
+        const size_t chunk = get_chunk_of_row(row);
+        const IndexEntry& entry = index[chunk];
+        const uint64_t chunk_end_row = std::min(end_row, entry.first_row + entry.row_count);
+        const ColumnView<int64_t> times = get_times(chunk);
+        const double* columns =
+            reinterpret_cast<const double*>(times.data + header->rows_per_chunk);
+        for (; row < chunk_end_row; row++)
+        {
+            const size_t i = row - entry.first_row;
+            check(std::fprintf(file, "%s\n{\"utc_nanoseconds\": %" PRId64,
+                               row == first_row ? "" : ",", times[i]) > 0);
+            for (size_t k = 0; k < selected.size(); k++)
+            {
+                const ChannelHeader* channel = selected[k];
+                check(std::fputs(", ", file) != EOF);
+                check(json_write_string(file, &names[k]));
+                check(std::fputs(": [", file) != EOF);
+                for (size_t j = 0; j < channel->width; j++)
+                {
+                    check(j == 0 || std::fputs(", ", file) != EOF);
+                    check(json_write_double(
+                        file, columns[(channel->first_column + j) * header->rows_per_chunk + i]));
+                }
+                check(std::fputc(']', file) != EOF);
+            }
+            check(std::fputc('}', file) != EOF);
+        }
+    }
+    check(std::fputs(first_row == end_row ? "]\n" : "\n]\n", file) != EOF);
+}
+
+}
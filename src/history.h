@@ -0,0 +1,295 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "time.h"
+
+namespace CamSim::History {
+
+// Simulation histories are single files of native endian, fixed width columns:
+//
+//     FileHeader, ChannelHeader[channel_count], zero padding to header_bytes
+//     chunk 0, chunk 1, ... each chunk_bytes long:
+//         ChunkHeader
+//         int64_t utc_nanoseconds[rows_per_chunk]
+//         double column[column_count][rows_per_chunk]
+//     IndexEntry[chunk_count]
+//     FileTrailer
+//
+// Channels are named groups of consecutive columns, such as a state vector or the constraint
+// residuals.  Every chunk holds rows_per_chunk rows whether full or not, so chunk i starts at
+// header_bytes + i * chunk_bytes and every column is 8 byte aligned for reading in place.  Rows
+// are in recording order with nondecreasing times, so the index gives the time span of each chunk
+// for binary searches by time.  A file cut short before its trailer still has whole chunks whose
+// headers say how many rows they hold.
+
+constexpr char file_magic[8] = {'C', 'S', 'H', 'I', 'S', 'T', '0', '1'};
+constexpr uint32_t chunk_magic = 0x4B4E4843;  // "CHNK"
+constexpr size_t max_channel_name_size = 47;
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t channel_count;
+    uint32_t column_count;
+    uint64_t rows_per_chunk;
+    uint64_t header_bytes;
+    uint64_t chunk_bytes;
+};
+
+struct ChannelHeader
+{
+    char name[max_channel_name_size + 1];  // Null terminated
+    uint64_t first_column;
+    uint64_t width;
+};
+
+struct ChunkHeader
+{
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t row_count;
+    int64_t first_utc_nanoseconds;
+    int64_t last_utc_nanoseconds;
+};
+
+struct IndexEntry
+{
+    int64_t first_utc_nanoseconds;
+    int64_t last_utc_nanoseconds;
+    uint64_t first_row;
+    uint64_t row_count;
+};
+
+struct FileTrailer
+{
+    uint64_t chunk_count;
+    uint64_t row_count;
+    uint64_t index_offset;
+    char magic[8];
+};
+
+// A named group of width columns.
+struct Channel
+{
+    std::string name;
+    size_t width;
+};
+
+struct RecorderOptions
+{
+    // Keeps one of every decimation calls to record, starting with the first.
+    size_t decimation = 1;
+    size_t rows_per_chunk = 4096;
+    // Chunks being filled or waiting for the writer.  Recording only waits for the writer once all
+    // of them are full, so more buffers ride out longer stalls of the disk.
+    size_t buffer_count = 2;
+};
+
+// Appends rows of channel values to a history file.  Rows are transposed into column chunks in
+// memory and a background thread writes each full chunk while the next one fills, so the
+// integration loop only copies values.  After construction the only allocation is one index entry
+// per chunk.
+//
+// Errors from the writer thread are rethrown by the next record that completes a chunk, or by
+// close.
+class Recorder
+{
+public:
+    // Creates or truncates the file at path and writes its header.  Throws std::invalid_argument
+    // for an empty channel list, an empty or too long channel name, a channel of width 0, or zero
+    // decimation, rows per chunk or buffers, and std::runtime_error if the file cannot be written.
+    Recorder(const std::string& path, const std::vector<Channel>& channels,
+             const RecorderOptions& options = RecorderOptions{});
+
+    // Closes the file, ignoring errors.  Call close to see them.
+    ~Recorder();
+
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    // Records a row at time, taking get_channels()[i].width values from channel_values[i], unless
+    // decimation drops the call.  Returns whether the row was kept.  Throws std::invalid_argument
+    // if time is earlier than the last recorded row and std::logic_error after close.
+    bool record(const Time::Timestamp& time, const double* const* channel_values);
+
+    // Writes the last partial chunk, the index and the trailer, and stops the writer thread.
+    // Throws std::runtime_error if any write failed.  Further calls do nothing.
+    void close();
+
+    const std::vector<Channel>& get_channels() const
+    {
+        return channels;
+    }
+
+    size_t get_column_count() const
+    {
+        return column_count;
+    }
+
+    // Rows kept so far.
+    uint64_t get_row_count() const
+    {
+        return row_count;
+    }
+
+private:
+    struct Buffer
+    {
+        std::vector<char> bytes;
+    };
+
+    void submit_current_chunk();
+    void write_chunks();
+    void write_or_throw(const void* data, const size_t size);
+
+    std::vector<Channel> channels;
+    size_t column_count;
+    RecorderOptions options;
+    size_t chunk_bytes;
+    std::FILE* file;
+    bool closed = false;
+
+    // Calls since the last kept row, modulo the decimation.
+    size_t decimation_phase = 0;
+    uint64_t row_count = 0;
+    int64_t last_utc_nanoseconds;
+    std::vector<IndexEntry> index;
+
+    // The ring of buffers.  The recording thread fills buffers[filling]; buffers from
+    // buffers[writing] up to it are queued for the writer.
+    std::vector<Buffer> buffers;
+    size_t filling = 0;
+    size_t writing = 0;
+    size_t queued = 0;
+    bool stopping = false;
+    std::exception_ptr writer_error;
+    std::mutex mutex;
+    std::condition_variable chunk_queued;
+    std::condition_variable chunk_written;
+    std::thread writer;
+};
+
+// A column of one chunk, read in place from the mapped file.
+template <typename T>
+struct ColumnView
+{
+    const T* data;
+    size_t size;
+
+    const T& operator[](const size_t i) const
+    {
+        return data[i];
+    }
+
+    const T* begin() const
+    {
+        return data;
+    }
+
+    const T* end() const
+    {
+        return data + size;
+    }
+};
+
+// Reads a history file by mapping it into memory, so only the pages of the chunks and columns
+// actually read are loaded.  Files cut short before their trailer are read up to their last
+// whole chunk.  Chunk, column and row arguments are not range checked.
+class Reader
+{
+public:
+    // Maps the file at path.  Throws std::runtime_error if it cannot be mapped or is not a
+    // history file.
+    explicit Reader(const std::string& path);
+
+    ~Reader();
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    size_t get_channel_count() const
+    {
+        return header->channel_count;
+    }
+
+    const ChannelHeader& get_channel(const size_t channel) const
+    {
+        return channels[channel];
+    }
+
+    // The channel called name.  Throws std::out_of_range if there is none.
+    const ChannelHeader& find_channel(const std::string& name) const;
+
+    size_t get_column_count() const
+    {
+        return header->column_count;
+    }
+
+    size_t get_chunk_count() const
+    {
+        return chunk_count;
+    }
+
+    uint64_t get_row_count() const
+    {
+        return row_count;
+    }
+
+    const IndexEntry& get_chunk_entry(const size_t chunk) const
+    {
+        return index[chunk];
+    }
+
+    // The chunk holding row.  Every chunk but the last is full.
+    size_t get_chunk_of_row(const uint64_t row) const
+    {
+        return row / header->rows_per_chunk;
+    }
+
+    ColumnView<int64_t> get_times(const size_t chunk) const;
+    ColumnView<double> get_column(const size_t chunk, const size_t column) const;
+
+    Time::Timestamp get_time(const uint64_t row) const;
+    double get_value(const uint64_t row, const size_t column) const;
+
+    // The first row at or after time, or get_row_count() if there is none.  Binary searches the
+    // index, then the times of one chunk.
+    uint64_t find_row(const Time::Timestamp& time) const;
+
+    // Streams the rows from begin up to but not including end as a JSON list of objects, one per
+    // row, with the row's time as "utc_nanoseconds" and a list of values for each of the named
+    // channels, e.g. [{"utc_nanoseconds": 0, "state": [1, 2]}].  Throws std::out_of_range for an
+    // unknown channel and std::runtime_error if writing fails.
+    void write_json(std::FILE* file, const std::vector<std::string>& channel_names,
+                    const Time::Timestamp& begin, const Time::Timestamp& end) const;
+
+private:
+    const char* get_chunk(const size_t chunk) const
+    {
+        return bytes + header->header_bytes + chunk * header->chunk_bytes;
+    }
+
+    const char* bytes;
+    size_t size;
+    const FileHeader* header;
+    const ChannelHeader* channels;
+    const IndexEntry* index;
+    size_t chunk_count;
+    uint64_t row_count;
+    // The index of a file without a trailer, rebuilt from its chunk headers.
+    std::vector<IndexEntry> recovered_index;
+};
+
+}
+
+#endif
@@ -0,0 +1,329 @@
+#include "history.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "json.h"
+
+namespace CamSim::History {
+
+namespace {
+
+std::vector<char> read_file(const std::string& path)
+{
+    std::vector<char> bytes;
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return bytes;
+    }
+    char buffer[4096];
+    size_t size;
+    while ((size = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        bytes.insert(bytes.end(), buffer, buffer + size);
+    }
+    std::fclose(file);
+    return bytes;
+}
+
+template <typename T>
+T read_at(const std::vector<char>& bytes, const size_t offset)
+{
+    T value;
+    std::memcpy(&value, bytes.data() + offset, sizeof(T));
+    return value;
+}
+
+Time::Timestamp time_at(const int64_t utc_nanoseconds)
+{
+    return Time::Timestamp::from_utc_since_epoch(Time::Duration::from_nanoseconds(utc_nanoseconds));
+}
+
+// Ten rows at times 0, 10, ... 90 in chunks of 4, with state {i, 2 i} and residual -i.
+void record_ten_rows(const std::string& path)
+{
+    RecorderOptions options;
+    options.rows_per_chunk = 4;
+    Recorder recorder(path, {{"state", 2}, {"residual", 1}}, options);
+    for (int i = 0; i < 10; i++)
+    {
+        const double state[2] = {1.0 * i, 2.0 * i};
+        const double residual = -1.0 * i;
+        const double* values[2] = {state, &residual};
+        recorder.record(time_at(10 * i), values);
+    }
+    recorder.close();
+}
+
+}
+
+TEST(HistoryTest, writes_decimated_columns)
+{
+    const std::string path = ::testing::TempDir() + "history_test_columns.bin";
+    const int64_t start = 1700000000000000000;
+    RecorderOptions options;
+    options.decimation = 3;
+    options.rows_per_chunk = 4;
+    {
+        Recorder recorder(path, {{"state", 2}, {"residual", 1}}, options);
+        EXPECT_EQ(recorder.get_column_count(), 3u);
+        for (int i = 0; i < 31; i++)
+        {
+            const double state[2] = {1.0 * i, -1.0 * i};
+            const double residual = 0.5 * i;
+            const double* values[2] = {state, &residual};
+            EXPECT_EQ(recorder.record(time_at(start + 1000 * i), values), i % 3 == 0);
+        }
+        EXPECT_EQ(recorder.get_row_count(), 11u);
+        recorder.close();
+        recorder.close();
+        const double* values[2] = {nullptr, nullptr};
+        EXPECT_THROW(recorder.record(time_at(start + 1000000), values), std::logic_error);
+    }
+
+    const std::vector<char> bytes = read_file(path);
+    std::remove(path.c_str());
+    ASSERT_GE(bytes.size(), sizeof(FileHeader) + sizeof(FileTrailer));
+
+    const FileHeader header = read_at<FileHeader>(bytes, 0);
+    EXPECT_EQ(std::memcmp(header.magic, file_magic, sizeof(file_magic)), 0);
+    EXPECT_EQ(header.channel_count, 2u);
+    EXPECT_EQ(header.column_count, 3u);
+    EXPECT_EQ(header.rows_per_chunk, 4u);
+    EXPECT_EQ(header.header_bytes % 64, 0u);
+    EXPECT_EQ(header.chunk_bytes, sizeof(ChunkHeader) + 8 * 4 * 4);
+    const ChannelHeader residual = read_at<ChannelHeader>(
+        bytes, sizeof(FileHeader) + sizeof(ChannelHeader));
+    EXPECT_STREQ(residual.name, "residual");
+    EXPECT_EQ(residual.first_column, 2u);
+    EXPECT_EQ(residual.width, 1u);
+
+    // Rows 0, 3, ... 30 in chunks of 4, 4 and 3.
+    const FileTrailer trailer = read_at<FileTrailer>(bytes, bytes.size() - sizeof(FileTrailer));
+    EXPECT_EQ(std::memcmp(trailer.magic, file_magic, sizeof(file_magic)), 0);
+    ASSERT_EQ(trailer.chunk_count, 3u);
+    EXPECT_EQ(trailer.row_count, 11u);
+    EXPECT_EQ(trailer.index_offset, header.header_bytes + 3 * header.chunk_bytes);
+    ASSERT_EQ(bytes.size(), trailer.index_offset + 3 * sizeof(IndexEntry) + sizeof(FileTrailer));
+
+    for (size_t chunk = 0; chunk < 3; chunk++)
+    {
+        const IndexEntry entry =
+            read_at<IndexEntry>(bytes, trailer.index_offset + chunk * sizeof(IndexEntry));
+        EXPECT_EQ(entry.first_row, 4 * chunk);
+        EXPECT_EQ(entry.row_count, chunk < 2 ? 4u : 3u);
+        EXPECT_EQ(entry.first_utc_nanoseconds, start + 12000 * (int64_t)chunk);
+        EXPECT_EQ(entry.last_utc_nanoseconds,
+                  start + 3000 * (int64_t)(entry.first_row + entry.row_count - 1));
+
+        const size_t offset = header.header_bytes + chunk * header.chunk_bytes;
+        const ChunkHeader chunk_header = read_at<ChunkHeader>(bytes, offset);
+        EXPECT_EQ(chunk_header.magic, chunk_magic);
+        EXPECT_EQ(chunk_header.row_count, entry.row_count);
+        EXPECT_EQ(chunk_header.first_utc_nanoseconds, entry.first_utc_nanoseconds);
+        EXPECT_EQ(chunk_header.last_utc_nanoseconds, entry.last_utc_nanoseconds);
+
+        const size_t times = offset + sizeof(ChunkHeader);
+        for (size_t row = 0; row < 4; row++)
+        {
+            const bool used = row < entry.row_count;
+            const size_t i = 3 * (entry.first_row + row);
+            EXPECT_EQ(read_at<int64_t>(bytes, times + 8 * row),
+                      used ? start + 1000 * (int64_t)i : 0);
+            EXPECT_EQ(read_at<double>(bytes, times + 8 * (4 + row)), used ? 1.0 * i : 0.0);
+            EXPECT_EQ(read_at<double>(bytes, times + 8 * (8 + row)), used ? -1.0 * i : 0.0);
+            EXPECT_EQ(read_at<double>(bytes, times + 8 * (12 + row)), used ? 0.5 * i : 0.0);
+        }
+    }
+}
+
+TEST(HistoryTest, empty_history_has_no_chunks)
+{
+    const std::string path = ::testing::TempDir() + "history_test_empty.bin";
+    Recorder(path, {{"state", 12}}).close();
+    const std::vector<char> bytes = read_file(path);
+    std::remove(path.c_str());
+    // A 40 byte file header and a 64 byte channel header, padded to 128.
+    ASSERT_EQ(bytes.size(), 128 + sizeof(FileTrailer));
+    const FileTrailer trailer = read_at<FileTrailer>(bytes, 128);
+    EXPECT_EQ(trailer.chunk_count, 0u);
+    EXPECT_EQ(trailer.row_count, 0u);
+    EXPECT_EQ(trailer.index_offset, 128u);
+}
+
+TEST(HistoryTest, invalid_recordings_throw)
+{
+    const std::string path = ::testing::TempDir() + "history_test_invalid.bin";
+    EXPECT_THROW(Recorder(path, {}), std::invalid_argument);
+    EXPECT_THROW(Recorder(path, {{"", 1}}), std::invalid_argument);
+    EXPECT_THROW(Recorder(path, {{std::string(48, 'x'), 1}}), std::invalid_argument);
+    EXPECT_THROW(Recorder(path, {{"state", 0}}), std::invalid_argument);
+    RecorderOptions options;
+    options.decimation = 0;
+    EXPECT_THROW(Recorder(path, {{"state", 1}}, options), std::invalid_argument);
+    EXPECT_THROW(Recorder(::testing::TempDir() + "missing/history.bin", {{"state", 1}}),
+                 std::runtime_error);
+
+    Recorder recorder(path, {{"state", 1}});
+    const double value = 1.0;
+    const double* values[1] = {&value};
+    EXPECT_TRUE(recorder.record(time_at(2000), values));
+    EXPECT_TRUE(recorder.record(time_at(2000), values));
+    EXPECT_THROW(recorder.record(time_at(1999), values), std::invalid_argument);
+    recorder.close();
+    std::remove(path.c_str());
+}
+
+TEST(HistoryTest, reader_views_and_seeks)
+{
+    const std::string path = ::testing::TempDir() + "history_test_reader.bin";
+    record_ten_rows(path);
+    const Reader reader(path);
+    ASSERT_EQ(reader.get_channel_count(), 2u);
+    EXPECT_EQ(reader.get_column_count(), 3u);
+    EXPECT_EQ(reader.get_chunk_count(), 3u);
+    EXPECT_EQ(reader.get_row_count(), 10u);
+    EXPECT_STREQ(reader.get_channel(0).name, "state");
+    EXPECT_EQ(reader.find_channel("residual").first_column, 2u);
+    EXPECT_THROW(reader.find_channel("energy"), std::out_of_range);
+
+    const ColumnView<int64_t> times = reader.get_times(2);
+    ASSERT_EQ(times.size, 2u);
+    EXPECT_EQ(times[0], 80);
+    EXPECT_EQ(times[1], 90);
+    const ColumnView<double> state_y = reader.get_column(1, 1);
+    ASSERT_EQ(state_y.size, 4u);
+    EXPECT_EQ(std::vector<double>(state_y.begin(), state_y.end()),
+              (std::vector<double>{8.0, 10.0, 12.0, 14.0}));
+    EXPECT_EQ(reader.get_value(6, 2), -6.0);
+    EXPECT_EQ(reader.get_time(9).get_utc_since_epoch().get_nanoseconds(), 90);
+
+    EXPECT_EQ(reader.find_row(time_at(-5)), 0u);
+    EXPECT_EQ(reader.find_row(time_at(30)), 3u);
+    EXPECT_EQ(reader.find_row(time_at(31)), 4u);
+    EXPECT_EQ(reader.find_row(time_at(40)), 4u);
+    EXPECT_EQ(reader.find_row(time_at(85)), 9u);
+    EXPECT_EQ(reader.find_row(time_at(91)), 10u);
+    std::remove(path.c_str());
+}
+
+TEST(HistoryTest, reader_streams_json)
+{
+    const std::string path = ::testing::TempDir() + "history_test_json.bin";
+    record_ten_rows(path);
+    const Reader reader(path);
+
+    char* text = nullptr;
+    size_t size = 0;
+    FILE* file = open_memstream(&text, &size);
+    ASSERT_NE(file, nullptr);
+    // Rows 3 to 5, across a chunk boundary.
+    reader.write_json(file, {"residual", "state"}, time_at(25), time_at(60));
+    std::fclose(file);
+    EXPECT_STREQ(text, "[\n"
+                       "{\"utc_nanoseconds\": 30, \"residual\": [-3], \"state\": [3, 6]},\n"
+                       "{\"utc_nanoseconds\": 40, \"residual\": [-4], \"state\": [4, 8]},\n"
+                       "{\"utc_nanoseconds\": 50, \"residual\": [-5], \"state\": [5, 10]}\n"
+                       "]\n");
+
+    Arena* arena = arena_create(1 << 16);
+    const String json{text, size};
+    JsonObject* rows = json_parse(arena, &json);
+    ASSERT_NE(rows, nullptr);
+    EXPECT_EQ(rows->type, JSON_OBJECT_LIST);
+    arena_free(arena);
+    std::free(text);
+
+    file = open_memstream(&text, &size);
+    ASSERT_NE(file, nullptr);
+    reader.write_json(file, {"state"}, time_at(60), time_at(60));
+    EXPECT_THROW(reader.write_json(file, {"energy"}, time_at(0), time_at(90)), std::out_of_range);
+    std::fclose(file);
+    EXPECT_STREQ(text, "[]\n");
+    std::free(text);
+    std::remove(path.c_str());
+}
+
+TEST(HistoryTest, reader_recovers_cut_files)
+{
+    const std::string path = ::testing::TempDir() + "history_test_cut.bin";
+    record_ten_rows(path);
+    size_t chunk_start = 0;
+    size_t chunk_bytes = 0;
+    {
+        const std::vector<char> bytes = read_file(path);
+        const FileHeader header = read_at<FileHeader>(bytes, 0);
+        chunk_start = header.header_bytes;
+        chunk_bytes = header.chunk_bytes;
+    }
+
+    // Lose the trailer, then half of the second chunk.
+    ASSERT_EQ(truncate(path.c_str(), chunk_start + 3 * chunk_bytes), 0);
+    {
+        const Reader reader(path);
+        EXPECT_EQ(reader.get_chunk_count(), 3u);
+        EXPECT_EQ(reader.get_row_count(), 10u);
+        EXPECT_EQ(reader.get_chunk_entry(2).first_row, 8u);
+        EXPECT_EQ(reader.get_chunk_entry(2).last_utc_nanoseconds, 90);
+        EXPECT_EQ(reader.find_row(time_at(75)), 8u);
+    }
+    ASSERT_EQ(truncate(path.c_str(), chunk_start + chunk_bytes + chunk_bytes / 2), 0);
+    {
+        const Reader reader(path);
+        EXPECT_EQ(reader.get_chunk_count(), 1u);
+        EXPECT_EQ(reader.get_row_count(), 4u);
+        EXPECT_EQ(reader.get_value(3, 0), 3.0);
+    }
+
+    ASSERT_EQ(truncate(path.c_str(), sizeof(FileHeader) - 1), 0);
+    EXPECT_THROW(Reader{path}, std::runtime_error);
+    FILE* file = std::fopen(path.c_str(), "wb");
+    std::fputs("{\"not\": \"a history file, but long enough to have a header\"}", file);
+    std::fclose(file);
+    EXPECT_THROW(Reader{path}, std::runtime_error);
+    std::remove(path.c_str());
+    EXPECT_THROW(Reader{path}, std::runtime_error);
+}
+
+TEST(HistoryTest, reader_rejects_corrupt_index)
+{
+    const std::string path = ::testing::TempDir() + "history_test_corrupt_index.bin";
+    record_ten_rows(path);
+    const std::vector<char> bytes = read_file(path);
+    const FileTrailer trailer = read_at<FileTrailer>(bytes, bytes.size() - sizeof(FileTrailer));
+    ASSERT_EQ(trailer.chunk_count, 3u);
+
+    // Overwrites the uint64_t at offset in a copy of the file.
+    const auto write_corrupted = [&](const size_t offset, const uint64_t value)
+    {
+        std::vector<char> corrupted = bytes;
+        std::memcpy(corrupted.data() + offset, &value, sizeof(value));
+        FILE* file = std::fopen(path.c_str(), "wb");
+        std::fwrite(corrupted.data(), 1, corrupted.size(), file);
+        std::fclose(file);
+    };
+    // Rows past the last chunk, a chunk out of place, a short chunk before the last and a total
+    // the chunks do not add up to.
+    const size_t last_entry = trailer.index_offset + 2 * sizeof(IndexEntry);
+    write_corrupted(last_entry + offsetof(IndexEntry, row_count), 1000);
+    EXPECT_THROW(Reader{path}, std::runtime_error);
+    write_corrupted(last_entry + offsetof(IndexEntry, first_row), 9);
+    EXPECT_THROW(Reader{path}, std::runtime_error);
+    write_corrupted(trailer.index_offset + offsetof(IndexEntry, row_count), 3);
+    EXPECT_THROW(Reader{path}, std::runtime_error);
+    write_corrupted(bytes.size() - sizeof(FileTrailer) + offsetof(FileTrailer, row_count), 11);
+    EXPECT_THROW(Reader{path}, std::runtime_error);
+
+    // The file as written is still read.
+    write_corrupted(0, read_at<uint64_t>(bytes, 0));
+    EXPECT_EQ(Reader(path).get_row_count(), 10u);
+    std::remove(path.c_str());
+}
+
+}
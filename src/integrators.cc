@@ -0,0 +1,432 @@
+#include "integrators.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace CamSim::Integrators {
+
+namespace {
+
+// Dormand-Prince 5(4) tableau.
+constexpr double c2 = 1.0 / 5.0;
+constexpr double c3 = 3.0 / 10.0;
+constexpr double c4 = 4.0 / 5.0;
+constexpr double c5 = 8.0 / 9.0;
+
+constexpr double a21 = 1.0 / 5.0;
+constexpr double a31 = 3.0 / 40.0;
+constexpr double a32 = 9.0 / 40.0;
+constexpr double a41 = 44.0 / 45.0;
+constexpr double a42 = -56.0 / 15.0;
+constexpr double a43 = 32.0 / 9.0;
+constexpr double a51 = 19372.0 / 6561.0;
+constexpr double a52 = -25360.0 / 2187.0;
+constexpr double a53 = 64448.0 / 6561.0;
+constexpr double a54 = -212.0 / 729.0;
+constexpr double a61 = 9017.0 / 3168.0;
+constexpr double a62 = -355.0 / 33.0;
+constexpr double a63 = 46732.0 / 5247.0;
+constexpr double a64 = 49.0 / 176.0;
+constexpr double a65 = -5103.0 / 18656.0;
+constexpr double a71 = 35.0 / 384.0;
+constexpr double a73 = 500.0 / 1113.0;
+constexpr double a74 = 125.0 / 192.0;
+constexpr double a75 = -2187.0 / 6784.0;
+constexpr double a76 = 11.0 / 84.0;
+
+// Fifth minus fourth order weights.
+constexpr double e1 = 71.0 / 57600.0;
+constexpr double e3 = -71.0 / 16695.0;
+constexpr double e4 = 71.0 / 1920.0;
+constexpr double e5 = -17253.0 / 339200.0;
+constexpr double e6 = 22.0 / 525.0;
+constexpr double e7 = -1.0 / 40.0;
+
+// Continuous extension.
+constexpr double d1 = -12715105075.0 / 11282082432.0;
+constexpr double d3 = 87487479700.0 / 32700410799.0;
+constexpr double d4 = -10690763975.0 / 1880347072.0;
+constexpr double d5 = 701980252875.0 / 199316789632.0;
+constexpr double d6 = -1453857185.0 / 822651844.0;
+constexpr double d7 = 69997945.0 / 29380423.0;
+
+// Step size controller.
+constexpr double safety = 0.9;
+constexpr double min_factor = 0.2;
+constexpr double max_factor = 5.0;
+
+// The step that lands on t_end when the remainder is within rounding of dt.
+double fixed_step_size(const double t, const double t_end, const double dt)
+{
+    const double remaining = t_end - t;
+    return remaining <= dt * (1.0 + 1e-9) ? remaining : dt;
+}
+
+}
+
+RK4::RK4(const size_t state_size)
+    : state_size(state_size),
+      k1(state_size),
+      k2(state_size),
+      k3(state_size),
+      k4(state_size),
+      stage(state_size)
+{
+    if (state_size == 0)
+    {
+        throw std::invalid_argument("Integrator state size must be positive");
+    }
+}
+
+void RK4::step(const Derivative& derivative, double& t, double* state, const double dt)
+{
+    derivative(t, state, k1.data());
+    for (size_t i = 0; i < state_size; i++)
+    {
+        stage[i] = state[i] + dt / 2.0 * k1[i];
+    }
+    derivative(t + dt / 2.0, stage.data(), k2.data());
+    for (size_t i = 0; i < state_size; i++)
+    {
+        stage[i] = state[i] + dt / 2.0 * k2[i];
+    }
+    derivative(t + dt / 2.0, stage.data(), k3.data());
+    for (size_t i = 0; i < state_size; i++)
+    {
+        stage[i] = state[i] + dt * k3[i];
+    }
+    derivative(t + dt, stage.data(), k4.data());
+
+    for (size_t i = 0; i < state_size; i++)
+    {
+        state[i] += dt / 6.0 * (k1[i] + 2.0 * k2[i] + 2.0 * k3[i] + k4[i]);
+    }
+    t += dt;
+}
+
+void RK4::integrate(
+    const Derivative& derivative,
+    double& t,
+    double* state,
+    const double t_end,
+    const double dt)
+{
+    if (!(dt > 0.0))
+    {
+        throw std::invalid_argument("Integrator step size must be positive");
+    }
+
+    while (t < t_end)
+    {
+        const double h = fixed_step_size(t, t_end, dt);
+        step(derivative, t, state, h);
+        if (h != dt)
+        {
+            t = t_end;
+        }
+    }
+}
+
+DormandPrince54::DormandPrince54(
+    const size_t state_size,
+    const double relative_tolerance,
+    const double absolute_tolerance)
+    : state_size(state_size),
+      relative_tolerance(relative_tolerance),
+      absolute_tolerance(absolute_tolerance),
+      k1(state_size),
+      k2(state_size),
+      k3(state_size),
+      k4(state_size),
+      k5(state_size),
+      k6(state_size),
+      k7(state_size),
+      stage(state_size),
+      candidate(state_size),
+      dense(5 * state_size)
+{
+    if (state_size == 0)
+    {
+        throw std::invalid_argument("Integrator state size must be positive");
+    }
+    if (!(relative_tolerance > 0.0) || !(absolute_tolerance > 0.0))
+    {
+        throw std::invalid_argument("Integrator tolerances must be positive");
+    }
+}
+
+void DormandPrince54::set_step_size(const double step_size)
+{
+    if (!(step_size >= 0.0))
+    {
+        throw std::invalid_argument("Integrator step size must not be negative");
+    }
+    this->step_size = step_size;
+}
+
+double DormandPrince54::initial_step_size(
+    const Derivative& derivative,
+    const double t,
+    const double* state,
+    const double t_end)
+{
+    // Hairer, Norsett and Wanner, Solving Ordinary Differential Equations I, section II.4, with
+    // k1 already holding the derivative at t.
+    double state_norm = 0.0;
+    double derivative_norm = 0.0;
+    for (size_t i = 0; i < state_size; i++)
+    {
+        const double scale = absolute_tolerance + relative_tolerance * std::fabs(state[i]);
+        state_norm += (state[i] / scale) * (state[i] / scale);
+        derivative_norm += (k1[i] / scale) * (k1[i] / scale);
+    }
+    state_norm = std::sqrt(state_norm / (double)state_size);
+    derivative_norm = std::sqrt(derivative_norm / (double)state_size);
+
+    double h0 =
+        state_norm < 1e-5 || derivative_norm < 1e-5 ? 1e-6 : 0.01 * state_norm / derivative_norm;
+    h0 = std::min(h0, t_end - t);
+
+    // Estimate the second derivative with an Euler step.
+    for (size_t i = 0; i < state_size; i++)
+    {
+        stage[i] = state[i] + h0 * k1[i];
+    }
+    derivative(t + h0, stage.data(), k2.data());
+    evaluations++;
+    double second_derivative_norm = 0.0;
+    for (size_t i = 0; i < state_size; i++)
+    {
+        const double scale = absolute_tolerance + relative_tolerance * std::fabs(state[i]);
+        second_derivative_norm += ((k2[i] - k1[i]) / scale) * ((k2[i] - k1[i]) / scale);
+    }
+    second_derivative_norm = std::sqrt(second_derivative_norm / (double)state_size) / h0;
+
+    const double largest = std::max(derivative_norm, second_derivative_norm);
+    const double h1 =
+        largest <= 1e-15 ? std::max(1e-6, h0 * 1e-3) : std::pow(0.01 / largest, 1.0 / 5.0);
+
+    return std::min(100.0 * h0, h1);
+}
+
+void DormandPrince54::step(
+    const Derivative& derivative,
+    double& t,
+    double* state,
+    const double t_end)
+{
+    if (t_end < t)
+    {
+        throw std::invalid_argument("DormandPrince54 only integrates forward in time");
+    }
+    if (t_end == t)
+    {
+        return;
+    }
+
+    if (!first_same_as_last || t != time)
+    {
+        derivative(t, state, k1.data());
+        evaluations++;
+        first_same_as_last = false;
+    }
+    if (step_size == 0.0)
+    {
+        step_size = initial_step_size(derivative, t, state, t_end);
+    }
+
+    bool rejected = false;
+    for (;;)
+    {
+        double h = max_step_size > 0.0 ? std::min(step_size, max_step_size) : step_size;
+        // Stretch a step that would stop just short of t_end to finish there, rather than leave a
+        // sliver of a few ulps for the next one.
+        if (t + 1.01 * h >= t_end)
+        {
+            h = t_end - t;
+        }
+        else if (!(h > 16.0 * std::numeric_limits<double>::epsilon() * std::fabs(t)) ||
+                 t + h == t)
+        {
+            throw std::runtime_error("DormandPrince54 step size underflow");
+        }
+
+        for (size_t i = 0; i < state_size; i++)
+        {
+            stage[i] = state[i] + h * a21 * k1[i];
+        }
+        derivative(t + c2 * h, stage.data(), k2.data());
+        for (size_t i = 0; i < state_size; i++)
+        {
+            stage[i] = state[i] + h * (a31 * k1[i] + a32 * k2[i]);
+        }
+        derivative(t + c3 * h, stage.data(), k3.data());
+        for (size_t i = 0; i < state_size; i++)
+        {
+            stage[i] = state[i] + h * (a41 * k1[i] + a42 * k2[i] + a43 * k3[i]);
+        }
+        derivative(t + c4 * h, stage.data(), k4.data());
+        for (size_t i = 0; i < state_size; i++)
+        {
+            stage[i] = state[i] + h * (a51 * k1[i] + a52 * k2[i] + a53 * k3[i] + a54 * k4[i]);
+        }
+        derivative(t + c5 * h, stage.data(), k5.data());
+        for (size_t i = 0; i < state_size; i++)
+        {
+            stage[i] = state[i] +
+                       h * (a61 * k1[i] + a62 * k2[i] + a63 * k3[i] + a64 * k4[i] + a65 * k5[i]);
+        }
+        const bool lands_on_end = h == t_end - t;
+        const double t_new = lands_on_end ? t_end : t + h;
+        derivative(t_new, stage.data(), k6.data());
+        for (size_t i = 0; i < state_size; i++)
+        {
+            candidate[i] = state[i] + h * (a71 * k1[i] + a73 * k3[i] + a74 * k4[i] +
+                                           a75 * k5[i] + a76 * k6[i]);
+        }
+        derivative(t_new, candidate.data(), k7.data());
+        evaluations += 6;
+
+        double error = 0.0;
+        for (size_t i = 0; i < state_size; i++)
+        {
+            const double scale =
+                absolute_tolerance +
+                relative_tolerance * std::max(std::fabs(state[i]), std::fabs(candidate[i]));
+            const double component = h *
+                                     (e1 * k1[i] + e3 * k3[i] + e4 * k4[i] + e5 * k5[i] +
+                                      e6 * k6[i] + e7 * k7[i]) /
+                                     scale;
+            error += component * component;
+        }
+        error = std::sqrt(error / (double)state_size);
+        const double factor = error == 0.0 ? max_factor : safety * std::pow(error, -1.0 / 5.0);
+
+        if (!(error <= 1.0))
+        {
+            rejected_steps++;
+            rejected = true;
+            step_size = h * (std::isfinite(error) ? std::max(min_factor, factor) : min_factor);
+            continue;
+        }
+
+        for (size_t i = 0; i < state_size; i++)
+        {
+            const double difference = candidate[i] - state[i];
+            const double spline = h * k1[i] - difference;
+            dense[i] = state[i];
+            dense[state_size + i] = difference;
+            dense[2 * state_size + i] = spline;
+            dense[3 * state_size + i] = difference - h * k7[i] - spline;
+            dense[4 * state_size + i] =
+                h * (d1 * k1[i] + d3 * k3[i] + d4 * k4[i] + d5 * k5[i] + d6 * k6[i] + d7 * k7[i]);
+        }
+
+        std::copy(candidate.begin(), candidate.end(), state);
+        std::swap(k1, k7);
+        previous_time = t;
+        t = t_new;
+        time = t;
+        first_same_as_last = true;
+        has_step = true;
+        accepted_steps++;
+        step_size = h * std::min(rejected ? 1.0 : max_factor, std::max(min_factor, factor));
+        return;
+    }
+}
+
+void DormandPrince54::integrate(
+    const Derivative& derivative,
+    double& t,
+    double* state,
+    const double t_end)
+{
+    while (t < t_end)
+    {
+        step(derivative, t, state, t_end);
+    }
+}
+
+void DormandPrince54::interpolate(const double t, double* state) const
+{
+    if (!has_step)
+    {
+        throw std::logic_error("DormandPrince54 has not taken a step");
+    }
+    if (t < previous_time || t > time)
+    {
+        throw std::out_of_range("Interpolation time is outside the last step");
+    }
+
+    const double theta = (t - previous_time) / (time - previous_time);
+    const double theta1 = 1.0 - theta;
+    for (size_t i = 0; i < state_size; i++)
+    {
+        const double inner = dense[3 * state_size + i] + theta1 * dense[4 * state_size + i];
+        state[i] = dense[i] + theta * (dense[state_size + i] +
+                                       theta1 * (dense[2 * state_size + i] + theta * inner));
+    }
+}
+
+VelocityVerlet::VelocityVerlet(const size_t position_size)
+    : position_size(position_size), current_acceleration(position_size)
+{
+    if (position_size == 0)
+    {
+        throw std::invalid_argument("Integrator state size must be positive");
+    }
+}
+
+void VelocityVerlet::step(
+    const Acceleration& acceleration,
+    double& t,
+    double* state,
+    const double dt)
+{
+    double* position = state;
+    double* velocity = state + position_size;
+    if (!has_acceleration)
+    {
+        acceleration(t, position, current_acceleration.data());
+        has_acceleration = true;
+    }
+
+    // Kick, drift, kick.
+    for (size_t i = 0; i < position_size; i++)
+    {
+        velocity[i] += dt / 2.0 * current_acceleration[i];
+        position[i] += dt * velocity[i];
+    }
+    t += dt;
+    acceleration(t, position, current_acceleration.data());
+    for (size_t i = 0; i < position_size; i++)
+    {
+        velocity[i] += dt / 2.0 * current_acceleration[i];
+    }
+}
+
+void VelocityVerlet::integrate(
+    const Acceleration& acceleration,
+    double& t,
+    double* state,
+    const double t_end,
+    const double dt)
+{
+    if (!(dt > 0.0))
+    {
+        throw std::invalid_argument("Integrator step size must be positive");
+    }
+
+    while (t < t_end)
+    {
+        const double h = fixed_step_size(t, t_end, dt);
+        step(acceleration, t, state, h);
+        if (h != dt)
+        {
+            t = t_end;
+        }
+    }
+}
+
+}
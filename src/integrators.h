@@ -0,0 +1,200 @@
+#ifndef INTEGRATORS_H
+#define INTEGRATORS_H
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+namespace CamSim::Integrators {
+
+// Writes d/dt state at time t.  MultiRigidbody::get_derivative fits after wrapping it in a lambda.
+using Derivative = std::function<void(double t, const double* state, double* state_derivative)>;
+
+// Writes the acceleration at time t for the given positions.
+using Acceleration = std::function<void(double t, const double* position, double* acceleration)>;
+
+// The classic fourth order Runge-Kutta method with a fixed step.  Stages live in the integrator,
+// so stepping does not allocate.
+class RK4
+{
+public:
+    // Throws std::invalid_argument if state_size is 0.
+    explicit RK4(const size_t state_size);
+
+    size_t get_state_size() const
+    {
+        return state_size;
+    }
+
+    // Advances t and state by dt in place.
+    void step(const Derivative& derivative, double& t, double* state, const double dt);
+
+    // Steps of dt until t_end, shortening the last one to land on it.  Throws
+    // std::invalid_argument if dt is not positive.
+    void integrate(
+        const Derivative& derivative,
+        double& t,
+        double* state,
+        const double t_end,
+        const double dt);
+
+private:
+    size_t state_size;
+    std::vector<double> k1;
+    std::vector<double> k2;
+    std::vector<double> k3;
+    std::vector<double> k4;
+    std::vector<double> stage;
+};
+
+// The Dormand-Prince 5(4) embedded Runge-Kutta method with step size control and the fourth order
+// continuous extension for dense output, following Hairer, Norsett and Wanner's DOPRI5.  The last
+// stage of a step is the first of the next one, so call reset whenever the state is changed
+// between steps, for example by MultiRigidbody::switch_attitudes_to_shadow.  Integrates forward in
+// time only.
+class DormandPrince54
+{
+public:
+    // The error of each component is measured against
+    // absolute_tolerance + relative_tolerance * |state|.  Throws std::invalid_argument if
+    // state_size is 0 or a tolerance is not positive.
+    DormandPrince54(
+        const size_t state_size,
+        const double relative_tolerance = 1e-9,
+        const double absolute_tolerance = 1e-12);
+
+    size_t get_state_size() const
+    {
+        return state_size;
+    }
+
+    // Takes one accepted step, no further than t_end, retrying smaller ones as needed, and
+    // advances t and state in place.  A step that would end within 1% of its size short of t_end
+    // is stretched to end there.  A step size of 0 picks a starting step from the derivatives.
+    // Throws std::runtime_error if the step size underflows.
+    void step(const Derivative& derivative, double& t, double* state, const double t_end);
+
+    // Accepted steps until t_end.
+    void integrate(const Derivative& derivative, double& t, double* state, const double t_end);
+
+    // Writes the state at t, which must lie within the last accepted step.  Throws
+    // std::logic_error before the first step and std::out_of_range outside the step.
+    void interpolate(const double t, double* state) const;
+
+    // Forgets the derivative carried over from the last step.
+    void reset()
+    {
+        first_same_as_last = false;
+    }
+
+    // The size the next step will try.
+    double get_step_size() const
+    {
+        return step_size;
+    }
+
+    void set_step_size(const double step_size);
+
+    double get_previous_time() const
+    {
+        return previous_time;
+    }
+
+    double get_time() const
+    {
+        return time;
+    }
+
+    size_t get_accepted_steps() const
+    {
+        return accepted_steps;
+    }
+
+    size_t get_rejected_steps() const
+    {
+        return rejected_steps;
+    }
+
+    size_t get_evaluations() const
+    {
+        return evaluations;
+    }
+
+    double max_step_size = 0.0;  // 0 for no limit
+
+private:
+    double initial_step_size(
+        const Derivative& derivative,
+        const double t,
+        const double* state,
+        const double t_end);
+
+    size_t state_size;
+    double relative_tolerance;
+    double absolute_tolerance;
+
+    double step_size = 0.0;
+    double previous_time = 0.0;
+    double time = 0.0;
+    bool first_same_as_last = false;
+    bool has_step = false;
+    size_t accepted_steps = 0;
+    size_t rejected_steps = 0;
+    size_t evaluations = 0;
+
+    std::vector<double> k1;
+    std::vector<double> k2;
+    std::vector<double> k3;
+    std::vector<double> k4;
+    std::vector<double> k5;
+    std::vector<double> k6;
+    std::vector<double> k7;
+    std::vector<double> stage;
+    std::vector<double> candidate;
+    // Dense output coefficients of the last accepted step.
+    std::vector<double> dense;
+};
+
+// Velocity Verlet, the second order symplectic integrator from the discrete Lagrangian of
+// x_ddot = a(t, x).  It keeps energy bounded over long runs where Runge-Kutta methods drift.  The
+// state is [position, velocity] like MultiRigidbody's full state, but the acceleration must not
+// depend on the velocity for the method to stay symplectic.
+class VelocityVerlet
+{
+public:
+    // Throws std::invalid_argument if position_size is 0.
+    explicit VelocityVerlet(const size_t position_size);
+
+    size_t get_state_size() const
+    {
+        return 2 * position_size;
+    }
+
+    // Advances t and state by dt in place.  One acceleration evaluation per step, the first one
+    // carrying over from the last step.
+    void step(const Acceleration& acceleration, double& t, double* state, const double dt);
+
+    // Steps of dt until t_end, shortening the last one to land on it.  Throws
+    // std::invalid_argument if dt is not positive.
+    void integrate(
+        const Acceleration& acceleration,
+        double& t,
+        double* state,
+        const double t_end,
+        const double dt);
+
+    // Forgets the acceleration carried over from the last step.
+    void reset()
+    {
+        has_acceleration = false;
+    }
+
+private:
+    size_t position_size;
+    bool has_acceleration = false;
+    std::vector<double> current_acceleration;
+};
+
+}
+
+#endif
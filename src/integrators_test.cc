@@ -0,0 +1,217 @@
+#include "integrators.h"
+
+#include <cmath>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace CamSim::Integrators {
+
+// x_ddot = -x from x = 1 at rest, so x = cos t.
+void harmonic_oscillator(double, const double* state, double* state_derivative)
+{
+    state_derivative[0] = state[1];
+    state_derivative[1] = -state[0];
+}
+
+// Two body motion with mu = 1, state = [r, v] in the plane.
+void kepler_acceleration(double, const double* position, double* acceleration)
+{
+    const double r = std::hypot(position[0], position[1]);
+    acceleration[0] = -position[0] / (r * r * r);
+    acceleration[1] = -position[1] / (r * r * r);
+}
+
+void kepler(const double t, const double* state, double* state_derivative)
+{
+    state_derivative[0] = state[2];
+    state_derivative[1] = state[3];
+    kepler_acceleration(t, state, state_derivative + 2);
+}
+
+double kepler_energy(const double* state)
+{
+    return 0.5 * (state[2] * state[2] + state[3] * state[3]) -
+           1.0 / std::hypot(state[0], state[1]);
+}
+
+// Periapsis of an orbit with semi-major axis 1, so a period of 2 pi.
+std::vector<double> eccentric_orbit(const double eccentricity)
+{
+    return {1.0 - eccentricity, 0.0, 0.0, std::sqrt((1.0 + eccentricity) / (1.0 - eccentricity))};
+}
+
+TEST(rk4_test, fourth_order_convergence)
+{
+    RK4 integrator(2);
+    std::vector<double> errors;
+    for (const double dt : {0.1, 0.05})
+    {
+        double t = 0.0;
+        std::vector<double> state = {1.0, 0.0};
+        integrator.integrate(harmonic_oscillator, t, state.data(), 2.0, dt);
+        EXPECT_EQ(t, 2.0);
+        errors.push_back(std::fabs(state[0] - std::cos(2.0)));
+    }
+    EXPECT_NEAR(errors[0] / errors[1], 16.0, 0.5);
+
+    // The last step shortens to land on the end time.
+    double t = 0.0;
+    std::vector<double> state = {1.0, 0.0};
+    integrator.integrate(harmonic_oscillator, t, state.data(), 1.0, 0.3);
+    EXPECT_EQ(t, 1.0);
+    EXPECT_NEAR(state[0], std::cos(1.0), 1e-4);
+}
+
+TEST(dormand_prince_test, meets_tolerance_over_an_eccentric_orbit)
+{
+    DormandPrince54 integrator(4, 1e-11, 1e-13);
+    double t = 0.0;
+    const std::vector<double> initial = eccentric_orbit(0.7);
+    std::vector<double> state = initial;
+    integrator.integrate(kepler, t, state.data(), 2.0 * M_PI);
+
+    EXPECT_EQ(t, 2.0 * M_PI);
+    for (size_t i = 0; i < state.size(); i++)
+    {
+        EXPECT_NEAR(state[i], initial[i], 1e-7) << i;
+    }
+    EXPECT_NEAR(kepler_energy(state.data()), kepler_energy(initial.data()), 1e-9);
+
+    // Steps adapt to the fast periapsis pass, and every step after the first reuses its last
+    // evaluation.
+    EXPECT_GT(integrator.get_accepted_steps(), 100u);
+    EXPECT_EQ(integrator.get_evaluations(),
+              2 + 6 * (integrator.get_accepted_steps() + integrator.get_rejected_steps()));
+}
+
+TEST(dormand_prince_test, dense_output_within_steps)
+{
+    DormandPrince54 integrator(2, 1e-8, 1e-10);
+    double t = 0.0;
+    std::vector<double> state = {1.0, 0.0};
+    std::vector<double> interpolated(2);
+    EXPECT_THROW(integrator.interpolate(0.0, interpolated.data()), std::logic_error);
+
+    double largest_error = 0.0;
+    while (t < 10.0)
+    {
+        integrator.step(harmonic_oscillator, t, state.data(), 10.0);
+        EXPECT_EQ(integrator.get_time(), t);
+        for (int i = 0; i <= 10; i++)
+        {
+            const double t_out = integrator.get_previous_time() +
+                                 (t - integrator.get_previous_time()) * (double)i / 10.0;
+            integrator.interpolate(t_out, interpolated.data());
+            largest_error = std::max(largest_error, std::fabs(interpolated[0] - std::cos(t_out)));
+            largest_error = std::max(largest_error, std::fabs(interpolated[1] + std::sin(t_out)));
+        }
+    }
+    EXPECT_LT(largest_error, 1e-7);
+    EXPECT_THROW(integrator.interpolate(10.5, interpolated.data()), std::out_of_range);
+
+    // Changing the state between steps needs a reset, which reevaluates the derivative at the
+    // same time before the next step.
+    const auto tries = [&integrator]()
+    { return integrator.get_accepted_steps() + integrator.get_rejected_steps(); };
+    state = {std::cos(10.0) + 1e-3, -std::sin(10.0)};
+    integrator.reset();
+    size_t evaluations = integrator.get_evaluations();
+    size_t previous_tries = tries();
+    integrator.step(harmonic_oscillator, t, state.data(), 10.5);
+    EXPECT_EQ(integrator.get_evaluations(), evaluations + 1 + 6 * (tries() - previous_tries));
+
+    // Without one, the step reuses the derivative of the last stage.
+    evaluations = integrator.get_evaluations();
+    previous_tries = tries();
+    integrator.step(harmonic_oscillator, t, state.data(), 11.0);
+    EXPECT_EQ(integrator.get_evaluations(), evaluations + 6 * (tries() - previous_tries));
+}
+
+TEST(dormand_prince_test, last_step_stretches_to_the_end)
+{
+    // Steps of 0.1 accumulate to 0.9999999999999999 after ten, so without looking ahead the end
+    // time is left a step of one ulp away.
+    DormandPrince54 integrator(2, 1e-3, 1e-3);
+    integrator.max_step_size = 0.1;
+    integrator.set_step_size(0.1);
+    double t = 0.0;
+    std::vector<double> state = {1.0, 0.0};
+    double accumulated = 0.0;
+    for (int i = 0; i < 10; i++)
+    {
+        accumulated += 0.1;
+    }
+    ASSERT_LT(accumulated, 1.0);
+
+    integrator.integrate(harmonic_oscillator, t, state.data(), 1.0);
+    EXPECT_EQ(t, 1.0);
+    EXPECT_EQ(integrator.get_accepted_steps(), 10u);
+    EXPECT_EQ(integrator.get_rejected_steps(), 0u);
+    EXPECT_NEAR(state[0], std::cos(1.0), 1e-3);
+}
+
+TEST(velocity_verlet_test, energy_stays_bounded)
+{
+    VelocityVerlet verlet(2);
+    RK4 rk4(4);
+    const std::vector<double> initial = eccentric_orbit(0.3);
+    const double energy = kepler_energy(initial.data());
+
+    // Over 200 orbits at a coarse step Verlet's energy error oscillates without growing while
+    // RK4's drifts.
+    std::vector<double> verlet_state = initial;
+    std::vector<double> rk4_state = initial;
+    double verlet_t = 0.0;
+    double rk4_t = 0.0;
+    double first_verlet_error = 0.0;
+    double last_verlet_error = 0.0;
+    double first_rk4_error = 0.0;
+    for (int orbit = 0; orbit < 200; orbit++)
+    {
+        const double t_end = 2.0 * M_PI * (orbit + 1);
+        for (int sample = 0; sample < 20; sample++)
+        {
+            verlet.integrate(kepler_acceleration, verlet_t, verlet_state.data(),
+                             t_end - 2.0 * M_PI * (19 - sample) / 20.0, 0.05);
+            double& largest_error = orbit < 10 ? first_verlet_error : last_verlet_error;
+            largest_error =
+                std::max(largest_error, std::fabs(kepler_energy(verlet_state.data()) - energy));
+        }
+        rk4.integrate(kepler, rk4_t, rk4_state.data(), t_end, 0.05);
+        if (orbit == 9)
+        {
+            first_rk4_error = std::fabs(kepler_energy(rk4_state.data()) - energy);
+        }
+    }
+    EXPECT_LT(last_verlet_error, 1.1 * first_verlet_error);
+    EXPECT_GT(std::fabs(kepler_energy(rk4_state.data()) - energy), 10.0 * first_rk4_error);
+}
+
+TEST(integrators_test, invalid_arguments_throw)
+{
+    EXPECT_THROW(RK4(0), std::invalid_argument);
+    EXPECT_THROW(VelocityVerlet(0), std::invalid_argument);
+    EXPECT_THROW(DormandPrince54(0), std::invalid_argument);
+    EXPECT_THROW(DormandPrince54(2, 0.0), std::invalid_argument);
+    EXPECT_THROW(DormandPrince54(2, 1e-6, -1.0), std::invalid_argument);
+
+    double t = 0.0;
+    std::vector<double> state = {1.0, 0.0};
+    RK4 rk4(2);
+    EXPECT_THROW(rk4.integrate(harmonic_oscillator, t, state.data(), 1.0, 0.0),
+                 std::invalid_argument);
+    DormandPrince54 dormand_prince(2);
+    EXPECT_THROW(dormand_prince.set_step_size(-1.0), std::invalid_argument);
+    EXPECT_THROW(dormand_prince.step(harmonic_oscillator, t, state.data(), -1.0),
+                 std::invalid_argument);
+
+    // A derivative that never settles shrinks the step until it underflows.
+    const Derivative diverging = [](double, const double*, double* state_derivative)
+    {
+        state_derivative[0] = NAN;
+        state_derivative[1] = NAN;
+    };
+    EXPECT_THROW(dormand_prince.step(diverging, t, state.data(), 1.0), std::runtime_error);
+}
+
+}
@@ -2,6 +2,7 @@
  * @file json.cc
  */
 #include "json.h"
+#include <math.h>
 
 /*
  * Tokenization logic.
@@ -130,7 +131,7 @@ json_tokenize (Arena* arena, const String* string)
                             return NULL;
                         }
 
-                        if (string_compare (string, true_string) == 0)
+                        if (string_equal (string, true_string))
                         {
                             JsonToken token{};
                             token.type = JSON_TOKEN_BOOLEAN;
@@ -140,7 +141,7 @@ json_tokenize (Arena* arena, const String* string)
                                 return NULL;
                             }
                         }
-                        else if (string_compare (string, false_string) == 0)
+                        else if (string_equal (string, false_string))
                         {
                             JsonToken token{};
                             token.type = JSON_TOKEN_BOOLEAN;
@@ -150,7 +151,7 @@ json_tokenize (Arena* arena, const String* string)
                                 return NULL;
                             }
                         }
-                        else if (string_compare (string, null_string) == 0)
+                        else if (string_equal (string, null_string))
                         {
                             JsonToken token{};
                             token.type = JSON_TOKEN_NULL;
@@ -479,72 +480,41 @@ json_string (Arena* arena, List* tokens, int* parse_idx)
     }
 
     /*
-     * Create a special arena for all of the little strings in this function that we don't need
-     * outside of this function.  Then create those strings.
+     * Views of the text of the tokens that are not stored as strings, and a buffer numbers are
+     * printed into, so rebuilding the string allocates nothing but the string itself.
      */
-    Arena* helper_string_arena = arena_create (MAX_JSON_TOKENS * MAX_JSON_KEY_SIZE);
-    if (helper_string_arena == NULL)
-    {
-        return NULL;
-    }
-    const String* null = string_create (helper_string_arena, "null");
-    if (null == NULL)
-    {
-        arena_free (helper_string_arena);
-        return NULL;
-    }
-    const String* colon = string_create (helper_string_arena, ":");
-    if (colon == NULL)
-    {
-        arena_free (helper_string_arena);
-        return NULL;
-    }
-    const String* comma = string_create (helper_string_arena, ",");
-    if (comma == NULL)
-    {
-        arena_free (helper_string_arena);
-        return NULL;
-    }
-    const String* open_curly = string_create (helper_string_arena, "{");
-    if (open_curly == NULL)
-    {
-        arena_free (helper_string_arena);
-        return NULL;
-    }
-    const String* close_curly = string_create (helper_string_arena, "}");
-    if (close_curly == NULL)
-    {
-        arena_free (helper_string_arena);
-        return NULL;
-    }
-    const String* open_square = string_create (helper_string_arena, "[");
-    if (open_square == NULL)
-    {
-        arena_free (helper_string_arena);
-        return NULL;
-    }
-    const String* close_square = string_create (helper_string_arena, "]");
-    if (close_square == NULL)
-    {
-        arena_free (helper_string_arena);
-        return NULL;
-    }
-    const String* true_str = string_create (helper_string_arena, "true");
-    if (true_str == NULL)
-    {
-        arena_free (helper_string_arena);
-        return NULL;
-    }
-    const String* false_str = string_create (helper_string_arena, "false");
-    if (false_str == NULL)
-    {
-        arena_free (helper_string_arena);
-        return NULL;
-    }
+    char null_text[] = "null";
+    char colon_text[] = ":";
+    char comma_text[] = ",";
+    char open_curly_text[] = "{";
+    char close_curly_text[] = "}";
+    char open_square_text[] = "[";
+    char close_square_text[] = "]";
+    char true_text[] = "true";
+    char false_text[] = "false";
+    const String null_view = { null_text, sizeof (null_text) - 1 };
+    const String colon_view = { colon_text, sizeof (colon_text) - 1 };
+    const String comma_view = { comma_text, sizeof (comma_text) - 1 };
+    const String open_curly_view = { open_curly_text, sizeof (open_curly_text) - 1 };
+    const String close_curly_view = { close_curly_text, sizeof (close_curly_text) - 1 };
+    const String open_square_view = { open_square_text, sizeof (open_square_text) - 1 };
+    const String close_square_view = { close_square_text, sizeof (close_square_text) - 1 };
+    const String true_view = { true_text, sizeof (true_text) - 1 };
+    const String false_view = { false_text, sizeof (false_text) - 1 };
+    const String* null = &null_view;
+    const String* colon = &colon_view;
+    const String* comma = &comma_view;
+    const String* open_curly = &open_curly_view;
+    const String* close_curly = &close_curly_view;
+    const String* open_square = &open_square_view;
+    const String* close_square = &close_square_view;
+    const String* true_str = &true_view;
+    const String* false_str = &false_view;
+    char number_buffer[MAX_JSON_KEY_SIZE];
+    String number_view = { number_buffer, 0 };
 
     JsonToken* string_token = NULL;
     const String* string_value = string_create (arena, "");
-    char* char_buffer = NULL;
     bool quote_found = false;
     bool early_exit = false;
     while (not quote_found and not early_exit
@@ -592,36 +562,29 @@ json_string (Arena* arena, List* tokens, int* parse_idx)
                                                string_token->boolean_value ? true_str : false_str);
             break;
         case JSON_TOKEN_DOUBLE:
-            char_buffer = arena_multi_allocate_type (helper_string_arena, MAX_JSON_KEY_SIZE, char);
-            if (char_buffer == NULL)
+            number_view.size = (size_t)snprintf (number_buffer, sizeof (number_buffer), "%lf",
+                                                 string_token->double_value);
+            if (number_view.size >= sizeof (number_buffer))
             {
                 early_exit = true;
                 break;
             }
-            sprintf (char_buffer, "%lf", string_token->double_value);
-            string_value = string_concatenate (arena, string_value,
-                                               string_create (helper_string_arena, char_buffer));
+            string_value = string_concatenate (arena, string_value, &number_view);
             break;
         case JSON_TOKEN_INTEGER:
-            char_buffer = arena_multi_allocate_type (helper_string_arena, MAX_JSON_KEY_SIZE, char);
-            if (char_buffer == NULL)
+            number_view.size = (size_t)snprintf (number_buffer, sizeof (number_buffer), "%ld",
+                                                 string_token->integer_value);
+            if (number_view.size >= sizeof (number_buffer))
             {
                 early_exit = true;
                 break;
             }
-            sprintf (char_buffer, "%ld", string_token->integer_value);
-            string_value = string_concatenate (arena, string_value,
-                                               string_create (helper_string_arena, char_buffer));
+            string_value = string_concatenate (arena, string_value, &number_view);
             break;
         }
         (*parse_idx)++;
     }
 
-    /*
-     * Free the helper arena.
-     */
-    arena_free (helper_string_arena);
-
     /*
      * Ran out of tokens as string was never closed, or memory ran out.  Fail parse.
      */
@@ -760,7 +723,7 @@ json_dictionary_get (JsonObject* dict, const String* key)
         {
             break;
         }
-        if (string_compare (key, current_key->string_value) == 0)
+        if (string_equal (key, current_key->string_value))
         {
             desired_value = current_value;
             break;
@@ -798,3 +761,98 @@ json_list_get (JsonObject* list, const int index)
 
     return NULL;
 }
+
+/*
+ * Writing logic.
+ */
+bool
+json_write_string (FILE* file, const String* string)
+{
+    if (file == NULL or string == NULL)
+    {
+        return false;
+    }
+
+    if (fputc ('"', file) == EOF)
+    {
+        return false;
+    }
+    size_t run_start = 0;
+    for (size_t i = 0; i < string->size; i++)
+    {
+        const unsigned char current_char = (unsigned char)string->text[i];
+        if (current_char >= 0x20 and current_char != '"' and current_char != '\\')
+        {
+            continue;
+        }
+
+        /*
+         * Write the run of plain characters before this one, then its escape.
+         */
+        if (fwrite (string->text + run_start, 1, i - run_start, file) != i - run_start)
+        {
+            return false;
+        }
+        char escape[8];
+        switch (current_char)
+        {
+        case '"':
+            snprintf (escape, sizeof (escape), "\\\"");
+            break;
+        case '\\':
+            snprintf (escape, sizeof (escape), "\\\\");
+            break;
+        case '\n':
+            snprintf (escape, sizeof (escape), "\\n");
+            break;
+        case '\r':
+            snprintf (escape, sizeof (escape), "\\r");
+            break;
+        case '\t':
+            snprintf (escape, sizeof (escape), "\\t");
+            break;
+        default:
+            snprintf (escape, sizeof (escape), "\\u%04x", current_char);
+            break;
+        }
+        if (fputs (escape, file) == EOF)
+        {
+            return false;
+        }
+        run_start = i + 1;
+    }
+    if (fwrite (string->text + run_start, 1, string->size - run_start, file)
+        != string->size - run_start)
+    {
+        return false;
+    }
+
+    return fputc ('"', file) != EOF;
+}
+
+bool
+json_write_double (FILE* file, const double value)
+{
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    if (not isfinite (value))
+    {
+        return fputs ("null", file) != EOF;
+    }
+
+    /*
+     * 17 significant digits always round trip, but try the shorter form first so that values such
+     * as 0.1 are written as people would write them.
+     */
+    char buffer[32];
+    snprintf (buffer, sizeof (buffer), "%.15g", value);
+    if (strtod (buffer, NULL) != value)
+    {
+        snprintf (buffer, sizeof (buffer), "%.17g", value);
+    }
+
+    return fputs (buffer, file) != EOF;
+}
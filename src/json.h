@@ -179,4 +179,25 @@ JsonObject* json_dictionary_get (JsonObject* dict, const String* key);
  * @return A pointer to the value if the index is valid, otherwise NULL.
  */
 JsonObject* json_list_get (JsonObject* list, const int index);
+
+/**
+ * Writes a string as a quoted JSON string, escaping quotes, backslashes and control characters.
+ *
+ * @param[in] file The file to write to.
+ * @param[in] string The string to write.
+ *
+ * @return true if the string was written, false if an argument is NULL or writing failed.
+ */
+bool json_write_string (FILE* file, const String* string);
+
+/**
+ * Writes a double with enough digits that json_parse gives back the same value.  JSON has no
+ * NaN or infinity, so those are written as null.
+ *
+ * @param[in] file The file to write to.
+ * @param[in] value The value to write.
+ *
+ * @return true if the value was written, false if file is NULL or writing failed.
+ */
+bool json_write_double (FILE* file, const double value);
 #endif
@@ -1,6 +1,7 @@
 #include "json.h"
 #include "utils.h"
 #include <gtest/gtest.h>
+#include <math.h>
 
 class JsonTest : public ::testing::Test
 {
@@ -311,3 +312,59 @@ TEST_F (JsonTest, NestedLookupCombination)
     EXPECT_EQ (bob_name->type, JSON_OBJECT_STRING);
     EXPECT_EQ (string_compare (bob_name->string_value, MakeString ("Bob")), 0);
 }
+
+/* ========================================================================= *
+ * json_write_string, json_write_double
+ * ========================================================================= */
+
+TEST_F (JsonTest, WrittenValuesParseBack)
+{
+    char* text = NULL;
+    size_t size = 0;
+    FILE* file = open_memstream (&text, &size);
+    ASSERT_NE ((intptr_t)file, (intptr_t)NULL);
+
+    const double values[] = { 0.1, -1.0 / 3.0, 6.02214076e23, 5e-324, 42.0 };
+    fputs ("{\"name\": ", file);
+    EXPECT_TRUE (json_write_string (file, MakeString ("state_x")));
+    fputs (", \"values\": [", file);
+    for (size_t i = 0; i < sizeof (values) / sizeof (values[0]); i++)
+    {
+        EXPECT_TRUE (json_write_double (file, values[i]));
+        fputs (", ", file);
+    }
+    EXPECT_TRUE (json_write_double (file, NAN));
+    fputs ("]}", file);
+    fclose (file);
+
+    const String written = { text, size };
+    EXPECT_NE (strstr (text, "[0.1, "), nullptr) << text;
+    EXPECT_NE (strstr (text, ", null]"), nullptr) << text;
+
+    JsonObject* root = json_parse (arena, &written);
+    ASSERT_NE ((intptr_t)root, (intptr_t)NULL) << text;
+    JsonObject* list = json_dictionary_get (root, MakeString ("values"));
+    ASSERT_NE ((intptr_t)list, (intptr_t)NULL);
+    for (size_t i = 0; i < sizeof (values) / sizeof (values[0]); i++)
+    {
+        JsonObject* value = json_list_get (list, (int)i);
+        ASSERT_NE ((intptr_t)value, (intptr_t)NULL);
+        const double parsed = value->type == JSON_OBJECT_INTEGER ? (double)value->integer_value
+                                                                  : value->double_value;
+        EXPECT_EQ (parsed, values[i]) << i;
+    }
+    EXPECT_EQ (json_list_get (list, 5)->type, JSON_OBJECT_NULL);
+    free (text);
+
+    // The parser does not read escapes, so only check what is written.
+    file = open_memstream (&text, &size);
+    ASSERT_NE ((intptr_t)file, (intptr_t)NULL);
+    EXPECT_TRUE (json_write_string (file, MakeString ("a \"b\"\\\n\x01")));
+    fclose (file);
+    EXPECT_STREQ (text, "\"a \\\"b\\\"\\\\\\n\\u0001\"");
+    free (text);
+
+    EXPECT_FALSE (json_write_string (NULL, MakeString ("x")));
+    EXPECT_FALSE (json_write_string (stdout, NULL));
+    EXPECT_FALSE (json_write_double (NULL, 1.0));
+}
@@ -1,5 +1,6 @@
 #include "math.h"
 
+#include <algorithm>
 #include <gsl/gsl_sf_legendre.h>
 
 namespace CamSim::Math {
@@ -17,7 +18,9 @@ double factorial(const int n)
 
 double semi_normalized_legendre(const int l, const int m, const double x)
 {
-    double legendre = gsl_sf_legendre_Plm(l, m, x);
+    // GSL includes the Condon-Shortley phase (-1)^m, which Schmidt semi-normalized functions do
+    // not.
+    double legendre = (m % 2 == 0 ? 1.0 : -1.0) * gsl_sf_legendre_Plm(l, m, x);
 
     if (m == 0)
     {
@@ -35,4 +38,189 @@ double semi_normalized_legendre_sin_deriv(const int l, const int m, const double
            std::sqrt((l + 1) * (l + 1) - m * m) * semi_normalized_legendre(l + 1, m, sin_x) / std::cos(x);
 }
 
+template <typename Scalar>
+BasicSemiNormalizedLegendreTable<Scalar>::BasicSemiNormalizedLegendreTable(const int max_l)
+    : max_l(max_l), values((max_l + 1) * (max_l + 2) / 2), normalization(values.size())
+{
+    for (int l = 0; l <= max_l; l++)
+    {
+        for (int m = 0; m <= l; m++)
+        {
+            normalization[l * (l + 1) / 2 + m] =
+                m == 0 ? 1.0 : std::sqrt(2.0 * factorial(l - m) / factorial(l + m));
+        }
+    }
+}
+
+template <typename Scalar>
+void BasicSemiNormalizedLegendreTable<Scalar>::compute(const Scalar& x, const int up_to_l)
+{
+    using std::sqrt;
+
+    // The unnormalized functions without the Condon-Shortley phase, from
+    // P_m^m = (2m - 1)!! (1 - x^2)^(m/2) and P_(m+1)^m = (2m + 1) x P_m^m up each column.
+    const Scalar root = sqrt(1.0 - x) * sqrt(1.0 + x);
+    Scalar diagonal = 1.0;
+    for (int m = 0; m <= up_to_l; m++)
+    {
+        if (m > 0)
+        {
+            diagonal *= (2 * m - 1) * root;
+        }
+        Scalar previous = 0.0;
+        Scalar current = diagonal;
+        values[m * (m + 1) / 2 + m] = current;
+        for (int l = m + 1; l <= up_to_l; l++)
+        {
+            const Scalar next = ((2 * l - 1) * x * current - (l + m - 1) * previous) / (l - m);
+            previous = current;
+            current = next;
+            values[l * (l + 1) / 2 + m] = current;
+        }
+    }
+
+    const int count = (up_to_l + 1) * (up_to_l + 2) / 2;
+    for (int i = 0; i < count; i++)
+    {
+        values[i] *= normalization[i];
+    }
+}
+
+template class BasicSemiNormalizedLegendreTable<double>;
+template class BasicSemiNormalizedLegendreTable<Coordinate::Lanes<4>>;
+template class BasicSemiNormalizedLegendreTable<Coordinate::Lanes<8>>;
+
+void chebyshev_nodes(const double begin, const double end, const size_t count, double* nodes)
+{
+    const double center = 0.5 * (begin + end);
+    const double half_width = 0.5 * (end - begin);
+    for (size_t k = 0; k < count; k++)
+    {
+        nodes[k] = center + half_width * std::cos(M_PI * (k + 0.5) / count);
+    }
+}
+
+void chebyshev_fit(const double* values, const size_t count, double* coefficients)
+{
+    // The discrete orthogonality of T_j over the nodes, c_j = 2 / n sum_k f(x_k) T_j(x_k), with
+    // c_0 halved.
+    for (size_t j = 0; j < count; j++)
+    {
+        double sum = 0.0;
+        for (size_t k = 0; k < count; k++)
+        {
+            sum += values[k] * std::cos(M_PI * j * (k + 0.5) / count);
+        }
+        coefficients[j] = (j == 0 ? 1.0 : 2.0) * sum / count;
+    }
+}
+
+double chebyshev_evaluate(const double* coefficients, const size_t count, const double x)
+{
+    double b1 = 0.0;
+    double b2 = 0.0;
+    for (size_t j = count; j-- > 1;)
+    {
+        const double b0 = 2.0 * x * b1 - b2 + coefficients[j];
+        b2 = b1;
+        b1 = b0;
+    }
+
+    return x * b1 - b2 + coefficients[0];
+}
+
+ChebyshevTrajectory::ChebyshevTrajectory(
+    const Function& function,
+    const size_t component_count,
+    const double begin,
+    const double end,
+    const ChebyshevOptions& options)
+    : component_count(component_count), options(options), begin(begin)
+{
+    if (!(begin < end) || component_count == 0 || options.node_count < 3 ||
+        !(options.segment_duration > 0.0) || !(options.min_segment_duration > 0.0) ||
+        !(options.tolerance > 0.0))
+    {
+        throw std::invalid_argument("Invalid Chebyshev trajectory interval or options");
+    }
+
+    nodes.resize(options.node_count);
+    node_values.resize(options.node_count * component_count);
+    component_values.resize(options.node_count);
+    probe_values.resize(component_count);
+    probe = std::cos(M_PI * (double)(options.node_count / 2) / (double)options.node_count);
+
+    const size_t segment_count = (size_t)std::ceil((end - begin) / options.segment_duration);
+    for (size_t i = 0; i < segment_count; i++)
+    {
+        const double segment_begin = begin + (end - begin) * i / segment_count;
+        const double segment_end = i + 1 == segment_count
+                                       ? end
+                                       : begin + (end - begin) * (i + 1) / segment_count;
+        fit(function, segment_begin, segment_end);
+    }
+}
+
+void ChebyshevTrajectory::fit(const Function& function, const double begin, const double end)
+{
+    const size_t node_count = options.node_count;
+    chebyshev_nodes(begin, end, node_count, nodes.data());
+    for (size_t k = 0; k < node_count; k++)
+    {
+        function(nodes[k], &node_values[k * component_count]);
+    }
+    function(0.5 * (begin + end) + 0.5 * (end - begin) * probe, probe_values.data());
+    function_evaluation_count += node_count + 1;
+
+    const size_t offset = coefficients.size();
+    coefficients.resize(offset + node_count * component_count);
+    double error = 0.0;
+    for (size_t component = 0; component < component_count; component++)
+    {
+        for (size_t k = 0; k < node_count; k++)
+        {
+            component_values[k] = node_values[k * component_count + component];
+        }
+        double* c = &coefficients[offset + component * node_count];
+        chebyshev_fit(component_values.data(), node_count, c);
+        error = std::max({error, std::abs(c[node_count - 1]) + std::abs(c[node_count - 2]),
+                          std::abs(chebyshev_evaluate(c, node_count, probe) -
+                                   probe_values[component])});
+    }
+
+    if (error > options.tolerance && 0.5 * (end - begin) >= options.min_segment_duration)
+    {
+        coefficients.resize(offset);
+        const double middle = 0.5 * (begin + end);
+        fit(function, begin, middle);
+        fit(function, middle, end);
+        return;
+    }
+
+    segment_ends.push_back(end);
+    error_estimate = std::max(error_estimate, error);
+}
+
+void ChebyshevTrajectory::evaluate(const double t, double* values) const
+{
+    if (!(t >= begin && t <= segment_ends.back()))
+    {
+        throw std::out_of_range("Time is outside the Chebyshev trajectory");
+    }
+
+    const size_t segment =
+        std::min<size_t>(std::lower_bound(segment_ends.begin(), segment_ends.end(), t) -
+                             segment_ends.begin(),
+                         segment_ends.size() - 1);
+    const double segment_begin = segment == 0 ? begin : segment_ends[segment - 1];
+    const double segment_end = segment_ends[segment];
+    const double x = (2.0 * t - segment_begin - segment_end) / (segment_end - segment_begin);
+    const size_t node_count = options.node_count;
+    const double* c = &coefficients[segment * node_count * component_count];
+    for (size_t component = 0; component < component_count; component++)
+    {
+        values[component] = chebyshev_evaluate(c + component * node_count, node_count, x);
+    }
+}
+
 }
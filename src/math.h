@@ -1,8 +1,13 @@
 #ifndef MATH_H
 #define MATH_H
 #include <cmath>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
 #include <tuple>
+#include <vector>
 
+#include "coordinates.h"
 #include "wgs84.h"
 
 namespace CamSim::Math {
@@ -13,6 +18,216 @@ double semi_normalized_legendre(const int l, const int m, const double x);
 
 double semi_normalized_legendre_sin_deriv(const int l, const int m, const double x);
 
+// Fills cos_values[m] = cos(m * angle) and sin_values[m] = sin(m * angle) for m = 0..max_m with one
+// sin and cos call, by the angle addition recurrence.  The error grows about linearly with m, to
+// roughly m * 1e-16.  Scalar is double or Coordinate::Lanes<N>, for N angles at once.
+template <typename Scalar>
+void sin_cos_multiples(const Scalar& angle, const int max_m, Scalar* cos_values, Scalar* sin_values)
+{
+    using std::cos;
+    using std::sin;
+
+    cos_values[0] = 1.0;
+    sin_values[0] = 0.0;
+    if (max_m < 1)
+    {
+        return;
+    }
+
+    const Scalar cos_angle = cos(angle);
+    const Scalar sin_angle = sin(angle);
+    cos_values[1] = cos_angle;
+    sin_values[1] = sin_angle;
+
+    // Rotating by angle each step is stabler than the Chebyshev recurrence
+    // cos((m + 1) x) = 2 cos(x) cos(m x) - cos((m - 1) x) when sin(angle) is small.
+    for (int m = 2; m <= max_m; m++)
+    {
+        cos_values[m] = cos_values[m - 1] * cos_angle - sin_values[m - 1] * sin_angle;
+        sin_values[m] = sin_values[m - 1] * cos_angle + cos_values[m - 1] * sin_angle;
+    }
+}
+
+// cos(m * angle) and sin(m * angle) for the longitude terms of a spherical harmonic expansion.
+// Allocates once, so one table can be recomputed for every evaluation.  With Scalar =
+// Coordinate::Lanes<N> each lane is the table of its own angle.
+template <typename Scalar>
+class BasicSinCosTable
+{
+public:
+    explicit BasicSinCosTable(const int max_m) : cos_values(max_m + 1), sin_values(max_m + 1)
+    {
+    }
+
+    void compute(const Scalar& angle)
+    {
+        compute(angle, get_max_m());
+    }
+
+    // Fills m = 0..up_to_m only, for an expansion truncated below max_m.
+    void compute(const Scalar& angle, const int up_to_m)
+    {
+        sin_cos_multiples(angle, up_to_m, cos_values.data(), sin_values.data());
+    }
+
+    int get_max_m() const
+    {
+        return (int)cos_values.size() - 1;
+    }
+
+    const Scalar& get_cos(const int m) const
+    {
+        return cos_values[m];
+    }
+
+    const Scalar& get_sin(const int m) const
+    {
+        return sin_values[m];
+    }
+
+private:
+    std::vector<Scalar> cos_values;
+    std::vector<Scalar> sin_values;
+};
+
+using SinCosTable = BasicSinCosTable<double>;
+
+// The Schmidt semi-normalized Legendre functions P_l^m(x) for 0 <= m <= l <= max_l, the values of
+// semi_normalized_legendre, by the three term recurrence in l so that one compute fills the table
+// for every term of an expansion.  The constructor allocates and computes the normalization, so
+// a table kept across evaluations makes compute allocation-free.  With Scalar =
+// Coordinate::Lanes<N> each lane is the table of its own x.
+template <typename Scalar>
+class BasicSemiNormalizedLegendreTable
+{
+public:
+    explicit BasicSemiNormalizedLegendreTable(const int max_l);
+
+    void compute(const Scalar& x)
+    {
+        compute(x, max_l);
+    }
+
+    // Fills rows l = 0..up_to_l only, for an expansion truncated below max_l.
+    void compute(const Scalar& x, const int up_to_l);
+
+    int get_max_l() const
+    {
+        return max_l;
+    }
+
+    const Scalar& get(const int l, const int m) const
+    {
+        return values[l * (l + 1) / 2 + m];
+    }
+
+private:
+    int max_l;
+    // Row l starts at l (l + 1) / 2.
+    std::vector<Scalar> values;
+    std::vector<double> normalization;
+};
+
+using SemiNormalizedLegendreTable = BasicSemiNormalizedLegendreTable<double>;
+
+// Defined in math.cc for one lane and for 4 and 8 lanes, like the multibody types.
+extern template class BasicSemiNormalizedLegendreTable<double>;
+extern template class BasicSemiNormalizedLegendreTable<Coordinate::Lanes<4>>;
+extern template class BasicSemiNormalizedLegendreTable<Coordinate::Lanes<8>>;
+
+// Fills nodes with the count Chebyshev points of the first kind, cos(pi (k + 1/2) / count) for
+// k = 0..count - 1, mapped from [-1, 1] onto [begin, end].
+void chebyshev_nodes(const double begin, const double end, const size_t count, double* nodes);
+
+// The coefficients c_j of the polynomial sum_j c_j T_j(x) of degree count - 1 through values at the
+// count nodes from chebyshev_nodes.
+void chebyshev_fit(const double* values, const size_t count, double* coefficients);
+
+// sum_j c_j T_j(x) for x in [-1, 1], by Clenshaw's recurrence.
+double chebyshev_evaluate(const double* coefficients, const size_t count, const double x);
+
+struct ChebyshevOptions
+{
+    // Nodes per segment, so the polynomials have degree node_count - 1.
+    size_t node_count = 12;
+    // Segments start this long and are halved until the error estimate of every component is
+    // within tolerance, but not below min_segment_duration.
+    double segment_duration = 60.0;
+    double min_segment_duration = 1e-3;
+    // Absolute, in the units of the values.
+    double tolerance = 1e-9;
+};
+
+// A smooth vector function of time on [begin, end] as piecewise Chebyshev polynomials, the way
+// ephemeris files store orbits.  The function is evaluated at the nodes of each segment once, when
+// constructed, and after that a query costs a binary search and one Clenshaw recurrence per
+// component.  A segment's error estimate is the larger of its last two coefficients' magnitudes
+// and the error at a probe halfway in angle between its two central nodes, which is never a node
+// whether node_count is even or odd.
+class ChebyshevTrajectory
+{
+public:
+    // Writes the values of the components at time t.
+    using Function = std::function<void(double t, double* values)>;
+
+    // Fits function over [begin, end].  Throws std::invalid_argument unless begin < end and there
+    // is a component, at least three nodes, positive durations and a positive tolerance.  With
+    // two nodes the error estimate would include the constant term.
+    ChebyshevTrajectory(
+        const Function& function,
+        const size_t component_count,
+        const double begin,
+        const double end,
+        const ChebyshevOptions& options = ChebyshevOptions{});
+
+    // Writes the fitted components at t.  Throws std::out_of_range if t is outside [begin, end].
+    void evaluate(const double t, double* values) const;
+
+    size_t get_component_count() const
+    {
+        return component_count;
+    }
+
+    size_t get_segment_count() const
+    {
+        return segment_ends.size();
+    }
+
+    // The largest error estimate over segments and components.  It is above the tolerance only if
+    // segments reached min_segment_duration.
+    double get_error_estimate() const
+    {
+        return error_estimate;
+    }
+
+    // How many times the function was evaluated.
+    size_t get_function_evaluation_count() const
+    {
+        return function_evaluation_count;
+    }
+
+private:
+    void fit(const Function& function, const double begin, const double end);
+
+    size_t component_count;
+    ChebyshevOptions options;
+    double begin;
+    // The probe on [-1, 1], cos(pi floor(node_count / 2) / node_count), an extremum of
+    // T_node_count.
+    double probe;
+    double error_estimate = 0.0;
+    size_t function_evaluation_count = 0;
+    // Segment i spans [segment_ends[i - 1], segment_ends[i]], the first one from begin, with
+    // node_count coefficients per component.
+    std::vector<double> segment_ends;
+    std::vector<double> coefficients;
+    // Scratch for fitting.
+    std::vector<double> nodes;
+    std::vector<double> node_values;
+    std::vector<double> component_values;
+    std::vector<double> probe_values;
+};
+
 }
 
 #endif
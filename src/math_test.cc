@@ -0,0 +1,173 @@
+#include "math.h"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace CamSim::Math {
+
+TEST(sin_cos_multiples_test, matches_std)
+{
+    const int max_m = 2190;
+    std::vector<double> cos_values(max_m + 1), sin_values(max_m + 1);
+
+    for (const double angle : {0.0, 1e-9, 0.3, -1.2, 2.5, M_PI, -3.1})
+    {
+        sin_cos_multiples(angle, max_m, cos_values.data(), sin_values.data());
+
+        for (int m = 0; m <= max_m; m++)
+        {
+            const double tolerance = 1e-15 * (m + 1);
+            EXPECT_NEAR(cos_values[m], std::cos(m * angle), tolerance) << angle << " " << m;
+            EXPECT_NEAR(sin_values[m], std::sin(m * angle), tolerance) << angle << " " << m;
+        }
+    }
+}
+
+TEST(sin_cos_table_test, recompute)
+{
+    SinCosTable table(12);
+    EXPECT_EQ(table.get_max_m(), 12);
+
+    for (const double angle : {0.1, 2.0})
+    {
+        table.compute(angle);
+        for (int m = 0; m <= 12; m++)
+        {
+            EXPECT_NEAR(table.get_cos(m), std::cos(m * angle), 1e-14);
+            EXPECT_NEAR(table.get_sin(m), std::sin(m * angle), 1e-14);
+        }
+    }
+
+    SinCosTable constant_table(0);
+    constant_table.compute(1.0);
+    EXPECT_EQ(constant_table.get_cos(0), 1.0);
+    EXPECT_EQ(constant_table.get_sin(0), 0.0);
+}
+
+TEST(semi_normalized_legendre_table_test, matches_function)
+{
+    SemiNormalizedLegendreTable table(13);
+    EXPECT_EQ(table.get_max_l(), 13);
+
+    for (const double x : {-1.0, -0.7, 0.0, 0.2, 0.9848, 1.0})
+    {
+        table.compute(x);
+        for (int l = 0; l <= 13; l++)
+        {
+            for (int m = 0; m <= l; m++)
+            {
+                EXPECT_NEAR(table.get(l, m), semi_normalized_legendre(l, m, x), 1e-12)
+                    << x << " " << l << " " << m;
+            }
+        }
+    }
+
+    // P_1^1(x) = sqrt(1 - x^2), with no Condon-Shortley phase.
+    table.compute(0.6);
+    EXPECT_NEAR(table.get(1, 1), 0.8, 1e-15);
+
+    // A truncated compute fills only the rows asked for.
+    table.compute(-0.3, 4);
+    EXPECT_NEAR(table.get(4, 3), semi_normalized_legendre(4, 3, -0.3), 1e-12);
+    EXPECT_NEAR(table.get(5, 3), semi_normalized_legendre(5, 3, 0.6), 1e-12);
+}
+
+TEST(chebyshev_test, reproduces_polynomials)
+{
+    const size_t count = 6;
+    double nodes[count], values[count], coefficients[count];
+    chebyshev_nodes(-2.0, 3.0, count, nodes);
+    const auto cubic = [](const double t) { return 1.0 - 2.0 * t + 0.5 * t * t * t; };
+    for (size_t k = 0; k < count; k++)
+    {
+        EXPECT_GE(nodes[k], -2.0);
+        EXPECT_LE(nodes[k], 3.0);
+        values[k] = cubic(nodes[k]);
+    }
+    chebyshev_fit(values, count, coefficients);
+    EXPECT_NEAR(coefficients[4], 0.0, 1e-14);
+    EXPECT_NEAR(coefficients[5], 0.0, 1e-14);
+    for (const double t : {-2.0, -0.7, 0.0, 1.3, 3.0})
+    {
+        const double x = (2.0 * t - 1.0) / 5.0;
+        EXPECT_NEAR(chebyshev_evaluate(coefficients, count, x), cubic(t), 1e-13) << t;
+    }
+}
+
+TEST(chebyshev_test, trajectory_meets_tolerance)
+{
+    // Two components varying over a 90 minute orbit, at very different scales.
+    const double period = 5400.0;
+    const auto orbit = [period](const double t, double* values)
+    {
+        values[0] =
+            3e-5 * std::sin(2.0 * M_PI * t / period) + 1e-6 * std::cos(6.0 * M_PI * t / period);
+        values[1] = 5e-5 * std::cos(2.0 * M_PI * t / period);
+    };
+
+    ChebyshevOptions options;
+    options.segment_duration = 600.0;
+    options.tolerance = 1e-13;
+    const ChebyshevTrajectory trajectory(orbit, 2, 100.0, 100.0 + period, options);
+    EXPECT_EQ(trajectory.get_component_count(), 2u);
+    EXPECT_GE(trajectory.get_segment_count(), 9u);
+    EXPECT_LE(trajectory.get_error_estimate(), 1e-13);
+
+    // A 1 kHz query rate over the orbit would evaluate the function 5.4 million times.
+    EXPECT_LT(trajectory.get_function_evaluation_count(), 1000u);
+    double max_error = 0.0;
+    for (double t = 100.0; t <= 100.0 + period; t += 0.37)
+    {
+        double fitted[2], exact[2];
+        trajectory.evaluate(t, fitted);
+        orbit(t, exact);
+        max_error = std::max({max_error, std::abs(fitted[0] - exact[0]),
+                              std::abs(fitted[1] - exact[1])});
+    }
+    EXPECT_LT(max_error, 1e-13);
+
+    // A tighter tolerance halves segments.
+    options.tolerance = 1e-17;
+    const ChebyshevTrajectory finer(orbit, 2, 100.0, 100.0 + period, options);
+    EXPECT_GT(finer.get_segment_count(), trajectory.get_segment_count());
+
+    double values[2];
+    EXPECT_THROW(trajectory.evaluate(99.0, values), std::out_of_range);
+    EXPECT_THROW(trajectory.evaluate(100.1 + period, values), std::out_of_range);
+    EXPECT_THROW(ChebyshevTrajectory(orbit, 2, 1.0, 1.0), std::invalid_argument);
+    for (const size_t node_count : {1, 2})
+    {
+        options.node_count = node_count;
+        EXPECT_THROW(ChebyshevTrajectory(orbit, 2, 0.0, 1.0, options), std::invalid_argument);
+    }
+}
+
+TEST(chebyshev_test, odd_node_count_probe_is_not_a_node)
+{
+    // T_7 is zero at the 7 nodes of [-1, 1] and at its middle, so a fit with 7 nodes is zero
+    // there and its coefficients are all zero.  Only a probe off the nodes and the middle sees
+    // the error.
+    const size_t node_count = 7;
+    const auto t7 = [](const double t, double* values)
+    { values[0] = std::cos(node_count * std::acos(std::clamp(t, -1.0, 1.0))); };
+
+    ChebyshevOptions options;
+    options.node_count = node_count;
+    options.segment_duration = 2.0;
+    options.tolerance = 1e-9;
+    const ChebyshevTrajectory trajectory(t7, 1, -1.0, 1.0, options);
+    EXPECT_GT(trajectory.get_segment_count(), 1u);
+
+    double max_error = 0.0;
+    for (double t = -1.0; t <= 1.0; t += 1e-3)
+    {
+        double fitted, exact;
+        trajectory.evaluate(t, &fitted);
+        t7(t, &exact);
+        max_error = std::max(max_error, std::abs(fitted - exact));
+    }
+    EXPECT_LT(max_error, 1e-8);
+}
+
+}
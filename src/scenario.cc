@@ -0,0 +1,530 @@
+#include "scenario.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "json.h"
+
+namespace CamSim::Scenario {
+
+namespace {
+
+// The most a parse tree can take: json_tokenize caps the token count, and every token adds at most
+// itself, one object and the few key sized strings json_string concatenates it into.
+constexpr size_t parse_capacity =
+    MAX_JSON_TOKENS * (sizeof(JsonToken) + sizeof(JsonObject) +
+                       4 * (sizeof(String) + MAX_JSON_KEY_SIZE + alignof(String)));
+
+struct ArenaDeleter
+{
+    void operator()(Arena* arena) const
+    {
+        arena_free(arena);
+    }
+};
+
+using ScratchArena = std::unique_ptr<Arena, ArenaDeleter>;
+
+ScratchArena create_scratch_arena(const size_t capacity)
+{
+    ScratchArena arena(arena_create(capacity));
+    if (!arena)
+    {
+        throw std::runtime_error("Cannot allocate the scenario parse arena");
+    }
+
+    return arena;
+}
+
+// A String viewing a C string, for looking up keys without allocating.
+String view(const char* text)
+{
+    return String{const_cast<char*>(text), std::strlen(text)};
+}
+
+bool equals(const String* string, const char* text)
+{
+    const String text_view = view(text);
+    return string_equal(string, &text_view);
+}
+
+size_t list_size(const JsonObject* list)
+{
+    size_t size = 0;
+    for (const JsonObject* value = list->first_value; value != nullptr; value = value->next_value)
+    {
+        size++;
+    }
+
+    return size;
+}
+
+bool is_number(const JsonObject* value)
+{
+    return value != nullptr &&
+           (value->type == JSON_OBJECT_DOUBLE || value->type == JSON_OBJECT_INTEGER);
+}
+
+double number_value(const JsonObject* value)
+{
+    return value->type == JSON_OBJECT_DOUBLE ? value->double_value : (double)value->integer_value;
+}
+
+bool read_numbers(const JsonObject* list, double* numbers, const size_t count)
+{
+    if (list == nullptr || list->type != JSON_OBJECT_LIST || list_size(list) != count)
+    {
+        return false;
+    }
+    const JsonObject* value = list->first_value;
+    for (size_t i = 0; i < count; i++, value = value->next_value)
+    {
+        if (!is_number(value))
+        {
+            return false;
+        }
+        numbers[i] = number_value(value);
+    }
+
+    return true;
+}
+
+// Reads the fields of one JSON object, naming the field in the exception when one is missing or
+// has the wrong type.  Objects in a list are named by their index.
+class ObjectReader
+{
+public:
+    ObjectReader(JsonObject* object, const char* name, const size_t index = no_index)
+        : object(object),
+          name(name),
+          index(index)
+    {
+        if (object == nullptr || object->type != JSON_OBJECT_DICT)
+        {
+            throw std::invalid_argument("Scenario " + describe(nullptr) + " must be an object");
+        }
+    }
+
+    JsonObject* find(const char* key) const
+    {
+        const String key_view = view(key);
+        return json_dictionary_get(object, &key_view);
+    }
+
+    double number(const char* key) const
+    {
+        const JsonObject* value = find(key);
+        if (!is_number(value))
+        {
+            fail(key, "must be a number");
+        }
+
+        return number_value(value);
+    }
+
+    double number(const char* key, const double default_value) const
+    {
+        return find(key) != nullptr ? number(key) : default_value;
+    }
+
+    size_t index_value(const char* key) const
+    {
+        const JsonObject* value = find(key);
+        if (value == nullptr || value->type != JSON_OBJECT_INTEGER || value->integer_value < 0)
+        {
+            fail(key, "must be a non-negative integer");
+        }
+
+        return (size_t)value->integer_value;
+    }
+
+    Vector3 vector(const char* key, const Vector3& default_value = Vector3{}) const
+    {
+        const JsonObject* value = find(key);
+        if (value == nullptr)
+        {
+            return default_value;
+        }
+        Vector3 vector;
+        if (!read_numbers(value, vector.values, 3))
+        {
+            fail(key, "must be a list of 3 numbers");
+        }
+
+        return vector;
+    }
+
+    Matrix3 matrix(const char* key) const
+    {
+        const JsonObject* value = find(key);
+        Matrix3 matrix;
+        bool valid = value != nullptr && value->type == JSON_OBJECT_LIST && list_size(value) == 3;
+        const JsonObject* row = valid ? value->first_value : nullptr;
+        for (size_t i = 0; valid && i < 3; i++, row = row->next_value)
+        {
+            valid = read_numbers(row, matrix.values[i], 3);
+        }
+        if (!valid)
+        {
+            fail(key, "must be 3 lists of 3 numbers");
+        }
+
+        return matrix;
+    }
+
+    // The string value of key, or nullptr if it is missing.
+    const String* string(const char* key) const
+    {
+        const JsonObject* value = find(key);
+        if (value == nullptr)
+        {
+            return nullptr;
+        }
+        if (value->type != JSON_OBJECT_STRING)
+        {
+            fail(key, "must be a string");
+        }
+
+        return value->string_value;
+    }
+
+    [[noreturn]] void fail(const char* key, const char* requirement) const
+    {
+        throw std::invalid_argument("Scenario " + describe(key) + " " + requirement);
+    }
+
+private:
+    static constexpr size_t no_index = (size_t)-1;
+
+    std::string describe(const char* key) const
+    {
+        std::string description = name;
+        if (index != no_index)
+        {
+            description += "[" + std::to_string(index) + "]";
+        }
+        if (key != nullptr)
+        {
+            description += std::string(".") + key;
+        }
+
+        return description;
+    }
+
+    JsonObject* object;
+    const char* name;
+    size_t index;
+};
+
+// The elements of an optional top level list, checking that it is a list.
+JsonObject* list_elements(const ObjectReader& root, const char* key, size_t& count)
+{
+    JsonObject* list = root.find(key);
+    if (list == nullptr)
+    {
+        count = 0;
+        return nullptr;
+    }
+    if (list->type != JSON_OBJECT_LIST)
+    {
+        root.fail(key, "must be a list");
+    }
+    count = list_size(list);
+
+    return list->first_value;
+}
+
+template <typename T>
+T* allocate_array(Arena* arena, const size_t count)
+{
+    if (count == 0)
+    {
+        return nullptr;
+    }
+    T* array = arena_multi_allocate_type(arena, count, T);
+    if (array == nullptr)
+    {
+        throw std::runtime_error("Scenario arena is out of memory");
+    }
+
+    return array;
+}
+
+BodyDefinition read_body(JsonObject* object, const size_t index)
+{
+    const ObjectReader body(object, "bodies", index);
+
+    return BodyDefinition{body.number("mass"),     body.matrix("inertia"),
+                          body.vector("position"), body.vector("attitude"),
+                          body.vector("velocity"), body.vector("attitude_rate")};
+}
+
+JointDefinition read_joint(JsonObject* object, const size_t index, const size_t body_count)
+{
+    const ObjectReader joint(object, "joints", index);
+    const String* type = joint.string("type");
+    if (type != nullptr && !equals(type, "revolute"))
+    {
+        joint.fail("type", "must be \"revolute\"");
+    }
+
+    const Vector3 z{0.0, 0.0, 1.0};
+    const JointDefinition definition{
+        joint.index_value("body1"),        joint.index_value("body2"),
+        joint.vector("position_in_1"),     joint.vector("position_in_2"),
+        joint.vector("direction_in_1", z), joint.vector("direction_in_2", z)};
+    if (definition.body1_idx >= body_count)
+    {
+        joint.fail("body1", "must be the index of a body");
+    }
+    if (definition.body2_idx >= body_count || definition.body2_idx == definition.body1_idx)
+    {
+        joint.fail("body2", "must be the index of another body");
+    }
+
+    return definition;
+}
+
+Dynamics::ForceGenerator read_force(JsonObject* object, const size_t index, const size_t body_count)
+{
+    const ObjectReader force(object, "forces", index);
+    const Dynamics::ForceGenerator definition{
+        force.index_value("body"), force.vector("force_in_0"), force.vector("force_in_body"),
+        force.vector("application_point_in_body"), force.vector("torque_in_body")};
+    if (definition.body_idx >= body_count)
+    {
+        force.fail("body", "must be the index of a body");
+    }
+
+    return definition;
+}
+
+IntegratorSettings read_integrator(JsonObject* object)
+{
+    const ObjectReader integrator(object, "integrator");
+    const String* method = integrator.string("method");
+    IntegratorSettings settings{};
+    if (method == nullptr || equals(method, "rk4"))
+    {
+        settings.method = IntegratorMethod::rk4;
+    }
+    else if (equals(method, "dormand_prince_54"))
+    {
+        settings.method = IntegratorMethod::dormand_prince_54;
+    }
+    else if (equals(method, "velocity_verlet"))
+    {
+        settings.method = IntegratorMethod::velocity_verlet;
+    }
+    else
+    {
+        integrator.fail("method", "must be \"rk4\", \"dormand_prince_54\" or \"velocity_verlet\"");
+    }
+
+    const bool adaptive = settings.method == IntegratorMethod::dormand_prince_54;
+    settings.step_size = adaptive ? integrator.number("step_size", 0.0)
+                                  : integrator.number("step_size");
+    settings.duration = integrator.number("duration");
+    settings.absolute_tolerance = integrator.number("absolute_tolerance", 1e-9);
+    settings.relative_tolerance = integrator.number("relative_tolerance", 1e-9);
+    if (!(settings.step_size > 0.0) && !(adaptive && settings.step_size == 0.0))
+    {
+        integrator.fail("step_size", "must be positive");
+    }
+    if (!(settings.duration >= 0.0))
+    {
+        integrator.fail("duration", "must not be negative");
+    }
+    if (!(settings.absolute_tolerance > 0.0) || !(settings.relative_tolerance > 0.0))
+    {
+        integrator.fail("absolute_tolerance", "and relative_tolerance must be positive");
+    }
+
+    return settings;
+}
+
+const Definition& parse_text(Arena* arena, Arena* scratch, const String* text)
+{
+    JsonObject* root_object = json_parse(scratch, text);
+    if (root_object == nullptr)
+    {
+        throw std::invalid_argument("Scenario is not valid JSON or exceeds the parser's limits");
+    }
+    const ObjectReader root(root_object, "scenario");
+
+    // Count first, so every array is allocated once at its final size.
+    size_t body_count;
+    size_t joint_count;
+    size_t force_count;
+    JsonObject* first_body = list_elements(root, "bodies", body_count);
+    JsonObject* first_joint = list_elements(root, "joints", joint_count);
+    JsonObject* first_force = list_elements(root, "forces", force_count);
+    if (body_count == 0)
+    {
+        root.fail("bodies", "must list at least one body");
+    }
+
+    Definition* definition = allocate_array<Definition>(arena, 1);
+    BodyDefinition* bodies = allocate_array<BodyDefinition>(arena, body_count);
+    JointDefinition* joints = allocate_array<JointDefinition>(arena, joint_count);
+    Dynamics::ForceGenerator* forces = allocate_array<Dynamics::ForceGenerator>(arena, force_count);
+
+    JsonObject* value = first_body;
+    for (size_t i = 0; i < body_count; i++, value = value->next_value)
+    {
+        new (&bodies[i]) BodyDefinition(read_body(value, i));
+    }
+    value = first_joint;
+    for (size_t i = 0; i < joint_count; i++, value = value->next_value)
+    {
+        new (&joints[i]) JointDefinition(read_joint(value, i, body_count));
+    }
+    value = first_force;
+    for (size_t i = 0; i < force_count; i++, value = value->next_value)
+    {
+        new (&forces[i]) Dynamics::ForceGenerator(read_force(value, i, body_count));
+    }
+
+    double alpha = 10.0;
+    double beta = 10.0;
+    if (JsonObject* baumgarte_object = root.find("baumgarte"))
+    {
+        const ObjectReader baumgarte(baumgarte_object, "baumgarte");
+        alpha = baumgarte.number("alpha", alpha);
+        beta = baumgarte.number("beta", beta);
+    }
+
+    MagneticFieldModel magnetic_field = MagneticFieldModel::none;
+    const String* magnetic_field_name = root.string("magnetic_field");
+    if (magnetic_field_name != nullptr && equals(magnetic_field_name, "wmm"))
+    {
+        magnetic_field = MagneticFieldModel::world_magnetic_model;
+    }
+    else if (magnetic_field_name != nullptr && !equals(magnetic_field_name, "none"))
+    {
+        root.fail("magnetic_field", "must be \"none\" or \"wmm\"");
+    }
+
+    GravityModel gravity = GravityModel::none;
+    const String* gravity_name = root.string("gravity");
+    if (gravity_name != nullptr && equals(gravity_name, "egm"))
+    {
+        gravity = GravityModel::earth_gravitational_model;
+    }
+    else if (gravity_name != nullptr && !equals(gravity_name, "none"))
+    {
+        root.fail("gravity", "must be \"none\" or \"egm\"");
+    }
+
+    return *new (definition) Definition{bodies,
+                                        body_count,
+                                        joints,
+                                        joint_count,
+                                        forces,
+                                        force_count,
+                                        alpha,
+                                        beta,
+                                        read_integrator(root.find("integrator")),
+                                        magnetic_field,
+                                        gravity};
+}
+
+}
+
+const Definition& parse(Arena* arena, const String* text)
+{
+    if (text == nullptr)
+    {
+        throw std::invalid_argument("Scenario text must not be null");
+    }
+    const ScratchArena scratch = create_scratch_arena(parse_capacity);
+
+    return parse_text(arena, scratch.get(), text);
+}
+
+const Definition& load(Arena* arena, const char* path)
+{
+    const std::unique_ptr<FILE, int (*)(FILE*)> file(std::fopen(path, "rb"), &std::fclose);
+    long size = -1;
+    if (file && std::fseek(file.get(), 0, SEEK_END) == 0)
+    {
+        size = std::ftell(file.get());
+    }
+    if (size < 0 || std::fseek(file.get(), 0, SEEK_SET) != 0)
+    {
+        throw std::runtime_error(std::string("Cannot read scenario file ") + path);
+    }
+
+    // One scratch arena for both the text and its parse tree.
+    const ScratchArena scratch =
+        create_scratch_arena(sizeof(String) + (size_t)size + alignof(String) + parse_capacity);
+    String* text = arena_allocate_type(scratch.get(), String);
+    if (text == nullptr)
+    {
+        throw std::runtime_error("Scenario arena is out of memory");
+    }
+    text->text = arena_multi_allocate_type(scratch.get(), (size_t)size, char);
+    if (text->text == nullptr)
+    {
+        throw std::runtime_error("Scenario arena is out of memory");
+    }
+    text->size = (size_t)size;
+    if (text->size != 0 && std::fread(text->text, 1, text->size, file.get()) != text->size)
+    {
+        throw std::runtime_error(std::string("Cannot read scenario file ") + path);
+    }
+
+    return parse_text(arena, scratch.get(), text);
+}
+
+Dynamics::MultiRigidbody build_model(const Definition& definition)
+{
+    Dynamics::MultiRigidbody model;
+    model.bodies.reserve(definition.body_count);
+    model.joints.reserve(definition.joint_count);
+    model.forces.reserve(definition.force_count);
+    for (size_t i = 0; i < definition.body_count; i++)
+    {
+        const BodyDefinition& body = definition.bodies[i];
+        model.add_body(body.m_body, body.inertia_body_wrt_cm_in_body, body.r_body_wrt_0_in_0,
+                       body.sigma_0_to_body, body.v_body_wrt_0_in_0, body.sigma_dot_0_to_body);
+    }
+    for (size_t i = 0; i < definition.joint_count; i++)
+    {
+        const JointDefinition& joint = definition.joints[i];
+        model.add_revolute_joint(joint.body1_idx, joint.body2_idx, joint.r_joint_wrt_1_in_1,
+                                 joint.r_joint_wrt_2_in_2, joint.joint_direction_in_1,
+                                 joint.joint_direction_in_2);
+    }
+    for (size_t i = 0; i < definition.force_count; i++)
+    {
+        model.add_force(definition.forces[i]);
+    }
+    model.alpha = definition.alpha;
+    model.beta = definition.beta;
+    model.initialize();
+
+    return model;
+}
+
+void get_initial_state(const Definition& definition, double* full_state)
+{
+    double* state = full_state;
+    double* state_dot = full_state + 6 * definition.body_count;
+    for (size_t i = 0; i < definition.body_count; i++)
+    {
+        const BodyDefinition& body = definition.bodies[i];
+        for (size_t j = 0; j < 3; j++)
+        {
+            state[6 * i + j] = body.r_body_wrt_0_in_0[j];
+            state[6 * i + 3 + j] = body.sigma_0_to_body[j];
+            state_dot[6 * i + j] = body.v_body_wrt_0_in_0[j];
+            state_dot[6 * i + 3 + j] = body.sigma_dot_0_to_body[j];
+        }
+    }
+}
+
+}
@@ -0,0 +1,130 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+#include <cstddef>
+#include <stdexcept>
+
+#include "coordinates.h"
+#include "dynamics.h"
+#include "utils.h"
+
+namespace CamSim::Scenario {
+
+using Coordinate::Matrix3;
+using Coordinate::Vector3;
+
+// A body's mass properties and initial state, as for MultiRigidbody::add_body.
+struct BodyDefinition
+{
+    double m_body;
+    Matrix3 inertia_body_wrt_cm_in_body;
+    Vector3 r_body_wrt_0_in_0;
+    Vector3 sigma_0_to_body;
+    Vector3 v_body_wrt_0_in_0;
+    Vector3 sigma_dot_0_to_body;
+};
+
+// A revolute joint, as for MultiRigidbody::add_revolute_joint.
+struct JointDefinition
+{
+    size_t body1_idx;
+    size_t body2_idx;
+    Vector3 r_joint_wrt_1_in_1;
+    Vector3 r_joint_wrt_2_in_2;
+    Vector3 joint_direction_in_1;
+    Vector3 joint_direction_in_2;
+};
+
+enum class IntegratorMethod
+{
+    rk4,
+    dormand_prince_54,
+    velocity_verlet,
+};
+
+struct IntegratorSettings
+{
+    IntegratorMethod method;
+    // The fixed step, or for Dormand-Prince the first step to try, 0 to let it pick one.
+    double step_size;
+    double duration;
+    // Dormand-Prince only.
+    double absolute_tolerance;
+    double relative_tolerance;
+};
+
+enum class MagneticFieldModel
+{
+    none,
+    world_magnetic_model,
+};
+
+enum class GravityModel
+{
+    none,
+    earth_gravitational_model,
+};
+
+// Everything a run needs to build its simulation, read once from a JSON file like
+//
+//     {
+//         "bodies": [{"mass": 2.0, "inertia": [[2.0, 0.0, 0.0], [0.0, 3.0, 0.0], [0.0, 0.0, 4.0]],
+//                     "position": [0.0, 0.0, 0.0], "attitude": [0.0, 0.0, 0.0],
+//                     "velocity": [0.0, 0.0, 0.0], "attitude_rate": [0.0, 0.0, 0.0]}],
+//         "joints": [{"type": "revolute", "body1": 0, "body2": 1,
+//                     "position_in_1": [0.5, 0.0, 0.0], "position_in_2": [-0.5, 0.0, 0.0],
+//                     "direction_in_1": [0.0, 0.0, 1.0], "direction_in_2": [0.0, 0.0, 1.0]}],
+//         "forces": [{"body": 0, "force_in_0": [0.0, 0.0, -9.8], "force_in_body": [0.0, 0.0, 0.0],
+//                     "application_point_in_body": [0.0, 0.0, 0.0],
+//                     "torque_in_body": [0.0, 0.0, 0.0]}],
+//         "baumgarte": {"alpha": 10.0, "beta": 10.0},
+//         "integrator": {"method": "rk4", "step_size": 0.01, "duration": 60.0},
+//         "magnetic_field": "wmm",
+//         "gravity": "none"
+//     }
+//
+// where attitudes are MRPs, every vector but a body's mass and inertia defaults to zero (joint
+// directions to z), joints and forces may be left out, and the methods are "rk4",
+// "dormand_prince_54" with "absolute_tolerance" and "relative_tolerance", or "velocity_verlet".
+// The models are "none", "wmm" and "egm".  The arrays are sized from the parsed counts and live in
+// the arena passed to parse, so a sweep parses once and builds every run's model from here.
+struct Definition
+{
+    const BodyDefinition* bodies;
+    size_t body_count;
+    const JointDefinition* joints;
+    size_t joint_count;
+    const Dynamics::ForceGenerator* forces;
+    size_t force_count;
+    double alpha;
+    double beta;
+    IntegratorSettings integrator;
+    MagneticFieldModel magnetic_field;
+    GravityModel gravity;
+
+    // Size of the full state [x, x_dot] of the model, 12 per body.
+    size_t get_full_state_size() const
+    {
+        return 12 * body_count;
+    }
+};
+
+// Parses a scenario from JSON text, allocating the definition and its arrays in arena.  The parse
+// tree lives in a scratch arena freed before returning.  Throws std::invalid_argument naming the
+// offending field if the text is not a valid scenario and std::runtime_error if an arena is out
+// of memory.
+const Definition& parse(Arena* arena, const String* text);
+
+// Reads and parses the scenario file at path.  Throws std::runtime_error if it cannot be read,
+// otherwise as parse.
+const Definition& load(Arena* arena, const char* path);
+
+// An initialized model of the scenario, with every buffer it evaluates with sized.  Throws
+// std::invalid_argument if a body or joint is invalid.
+Dynamics::MultiRigidbody build_model(const Definition& definition);
+
+// Writes the initial full state [x, x_dot], for restarting a model without rebuilding it.
+void get_initial_state(const Definition& definition, double* full_state);
+
+}
+
+#endif
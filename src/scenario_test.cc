@@ -0,0 +1,174 @@
+#include "scenario.h"
+
+#include <cstdio>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace CamSim::Scenario {
+
+// The three body chain from dynamics_test.cc.
+constexpr const char* chain_json = R"({
+    "bodies": [
+        {"mass": 2.0, "inertia": [[2.0, 0.1, 0.0], [0.1, 3.0, 0.2], [0.0, 0.2, 4.0]],
+         "position": [0, 0, 0], "attitude": [0.1, -0.2, 0.05],
+         "velocity": [0.1, 0.2, -0.3], "attitude_rate": [0.01, 0.02, -0.03]},
+        {"mass": 1.5, "inertia": [[1.0, 0.0, 0.0], [0.0, 1.5, 0.0], [0.0, 0.0, 0.5]],
+         "position": [1.1, 0.05, -0.02], "attitude": [-0.05, 0.1, 0.2],
+         "velocity": [0.0, -0.1, 0.2], "attitude_rate": [-0.02, 0.04, 0.01]},
+        {"mass": 0.7, "inertia": [[0.3, 0, 0], [0, 0.4, 0], [0, 0, 0.5]],
+         "position": [2.0, 0.1, 0.1], "attitude": [0.3, 0.0, -0.1],
+         "velocity": [0.05, 0.05, 0.05], "attitude_rate": [0.0, -0.01, 0.02]}
+    ],
+    "joints": [
+        {"type": "revolute", "body1": 0, "body2": 1,
+         "position_in_1": [0.5, 0.0, 0.0], "position_in_2": [-0.5, 0.0, 0.0]},
+        {"body1": 1, "body2": 2, "position_in_1": [0.5, 0.0, 0.0], "position_in_2": [-0.4, 0, 0],
+         "direction_in_1": [0.0, 1.0, 0.0], "direction_in_2": [0.0, 1.0, 0.0]}
+    ],
+    "forces": [
+        {"body": 0, "force_in_0": [0.0, 0.0, -9.8]},
+        {"body": 2, "force_in_0": [0.1, 0.0, 0.0], "force_in_body": [0.0, 0.5, 0.0],
+         "application_point_in_body": [0.2, 0.0, 0.1], "torque_in_body": [0.0, 0.0, 0.3]}
+    ],
+    "baumgarte": {"alpha": 5.0},
+    "integrator": {"method": "dormand_prince_54", "duration": 10, "relative_tolerance": 1e-8},
+    "magnetic_field": "wmm"
+})";
+
+class ScenarioTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        arena = arena_create(1 << 16);
+        ASSERT_NE(arena, nullptr);
+    }
+
+    void TearDown() override
+    {
+        arena_free(arena);
+    }
+
+    const Definition& parse_text(const std::string& text)
+    {
+        const String string{const_cast<char*>(text.data()), text.size()};
+        return parse(arena, &string);
+    }
+
+    Arena* arena = nullptr;
+};
+
+TEST_F(ScenarioTest, builds_the_model_it_describes)
+{
+    const Definition& definition = parse_text(chain_json);
+    ASSERT_EQ(definition.body_count, 3u);
+    ASSERT_EQ(definition.joint_count, 2u);
+    ASSERT_EQ(definition.force_count, 2u);
+    EXPECT_EQ(definition.bodies[1].inertia_body_wrt_cm_in_body(1, 1), 1.5);
+    EXPECT_EQ(definition.joints[0].joint_direction_in_2[2], 1.0);
+    EXPECT_EQ(definition.forces[1].r_f_wrt_body_in_body[2], 0.1);
+    EXPECT_EQ(definition.alpha, 5.0);
+    EXPECT_EQ(definition.beta, 10.0);
+    EXPECT_EQ(definition.integrator.method, IntegratorMethod::dormand_prince_54);
+    EXPECT_EQ(definition.integrator.step_size, 0.0);
+    EXPECT_EQ(definition.integrator.duration, 10.0);
+    EXPECT_EQ(definition.integrator.absolute_tolerance, 1e-9);
+    EXPECT_EQ(definition.integrator.relative_tolerance, 1e-8);
+    EXPECT_EQ(definition.magnetic_field, MagneticFieldModel::world_magnetic_model);
+    EXPECT_EQ(definition.gravity, GravityModel::none);
+
+    // The same chain built by hand.
+    Dynamics::MultiRigidbody expected;
+    for (size_t i = 0; i < definition.body_count; i++)
+    {
+        const BodyDefinition& body = definition.bodies[i];
+        expected.add_body(body.m_body, body.inertia_body_wrt_cm_in_body, body.r_body_wrt_0_in_0,
+                          body.sigma_0_to_body, body.v_body_wrt_0_in_0, body.sigma_dot_0_to_body);
+    }
+    expected.add_revolute_joint(0, 1, Vector3{0.5, 0.0, 0.0}, Vector3{-0.5, 0.0, 0.0});
+    expected.add_revolute_joint(1, 2, Vector3{0.5, 0.0, 0.0}, Vector3{-0.4, 0.0, 0.0},
+                                Vector3{0.0, 1.0, 0.0}, Vector3{0.0, 1.0, 0.0});
+    expected.add_force(Dynamics::ForceGenerator{0, Vector3{0.0, 0.0, -9.8}, Vector3{}, Vector3{},
+                                                Vector3{}});
+    expected.add_force(Dynamics::ForceGenerator{2, Vector3{0.1, 0.0, 0.0},
+                                                Vector3{0.0, 0.5, 0.0}, Vector3{0.2, 0.0, 0.1},
+                                                Vector3{0.0, 0.0, 0.3}});
+    expected.alpha = 5.0;
+    expected.initialize();
+
+    Dynamics::MultiRigidbody model = build_model(definition);
+    ASSERT_TRUE(model.is_initialized());
+    std::vector<double> full_state(definition.get_full_state_size());
+    get_initial_state(definition, full_state.data());
+    std::vector<double> derivative(full_state.size());
+    std::vector<double> expected_derivative(full_state.size());
+    model.get_derivative(full_state.data(), derivative.data());
+    expected.get_derivative(full_state.data(), expected_derivative.data());
+    for (size_t i = 0; i < full_state.size(); i++)
+    {
+        EXPECT_EQ(derivative[i], expected_derivative[i]) << i;
+    }
+    EXPECT_EQ(full_state[3], 0.1);
+    EXPECT_EQ(full_state[18 + 17], 0.02);
+}
+
+TEST_F(ScenarioTest, loads_files)
+{
+    const std::string path = ::testing::TempDir() + "scenario_test_chain.json";
+    FILE* file = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    std::fputs(chain_json, file);
+    std::fclose(file);
+
+    const Definition& definition = load(arena, path.c_str());
+    EXPECT_EQ(definition.body_count, 3u);
+    EXPECT_EQ(definition.bodies[2].m_body, 0.7);
+    std::remove(path.c_str());
+
+    EXPECT_THROW(load(arena, path.c_str()), std::runtime_error);
+}
+
+TEST_F(ScenarioTest, invalid_scenarios_throw)
+{
+    const std::string body = R"({"mass": 1.0, "inertia": [[1, 0, 0], [0, 1, 0], [0, 0, 1]]})";
+    const std::string integrator = R"("integrator": {"step_size": 0.1, "duration": 1.0})";
+    EXPECT_NO_THROW(parse_text("{\"bodies\": [" + body + "], " + integrator + "}"));
+
+    for (const std::string& text : {
+             std::string("{\"bodies\": [" + body),
+             std::string("{\"bodies\": [], " + integrator + "}"),
+             std::string("{\"bodies\": [" + body + "]}"),
+             std::string(R"({"bodies": [{"mass": 1.0}], )" + integrator + "}"),
+             std::string(R"({"bodies": [{"mass": "heavy", "inertia": [[1, 0, 0], [0, 1, 0], )"
+                         R"([0, 0, 1]]}], )" +
+                         integrator + "}"),
+             std::string("{\"bodies\": [" + body +
+                         "], \"joints\": [{\"body1\": 0, \"body2\": 1}], " + integrator + "}"),
+             std::string("{\"bodies\": [" + body + "], \"forces\": [{\"body\": -1}], " +
+                         integrator + "}"),
+             std::string("{\"bodies\": [" + body + R"(], "integrator": {"duration": 1.0}})"),
+             std::string("{\"bodies\": [" + body + R"(], "integrator": {"method": "euler", )"
+                         R"("step_size": 0.1, "duration": 1.0}})"),
+             std::string("{\"bodies\": [" + body + "], \"magnetic_field\": \"igrf\", " +
+                         integrator + "}"),
+         })
+    {
+        EXPECT_THROW(parse_text(text), std::invalid_argument) << text;
+    }
+
+    // Out of arena.
+    Arena* small_arena = arena_create(64);
+    const String text{const_cast<char*>(chain_json), std::strlen(chain_json)};
+    EXPECT_THROW(parse(small_arena, &text), std::runtime_error);
+    arena_free(small_arena);
+
+    // Valid syntax, invalid body.
+    const Definition& massless = parse_text(
+        R"({"bodies": [{"mass": 0, "inertia": [[1, 0, 0], [0, 1, 0], [0, 0, 1]]}], )" + integrator +
+        "}");
+    EXPECT_THROW(build_model(massless), std::invalid_argument);
+}
+
+}
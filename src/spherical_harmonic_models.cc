@@ -1,9 +1,75 @@
 #include "spherical_harmonic_models.h"
 
-#include <iomanip>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <sstream>
 
 namespace CamSim::Model {
 
+namespace {
+
+// Parses a header line, whose name must start with a letter so that a line of coefficients is not
+// taken for one.
+bool parse_coefficient_header(const std::string& line, CoefficientFileHeader& header)
+{
+    std::istringstream stream(line);
+    return (stream >> header.epoch >> header.name >> header.release_date) &&
+           std::isalpha((unsigned char)header.name[0]);
+}
+
+void check_order(const int order, const size_t coefficient_count)
+{
+    if (order < 0 || order >= (int)coefficient_count)
+    {
+        throw std::invalid_argument("Order " + std::to_string(order) + " is not in the model");
+    }
+}
+
+// The tables an evaluation fills, kept per thread so that const models evaluate from any thread
+// without allocating or recomputing the Legendre normalization after the first call.
+template <typename Scalar>
+struct Workspace
+{
+    Math::BasicSinCosTable<Scalar> longitude_table{0};
+    Math::BasicSemiNormalizedLegendreTable<Scalar> legendre_table{0};
+};
+
+// The calling thread's workspace, grown to order if it is smaller.
+template <typename Scalar>
+Workspace<Scalar>& get_workspace(const int order)
+{
+    thread_local Workspace<Scalar> workspace;
+    if (workspace.longitude_table.get_max_m() < order)
+    {
+        workspace.longitude_table = Math::BasicSinCosTable<Scalar>(order);
+        // dP_l^m / dphi needs P_(l+1)^m.
+        workspace.legendre_table = Math::BasicSemiNormalizedLegendreTable<Scalar>(order + 1);
+    }
+
+    return workspace;
+}
+
+}
+
+CoefficientFileHeader read_coefficient_header(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Could not open coefficients file at '" + path + "'");
+    }
+
+    std::string line;
+    CoefficientFileHeader header;
+    if (!std::getline(file, line) || !parse_coefficient_header(line, header))
+    {
+        throw std::runtime_error("Coefficients file at '" + path + "' has no header");
+    }
+
+    return header;
+}
+
 void SphericalHarmonicModel::load_coefficients(const std::string& path)
 {
     std::ifstream file(path);
@@ -12,24 +78,51 @@ void SphericalHarmonicModel::load_coefficients(const std::string& path)
         throw std::runtime_error("Could not open coefficients file at '" + path + "'");
     }
 
-    int l, m;
-    double g, h, g_dot, h_dot;
-    while (file >> l >> m >> g >> h >> g_dot >> h_dot)
+    // Lines that are not coefficients, such as the header and the trailing rows of nines, are
+    // skipped.
+    std::string line;
+    while (std::getline(file, line))
     {
+        std::istringstream stream(line);
+        int l, m;
+        double g, h, g_dot, h_dot;
+        if (!(stream >> l >> m >> g >> h >> g_dot >> h_dot))
+        {
+            continue;
+        }
+        if (l < 0 || (size_t)l >= coefficients.size())
+        {
+            throw std::runtime_error("Coefficients file at '" + path + "' has degree " +
+                                     std::to_string(l) + " above the model's");
+        }
         coefficients[l].push_back(SphericalHarmonicCoefficients{
             .l = l, .m = m, .g = g, .h = h, .g_dot = g_dot, .h_dot = h_dot});
     }
-}
 
-WorldMagneticModel::WorldMagneticModel()
-{
-    coefficients.resize(max_order + 1);
-    load_coefficients();
+    // Evaluation indexes coefficients[l][m] for every order of every degree up to the model's.
+    for (size_t l = 1; l < coefficients.size(); l++)
+    {
+        bool complete = coefficients[l].size() == l + 1;
+        for (size_t m = 0; complete && m <= l; m++)
+        {
+            complete = coefficients[l][m].m == (int)m;
+        }
+        if (!complete)
+        {
+            throw std::runtime_error("Coefficients file at '" + path +
+                                     "' does not have orders 0 to " + std::to_string(l) +
+                                     " of degree " + std::to_string(l) + " in order");
+        }
+    }
 }
 
-void WorldMagneticModel::load_coefficients()
+WorldMagneticModel::WorldMagneticModel(const std::string& path)
 {
-    SphericalHarmonicModel::load_coefficients("/home/cwolfe/sb/projects/sim/coeffs/WMM.COF");
+    const CoefficientFileHeader header = read_coefficient_header(path);
+    epoch = header.epoch;
+    name = header.name;
+    coefficients.resize(max_order + 1);
+    SphericalHarmonicModel::load_coefficients(path);
 }
 
 double WorldMagneticModel::get_potential(
@@ -39,8 +132,13 @@ double WorldMagneticModel::get_potential(
     const Time::Timestamp timestamp,
     const int order) const
 {
+    check_order(order, coefficients.size());
+
     double potential = 0.0;
     const double decimal_year = timestamp.get_decimal_year();
+    Math::SinCosTable& longitude_table = get_workspace<double>(order).longitude_table;
+    longitude_table.compute(theta, order);
+    const double sin_phi = std::sin(phi);
 
     for (int l = 1; l <= order; l++)
     {
@@ -51,9 +149,8 @@ double WorldMagneticModel::get_potential(
             const double g = coeffs.get_g(decimal_year, epoch);
             const double h = coeffs.get_h(decimal_year, epoch);
 
-            std::cout << "g: " << g << ", h: " << h << std::endl;
-            inner += (g * std::cos((double)m * theta) + h * std::sin((double)m * theta)) *
-                     Math::semi_normalized_legendre(l, m, std::sin(phi));
+            inner += (g * longitude_table.get_cos(m) + h * longitude_table.get_sin(m)) *
+                     Math::semi_normalized_legendre(l, m, sin_phi);
         }
         potential += std::pow(geomagnetic_radius / radius, (double)(l + 1)) * inner;
     }
@@ -68,24 +165,25 @@ double WorldMagneticModel::get_x_prime(
     const Time::Timestamp timestamp,
     const int order) const
 {
+    check_order(order, coefficients.size());
+
     double x_prime = 0.0;
     const double decimal_year = timestamp.get_decimal_year();
+    Math::SinCosTable& longitude_table = get_workspace<double>(order).longitude_table;
+    longitude_table.compute(theta, order);
 
     for (int l = 1; l <= order; l++)
     {
         double inner = 0.0;
         for (int m = 0; m <= l; m++)
         {
-            std::cout << l << ", " << m << ": " << std::endl;
             const SphericalHarmonicCoefficients& coeffs = coefficients[l][m];
             const double g = coeffs.get_g(decimal_year, epoch);
             const double h = coeffs.get_h(decimal_year, epoch);
-            std::cout << "(l, m) = (" << l << ", " << m << "), g = " << std::setprecision(20) << g
-                      << ", h = " << h << std::endl;
-            inner += (g * std::cos((double)m * theta) + h * std::sin((double)m * theta)) *
+            inner += (g * longitude_table.get_cos(m) + h * longitude_table.get_sin(m)) *
                      Math::semi_normalized_legendre_sin_deriv(l, m, phi);
         }
-        x_prime += std::pow(geomagnetic_radius / radius, (double)(l + 2));
+        x_prime += std::pow(geomagnetic_radius / radius, (double)(l + 2)) * inner;
     }
 
     return -x_prime;
@@ -98,23 +196,27 @@ double WorldMagneticModel::get_y_prime(
     const Time::Timestamp timestamp,
     const int order) const
 {
+    check_order(order, coefficients.size());
+
     double y_prime = 0.0;
     const double decimal_year = timestamp.get_decimal_year();
+    Math::SinCosTable& longitude_table = get_workspace<double>(order).longitude_table;
+    longitude_table.compute(theta, order);
+    const double sin_phi = std::sin(phi);
 
     for (int l = 1; l <= order; l++)
     {
         double inner = 0.0;
         for (int m = 0; m <= l; m++)
         {
-            std::cout << l << ", " << m << ": " << std::endl;
             const SphericalHarmonicCoefficients& coeffs = coefficients[l][m];
             const double g = coeffs.get_g(decimal_year, epoch);
             const double h = coeffs.get_h(decimal_year, epoch);
             inner += (double)m *
-                     (g * std::sin((double)m * theta) - h * std::cos((double)m * theta)) *
-                     Math::semi_normalized_legendre(l, m, std::sin(phi));
+                     (g * longitude_table.get_sin(m) - h * longitude_table.get_cos(m)) *
+                     Math::semi_normalized_legendre(l, m, sin_phi);
         }
-        y_prime += std::pow(geomagnetic_radius / radius, (double)(l + 2));
+        y_prime += std::pow(geomagnetic_radius / radius, (double)(l + 2)) * inner;
     }
 
     return y_prime / std::cos(phi);
@@ -127,25 +229,292 @@ double WorldMagneticModel::get_z_prime(
     const Time::Timestamp timestamp,
     const int order) const
 {
+    check_order(order, coefficients.size());
+
     double z_prime = 0.0;
     const double decimal_year = timestamp.get_decimal_year();
+    Math::SinCosTable& longitude_table = get_workspace<double>(order).longitude_table;
+    longitude_table.compute(theta, order);
+    const double sin_phi = std::sin(phi);
 
     for (int l = 1; l <= order; l++)
     {
         double inner = 0.0;
         for (int m = 0; m <= l; m++)
         {
-            std::cout << l << ", " << m << ": " << std::endl;
             const SphericalHarmonicCoefficients& coeffs = coefficients[l][m];
             const double g = coeffs.get_g(decimal_year, epoch);
             const double h = coeffs.get_h(decimal_year, epoch);
-            inner += (g * std::cos((double)m * theta) + h * std::sin((double)m * theta)) *
-                     Math::semi_normalized_legendre(l, m, std::sin(phi));
+            inner += (g * longitude_table.get_cos(m) + h * longitude_table.get_sin(m)) *
+                     Math::semi_normalized_legendre(l, m, sin_phi);
         }
-        z_prime += (double)(l + 1) * std::pow(geomagnetic_radius / radius, (double)(l + 2));
+        z_prime += (double)(l + 1) * std::pow(geomagnetic_radius / radius, (double)(l + 2)) * inner;
     }
 
     return -z_prime;
 }
 
+void WorldMagneticModel::get_field(
+    const double theta,
+    const double phi,
+    const double radius,
+    const Time::Timestamp timestamp,
+    const int order,
+    MagneticField& field,
+    const bool with_rate,
+    const bool with_gradient) const
+{
+    evaluate_field(theta, phi, radius, timestamp.get_decimal_year(), order, field, with_rate,
+                   with_gradient);
+}
+
+template <typename Scalar>
+void WorldMagneticModel::evaluate_field(
+    const Scalar& theta,
+    const Scalar& phi,
+    const Scalar& radius,
+    const Scalar& decimal_year,
+    const int order,
+    BasicMagneticField<Scalar>& field,
+    const bool with_rate,
+    const bool with_gradient) const
+{
+    using std::cos;
+    using std::sin;
+
+    check_order(order, coefficients.size());
+
+    field = BasicMagneticField<Scalar>{};
+    const Scalar years = decimal_year - epoch;
+    Workspace<Scalar>& workspace = get_workspace<Scalar>(order);
+    const Math::BasicSinCosTable<Scalar>& longitude_table = workspace.longitude_table;
+    const Math::BasicSemiNormalizedLegendreTable<Scalar>& legendre_table =
+        workspace.legendre_table;
+    workspace.longitude_table.compute(theta, order);
+    const Scalar sin_phi = sin(phi);
+    const Scalar cos_phi = cos(phi);
+    const Scalar tan_phi = sin_phi / cos_phi;
+    workspace.legendre_table.compute(sin_phi, order + 1);
+
+    // With A = g cos(m theta) + h sin(m theta) and B = g sin(m theta) - h cos(m theta), per degree
+    //     x' = -s sum A dP,  y' = s sum m B P / cos(phi),  z' = -(l + 1) s sum A P
+    // where s = (a / r)^(l + 2).  Rates replace g and h by their rates, dA/dtheta = -m B and
+    // dB/dtheta = m A, and ds/dr = -(l + 2) s / r.
+    Scalar x_sum = 0.0, y_sum = 0.0, z_sum = 0.0;
+    Scalar x_rate_sum = 0.0, y_rate_sum = 0.0, z_rate_sum = 0.0;
+    Scalar x_radius_sum = 0.0, y_radius_sum = 0.0, z_radius_sum = 0.0;
+    Scalar x_theta_sum = 0.0, y_theta_sum = 0.0, z_theta_sum = 0.0;
+    Scalar x_phi_sum = 0.0, y_phi_sum = 0.0, z_phi_sum = 0.0;
+    const Scalar radius_ratio = geomagnetic_radius / radius;
+    Scalar scale = radius_ratio * radius_ratio;
+    for (int l = 1; l <= order; l++)
+    {
+        Scalar a_dp = 0.0, m_b_p = 0.0, a_p = 0.0;
+        Scalar a_rate_dp = 0.0, m_b_rate_p = 0.0, a_rate_p = 0.0;
+        Scalar m_b_dp = 0.0, m2_a_p = 0.0, a_d2p = 0.0;
+        for (int m = 0; m <= l; m++)
+        {
+            const SphericalHarmonicCoefficients& coeffs = coefficients[l][m];
+            const Scalar g = coeffs.g + coeffs.g_dot * years;
+            const Scalar h = coeffs.h + coeffs.h_dot * years;
+            const Scalar& cos_m = longitude_table.get_cos(m);
+            const Scalar& sin_m = longitude_table.get_sin(m);
+            const Scalar a = g * cos_m + h * sin_m;
+            const Scalar b = g * sin_m - h * cos_m;
+
+            const Scalar& p = legendre_table.get(l, m);
+            const Scalar dp = ((l + 1) * sin_phi * p -
+                               std::sqrt((double)((l + 1) * (l + 1) - m * m)) *
+                                   legendre_table.get(l + 1, m)) /
+                              cos_phi;
+            a_dp += a * dp;
+            m_b_p += m * b * p;
+            a_p += a * p;
+
+            if (with_rate)
+            {
+                const Scalar a_rate = coeffs.g_dot * cos_m + coeffs.h_dot * sin_m;
+                const Scalar b_rate = coeffs.g_dot * sin_m - coeffs.h_dot * cos_m;
+                a_rate_dp += a_rate * dp;
+                m_b_rate_p += m * b_rate * p;
+                a_rate_p += a_rate * p;
+            }
+            if (with_gradient)
+            {
+                // Legendre's equation in latitude.
+                const Scalar d2p =
+                    tan_phi * dp - (l * (l + 1) - m * m / (cos_phi * cos_phi)) * p;
+                m_b_dp += m * b * dp;
+                m2_a_p += m * m * a * p;
+                a_d2p += a * d2p;
+            }
+        }
+
+        scale *= radius_ratio;
+        x_sum -= scale * a_dp;
+        y_sum += scale * m_b_p;
+        z_sum -= (l + 1) * scale * a_p;
+        if (with_rate)
+        {
+            x_rate_sum -= scale * a_rate_dp;
+            y_rate_sum += scale * m_b_rate_p;
+            z_rate_sum -= (l + 1) * scale * a_rate_p;
+        }
+        if (with_gradient)
+        {
+            x_radius_sum += (l + 2) * scale * a_dp;
+            y_radius_sum -= (l + 2) * scale * m_b_p;
+            z_radius_sum += (l + 1) * (l + 2) * scale * a_p;
+            x_theta_sum += scale * m_b_dp;
+            y_theta_sum += scale * m2_a_p;
+            z_theta_sum += (l + 1) * scale * m_b_p;
+            x_phi_sum -= scale * a_d2p;
+            y_phi_sum += scale * m_b_dp;
+            z_phi_sum -= (l + 1) * scale * a_dp;
+        }
+    }
+
+    field.field[0] = x_sum;
+    field.field[1] = y_sum / cos_phi;
+    field.field[2] = z_sum;
+    if (with_rate)
+    {
+        field.rate[0] = x_rate_sum;
+        field.rate[1] = y_rate_sum / cos_phi;
+        field.rate[2] = z_rate_sum;
+    }
+    if (with_gradient)
+    {
+        field.gradient[0][0] = x_radius_sum / radius;
+        field.gradient[1][0] = y_radius_sum / (radius * cos_phi);
+        field.gradient[2][0] = z_radius_sum / radius;
+        field.gradient[0][1] = x_theta_sum;
+        field.gradient[1][1] = y_theta_sum / cos_phi;
+        field.gradient[2][1] = z_theta_sum;
+        field.gradient[0][2] = x_phi_sum;
+        // d/dphi of 1 / cos(phi) is tan(phi) / cos(phi).
+        field.gradient[1][2] = (y_phi_sum + tan_phi * y_sum) / cos_phi;
+        field.gradient[2][2] = z_phi_sum;
+    }
+}
+
+template void WorldMagneticModel::evaluate_field(
+    const Coordinate::Lanes<4>& theta,
+    const Coordinate::Lanes<4>& phi,
+    const Coordinate::Lanes<4>& radius,
+    const Coordinate::Lanes<4>& decimal_year,
+    const int order,
+    BasicMagneticField<Coordinate::Lanes<4>>& field,
+    const bool with_rate,
+    const bool with_gradient) const;
+
+template void WorldMagneticModel::evaluate_field(
+    const Coordinate::Lanes<8>& theta,
+    const Coordinate::Lanes<8>& phi,
+    const Coordinate::Lanes<8>& radius,
+    const Coordinate::Lanes<8>& decimal_year,
+    const int order,
+    BasicMagneticField<Coordinate::Lanes<8>>& field,
+    const bool with_rate,
+    const bool with_gradient) const;
+
+MagneticFieldTrajectory::MagneticFieldTrajectory(
+    const WorldMagneticModel& model,
+    const Position& position,
+    const Time::Timestamp& start,
+    const double duration,
+    const int order,
+    const Math::ChebyshevOptions& options)
+    : fit(
+          [&](const double t, double* field)
+          {
+              double theta, phi, radius;
+              position(t, theta, phi, radius);
+              MagneticField value;
+              model.get_field(theta, phi, radius, start + Time::Duration::from_seconds(t), order,
+                              value);
+              std::copy(value.field, value.field + 3, field);
+          },
+          3,
+          0.0,
+          duration,
+          options)
+{
+}
+
+WorldMagneticModelRegistry::WorldMagneticModelRegistry(
+    const std::string& directory, const double validity_years)
+    : validity_years(validity_years)
+{
+    std::error_code error;
+    std::filesystem::directory_iterator entries(directory, error);
+    if (error)
+    {
+        throw std::runtime_error("Could not read coefficients directory '" + directory +
+                                 "': " + error.message());
+    }
+
+    for (const std::filesystem::directory_entry& entry : entries)
+    {
+        if (!entry.is_regular_file() || entry.path().extension() != ".COF")
+        {
+            continue;
+        }
+        std::ifstream file(entry.path());
+        std::string line;
+        CoefficientFileHeader header;
+        // Other models' coefficient files, including the high resolution WMMHR, share the
+        // directory.
+        if (std::getline(file, line) && parse_coefficient_header(line, header) &&
+            header.name.compare(0, 4, "WMM-") == 0)
+        {
+            add(entry.path().string());
+        }
+    }
+}
+
+void WorldMagneticModelRegistry::add(const std::string& path)
+{
+    auto release = std::make_unique<Release>();
+    release->header = read_coefficient_header(path);
+    release->path = path;
+
+    const auto position = std::lower_bound(
+        releases.begin(), releases.end(), release->header.epoch,
+        [](const std::unique_ptr<Release>& other, const double epoch)
+        { return other->header.epoch < epoch; });
+    if (position != releases.end() && (*position)->header.epoch == release->header.epoch)
+    {
+        throw std::invalid_argument("Coefficients file at '" + path + "' has the same epoch as '" +
+                                    (*position)->path + "'");
+    }
+    releases.insert(position, std::move(release));
+}
+
+const WorldMagneticModel& WorldMagneticModelRegistry::select(
+    const Time::Timestamp& timestamp) const
+{
+    const double decimal_year = timestamp.get_decimal_year();
+    const auto after = std::upper_bound(
+        releases.begin(), releases.end(), decimal_year,
+        [](const double year, const std::unique_ptr<Release>& release)
+        { return year < release->header.epoch; });
+    if (after == releases.begin() ||
+        decimal_year >= (*(after - 1))->header.epoch + validity_years)
+    {
+        throw std::out_of_range("No World Magnetic Model release is valid in " +
+                                std::to_string(decimal_year));
+    }
+
+    Release& release = **(after - 1);
+    std::call_once(release.load_once,
+                   [&release]()
+                   {
+                       release.model = std::make_unique<WorldMagneticModel>(release.path);
+                       release.model_loaded.store(true, std::memory_order_release);
+                   });
+
+    return *release.model;
+}
+
 }
@@ -1,16 +1,21 @@
 #ifndef SPHERICAL_HARMONIC_MODELS_H
 #define SPHERICAL_HARMONIC_MODELS_H
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
 #include <fstream>
+#include <functional>
 #include <gsl/gsl_sf_legendre.h>
 #include <gsl/gsl_vector.h>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <stdio.h>
 #include <string>
 #include <vector>
 
+#include "coordinates.h"
 #include "math.h"
 #include "time.h"
 
@@ -38,19 +43,31 @@ struct SphericalHarmonicCoefficients
 
     double get_g(const double decimal_year, const double decimal_year_epoch) const
     {
-        std::cout << "g: " << g << " " << g_dot << " " << decimal_year << " " << decimal_year_epoch
-                  << std::endl;
         return g + g_dot * (decimal_year - decimal_year_epoch);
     }
 
     double get_h(const double decimal_year, const double decimal_year_epoch) const
     {
-        std::cout << "h: " << h << " " << h_dot << " " << decimal_year << " " << decimal_year_epoch
-                  << std::endl;
         return h + h_dot * (decimal_year - decimal_year_epoch);
     }
 };
 
+// The first line of a coefficient file as NOAA distributes it, e.g.
+//
+//         2025.0            WMM-2025        11/13/2024
+//
+// giving the epoch, in decimal years, that the coefficients are propagated from.
+struct CoefficientFileHeader
+{
+    double epoch;
+    std::string name;
+    std::string release_date;
+};
+
+// Reads the header of the coefficient file at path.  Throws std::runtime_error if the file cannot
+// be opened or does not start with a header line.
+CoefficientFileHeader read_coefficient_header(const std::string& path);
+
 class SphericalHarmonicModel
 {
 protected:
@@ -64,10 +81,43 @@ protected:
     double geomagnetic_radius = 6371200.0;
 };
 
+// The field at a point as WorldMagneticModel::get_field gives it, in nT.  Coordinates are the
+// model's: radius in m, longitude theta and latitude phi in radians.  Scalar is double for one
+// point or Coordinate::Lanes<N> for N points.
+template <typename Scalar>
+struct BasicMagneticField
+{
+    // x', y' and z'.
+    Scalar field[3];
+    // Their secular variation, in nT per year.
+    Scalar rate[3];
+    // gradient[i][0], gradient[i][1] and gradient[i][2] are the derivatives of field[i] by radius,
+    // theta and phi.
+    Scalar gradient[3][3];
+};
+
+using MagneticField = BasicMagneticField<double>;
+
 class WorldMagneticModel : public SphericalHarmonicModel
 {
 public:
-    WorldMagneticModel();
+    // Loads the coefficient file at path, taking the epoch from its header.  Throws
+    // std::runtime_error if the file cannot be read, has no header, has a degree above 12 or does
+    // not have orders 0 to l of each degree l from 1 to 12 in order.
+    explicit WorldMagneticModel(const std::string& path);
+
+    double get_epoch() const
+    {
+        return epoch;
+    }
+
+    const std::string& get_name() const
+    {
+        return name;
+    }
+
+    // The potential and x', y' and z' one at a time, each walking the coefficients.  Throw
+    // std::invalid_argument for an order above the model's.
     double get_potential(
         const double theta,
         const double phi,
@@ -96,11 +146,146 @@ public:
         const Time::Timestamp timestamp,
         const int order) const;
 
+    // x', y' and z' in one pass that computes the Legendre functions and longitude terms once,
+    // and from the same terms their secular variation if with_rate and their gradient if
+    // with_gradient.  Parts not asked for are zero.  The derivatives by phi, like y', are singular
+    // at the poles.  Throws std::invalid_argument for an order above the model's.
+    void get_field(
+        const double theta,
+        const double phi,
+        const double radius,
+        const Time::Timestamp timestamp,
+        const int order,
+        MagneticField& field,
+        const bool with_rate = false,
+        const bool with_gradient = false) const;
+
+    // get_field for LaneCount points at once, lane l of each argument and of field belonging to
+    // point l, such as one body's position in every scenario of a Dynamics::LockstepMultiRigidbody.
+    // Times are decimal years, as Time::Timestamp::get_decimal_year gives them.  Every lane is
+    // expanded to the same order.  Defined for 4 and 8 lanes.
+    template <size_t LaneCount>
+    void get_field(
+        const Coordinate::Lanes<LaneCount>& theta,
+        const Coordinate::Lanes<LaneCount>& phi,
+        const Coordinate::Lanes<LaneCount>& radius,
+        const Coordinate::Lanes<LaneCount>& decimal_year,
+        const int order,
+        BasicMagneticField<Coordinate::Lanes<LaneCount>>& field,
+        const bool with_rate = false,
+        const bool with_gradient = false) const
+    {
+        evaluate_field(theta, phi, radius, decimal_year, order, field, with_rate, with_gradient);
+    }
+
 protected:
-    const double epoch = 2020.0;
+    double epoch;
+    std::string name;
     const int max_order = 12;
 
-    void load_coefficients();
+private:
+    template <typename Scalar>
+    void evaluate_field(
+        const Scalar& theta,
+        const Scalar& phi,
+        const Scalar& radius,
+        const Scalar& decimal_year,
+        const int order,
+        BasicMagneticField<Scalar>& field,
+        const bool with_rate,
+        const bool with_gradient) const;
+};
+
+// The WMM releases a run may need, indexed by epoch and each loaded on first use, so multi-year
+// campaigns get the right coefficients for every timestamp without loading every release.  A
+// timestamp selects the latest release whose epoch is not after it, if that release is still
+// within validity_years of its epoch.
+class WorldMagneticModelRegistry
+{
+public:
+    explicit WorldMagneticModelRegistry(const double validity_years = 5.0)
+        : validity_years(validity_years)
+    {
+    }
+
+    // Indexes every .COF file in directory whose header names a WMM release, reading only the
+    // headers.  Throws std::runtime_error if the directory cannot be read and as add.
+    explicit WorldMagneticModelRegistry(
+        const std::string& directory, const double validity_years = 5.0);
+
+    // Indexes the coefficient file at path.  Throws std::runtime_error if it has no header and
+    // std::invalid_argument if a release with the same epoch is already indexed.
+    void add(const std::string& path);
+
+    // The release valid at timestamp, loaded on first use.  Safe to call from several threads.
+    // Throws std::out_of_range if no release is valid at timestamp and std::runtime_error if the
+    // release cannot be loaded, in which case the next call tries again.
+    const WorldMagneticModel& select(const Time::Timestamp& timestamp) const;
+
+    // Releases in order of epoch.
+    size_t get_release_count() const
+    {
+        return releases.size();
+    }
+
+    const CoefficientFileHeader& get_release(const size_t release) const
+    {
+        return releases[release]->header;
+    }
+
+    bool is_loaded(const size_t release) const
+    {
+        return releases[release]->model_loaded.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Release
+    {
+        CoefficientFileHeader header;
+        std::string path;
+        std::once_flag load_once;
+        std::atomic<bool> model_loaded{false};
+        std::unique_ptr<WorldMagneticModel> model;
+    };
+
+    double validity_years;
+    std::vector<std::unique_ptr<Release>> releases;
+};
+
+// A WorldMagneticModel's field along a trajectory, fitted once with Chebyshev polynomials over
+// segments of the trajectory so that high rate queries, such as a 1 kHz magnetometer, cost a few
+// polynomial evaluations instead of a model evaluation each.
+class MagneticFieldTrajectory
+{
+public:
+    // Writes the longitude theta, latitude phi and radius, as the model takes them, at t seconds
+    // after the start.
+    using Position = std::function<void(double t, double& theta, double& phi, double& radius)>;
+
+    // Fits x', y' and z' over [start, start + duration].  options.tolerance is in the model's
+    // units, nT.  Throws as Math::ChebyshevTrajectory.
+    MagneticFieldTrajectory(
+        const WorldMagneticModel& model,
+        const Position& position,
+        const Time::Timestamp& start,
+        const double duration,
+        const int order,
+        const Math::ChebyshevOptions& options);
+
+    // Writes x', y' and z' at t seconds after the start.  Throws std::out_of_range if t is outside
+    // [0, duration].
+    void get_field(const double t, double* field) const
+    {
+        fit.evaluate(t, field);
+    }
+
+    const Math::ChebyshevTrajectory& get_fit() const
+    {
+        return fit;
+    }
+
+private:
+    Math::ChebyshevTrajectory fit;
 };
 
 class EarthGravitationalModel : public SphericalHarmonicModel
@@ -0,0 +1,291 @@
+#include "spherical_harmonic_models.h"
+#include "tools/cpp/runfiles/runfiles.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <tuple>
+
+namespace CamSim::Model {
+
+namespace {
+
+std::string get_runfiles_path(const std::string& filename)
+{
+    using bazel::tools::cpp::runfiles::Runfiles;
+    std::string error;
+    static std::unique_ptr<Runfiles> runfiles(Runfiles::Create("", &error));
+    if (!runfiles)
+    {
+        throw std::runtime_error("Failed to init Bazel runfiles: " + error);
+    }
+
+    return runfiles->Rlocation("camsim/" + filename);
+}
+
+// Writes a degree 12 coefficient file in NOAA's layout, with g10 set to g so the releases differ
+// and only the first row_count of its 90 rows.
+void write_coefficients(
+    const std::string& path, const std::string& header, const double g, const int row_count = 90)
+{
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    ASSERT_NE(file, nullptr);
+    std::fprintf(file, "%s\n", header.c_str());
+    int rows = 0;
+    for (int l = 1; l <= 12; l++)
+    {
+        for (int m = 0; m <= l && rows < row_count; m++, rows++)
+        {
+            std::fprintf(file, "%3d%3d  %8.1f  %8.1f  %9.1f  %9.1f\n", l, m,
+                         l == 1 && m == 0 ? g : 1.0, m == 0 ? 0.0 : 1.0, 0.1, m == 0 ? 0.0 : 0.1);
+        }
+    }
+    std::fprintf(file, "999999999999999999999999999999999999999999999999\n");
+    std::fprintf(file, "999999999999999999999999999999999999999999999999\n");
+    std::fclose(file);
+}
+
+class registry_test : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        directory = ::testing::TempDir() + "spherical_harmonic_models_test";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directory(directory);
+        write_coefficients(directory + "/WMM2025.COF",
+                           "    2025.0            WMM-2025        11/13/2024", -29351.8);
+        write_coefficients(directory + "/WMM2020.COF",
+                           "    2020.0            WMM-2020        12/10/2019", -29404.5);
+        write_coefficients(directory + "/WMMHR.COF",
+                           "    2025.0            WMMHR-2025      11/13/2024", 0.0);
+        write_coefficients(directory + "/EGM.COF", "  2  0  1.0 0.0 0.0 0.0", 0.0);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(directory);
+    }
+
+    std::string directory;
+};
+
+}
+
+TEST(coefficient_header_test, reads_header)
+{
+    const std::string path = ::testing::TempDir() + "spherical_harmonic_models_test_header.COF";
+    write_coefficients(path, "    2025.0            WMM-2025        11/13/2024", -29351.8);
+
+    const CoefficientFileHeader header = read_coefficient_header(path);
+    EXPECT_EQ(header.epoch, 2025.0);
+    EXPECT_EQ(header.name, "WMM-2025");
+    EXPECT_EQ(header.release_date, "11/13/2024");
+
+    const WorldMagneticModel model(path);
+    EXPECT_EQ(model.get_epoch(), 2025.0);
+    EXPECT_EQ(model.get_name(), "WMM-2025");
+    std::remove(path.c_str());
+
+    // A file that starts with coefficients has no header.
+    write_coefficients(path, "  1  0  -29351.8       0.0       12.0        0.0", -29351.8);
+    EXPECT_THROW(read_coefficient_header(path), std::runtime_error);
+    EXPECT_THROW(WorldMagneticModel model(path), std::runtime_error);
+    std::remove(path.c_str());
+    EXPECT_THROW(read_coefficient_header(path), std::runtime_error);
+}
+
+TEST(coefficient_header_test, rejects_incomplete_coefficients)
+{
+    const std::string path =
+        ::testing::TempDir() + "spherical_harmonic_models_test_incomplete.COF";
+    const std::string header = "    2025.0            WMM-2025        11/13/2024";
+    write_coefficients(path, header, -29351.8);
+    EXPECT_NO_THROW(WorldMagneticModel model(path));
+
+    // The last row of degree 12, and then all of it, missing.
+    for (const int row_count : {89, 77})
+    {
+        write_coefficients(path, header, -29351.8, row_count);
+        EXPECT_THROW(WorldMagneticModel model(path), std::runtime_error) << row_count;
+        WorldMagneticModelRegistry registry;
+        registry.add(path);
+        EXPECT_THROW(registry.select(Time::Timestamp::from_decimal_year(2026.0)),
+                     std::runtime_error)
+            << row_count;
+    }
+    std::remove(path.c_str());
+}
+
+TEST_F(registry_test, indexes_releases_by_epoch)
+{
+    const WorldMagneticModelRegistry registry(directory);
+
+    ASSERT_EQ(registry.get_release_count(), 2);
+    EXPECT_EQ(registry.get_release(0).name, "WMM-2020");
+    EXPECT_EQ(registry.get_release(1).name, "WMM-2025");
+    EXPECT_FALSE(registry.is_loaded(0));
+    EXPECT_FALSE(registry.is_loaded(1));
+
+    EXPECT_THROW(WorldMagneticModelRegistry(directory + "/missing"), std::runtime_error);
+}
+
+TEST_F(registry_test, selects_release_by_time_and_loads_it_once)
+{
+    const WorldMagneticModelRegistry registry(directory);
+
+    const WorldMagneticModel& model =
+        registry.select(Time::Timestamp::from_decimal_year(2026.5));
+    EXPECT_EQ(model.get_name(), "WMM-2025");
+    EXPECT_FALSE(registry.is_loaded(0));
+    EXPECT_TRUE(registry.is_loaded(1));
+    EXPECT_EQ(&registry.select(Time::Timestamp::from_decimal_year(2029.9)), &model);
+
+    EXPECT_EQ(registry.select(Time::Timestamp::from_decimal_year(2024.9)).get_name(), "WMM-2020");
+    EXPECT_TRUE(registry.is_loaded(0));
+
+    EXPECT_THROW(registry.select(Time::Timestamp::from_decimal_year(2019.9)), std::out_of_range);
+    EXPECT_THROW(registry.select(Time::Timestamp::from_decimal_year(2030.1)), std::out_of_range);
+}
+
+TEST_F(registry_test, rejects_duplicate_epochs)
+{
+    WorldMagneticModelRegistry registry;
+    registry.add(directory + "/WMM2025.COF");
+    EXPECT_THROW(registry.add(directory + "/WMMHR.COF"), std::invalid_argument);
+    EXPECT_THROW(registry.add(directory + "/EGM.COF"), std::runtime_error);
+    EXPECT_EQ(registry.get_release_count(), 1);
+}
+
+TEST(world_magnetic_model_test, fused_field_matches_components)
+{
+    const WorldMagneticModel model(get_runfiles_path("coeffs/WMM2025.COF"));
+    const Time::Timestamp timestamp = Time::Timestamp::from_decimal_year(2026.3);
+
+    for (const auto& [theta, phi, radius] :
+         {std::tuple{0.3, 1.2, 6.4e6}, std::tuple{-2.0, -0.4, 6.9e6}, std::tuple{3.0, 0.0, 4.2e7}})
+    {
+        // The lower order reuses the tables the full order filled.
+        for (const int order : {12, 5})
+        {
+            MagneticField field;
+            model.get_field(theta, phi, radius, timestamp, order, field);
+            const double scale = std::abs(field.field[2]) + 1.0;
+            EXPECT_NEAR(field.field[0], model.get_x_prime(theta, phi, radius, timestamp, order),
+                        1e-12 * scale);
+            EXPECT_NEAR(field.field[1], model.get_y_prime(theta, phi, radius, timestamp, order),
+                        1e-12 * scale);
+            EXPECT_NEAR(field.field[2], model.get_z_prime(theta, phi, radius, timestamp, order),
+                        1e-12 * scale);
+            for (int i = 0; i < 3; i++)
+            {
+                EXPECT_EQ(field.rate[i], 0.0);
+                EXPECT_EQ(field.gradient[i][0], 0.0);
+            }
+        }
+    }
+
+    MagneticField field;
+    EXPECT_THROW(model.get_field(0.0, 0.0, 7e6, timestamp, 13, field), std::invalid_argument);
+    EXPECT_THROW(model.get_potential(0.0, 0.0, 7e6, timestamp, 13), std::invalid_argument);
+    EXPECT_THROW(model.get_x_prime(0.0, 0.0, 7e6, timestamp, 13), std::invalid_argument);
+    EXPECT_THROW(model.get_y_prime(0.0, 0.0, 7e6, timestamp, -1), std::invalid_argument);
+    EXPECT_THROW(model.get_z_prime(0.0, 0.0, 7e6, timestamp, 13), std::invalid_argument);
+}
+
+template <size_t LaneCount>
+void expect_lanes_match_points(const WorldMagneticModel& model)
+{
+    using Lanes = Coordinate::Lanes<LaneCount>;
+    Lanes theta, phi, radius, decimal_year;
+    for (size_t lane = 0; lane < LaneCount; lane++)
+    {
+        theta[lane] = -3.0 + 0.8 * lane;
+        phi[lane] = 1.4 - 0.37 * lane;
+        radius[lane] = 6.4e6 + 1e6 * lane;
+        decimal_year[lane] = 2025.0 + 0.6 * lane;
+    }
+
+    BasicMagneticField<Lanes> lanes;
+    model.get_field(theta, phi, radius, decimal_year, 12, lanes, true, true);
+    for (size_t lane = 0; lane < LaneCount; lane++)
+    {
+        MagneticField point;
+        model.get_field(theta[lane], phi[lane], radius[lane],
+                        Time::Timestamp::from_decimal_year(decimal_year[lane]), 12, point, true,
+                        true);
+        for (int i = 0; i < 3; i++)
+        {
+            const double scale = std::abs(point.field[i]) + 1.0;
+            EXPECT_NEAR(lanes.field[i][lane], point.field[i], 1e-12 * scale) << lane;
+            EXPECT_NEAR(lanes.rate[i][lane], point.rate[i], 1e-12 * scale) << lane;
+            for (int j = 0; j < 3; j++)
+            {
+                EXPECT_NEAR(lanes.gradient[i][j][lane], point.gradient[i][j], 1e-12 * scale)
+                    << lane;
+            }
+        }
+    }
+
+    EXPECT_THROW(model.get_field(theta, phi, radius, decimal_year, 13, lanes),
+                 std::invalid_argument);
+}
+
+TEST(world_magnetic_model_test, lanes_match_points)
+{
+    const WorldMagneticModel model(get_runfiles_path("coeffs/WMM2025.COF"));
+    expect_lanes_match_points<4>(model);
+    expect_lanes_match_points<8>(model);
+}
+
+TEST(world_magnetic_model_test, rate_and_gradient_match_differences)
+{
+    const WorldMagneticModel model(get_runfiles_path("coeffs/WMM2025.COF"));
+    const double year = 2027.0;
+    const double theta = 1.1;
+    const double phi = 0.7;
+    const double radius = 6.8e6;
+
+    MagneticField field;
+    model.get_field(theta, phi, radius, Time::Timestamp::from_decimal_year(year), 12, field, true,
+                    true);
+    const auto evaluate = [&](const double t, const double r, const double th, const double ph)
+    {
+        MagneticField value;
+        model.get_field(th, ph, r, Time::Timestamp::from_decimal_year(t), 12, value);
+        return value;
+    };
+
+    // The field is linear in time, so a year's difference is the rate.
+    const MagneticField later = evaluate(year + 1.0, radius, theta, phi);
+    for (int i = 0; i < 3; i++)
+    {
+        EXPECT_NEAR(field.rate[i], later.field[i] - field.field[i], 1e-6) << i;
+    }
+
+    // Central differences, with errors of order step^2 times the third derivative.
+    const double radius_step = 10.0;
+    const double angle_step = 1e-5;
+    const MagneticField radius_up = evaluate(year, radius + radius_step, theta, phi);
+    const MagneticField radius_down = evaluate(year, radius - radius_step, theta, phi);
+    const MagneticField theta_up = evaluate(year, radius, theta + angle_step, phi);
+    const MagneticField theta_down = evaluate(year, radius, theta - angle_step, phi);
+    const MagneticField phi_up = evaluate(year, radius, theta, phi + angle_step);
+    const MagneticField phi_down = evaluate(year, radius, theta, phi - angle_step);
+    for (int i = 0; i < 3; i++)
+    {
+        EXPECT_NEAR(field.gradient[i][0],
+                    (radius_up.field[i] - radius_down.field[i]) / (2.0 * radius_step), 1e-8)
+            << i;
+        EXPECT_NEAR(field.gradient[i][1],
+                    (theta_up.field[i] - theta_down.field[i]) / (2.0 * angle_step), 1e-4)
+            << i;
+        EXPECT_NEAR(field.gradient[i][2],
+                    (phi_up.field[i] - phi_down.field[i]) / (2.0 * angle_step), 1e-4)
+            << i;
+    }
+}
+
+}
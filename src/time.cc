@@ -1,20 +1,430 @@
 #include "time.h"
 
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
 namespace CamSim::Time {
 
+namespace {
+
+// Branch-free binary search for the index of the last key that is less than or equal to value, or 0
+// if there is none.  The loop runs a fixed number of times and the comparison compiles to a
+// conditional move.
+template <typename Key, typename Getter>
+size_t last_less_equal(const size_t size, const double value, Getter get_key)
+{
+    size_t base = 0;
+    size_t remaining = size;
+    while (remaining > 1)
+    {
+        const size_t half = remaining / 2;
+        base = (double)(Key)get_key(base + half) <= value ? base + half : base;
+        remaining -= half;
+    }
+
+    return base;
+}
+
+bool uses_leap_seconds(const TimeScale scale)
+{
+    return scale == TimeScale::TAI || scale == TimeScale::GPS || scale == TimeScale::TT ||
+           scale == TimeScale::JD_GPS || scale == TimeScale::JD_TT;
+}
+
+double year_start_timestamp(const long year)
+{
+    return (double)days_from_civil(year, 1, 1) * SECONDS_PER_DAY;
+}
+
+// Number of values checked at once before converting them in one vectorized loop.
+constexpr size_t batch_block_size = 64;
+
+// Installed tables are never freed, so references handed out by get_leap_second_table stay valid
+// after another table is installed.  There are only ever a handful of them.
+std::atomic<const LeapSecondTable*> active_leap_second_table{nullptr};
+std::mutex installed_leap_second_tables_mutex;
+std::vector<std::unique_ptr<const LeapSecondTable>> installed_leap_second_tables;
+
+std::vector<std::string> split_line(const std::string& line)
+{
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, ','))
+    {
+        fields.push_back(field);
+    }
+
+    return fields;
+}
+
+// Parses the whole field as a number, throwing on trailing characters.
+template <typename Number>
+Number parse_field(const std::string& field, const std::string& path, const size_t line_number)
+{
+    std::istringstream stream(field);
+    Number value;
+    if (!(stream >> value) || !(stream >> std::ws).eof())
+    {
+        throw std::runtime_error("Invalid value '" + field + "' on line " +
+                                 std::to_string(line_number) + " of '" + path + "'");
+    }
+
+    return value;
+}
+
+}
+
+LeapSecondTable::LeapSecondTable(const std::vector<std::pair<long long, double>>& rows)
+{
+    if (rows.empty())
+    {
+        throw std::runtime_error("Leap second table is empty");
+    }
+    if (rows.size() > std::numeric_limits<std::uint16_t>::max())
+    {
+        throw std::runtime_error("Leap second table has too many rows");
+    }
+
+    starts.reserve(rows.size());
+    leap_seconds.reserve(rows.size());
+    for (const auto& [start, leap] : rows)
+    {
+        if (start % SECONDS_PER_DAY != 0)
+        {
+            throw std::runtime_error("Leap second starting at " + std::to_string(start) +
+                                     " is not at midnight UTC");
+        }
+        if (!starts.empty() && start <= starts.back())
+        {
+            throw std::runtime_error("Leap second table is not sorted at " + std::to_string(start));
+        }
+        starts.push_back(start);
+        leap_seconds.push_back(leap);
+    }
+
+    const long long first_day = starts.front() / SECONDS_PER_DAY;
+    const long long last_day = starts.back() / SECONDS_PER_DAY;
+    day_index.resize((size_t)(last_day - first_day));
+    for (size_t i = 0; i + 1 < starts.size(); i++)
+    {
+        std::fill(day_index.begin() + (starts[i] / SECONDS_PER_DAY - first_day),
+                  day_index.begin() + (starts[i + 1] / SECONDS_PER_DAY - first_day),
+                  (std::uint16_t)i);
+    }
+}
+
+LeapSecondTable LeapSecondTable::from_file(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Could not open leap second file at '" + path + "'");
+    }
+
+    std::string line;
+    if (!std::getline(file, line))
+    {
+        throw std::runtime_error("Leap second file at '" + path + "' is empty");
+    }
+    const std::vector<std::string> header = split_line(line);
+    const bool has_dates = header.size() == 4;
+    if (!has_dates && header.size() != 2)
+    {
+        throw std::runtime_error("Unknown leap second file header '" + line + "' in '" + path + "'");
+    }
+
+    std::vector<std::pair<long long, double>> rows;
+    size_t line_number = 1;
+    while (std::getline(file, line))
+    {
+        line_number++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+        {
+            continue;
+        }
+
+        const std::vector<std::string> fields = split_line(line);
+        if (fields.size() != header.size())
+        {
+            throw std::runtime_error("Expected " + std::to_string(header.size()) +
+                                     " fields on line " + std::to_string(line_number) + " of '" +
+                                     path + "'");
+        }
+
+        long long start;
+        if (has_dates)
+        {
+            const long year = parse_field<long>(fields[0], path, line_number);
+            const unsigned month = parse_field<unsigned>(fields[1], path, line_number);
+            const unsigned day = parse_field<unsigned>(fields[2], path, line_number);
+            if (month < 1 || month > 12 || day < 1 || day > 31)
+            {
+                throw std::runtime_error("Invalid date on line " + std::to_string(line_number) +
+                                         " of '" + path + "'");
+            }
+            start = (long long)days_from_civil(year, month, day) * SECONDS_PER_DAY;
+        }
+        else
+        {
+            start = parse_field<long long>(fields[0], path, line_number);
+        }
+        rows.emplace_back(start, parse_field<double>(fields.back(), path, line_number));
+    }
+
+    if (rows.empty())
+    {
+        throw std::runtime_error("Leap second file at '" + path + "' has no rows");
+    }
+
+    // The files start at 1972, so keep the compiled-in values for anything earlier.
+    std::vector<std::pair<long long, double>> earlier_rows;
+    for (const auto& [start, leap] : compiled_in_rows)
+    {
+        if ((long long)start < rows.front().first)
+        {
+            earlier_rows.emplace_back((long long)start, leap);
+        }
+    }
+    rows.insert(rows.begin(), earlier_rows.begin(), earlier_rows.end());
+
+    return LeapSecondTable(rows);
+}
+
+const LeapSecondTable& LeapSecondTable::compiled_in()
+{
+    static const LeapSecondTable table = [] {
+        std::vector<std::pair<long long, double>> rows;
+        for (const auto& [start, leap] : compiled_in_rows)
+        {
+            rows.emplace_back((long long)start, leap);
+        }
+        return LeapSecondTable(rows);
+    }();
+
+    return table;
+}
+
+const LeapSecondTable& Timestamp::get_leap_second_table()
+{
+    const LeapSecondTable* table = active_leap_second_table.load(std::memory_order_acquire);
+
+    return table != nullptr ? *table : LeapSecondTable::compiled_in();
+}
+
+void Timestamp::set_leap_second_table(const LeapSecondTable& table)
+{
+    std::lock_guard<std::mutex> lock(installed_leap_second_tables_mutex);
+    installed_leap_second_tables.push_back(std::make_unique<const LeapSecondTable>(table));
+    active_leap_second_table.store(installed_leap_second_tables.back().get(),
+                                   std::memory_order_release);
+}
+
+void Timestamp::reset_leap_second_table()
+{
+    active_leap_second_table.store(nullptr, std::memory_order_release);
+}
+
 double Timestamp::get_utc_leap_seconds(const ulong seconds)
 {
-    // Get first leap second timestamp that is less than seconds
-    for (auto it = leap_seconds_table.rbegin(); it != leap_seconds_table.rend(); ++it)
+    return get_leap_second_table().get_leap_seconds((long long)seconds);
+}
+
+Timestamp Timestamp::from_utc_since_epoch(const Duration utc_since_epoch)
+{
+    // Floor division so times before the epoch keep 0 <= tv_nsec < 1e9.
+    const long long nanoseconds = utc_since_epoch.get_nanoseconds();
+    long long seconds = nanoseconds / Duration::nanoseconds_per_second;
+    long long remainder = nanoseconds % Duration::nanoseconds_per_second;
+    if (remainder < 0)
+    {
+        seconds -= 1;
+        remainder += Duration::nanoseconds_per_second;
+    }
+
+    Timestamp timestamp(0, 0);
+    timestamp.posix_timestamp.tv_sec = (std::time_t)seconds;
+    timestamp.posix_timestamp.tv_nsec = (long)remainder;
+
+    return timestamp;
+}
+
+Timestamp Timestamp::from_tai_since_epoch(const Duration tai_since_epoch)
+{
+    // Find the last leap second that has started by this TAI instant.  Leap seconds start at the
+    // row's UTC timestamp, which is that timestamp + leap_seconds in TAI.
+    const LeapSecondTable& table = get_leap_second_table();
+    const auto tai_start = [&](const size_t i) {
+        return Duration::from_nanoseconds(table.get_start(i) * Duration::nanoseconds_per_second) +
+               Duration::from_seconds(table.get_leap_seconds_at(i));
+    };
+    size_t base = 0;
+    size_t remaining = table.size();
+    while (remaining > 1)
+    {
+        const size_t half = remaining / 2;
+        base = tai_start(base + half) <= tai_since_epoch ? base + half : base;
+        remaining -= half;
+    }
+
+    Duration utc_since_epoch =
+        tai_since_epoch - Duration::from_seconds(table.get_leap_seconds_at(base));
+
+    // Inside an inserted leap second, hold at the last nanosecond before it.
+    if (base + 1 < table.size())
     {
-        const auto& [valid_after_timestamp, leap_seconds] = *it;
-        if (seconds >= valid_after_timestamp)
+        const Duration next_start = Duration::from_nanoseconds(
+            table.get_start(base + 1) * Duration::nanoseconds_per_second);
+        if (utc_since_epoch >= next_start)
         {
-            return leap_seconds;
+            utc_since_epoch = next_start - Duration::from_nanoseconds(1);
         }
     }
 
-    return 0.0;
+    return from_utc_since_epoch(utc_since_epoch);
+}
+
+Timestamp::AffineMap Timestamp::get_affine_map(
+    const TimeScale scale,
+    const double leap_seconds,
+    const long year)
+{
+    const double gps_offset = leap_seconds - gps_epoch_offset - gps_tai_offset;
+    const double tt_offset = leap_seconds + tt_tai_offset;
+
+    switch (scale)
+    {
+    case TimeScale::UTC:
+        return AffineMap{1.0, 0.0};
+    case TimeScale::TAI:
+        return AffineMap{1.0, leap_seconds};
+    case TimeScale::GPS:
+        return AffineMap{1.0, gps_offset};
+    case TimeScale::TT:
+        return AffineMap{1.0, tt_offset};
+    case TimeScale::JD_UTC:
+        return AffineMap{1.0 / SECONDS_PER_DAY, jd_offset};
+    case TimeScale::JD_GPS:
+        return AffineMap{1.0 / SECONDS_PER_DAY, gps_offset / SECONDS_PER_DAY + jd_offset};
+    case TimeScale::JD_TT:
+        return AffineMap{1.0 / SECONDS_PER_DAY, tt_offset / SECONDS_PER_DAY + jd_offset};
+    case TimeScale::DECIMAL_YEAR:
+    {
+        const double start_timestamp = year_start_timestamp(year);
+        const double year_length = year_start_timestamp(year + 1) - start_timestamp;
+        return AffineMap{1.0 / year_length, (double)year - start_timestamp / year_length};
+    }
+    }
+
+    throw std::invalid_argument("Unknown time scale");
+}
+
+void Timestamp::convert_batch(
+    const TimeScale from,
+    const TimeScale to,
+    const double* input,
+    double* output,
+    const size_t count)
+{
+    const LeapSecondTable& table = get_leap_second_table();
+    const size_t leap_count = table.size();
+    constexpr double infinity = std::numeric_limits<double>::infinity();
+
+    // The instants where each leap second count starts in the input scale.
+    std::vector<double> input_starts(leap_count);
+    for (size_t k = 0; k < leap_count; k++)
+    {
+        input_starts[k] = get_affine_map(from, table.get_leap_seconds_at(k), 0)
+                              .apply((double)table.get_start(k));
+    }
+
+    size_t i = 0;
+    while (i < count)
+    {
+        const double first = input[i];
+
+        // Find how the input scale maps to UTC at the first value of the run, and the range of
+        // input values where that map holds.
+        AffineMap input_map = get_affine_map(from, 0.0, 0);
+        double input_low = -infinity;
+        double input_high = infinity;
+        if (uses_leap_seconds(from))
+        {
+            const size_t k = last_less_equal<double>(
+                leap_count, first, [&](const size_t j) { return input_starts[j]; });
+            input_map = get_affine_map(from, table.get_leap_seconds_at(k), 0);
+            input_low = k == 0 ? -infinity : input_starts[k];
+            input_high = k + 1 < leap_count ? input_starts[k + 1] : infinity;
+        }
+        else if (from == TimeScale::DECIMAL_YEAR)
+        {
+            const long year = (long)std::floor(first);
+            input_map = get_affine_map(from, 0.0, year);
+            input_low = (double)year;
+            input_high = (double)(year + 1);
+        }
+        const double utc_timestamp = input_map.invert(first);
+
+        // Find how UTC maps to the output scale at that instant, and the range of UTC timestamps
+        // where that map holds.
+        double leap_seconds = 0.0;
+        long year = 0;
+        double utc_low = -infinity;
+        double utc_high = infinity;
+        if (uses_leap_seconds(to))
+        {
+            const size_t k = table.get_index((long long)std::floor(utc_timestamp));
+            leap_seconds = table.get_leap_seconds_at(k);
+            utc_low = k == 0 ? -infinity : (double)table.get_start(k);
+            utc_high = k + 1 < leap_count ? (double)table.get_start(k + 1) : infinity;
+        }
+        else if (to == TimeScale::DECIMAL_YEAR)
+        {
+            year = year_from_days((long)std::floor(utc_timestamp / SECONDS_PER_DAY));
+            utc_low = year_start_timestamp(year);
+            utc_high = year_start_timestamp(year + 1);
+        }
+        const AffineMap output_map = get_affine_map(to, leap_seconds, year);
+
+        // Combine both maps into one multiply-add, valid for input values in [low, high).
+        const double low = std::max(input_low, input_map.apply(utc_low));
+        const double high = std::min(input_high, input_map.apply(utc_high));
+        const double scale = output_map.scale / input_map.scale;
+        const double offset = output_map.offset - scale * input_map.offset;
+
+        // The first value always belongs to the run, even if it falls inside a leap second.
+        output[i] = first * scale + offset;
+        i++;
+
+        // Convert whole blocks while every value in the block is in range.
+        while (i + batch_block_size <= count)
+        {
+            bool inside = true;
+            for (size_t j = i; j < i + batch_block_size; j++)
+            {
+                inside &= (low <= input[j]) & (input[j] < high);
+            }
+            if (!inside)
+            {
+                break;
+            }
+            for (size_t j = i; j < i + batch_block_size; j++)
+            {
+                output[j] = input[j] * scale + offset;
+            }
+            i += batch_block_size;
+        }
+
+        // Finish the run one value at a time.
+        while (i < count && low <= input[i] && input[i] < high)
+        {
+            output[i] = input[i] * scale + offset;
+            i++;
+        }
+    }
 }
 
 }
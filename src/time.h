@@ -1,18 +1,240 @@
 #ifndef TIME_H
 #define TIME_H
+#include <array>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <ctime>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <stdexcept>
+#include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #define SECONDS_PER_DAY 86400
 
 namespace CamSim::Time {
 
+// Days since 1970-01-01 of a proleptic Gregorian date (H. Hinnant's days_from_civil).
+constexpr long days_from_civil(long year, const unsigned month, const unsigned day)
+{
+    year -= month <= 2;
+    const long era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned year_of_era = (unsigned)(year - era * 400);
+    const unsigned day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+    return era * 146097 + (long)day_of_era - 719468;
+}
+
+// Proleptic Gregorian year containing the given number of days since 1970-01-01.
+constexpr long year_from_days(long days)
+{
+    days += 719468;
+    const long era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned day_of_era = (unsigned)(days - era * 146097);
+    const unsigned year_of_era =
+        (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    const unsigned day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    const unsigned month_index = (5 * day_of_year + 2) / 153;
+
+    // The computation above uses years starting in March, so January and February belong to the
+    // next civil year.
+    return (long)year_of_era + era * 400 + (month_index >= 10);
+}
+
+static_assert(days_from_civil(1970, 1, 1) == 0);
+static_assert(days_from_civil(2000, 3, 1) == 11017);
+static_assert(year_from_days(-1) == 1969 && year_from_days(0) == 1970);
+static_assert(year_from_days(days_from_civil(2024, 12, 31)) == 2024);
+
+// An exact span of time in integer nanoseconds (about +-292 years).  Stepping and differencing
+// Timestamps with Durations is exact, so long propagations do not accumulate rounding error.
+class Duration
+{
+public:
+    constexpr Duration() = default;
+
+    static constexpr Duration from_nanoseconds(const long long nanoseconds)
+    {
+        return Duration(nanoseconds);
+    }
+
+    // Rounds to the nearest nanosecond.
+    static Duration from_seconds(const double seconds)
+    {
+        return Duration(std::llround(seconds * 1e9));
+    }
+
+    constexpr long long get_nanoseconds() const
+    {
+        return nanoseconds;
+    }
+
+    double get_seconds() const
+    {
+        // Split before converting so durations longer than 2^53 ns (~104 days) keep their
+        // nanoseconds.
+        return (double)(nanoseconds / nanoseconds_per_second) +
+               (double)(nanoseconds % nanoseconds_per_second) / 1e9;
+    }
+
+    constexpr Duration operator+(const Duration other) const
+    {
+        return Duration(nanoseconds + other.nanoseconds);
+    }
+
+    constexpr Duration operator-(const Duration other) const
+    {
+        return Duration(nanoseconds - other.nanoseconds);
+    }
+
+    constexpr Duration operator-() const
+    {
+        return Duration(-nanoseconds);
+    }
+
+    constexpr Duration operator*(const long long factor) const
+    {
+        return Duration(nanoseconds * factor);
+    }
+
+    Duration& operator+=(const Duration other)
+    {
+        nanoseconds += other.nanoseconds;
+        return *this;
+    }
+
+    Duration& operator-=(const Duration other)
+    {
+        nanoseconds -= other.nanoseconds;
+        return *this;
+    }
+
+    constexpr bool operator==(const Duration other) const
+    {
+        return nanoseconds == other.nanoseconds;
+    }
+
+    constexpr bool operator!=(const Duration other) const
+    {
+        return nanoseconds != other.nanoseconds;
+    }
+
+    constexpr bool operator<(const Duration other) const
+    {
+        return nanoseconds < other.nanoseconds;
+    }
+
+    constexpr bool operator<=(const Duration other) const
+    {
+        return nanoseconds <= other.nanoseconds;
+    }
+
+    constexpr bool operator>(const Duration other) const
+    {
+        return nanoseconds > other.nanoseconds;
+    }
+
+    constexpr bool operator>=(const Duration other) const
+    {
+        return nanoseconds >= other.nanoseconds;
+    }
+
+    static constexpr long long nanoseconds_per_second = 1000000000;
+
+private:
+    constexpr explicit Duration(const long long nanoseconds) : nanoseconds(nanoseconds)
+    {
+    }
+
+    long long nanoseconds = 0;
+};
+
+// Time scales understood by Timestamp::convert_batch.  Plain scales are in seconds since
+// 1970-01-01 of that scale (GPS is since the GPS epoch), JD scales are in days.
+enum class TimeScale
+{
+    UTC,
+    TAI,
+    GPS,
+    TT,
+    JD_UTC,
+    JD_GPS,
+    JD_TT,
+    DECIMAL_YEAR,
+};
+
+// TAI - UTC as a function of UTC, built from rows of (UTC timestamp where the count starts, leap
+// seconds).  Leap seconds only ever start at midnight, so a per-day index answers lookups with one
+// division and one load.
+class LeapSecondTable
+{
+public:
+    // Throws std::runtime_error if the rows are empty, not sorted, or do not start at midnight UTC.
+    explicit LeapSecondTable(const std::vector<std::pair<long long, double>>& rows);
+
+    // Reads timestamp_leap_seconds.txt ("timestamp,leap_seconds") or leap_seconds_table.txt
+    // ("year,month,day,leap_seconds"), picked by the header line.  Times before the first row keep
+    // the compiled-in values.  Throws std::runtime_error if the file cannot be read or parsed.
+    static LeapSecondTable from_file(const std::string& path);
+
+    // The table built into the binary, used until another one is installed in Timestamp.
+    static const LeapSecondTable& compiled_in();
+
+    size_t get_index(const long long utc_seconds) const
+    {
+        if (utc_seconds < starts.front())
+        {
+            return 0;
+        }
+        const long long day = (utc_seconds - starts.front()) / SECONDS_PER_DAY;
+
+        return day < (long long)day_index.size() ? day_index[day] : starts.size() - 1;
+    }
+
+    double get_leap_seconds(const long long utc_seconds) const
+    {
+        return leap_seconds[get_index(utc_seconds)];
+    }
+
+    size_t size() const
+    {
+        return starts.size();
+    }
+
+    long long get_start(const size_t index) const
+    {
+        return starts[index];
+    }
+
+    double get_leap_seconds_at(const size_t index) const
+    {
+        return leap_seconds[index];
+    }
+
+private:
+    std::vector<long long> starts;
+    std::vector<double> leap_seconds;
+
+    // Row index for every day from the first row to the last one.
+    std::vector<std::uint16_t> day_index;
+
+    static constexpr std::array<std::tuple<ulong, double>, 29> compiled_in_rows = {{
+        {0, 4.2131700},     {63072000, 10.0},   {78796800, 11.0},   {94694400, 12.0},
+        {126230400, 13.0},  {157766400, 14.0},  {189302400, 15.0},  {220924800, 16.0},
+        {252460800, 17.0},  {283996800, 18.0},  {315532800, 19.0},  {362793600, 20.0},
+        {394329600, 21.0},  {425865600, 22.0},  {489024000, 23.0},  {567993600, 24.0},
+        {631152000, 25.0},  {662688000, 26.0},  {709948800, 27.0},  {741484800, 28.0},
+        {773020800, 29.0},  {820454400, 30.0},  {867715200, 31.0},  {915148800, 32.0},
+        {1136073600, 33.0}, {1230768000, 34.0}, {1341100800, 35.0}, {1435708800, 36.0},
+        {1483228800, 37.0},
+    }};
+};
+
 class Timestamp
 {
 public:
@@ -29,37 +251,54 @@ public:
     static Timestamp from_posix_timestamp(const double posix_timestamp)
     {
         const double seconds = std::floor(posix_timestamp);
-        const double nanoseconds = 1e9 * (posix_timestamp - seconds);
+        const long long nanoseconds = std::llround(1e9 * (posix_timestamp - seconds));
 
-        return Timestamp((long)seconds, (long)nanoseconds);
+        return from_utc_since_epoch(
+            Duration::from_nanoseconds((long long)seconds * Duration::nanoseconds_per_second +
+                                       nanoseconds));
     }
 
+    // Exact inverse of get_utc_since_epoch.
+    static Timestamp from_utc_since_epoch(const Duration utc_since_epoch);
+
+    // Exact inverse of get_tai_since_epoch.  TAI instants inside an inserted leap second map to the
+    // last nanosecond before it, as POSIX time cannot represent 23:59:60.
+    static Timestamp from_tai_since_epoch(const Duration tai_since_epoch);
+
     static Timestamp from_jd_utc(const double jd_utc)
     {
-        const double posix_timestamp = (jd_utc - jd_offset) * SECONDS_PER_DAY;
+        return from_jd_utc(jd_utc, 0.0);
+    }
 
-        return from_posix_timestamp(posix_timestamp);
+    // Takes the JD as a two-part (whole + fraction) value, e.g. from get_jd_utc_split, to keep
+    // sub-microsecond precision.
+    static Timestamp from_jd_utc(const double jd_whole, const double jd_fraction)
+    {
+        return from_utc_since_epoch(jd_to_duration(jd_whole, jd_fraction));
     }
 
     static Timestamp from_jd_gps(const double jd_gps)
     {
-        const double gps_timestamp = (jd_gps - jd_offset) * SECONDS_PER_DAY;
-        const double tai_timestamp = gps_timestamp + gps_epoch_offset + gps_tai_offset;
+        return from_jd_gps(jd_gps, 0.0);
+    }
 
-        // This isn't exactly correct when you are close to leap seconds, but it is close enough.
-        const double posix_timestamp = tai_timestamp - get_utc_leap_seconds((ulong)tai_timestamp);
+    // Takes the JD as a two-part (whole + fraction) value, e.g. from get_jd_gps_split.  Handles
+    // leap second boundaries exactly by looking the leap seconds up in TAI.
+    static Timestamp from_jd_gps(const double jd_whole, const double jd_fraction)
+    {
+        const Duration gps_since_epoch = jd_to_duration(jd_whole, jd_fraction);
 
-        return from_posix_timestamp(posix_timestamp);
+        return from_tai_since_epoch(
+            gps_since_epoch + Duration::from_seconds(gps_epoch_offset + gps_tai_offset));
     }
 
     static Timestamp from_decimal_year(const double decimal_year)
     {
-        int year = std::floor(decimal_year);
-        double decimal = decimal_year - year;
-        int index = year - 1970;
+        const long year = (long)std::floor(decimal_year);
+        const double decimal = decimal_year - (double)year;
 
-        double start_timestamp = std::get<1>(year_timestamps_table[index]);
-        double end_timestamp = std::get<2>(year_timestamps_table[index]);
+        const double start_timestamp = (double)days_from_civil(year, 1, 1) * SECONDS_PER_DAY;
+        const double end_timestamp = (double)days_from_civil(year + 1, 1, 1) * SECONDS_PER_DAY;
 
         return from_posix_timestamp(start_timestamp + (end_timestamp - start_timestamp) * decimal);
     }
@@ -69,6 +308,90 @@ public:
         return posix_timestamp.tv_sec + posix_timestamp.tv_nsec / 1e9;
     }
 
+    // Exact time since the POSIX epoch, in UTC (leap seconds not counted).
+    Duration get_utc_since_epoch() const
+    {
+        return Duration::from_nanoseconds(
+            (long long)posix_timestamp.tv_sec * Duration::nanoseconds_per_second +
+            posix_timestamp.tv_nsec);
+    }
+
+    // Exact time since the POSIX epoch, in TAI.
+    Duration get_tai_since_epoch() const
+    {
+        return get_utc_since_epoch() + get_utc_leap_duration(posix_timestamp.tv_sec);
+    }
+
+    // Two-part JDs: the whole part holds the day (ending in .5) and the fraction holds the time of
+    // day, so together they keep the full precision that a single double loses.
+    std::pair<double, double> get_jd_utc_split() const
+    {
+        return duration_to_jd(get_utc_since_epoch());
+    }
+
+    std::pair<double, double> get_jd_gps_split() const
+    {
+        return duration_to_jd(
+            get_tai_since_epoch() - Duration::from_seconds(gps_epoch_offset + gps_tai_offset));
+    }
+
+    std::pair<double, double> get_jd_tt_split() const
+    {
+        return duration_to_jd(get_tai_since_epoch() + Duration::from_seconds(tt_tai_offset));
+    }
+
+    Timestamp operator+(const Duration duration) const
+    {
+        return from_utc_since_epoch(get_utc_since_epoch() + duration);
+    }
+
+    Timestamp operator-(const Duration duration) const
+    {
+        return from_utc_since_epoch(get_utc_since_epoch() - duration);
+    }
+
+    Timestamp& operator+=(const Duration duration)
+    {
+        return *this = *this + duration;
+    }
+
+    Timestamp& operator-=(const Duration duration)
+    {
+        return *this = *this - duration;
+    }
+
+    // Elapsed UTC time between two timestamps, ignoring leap seconds between them (use
+    // get_tai_since_epoch to count them).
+    Duration operator-(const Timestamp& other) const
+    {
+        return get_utc_since_epoch() - other.get_utc_since_epoch();
+    }
+
+    bool operator==(const Timestamp& other) const
+    {
+        return get_utc_since_epoch() == other.get_utc_since_epoch();
+    }
+
+    bool operator!=(const Timestamp& other) const
+    {
+        return !(*this == other);
+    }
+
+    bool operator<(const Timestamp& other) const
+    {
+        return get_utc_since_epoch() < other.get_utc_since_epoch();
+    }
+
+    double get_tai_timestamp() const
+    {
+        return get_utc_timestamp() + get_utc_leap_seconds(posix_timestamp.tv_sec);
+    }
+
+    double get_tt_timestamp() const
+    {
+        return get_tai_timestamp() + tt_tai_offset;
+    }
+
     double get_gps_timestamp() const
     {
         return get_tai_timestamp() - gps_epoch_offset - gps_tai_offset;
@@ -84,19 +407,51 @@ public:
         return get_gps_timestamp() / (double)SECONDS_PER_DAY + jd_offset;
     }
 
+    double get_jd_tt() const
+    {
+        return get_tt_timestamp() / (double)SECONDS_PER_DAY + jd_offset;
+    }
+
     double get_decimal_year() const
     {
-        double timestamp = get_utc_timestamp();
-        for (auto& [year, start_timestamp, end_timestamp] : year_timestamps_table)
-        {
-            if (start_timestamp <= timestamp && timestamp < end_timestamp)
-            {
-                return year + (timestamp - start_timestamp) / (end_timestamp - start_timestamp);
-            }
-        }
-        throw std::range_error("Timestamp year is out of range [1970, 2030)");
+        // Get the year straight from the day number instead of searching a table of years.
+        const double timestamp = get_utc_timestamp();
+        const long days = (long)std::floor(timestamp / SECONDS_PER_DAY);
+        const long year = year_from_days(days);
+
+        const double start_timestamp = (double)days_from_civil(year, 1, 1) * SECONDS_PER_DAY;
+        const double end_timestamp = (double)days_from_civil(year + 1, 1, 1) * SECONDS_PER_DAY;
+
+        return year + (timestamp - start_timestamp) / (end_timestamp - start_timestamp);
+    }
+
+    // Converts count finite values from one time scale to another, agreeing with the scalar
+    // accessors up to rounding.  Every conversion is affine between leap seconds (and year
+    // boundaries for decimal years), so the input is processed in runs that share one leap second
+    // lookup, and each run is a plain multiply-add loop the compiler vectorizes.  Sorted input gives
+    // the longest runs, but any order works.  input and output may be the same array.
+    static void convert_batch(
+        const TimeScale from,
+        const TimeScale to,
+        const double* input,
+        double* output,
+        const size_t count);
+
+    // The leap second table used by every conversion, the compiled-in one unless another has been
+    // installed.  Installing a table is thread safe, and references to earlier tables stay valid.
+    static const LeapSecondTable& get_leap_second_table();
+
+    static void set_leap_second_table(const LeapSecondTable& table);
+
+    // Installs the table read by LeapSecondTable::from_file, so a new IERS bulletin only needs a
+    // new data file.
+    static void load_leap_second_table(const std::string& path)
+    {
+        set_leap_second_table(LeapSecondTable::from_file(path));
     }
 
+    static void reset_leap_second_table();
+
 private:
     Timestamp()
     {
@@ -109,91 +464,66 @@ private:
         posix_timestamp.tv_nsec = nanoseconds;
     }
 
-    double get_tai_timestamp() const
+    // value = scale * utc_timestamp + offset, which holds for every time scale between two leap
+    // seconds (and within one year for decimal years).
+    struct AffineMap
     {
-        return get_utc_timestamp() + get_utc_leap_seconds(posix_timestamp.tv_sec);
-    }
+        double scale;
+        double offset;
+
+        double apply(const double utc_timestamp) const
+        {
+            return scale * utc_timestamp + offset;
+        }
+
+        double invert(const double value) const
+        {
+            return (value - offset) / scale;
+        }
+    };
+
+    static AffineMap get_affine_map(const TimeScale scale, const double leap_seconds, const long year);
 
     static double get_utc_leap_seconds(ulong seconds);
 
+    static Duration get_utc_leap_duration(const ulong seconds)
+    {
+        return Duration::from_seconds(get_utc_leap_seconds(seconds));
+    }
+
+    static Duration jd_to_duration(const double jd_whole, const double jd_fraction)
+    {
+        // Move the whole days out of both parts so the fraction is converted at full precision.
+        const double days = jd_whole - jd_offset;
+        const double whole_days = std::floor(days);
+        const double fraction = (days - whole_days) + jd_fraction;
+
+        return Duration::from_nanoseconds((long long)whole_days * SECONDS_PER_DAY *
+                                          Duration::nanoseconds_per_second) +
+               Duration::from_seconds(fraction * SECONDS_PER_DAY);
+    }
+
+    static std::pair<double, double> duration_to_jd(const Duration duration)
+    {
+        constexpr long long nanoseconds_per_day =
+            (long long)SECONDS_PER_DAY * Duration::nanoseconds_per_second;
+        const long long nanoseconds = duration.get_nanoseconds();
+        long long days = nanoseconds / nanoseconds_per_day;
+        long long remainder = nanoseconds % nanoseconds_per_day;
+        if (remainder < 0)
+        {
+            days -= 1;
+            remainder += nanoseconds_per_day;
+        }
+
+        return {jd_offset + (double)days, (double)remainder / (double)nanoseconds_per_day};
+    }
+
     std::timespec posix_timestamp;
     static constexpr double gps_epoch_offset = 315964800.0;
     static constexpr double gps_tai_offset = 19.0;
+    static constexpr double tt_tai_offset = 32.184;
     static constexpr double jd_offset = 2440587.5;
-
-    static constexpr std::array<std::tuple<ulong, double>, 29> leap_seconds_table = {{
-        {0, 4.2131700},     {63072000, 10.0},   {78796800, 11.0},   {94694400, 12.0},
-        {126230400, 13.0},  {157766400, 14.0},  {189302400, 15.0},  {220924800, 16.0},
-        {252460800, 17.0},  {283996800, 18.0},  {315532800, 19.0},  {362793600, 20.0},
-        {394329600, 21.0},  {425865600, 22.0},  {489024000, 23.0},  {567993600, 24.0},
-        {631152000, 25.0},  {662688000, 26.0},  {709948800, 27.0},  {741484800, 28.0},
-        {773020800, 29.0},  {820454400, 30.0},  {867715200, 31.0},  {915148800, 32.0},
-        {1136073600, 33.0}, {1230768000, 34.0}, {1341100800, 35.0}, {1435708800, 36.0},
-        {1483228800, 37.0},
-    }};
-
-    static constexpr std::array<std::tuple<double, double, double>, 60> year_timestamps_table = {{
-        {1970.0, 0.0, 31536000.0},
-        {1971.0, 31536000.0, 63072000.0},
-        {1972.0, 63072000.0, 94694400.0},
-        {1973.0, 94694400.0, 126230400.0},
-        {1974.0, 126230400.0, 157766400.0},
-        {1975.0, 157766400.0, 189302400.0},
-        {1976.0, 189302400.0, 220924800.0},
-        {1977.0, 220924800.0, 252460800.0},
-        {1978.0, 252460800.0, 283996800.0},
-        {1979.0, 283996800.0, 315532800.0},
-        {1980.0, 315532800.0, 347155200.0},
-        {1981.0, 347155200.0, 378691200.0},
-        {1982.0, 378691200.0, 410227200.0},
-        {1983.0, 410227200.0, 441763200.0},
-        {1984.0, 441763200.0, 473385600.0},
-        {1985.0, 473385600.0, 504921600.0},
-        {1986.0, 504921600.0, 536457600.0},
-        {1987.0, 536457600.0, 567993600.0},
-        {1988.0, 567993600.0, 599616000.0},
-        {1989.0, 599616000.0, 631152000.0},
-        {1990.0, 631152000.0, 662688000.0},
-        {1991.0, 662688000.0, 694224000.0},
-        {1992.0, 694224000.0, 725846400.0},
-        {1993.0, 725846400.0, 757382400.0},
-        {1994.0, 757382400.0, 788918400.0},
-        {1995.0, 788918400.0, 820454400.0},
-        {1996.0, 820454400.0, 852076800.0},
-        {1997.0, 852076800.0, 883612800.0},
-        {1998.0, 883612800.0, 915148800.0},
-        {1999.0, 915148800.0, 946684800.0},
-        {2000.0, 946684800.0, 978307200.0},
-        {2001.0, 978307200.0, 1009843200.0},
-        {2002.0, 1009843200.0, 1041379200.0},
-        {2003.0, 1041379200.0, 1072915200.0},
-        {2004.0, 1072915200.0, 1104537600.0},
-        {2005.0, 1104537600.0, 1136073600.0},
-        {2006.0, 1136073600.0, 1167609600.0},
-        {2007.0, 1167609600.0, 1199145600.0},
-        {2008.0, 1199145600.0, 1230768000.0},
-        {2009.0, 1230768000.0, 1262304000.0},
-        {2010.0, 1262304000.0, 1293840000.0},
-        {2011.0, 1293840000.0, 1325376000.0},
-        {2012.0, 1325376000.0, 1356998400.0},
-        {2013.0, 1356998400.0, 1388534400.0},
-        {2014.0, 1388534400.0, 1420070400.0},
-        {2015.0, 1420070400.0, 1451606400.0},
-        {2016.0, 1451606400.0, 1483228800.0},
-        {2017.0, 1483228800.0, 1514764800.0},
-        {2018.0, 1514764800.0, 1546300800.0},
-        {2019.0, 1546300800.0, 1577836800.0},
-        {2020.0, 1577836800.0, 1609459200.0},
-        {2021.0, 1609459200.0, 1640995200.0},
-        {2022.0, 1640995200.0, 1672531200.0},
-        {2023.0, 1672531200.0, 1704067200.0},
-        {2024.0, 1704067200.0, 1735689600.0},
-        {2025.0, 1735689600.0, 1767225600.0},
-        {2026.0, 1767225600.0, 1798761600.0},
-        {2027.0, 1798761600.0, 1830297600.0},
-        {2028.0, 1830297600.0, 1861920000.0},
-        {2029.0, 1861920000.0, 1893456000.0},
-    }};
 };
 
 }
@@ -0,0 +1,322 @@
+#include "time.h"
+#include "tools/cpp/runfiles/runfiles.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace CamSim::Time {
+
+std::string get_runfiles_path(const std::string& filename)
+{
+    using bazel::tools::cpp::runfiles::Runfiles;
+    std::string error;
+    static std::unique_ptr<Runfiles> runfiles(Runfiles::Create("", &error));
+    if (!runfiles)
+    {
+        throw std::runtime_error("Failed to init Bazel runfiles: " + error);
+    }
+
+    return runfiles->Rlocation("camsim/" + filename);
+}
+
+std::string write_temporary_file(const std::string& name, const std::string& contents)
+{
+    const std::string path = testing::TempDir() + name;
+    std::ofstream file(path);
+    file << contents;
+
+    return path;
+}
+
+TEST(days_from_civil_test, known_dates)
+{
+    EXPECT_EQ(days_from_civil(1970, 1, 1), 0);
+    EXPECT_EQ(days_from_civil(1969, 12, 31), -1);
+    EXPECT_EQ(days_from_civil(1972, 1, 1), 730);
+    EXPECT_EQ(days_from_civil(2000, 1, 1), 10957);
+    EXPECT_EQ(days_from_civil(2100, 1, 1), 47482);
+}
+
+TEST(year_from_days_test, year_boundaries)
+{
+    for (long year = 1900; year <= 2200; year++)
+    {
+        const long first_day = days_from_civil(year, 1, 1);
+        EXPECT_EQ(year_from_days(first_day), year);
+        EXPECT_EQ(year_from_days(first_day - 1), year - 1);
+    }
+}
+
+TEST(get_decimal_year_test, matches_year_table)
+{
+    // Rows taken from year_timestamps.txt.
+    const std::vector<std::tuple<double, double, double>> years = {
+        {1970.0, 0.0, 31536000.0},
+        {1972.0, 63072000.0, 94694400.0},
+        {2000.0, 946684800.0, 978307200.0},
+        {2024.0, 1704067200.0, 1735689600.0},
+        {2030.0, 1893456000.0, 1924992000.0},
+    };
+
+    for (const auto& [year, start_timestamp, end_timestamp] : years)
+    {
+        for (const double fraction : {0.0, 0.3, 0.75})
+        {
+            const double timestamp = start_timestamp + (end_timestamp - start_timestamp) * fraction;
+            const Timestamp time = Timestamp::from_posix_timestamp(timestamp);
+
+            EXPECT_NEAR(time.get_decimal_year(), year + fraction, 1e-9);
+            EXPECT_NEAR(
+                Timestamp::from_decimal_year(year + fraction).get_utc_timestamp(), timestamp, 1e-3);
+        }
+    }
+}
+
+TEST(get_decimal_year_test, past_2030)
+{
+    const Timestamp time = Timestamp::from_posix_timestamp((ulong)days_from_civil(2045, 7, 2) * 86400);
+
+    EXPECT_NEAR(time.get_decimal_year(), 2045.0 + 182.0 / 365.0, 1e-9);
+}
+
+TEST(get_gps_timestamp_test, leap_seconds)
+{
+    // GPS time is TAI - 19 s, counted from 1980-01-06.
+    const std::vector<std::tuple<ulong, double>> utc_to_leap_seconds = {
+        {315964800, 19.0},  // GPS epoch
+        {1136073599, 32.0}, // Just before the 2006 leap second
+        {1136073600, 33.0}, // Just after the 2006 leap second
+        {1483228800, 37.0}, // 2017
+        {1700000000, 37.0},
+    };
+
+    for (const auto& [utc_timestamp, leap_seconds] : utc_to_leap_seconds)
+    {
+        const Timestamp time = Timestamp::from_posix_timestamp(utc_timestamp);
+
+        EXPECT_DOUBLE_EQ(
+            time.get_gps_timestamp(), (double)utc_timestamp + leap_seconds - 19.0 - 315964800.0);
+    }
+}
+
+TEST(convert_batch_test, matches_scalar_accessors)
+{
+    // Sorted UTC timestamps from 1970 to 2040, with extra samples around two leap seconds.
+    std::vector<double> utc_timestamps;
+    for (double timestamp = 1000.5; timestamp < 2.2e9; timestamp += 3.7e5)
+    {
+        utc_timestamps.push_back(timestamp);
+    }
+    for (const double leap_second : {915148800.0, 1483228800.0})
+    {
+        for (double offset = -2.0; offset <= 2.0; offset += 0.25)
+        {
+            utc_timestamps.push_back(leap_second + offset);
+        }
+    }
+    std::sort(utc_timestamps.begin(), utc_timestamps.end());
+
+    const std::vector<std::tuple<TimeScale, std::function<double(const Timestamp&)>, double>>
+        scales = {
+            {TimeScale::UTC, &Timestamp::get_utc_timestamp, 1e-6},
+            {TimeScale::TAI, &Timestamp::get_tai_timestamp, 1e-6},
+            {TimeScale::GPS, &Timestamp::get_gps_timestamp, 1e-6},
+            {TimeScale::TT, &Timestamp::get_tt_timestamp, 1e-6},
+            {TimeScale::JD_UTC, &Timestamp::get_jd_utc, 1e-9},
+            {TimeScale::JD_GPS, &Timestamp::get_jd_gps, 1e-9},
+            {TimeScale::JD_TT, &Timestamp::get_jd_tt, 1e-9},
+            {TimeScale::DECIMAL_YEAR, &Timestamp::get_decimal_year, 1e-12},
+        };
+
+    std::mt19937 generator(42);
+    for (const bool shuffled : {false, true})
+    {
+        std::vector<double> utc = utc_timestamps;
+        if (shuffled)
+        {
+            std::shuffle(utc.begin(), utc.end(), generator);
+        }
+
+        for (const auto& [scale, accessor, tolerance] : scales)
+        {
+            std::vector<double> converted(utc.size());
+            Timestamp::convert_batch(TimeScale::UTC, scale, utc.data(), converted.data(), utc.size());
+
+            for (size_t i = 0; i < utc.size(); i++)
+            {
+                const Timestamp time = Timestamp::from_posix_timestamp(utc[i]);
+                EXPECT_NEAR(converted[i], accessor(time), tolerance) << utc[i];
+            }
+
+            // Converting back recovers UTC, except inside the leap seconds themselves.
+            std::vector<double> round_trip = converted;
+            Timestamp::convert_batch(
+                scale, TimeScale::UTC, round_trip.data(), round_trip.data(), round_trip.size());
+            for (size_t i = 0; i < utc.size(); i++)
+            {
+                EXPECT_NEAR(round_trip[i], utc[i], 1e-4) << utc[i];
+            }
+        }
+    }
+}
+
+TEST(duration_test, exact_stepping)
+{
+    const Timestamp start = Timestamp::from_posix_timestamp((ulong)1700000000, (ulong)123456789);
+    const Duration step = Duration::from_seconds(1e-3);
+
+    Timestamp time = start;
+    for (int i = 0; i < 1000000; i++)
+    {
+        time += step;
+    }
+
+    EXPECT_EQ(time - start, Duration::from_seconds(1000.0));
+    EXPECT_EQ(time, start + step * 1000000);
+    EXPECT_EQ(time.get_utc_since_epoch().get_nanoseconds() % 1000000000, 123456789);
+    EXPECT_EQ((start - Duration::from_seconds(1700000001.0)).get_utc_since_epoch(),
+              Duration::from_nanoseconds(-1000000000 + 123456789));
+    EXPECT_DOUBLE_EQ((time - start).get_seconds(), 1000.0);
+}
+
+TEST(duration_test, tai_round_trip)
+{
+    for (const ulong leap_second : {(ulong)915148800, (ulong)1483228800})
+    {
+        for (long long offset_ns = -3000000000; offset_ns <= 3000000000; offset_ns += 250000000)
+        {
+            const Timestamp time =
+                Timestamp::from_posix_timestamp(leap_second) + Duration::from_nanoseconds(offset_ns);
+
+            EXPECT_EQ(Timestamp::from_tai_since_epoch(time.get_tai_since_epoch()), time);
+        }
+
+        // The inserted second itself holds just before the new day.
+        const Timestamp boundary = Timestamp::from_posix_timestamp(leap_second);
+        const Duration inside_leap_second =
+            boundary.get_tai_since_epoch() - Duration::from_seconds(0.5);
+        EXPECT_EQ(Timestamp::from_tai_since_epoch(inside_leap_second),
+                  boundary - Duration::from_nanoseconds(1));
+    }
+}
+
+TEST(from_jd_gps_test, leap_second_boundary)
+{
+    // Up to 37 s after a leap second, looking the leap seconds up by TAI instead of UTC used to
+    // put the result off by a second.
+    const ulong leap_second = 1483228800;
+    for (long long offset_s = -40; offset_s <= 40; offset_s++)
+    {
+        const Timestamp time = Timestamp::from_posix_timestamp(leap_second + offset_s, (ulong)250000000);
+
+        const auto [jd_whole, jd_fraction] = time.get_jd_gps_split();
+        EXPECT_EQ(Timestamp::from_jd_gps(jd_whole, jd_fraction), time);
+        EXPECT_NEAR(Timestamp::from_jd_gps(time.get_jd_gps()).get_utc_timestamp(),
+                    time.get_utc_timestamp(), 1e-4);
+    }
+}
+
+TEST(jd_split_test, keeps_nanoseconds)
+{
+    const Timestamp time = Timestamp::from_posix_timestamp((ulong)1700000000, (ulong)1);
+
+    const auto [jd_whole, jd_fraction] = time.get_jd_utc_split();
+    EXPECT_EQ(jd_whole, 2460262.5);
+    EXPECT_NEAR(jd_fraction, (22 * 3600 + 13 * 60 + 20 + 1e-9) / 86400.0, 1e-15);
+    EXPECT_EQ(Timestamp::from_jd_utc(jd_whole, jd_fraction), time);
+    EXPECT_NEAR(jd_whole + jd_fraction, time.get_jd_utc(), 1e-9);
+}
+
+TEST(leap_second_table_test, shipped_files_match_compiled_in)
+{
+    const LeapSecondTable& compiled_in = LeapSecondTable::compiled_in();
+
+    for (const std::string filename : {"timestamp_leap_seconds.txt", "leap_seconds_table.txt"})
+    {
+        const LeapSecondTable table = LeapSecondTable::from_file(get_runfiles_path(filename));
+
+        ASSERT_EQ(table.size(), compiled_in.size()) << filename;
+        for (size_t i = 0; i < table.size(); i++)
+        {
+            EXPECT_EQ(table.get_start(i), compiled_in.get_start(i)) << filename;
+            EXPECT_EQ(table.get_leap_seconds_at(i), compiled_in.get_leap_seconds_at(i)) << filename;
+        }
+    }
+}
+
+TEST(leap_second_table_test, index_matches_search)
+{
+    const LeapSecondTable& table = LeapSecondTable::compiled_in();
+
+    std::mt19937_64 generator(31);
+    std::uniform_int_distribution<long long> seconds(-1000000, 2000000000);
+    for (int i = 0; i < 100000; i++)
+    {
+        const long long utc_seconds = seconds(generator);
+
+        size_t expected = 0;
+        while (expected + 1 < table.size() && table.get_start(expected + 1) <= utc_seconds)
+        {
+            expected++;
+        }
+        ASSERT_EQ(table.get_index(utc_seconds), expected) << utc_seconds;
+    }
+
+    // Exactly at a leap second and one second before it.
+    EXPECT_EQ(table.get_leap_seconds(1483228800), 37.0);
+    EXPECT_EQ(table.get_leap_seconds(1483228799), 36.0);
+}
+
+TEST(leap_second_table_test, installed_table_extends_past_compiled_in)
+{
+    // A made-up leap second at the start of 2031, as a new bulletin would add it.
+    const std::string path = write_temporary_file(
+        "future_leap_seconds.txt", "year,month,day,leap_seconds\n1972,1,1,10.0\n"
+                                   "2017,1,1,37.0\n2031,1,1,38.0\n");
+    const ulong leap_second = (ulong)days_from_civil(2031, 1, 1) * SECONDS_PER_DAY;
+    const Timestamp before = Timestamp::from_posix_timestamp(leap_second - 1);
+    const Timestamp after = Timestamp::from_posix_timestamp(leap_second + 1);
+
+    EXPECT_DOUBLE_EQ(after.get_tai_timestamp() - after.get_utc_timestamp(), 37.0);
+
+    Timestamp::load_leap_second_table(path);
+    EXPECT_DOUBLE_EQ(before.get_tai_timestamp() - before.get_utc_timestamp(), 37.0);
+    EXPECT_DOUBLE_EQ(after.get_tai_timestamp() - after.get_utc_timestamp(), 38.0);
+    EXPECT_EQ(Timestamp::from_tai_since_epoch(after.get_tai_since_epoch()), after);
+
+    // Times before the file's first row keep the compiled-in values.
+    EXPECT_DOUBLE_EQ(Timestamp::from_posix_timestamp((ulong)0).get_tai_timestamp(), 4.21317);
+
+    const std::vector<double> utc = {(double)leap_second - 1.0, (double)leap_second + 1.0};
+    std::vector<double> gps(utc.size());
+    Timestamp::convert_batch(TimeScale::UTC, TimeScale::GPS, utc.data(), gps.data(), utc.size());
+    EXPECT_DOUBLE_EQ(gps[0], before.get_gps_timestamp());
+    EXPECT_DOUBLE_EQ(gps[1], after.get_gps_timestamp());
+    EXPECT_DOUBLE_EQ(gps[1] - gps[0], 3.0);
+
+    Timestamp::reset_leap_second_table();
+    EXPECT_DOUBLE_EQ(after.get_tai_timestamp() - after.get_utc_timestamp(), 37.0);
+}
+
+TEST(leap_second_table_test, bad_files_throw)
+{
+    EXPECT_THROW(LeapSecondTable::from_file(testing::TempDir() + "missing_leap_seconds.txt"),
+                 std::runtime_error);
+
+    for (const std::string contents :
+         {"", "timestamp,leap_seconds\n", "timestamp,leap_seconds\n63072000,ten\n",
+          "timestamp,leap_seconds\n63072000\n", "timestamp,leap_seconds\n63072001,10.0\n",
+          "timestamp,leap_seconds\n78796800,11.0\n63072000,10.0\n",
+          "year,month,day,leap_seconds\n1972,13,1,10.0\n", "a,b,c\n1,2,3\n"})
+    {
+        const std::string path = write_temporary_file("bad_leap_seconds.txt", contents);
+        EXPECT_THROW(LeapSecondTable::from_file(path), std::runtime_error) << contents;
+    }
+}
+
+}
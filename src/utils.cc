@@ -3,6 +3,9 @@
  */
 #include "utils.h"
 #include <cstring>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 Arena*
 arena_create (size_t capacity)
@@ -30,15 +33,31 @@ arena_create (size_t capacity)
     return arena;
 }
 
+#ifdef CAMSIM_ARENA_STATS
+/*
+ * Where arena_free writes reports.
+ */
+static FILE* arena_stats_output = stderr;
+#endif
+
 void
 arena_free (Arena* arena)
 {
+#ifdef CAMSIM_ARENA_STATS
+    if (arena_stats_output != NULL)
+    {
+        arena_stats_report (arena, arena_stats_output);
+    }
+#endif
     free (arena->buffer);
     free (arena);
 }
 
+/*
+ * The parentheses stop the stats build macro from expanding the name.
+ */
 void*
-arena_allocate (Arena* arena, size_t size, size_t alignment)
+(arena_allocate) (Arena* arena, size_t size, size_t alignment)
 {
     /*
      * Determine how much padding we need to maintain alignment.
@@ -77,10 +96,364 @@ arena_allocate (Arena* arena, size_t size, size_t alignment)
 }
 
 void*
-arena_multi_allocate (Arena* arena, size_t number, size_t size, size_t alignment)
+(arena_multi_allocate) (Arena* arena, size_t number, size_t size, size_t alignment)
+{
+    return (arena_allocate) (arena, number * size, alignment);
+}
+
+#ifdef CAMSIM_ARENA_STATS
+/*
+ * Gets the size class of an allocation.
+ */
+static int
+arena_stats_size_class (size_t size)
+{
+    if (size <= 1)
+    {
+        return 0;
+    }
+    int size_class = 64 - __builtin_clzll ((unsigned long long)(size - 1));
+
+    return size_class < ARENA_STATS_SIZE_CLASSES ? size_class : ARENA_STATS_SIZE_CLASSES - 1;
+}
+
+/*
+ * Records a failed allocation against its call site.
+ */
+static void
+arena_stats_record_failure (ArenaStats* stats, size_t size, const char* file, int line)
+{
+    stats->failure_count++;
+
+    for (int i = 0; i < stats->failure_site_count; i++)
+    {
+        ArenaFailureSite* site = &stats->failure_sites[i];
+        if (site->line == line and strcmp (site->file, file) == 0)
+        {
+            site->count++;
+            site->largest_size = size > site->largest_size ? size : site->largest_size;
+            return;
+        }
+    }
+
+    if (stats->failure_site_count < ARENA_STATS_MAX_FAILURE_SITES)
+    {
+        ArenaFailureSite* site = &stats->failure_sites[stats->failure_site_count];
+        site->file = file;
+        site->line = line;
+        site->count = 1;
+        site->largest_size = size;
+        stats->failure_site_count++;
+    }
+}
+
+void*
+arena_allocate_at (Arena* arena, size_t size, size_t alignment, const char* file, int line)
+{
+    ArenaStats* stats = &arena->stats;
+    size_t offset_before = arena->offset;
+
+    void* pointer = (arena_allocate) (arena, size, alignment);
+    if (pointer == NULL)
+    {
+        arena_stats_record_failure (stats, size, file, line);
+        return NULL;
+    }
+
+    stats->bytes_requested += size;
+    stats->bytes_padding += arena->offset - offset_before - size;
+    stats->peak_offset = arena->offset > stats->peak_offset ? arena->offset : stats->peak_offset;
+    stats->allocation_count++;
+    stats->size_class_counts[arena_stats_size_class (size)]++;
+
+    return pointer;
+}
+
+void
+arena_stats_report (const Arena* arena, FILE* file)
+{
+    const ArenaStats* stats = &arena->stats;
+    double used_percent
+        = arena->capacity == 0 ? 0.0 : 100.0 * (double)stats->peak_offset / (double)arena->capacity;
+
+    fprintf (file, "arena %p: capacity %zu, peak offset %zu (%.1f%%), requested %zu, padding %zu\n",
+             (const void*)arena, arena->capacity, stats->peak_offset, used_percent,
+             stats->bytes_requested, stats->bytes_padding);
+    fprintf (file, "  allocations %zu, failures %zu\n", stats->allocation_count,
+             stats->failure_count);
+
+    for (int i = 0; i < ARENA_STATS_SIZE_CLASSES; i++)
+    {
+        if (stats->size_class_counts[i] == 0)
+        {
+            continue;
+        }
+        if (i == ARENA_STATS_SIZE_CLASSES - 1)
+        {
+            fprintf (file, "  size > %zu: %zu\n", (size_t)1 << (i - 1), stats->size_class_counts[i]);
+        }
+        else
+        {
+            fprintf (file, "  size <= %zu: %zu\n", (size_t)1 << i, stats->size_class_counts[i]);
+        }
+    }
+
+    for (int i = 0; i < stats->failure_site_count; i++)
+    {
+        const ArenaFailureSite* site = &stats->failure_sites[i];
+        fprintf (file, "  failed at %s:%d: %zu times, largest request %zu\n", site->file,
+                 site->line, site->count, site->largest_size);
+    }
+}
+
+void
+arena_stats_set_output (FILE* file)
+{
+    arena_stats_output = file;
+}
+#endif
+
+/*
+ * String kernels.  Each kernel has a scalar version, and on x86-64 an SSE2 (always available) and
+ * an AVX2 version.  The best supported version is chosen once at startup and can be overridden
+ * with string_simd_level_set.  All of the kernels return the size of the input when nothing is
+ * found.
+ */
+
+/*
+ * Finds the index of the first character that differs between a and b.
+ */
+static size_t
+string_mismatch_scalar (const char* a, const char* b, size_t size)
+{
+    size_t i = 0;
+    while (i < size and a[i] == b[i])
+    {
+        i++;
+    }
+
+    return i;
+}
+
+/*
+ * Finds the index of the first occurrence of character.
+ */
+static size_t
+string_find_char_scalar (const char* text, size_t size, char character)
+{
+    const char* found = (const char*)memchr (text, character, size);
+
+    return found == NULL ? size : (size_t)(found - text);
+}
+
+/*
+ * Finds the index of the first occurrence of needle in text.  Assumes 2 <= needle_size <= size.
+ */
+static size_t
+string_find_scalar (const char* text, size_t size, const char* needle, size_t needle_size)
+{
+    for (size_t i = 0; i + needle_size <= size; i++)
+    {
+        if (text[i] == needle[0] and memcmp (text + i + 1, needle + 1, needle_size - 1) == 0)
+        {
+            return i;
+        }
+    }
+
+    return size;
+}
+
+#if defined(__x86_64__)
+static size_t
+string_mismatch_sse2 (const char* a, const char* b, size_t size)
+{
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i a_block = _mm_loadu_si128 ((const __m128i*)(a + i));
+        __m128i b_block = _mm_loadu_si128 ((const __m128i*)(b + i));
+        unsigned mask = ~(unsigned)_mm_movemask_epi8 (_mm_cmpeq_epi8 (a_block, b_block)) & 0xffffu;
+        if (mask != 0)
+        {
+            return i + __builtin_ctz (mask);
+        }
+    }
+
+    return i + string_mismatch_scalar (a + i, b + i, size - i);
+}
+
+static size_t
+string_find_char_sse2 (const char* text, size_t size, char character)
+{
+    __m128i pattern = _mm_set1_epi8 (character);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i block = _mm_loadu_si128 ((const __m128i*)(text + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8 (_mm_cmpeq_epi8 (block, pattern));
+        if (mask != 0)
+        {
+            return i + __builtin_ctz (mask);
+        }
+    }
+
+    return i + string_find_char_scalar (text + i, size - i, character);
+}
+
+/*
+ * Compares the first and last character of the needle against 16 candidate positions at once, and
+ * only runs a full comparison on positions where both match.
+ */
+static size_t
+string_find_sse2 (const char* text, size_t size, const char* needle, size_t needle_size)
+{
+    __m128i first = _mm_set1_epi8 (needle[0]);
+    __m128i last = _mm_set1_epi8 (needle[needle_size - 1]);
+    size_t positions = size - needle_size + 1;
+    size_t i = 0;
+    for (; i + 16 <= positions; i += 16)
+    {
+        __m128i first_block = _mm_loadu_si128 ((const __m128i*)(text + i));
+        __m128i last_block = _mm_loadu_si128 ((const __m128i*)(text + i + needle_size - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8 (
+            _mm_and_si128 (_mm_cmpeq_epi8 (first_block, first), _mm_cmpeq_epi8 (last_block, last)));
+        while (mask != 0)
+        {
+            size_t candidate = i + __builtin_ctz (mask);
+            if (memcmp (text + candidate + 1, needle + 1, needle_size - 2) == 0)
+            {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    size_t index = string_find_scalar (text + i, size - i, needle, needle_size);
+
+    return index == size - i ? size : i + index;
+}
+
+__attribute__ ((target ("avx2"))) static size_t
+string_mismatch_avx2 (const char* a, const char* b, size_t size)
+{
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i a_block = _mm256_loadu_si256 ((const __m256i*)(a + i));
+        __m256i b_block = _mm256_loadu_si256 ((const __m256i*)(b + i));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (a_block, b_block));
+        if (mask != 0)
+        {
+            return i + __builtin_ctz (mask);
+        }
+    }
+
+    return i + string_mismatch_sse2 (a + i, b + i, size - i);
+}
+
+__attribute__ ((target ("avx2"))) static size_t
+string_find_char_avx2 (const char* text, size_t size, char character)
 {
-    return arena_allocate (arena, number * size, alignment);
+    __m256i pattern = _mm256_set1_epi8 (character);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256 ((const __m256i*)(text + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (block, pattern));
+        if (mask != 0)
+        {
+            return i + __builtin_ctz (mask);
+        }
+    }
+
+    return i + string_find_char_sse2 (text + i, size - i, character);
+}
+
+__attribute__ ((target ("avx2"))) static size_t
+string_find_avx2 (const char* text, size_t size, const char* needle, size_t needle_size)
+{
+    __m256i first = _mm256_set1_epi8 (needle[0]);
+    __m256i last = _mm256_set1_epi8 (needle[needle_size - 1]);
+    size_t positions = size - needle_size + 1;
+    size_t i = 0;
+    for (; i + 32 <= positions; i += 32)
+    {
+        __m256i first_block = _mm256_loadu_si256 ((const __m256i*)(text + i));
+        __m256i last_block = _mm256_loadu_si256 ((const __m256i*)(text + i + needle_size - 1));
+        unsigned mask = (unsigned)_mm256_movemask_epi8 (_mm256_and_si256 (
+            _mm256_cmpeq_epi8 (first_block, first), _mm256_cmpeq_epi8 (last_block, last)));
+        while (mask != 0)
+        {
+            size_t candidate = i + __builtin_ctz (mask);
+            if (memcmp (text + candidate + 1, needle + 1, needle_size - 2) == 0)
+            {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    size_t index = string_find_sse2 (text + i, size - i, needle, needle_size);
+
+    return index == size - i ? size : i + index;
 }
+#endif
+
+/*
+ * The set of kernels currently in use.
+ */
+typedef struct
+{
+    StringSimdLevel level;
+    size_t (*mismatch) (const char* a, const char* b, size_t size);
+    size_t (*find_char) (const char* text, size_t size, char character);
+    size_t (*find) (const char* text, size_t size, const char* needle, size_t needle_size);
+} StringKernels;
+
+/*
+ * Gets the best SIMD level the CPU supports.
+ */
+static StringSimdLevel
+string_simd_level_supported (void)
+{
+#if defined(__x86_64__)
+    /*
+     * Needed because this can run from a static initializer, before the CPU model is populated.
+     */
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2"))
+    {
+        return STRING_SIMD_AVX2;
+    }
+    return STRING_SIMD_SSE2;
+#else
+    return STRING_SIMD_SCALAR;
+#endif
+}
+
+/*
+ * Gets the kernels for a SIMD level.  Assumes the level is supported.
+ */
+static StringKernels
+string_kernels_for_level (StringSimdLevel level)
+{
+    switch (level)
+    {
+#if defined(__x86_64__)
+    case STRING_SIMD_AVX2:
+        return StringKernels{ STRING_SIMD_AVX2, string_mismatch_avx2, string_find_char_avx2,
+                              string_find_avx2 };
+    case STRING_SIMD_SSE2:
+        return StringKernels{ STRING_SIMD_SSE2, string_mismatch_sse2, string_find_char_sse2,
+                              string_find_sse2 };
+#endif
+    default:
+        return StringKernels{ STRING_SIMD_SCALAR, string_mismatch_scalar, string_find_char_scalar,
+                              string_find_scalar };
+    }
+}
+
+static StringKernels string_kernels = string_kernels_for_level (string_simd_level_supported ());
 
 /*
  * A private method used to create an empty string (as strings are treated as immutable when using
@@ -125,13 +498,10 @@ string_create (Arena* arena, const char* text)
 {
     /*
      * Get the size of the string by looking for a null terminator.  Fail if the size is greater
-     * than MAX_STRING_SIZE.
+     * than MAX_STRING_SIZE.  strnlen never reads past the terminator or the limit, and is
+     * vectorized by the C library.
      */
-    int size = 0;
-    while (text[size] != '\0' and size <= MAX_STRING_SIZE)
-    {
-        size++;
-    }
+    size_t size = strnlen (text, MAX_STRING_SIZE + 1);
     if (size > MAX_STRING_SIZE)
     {
         return NULL;
@@ -196,20 +566,13 @@ string_compare (const String* a, const String* b)
     size_t shorter_size = a->size <= b->size ? a->size : b->size;
 
     /*
-     * Compare character by character to find the first different character.
+     * Find the first different character.  The characters are compared as char (not unsigned char
+     * like memcmp) so the ordering does not depend on the SIMD level.
      */
-    for (size_t i = 0; i < shorter_size; i++)
+    size_t i = string_kernels.mismatch (a->text, b->text, shorter_size);
+    if (i < shorter_size)
     {
-        char a_char = a->text[i];
-        char b_char = b->text[i];
-        if (a_char < b_char)
-        {
-            return -1;
-        }
-        if (a_char > b_char)
-        {
-            return 1;
-        }
+        return a->text[i] < b->text[i] ? -1 : 1;
     }
 
     /*
@@ -220,6 +583,123 @@ string_compare (const String* a, const String* b)
     return -(a->size < b->size) + (a->size > b->size);
 }
 
+bool
+string_equal (const String* a, const String* b)
+{
+    if (a->size != b->size)
+    {
+        return false;
+    }
+
+    return string_kernels.mismatch (a->text, b->text, a->size) == a->size;
+}
+
+int
+string_find_char (const String* string, char character)
+{
+    size_t index = string_kernels.find_char (string->text, string->size, character);
+
+    return index < string->size ? (int)index : -1;
+}
+
+int
+string_find (const String* string, const String* substring)
+{
+    /*
+     * Handle the degenerate cases up front so the kernels can assume 2 <= needle size <= haystack
+     * size.
+     */
+    if (substring->size == 0)
+    {
+        return 0;
+    }
+    if (substring->size > string->size)
+    {
+        return -1;
+    }
+    if (substring->size == 1)
+    {
+        return string_find_char (string, substring->text[0]);
+    }
+
+    size_t index
+        = string_kernels.find (string->text, string->size, substring->text, substring->size);
+
+    return index < string->size ? (int)index : -1;
+}
+
+/*
+ * Constants for string_hash, taken from the 64 bit golden ratio and the murmur3 finalizer.
+ */
+constexpr uint64_t HASH_SEED = 0x9e3779b97f4a7c15ull;
+constexpr uint64_t HASH_MULTIPLY_1 = 0xff51afd7ed558ccdull;
+constexpr uint64_t HASH_MULTIPLY_2 = 0xc4ceb9fe1a85ec53ull;
+
+/*
+ * Mixes one word into the hash state.
+ */
+static inline uint64_t
+string_hash_mix (uint64_t hash, uint64_t word)
+{
+    hash ^= word * HASH_MULTIPLY_1;
+    hash = (hash << 31) | (hash >> 33);
+
+    return hash * HASH_MULTIPLY_2;
+}
+
+uint64_t
+string_hash (const String* string)
+{
+    /*
+     * Consume the string a word at a time.  memcpy is used for the unaligned loads and compiles to
+     * a single mov.
+     */
+    uint64_t hash = HASH_SEED ^ (string->size * HASH_MULTIPLY_2);
+    size_t i = 0;
+    for (; i + sizeof (uint64_t) <= string->size; i += sizeof (uint64_t))
+    {
+        uint64_t word;
+        memcpy (&word, string->text + i, sizeof (uint64_t));
+        hash = string_hash_mix (hash, word);
+    }
+
+    /*
+     * Pack the leftover characters into one final word.
+     */
+    if (i < string->size)
+    {
+        uint64_t word = 0;
+        memcpy (&word, string->text + i, string->size - i);
+        hash = string_hash_mix (hash, word);
+    }
+
+    /*
+     * Finalize so that every input bit affects every output bit.
+     */
+    hash ^= hash >> 33;
+    hash *= HASH_MULTIPLY_1;
+    hash ^= hash >> 33;
+    hash *= HASH_MULTIPLY_2;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+StringSimdLevel
+string_simd_level (void)
+{
+    return string_kernels.level;
+}
+
+StringSimdLevel
+string_simd_level_set (StringSimdLevel level)
+{
+    StringSimdLevel supported = string_simd_level_supported ();
+    string_kernels = string_kernels_for_level (level < supported ? level : supported);
+
+    return string_kernels.level;
+}
+
 const String*
 string_concatenate (Arena* arena, const String* a, const String* b)
 {
@@ -9,6 +9,93 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef CAMSIM_ARENA_STATS
+/**
+ * The number of allocation size classes tracked.  Class 0 holds allocations of at most 1 byte, class
+ * k holds allocations in (2^(k - 1), 2^k], and the last class holds everything larger.
+ */
+constexpr int ARENA_STATS_SIZE_CLASSES = 24;
+
+/**
+ * The maximum number of distinct call sites that failed allocations are recorded for.
+ */
+constexpr int ARENA_STATS_MAX_FAILURE_SITES = 16;
+
+/**
+ * A call site where an allocation failed.
+ */
+typedef struct
+{
+    /**
+     * The source file of the call site.
+     */
+    const char* file;
+
+    /**
+     * The line of the call site.
+     */
+    int line;
+
+    /**
+     * The number of failed allocations from this site.
+     */
+    size_t count;
+
+    /**
+     * The largest failed request (in bytes) from this site.
+     */
+    size_t largest_size;
+} ArenaFailureSite;
+
+/**
+ * Allocation statistics for an arena, only recorded when built with CAMSIM_ARENA_STATS (use
+ * --config=arena_stats).
+ */
+typedef struct
+{
+    /**
+     * The total number of bytes requested by successful allocations.
+     */
+    size_t bytes_requested;
+
+    /**
+     * The total number of bytes lost to alignment padding.
+     */
+    size_t bytes_padding;
+
+    /**
+     * The highest offset the arena has reached.
+     */
+    size_t peak_offset;
+
+    /**
+     * The number of successful allocations.
+     */
+    size_t allocation_count;
+
+    /**
+     * The number of successful allocations in each size class.
+     */
+    size_t size_class_counts[ARENA_STATS_SIZE_CLASSES];
+
+    /**
+     * The number of failed allocations.
+     */
+    size_t failure_count;
+
+    /**
+     * The call sites of failed allocations.  Failures from sites past the limit are only counted in
+     * failure_count.
+     */
+    ArenaFailureSite failure_sites[ARENA_STATS_MAX_FAILURE_SITES];
+
+    /**
+     * The number of entries used in failure_sites.
+     */
+    int failure_site_count;
+} ArenaStats;
+#endif
+
 /**
  * Provides a more centralized way to allocate memory.  All allocation calls are
  * made when first allocating the Arena, and then objects will use the memory in
@@ -31,6 +118,13 @@ typedef struct
      * Beginning of free space in arena
      */
     size_t offset;
+
+#ifdef CAMSIM_ARENA_STATS
+    /**
+     * Allocation statistics, reported when the arena is freed.
+     */
+    ArenaStats stats;
+#endif
 } Arena;
 
 /**
@@ -78,6 +172,43 @@ void* arena_multi_allocate (Arena* arena, size_t number, size_t size, size_t ali
 #define arena_multi_allocate_type(arena, number, type)                                             \
     (type*)arena_multi_allocate (arena, number, sizeof (type), alignof (type))
 
+#ifdef CAMSIM_ARENA_STATS
+/**
+ * Allocates memory for an object in the arena, recording the call site if the allocation fails.
+ * In stats builds arena_allocate and arena_multi_allocate are macros around this, so every caller
+ * is recorded without changes.
+ *
+ * @param[in] arena
+ * @param[in] size The size of the object you want to allocate
+ * @param[in] alignment The alignment of the object you want to allocate
+ * @param[in] file The source file of the call site
+ * @param[in] line The line of the call site
+ *
+ * @return pointer The pointer to the object (NULL if arena is full)
+ */
+void* arena_allocate_at (Arena* arena, size_t size, size_t alignment, const char* file, int line);
+
+#define arena_allocate(arena, size, alignment)                                                     \
+    arena_allocate_at (arena, size, alignment, __FILE__, __LINE__)
+#define arena_multi_allocate(arena, number, size, alignment)                                       \
+    arena_allocate_at (arena, (number) * (size), alignment, __FILE__, __LINE__)
+
+/**
+ * Writes a human readable report of the allocation statistics of an arena.
+ *
+ * @param[in] arena
+ * @param[in] file The file to write the report to.
+ */
+void arena_stats_report (const Arena* arena, FILE* file);
+
+/**
+ * Sets where arena_free writes the report of each arena.  Defaults to stderr.
+ *
+ * @param[in] file The file to write reports to, or NULL to stop reporting.
+ */
+void arena_stats_set_output (FILE* file);
+#endif
+
 /**
  * Handles strings (no null terminator).  Strings should be treated as immutable.
  */
@@ -127,6 +258,75 @@ char* string_c_str (Arena* arena, const String* string);
  */
 int string_compare (const String* a, const String* b);
 
+/**
+ * Checks two strings for equality.  Cheaper than string_compare when only equality matters, as
+ * strings of different sizes are rejected without looking at the text.
+ *
+ * @param[in] a The first string.
+ * @param[in] b The second string.
+ *
+ * @return true if the strings contain the same text, false otherwise.
+ */
+bool string_equal (const String* a, const String* b);
+
+/**
+ * Finds the first occurrence of a character in a string.
+ *
+ * @param[in] string The string to search.
+ * @param[in] character The character to look for.
+ *
+ * @return The index of the first occurrence of the character, or -1 if it is not in the string.
+ */
+int string_find_char (const String* string, char character);
+
+/**
+ * Finds the first occurrence of a substring in a string.
+ *
+ * @param[in] string The string to search.
+ * @param[in] substring The string to look for.  An empty substring is found at index 0.
+ *
+ * @return The index of the start of the first occurrence, or -1 if it is not in the string.
+ */
+int string_find (const String* string, const String* substring);
+
+/**
+ * Hashes a string.  The hash is a non-cryptographic 64 bit hash meant for lookup tables, and does
+ * not depend on which SIMD level is in use.
+ *
+ * @param[in] string The string to hash.
+ *
+ * @return The hash of the string.
+ */
+uint64_t string_hash (const String* string);
+
+/**
+ * The instruction set used by the string primitives.  The best level supported by the CPU is
+ * selected at startup, and every level gives identical results.
+ */
+enum StringSimdLevel
+{
+    STRING_SIMD_SCALAR = 0,
+    STRING_SIMD_SSE2,
+    STRING_SIMD_AVX2
+};
+
+/**
+ * Gets the instruction set currently used by the string primitives.
+ *
+ * @return The current SIMD level.
+ */
+StringSimdLevel string_simd_level (void);
+
+/**
+ * Sets the instruction set used by the string primitives.  Mostly useful for testing and
+ * benchmarking the fallbacks.  Not thread safe, so call it before any threads use strings.
+ *
+ * @param[in] level The desired SIMD level.  Clamped to the best level supported by the CPU.
+ *
+ * @return The SIMD level that is now in use.
+ */
+StringSimdLevel string_simd_level_set (StringSimdLevel level);
+
 /**
  * Concatenate two strings.
  *
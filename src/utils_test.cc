@@ -64,6 +64,62 @@ TEST (arena, test_multi_allocation)
                (uintptr_t)second_valid_pointer);
 }
 
+#ifdef CAMSIM_ARENA_STATS
+TEST (arena, test_stats)
+{
+    Arena* arena = arena_create (64);
+    ASSERT_NOT_NULL (arena);
+
+    char* first = arena_allocate_type (arena, char);
+    int64_t* second = arena_allocate_type (arena, int64_t);
+    int32_t* third = arena_multi_allocate_type (arena, 4, int32_t);
+    ASSERT_NOT_NULL (first);
+    ASSERT_NOT_NULL (second);
+    ASSERT_NOT_NULL (third);
+
+    /*
+     * 1 + 8 + 16 bytes requested, with 7 bytes of padding before the int64_t.
+     */
+    EXPECT_EQ (arena->stats.bytes_requested, 25u);
+    EXPECT_EQ (arena->stats.bytes_padding, 7u);
+    EXPECT_EQ (arena->stats.peak_offset, 32u);
+    EXPECT_EQ (arena->stats.allocation_count, 3u);
+    EXPECT_EQ (arena->stats.size_class_counts[0], 1u);
+    EXPECT_EQ (arena->stats.size_class_counts[3], 1u);
+    EXPECT_EQ (arena->stats.size_class_counts[4], 1u);
+
+    /*
+     * Failures are grouped by call site.
+     */
+    for (int i = 0; i < 2; i++)
+    {
+        EXPECT_NULL (arena_allocate (arena, 100 + i, 1));
+    }
+    EXPECT_NULL (arena_allocate (arena, 1000, 1));
+    EXPECT_EQ (arena->stats.failure_count, 3u);
+    ASSERT_EQ (arena->stats.failure_site_count, 2);
+    EXPECT_EQ (arena->stats.failure_sites[0].count, 2u);
+    EXPECT_EQ (arena->stats.failure_sites[0].largest_size, 101u);
+    EXPECT_EQ (arena->stats.failure_sites[1].count, 1u);
+    EXPECT_NE (strstr (arena->stats.failure_sites[0].file, "utils_test.cc"), nullptr);
+
+    /*
+     * The report mentions the failure sites.
+     */
+    char report[4096] = { 0 };
+    FILE* report_file = fmemopen (report, sizeof (report) - 1, "w");
+    ASSERT_NOT_NULL (report_file);
+    arena_stats_report (arena, report_file);
+    fclose (report_file);
+    EXPECT_NE (strstr (report, "peak offset 32"), nullptr);
+    EXPECT_NE (strstr (report, "failed at"), nullptr);
+
+    arena_stats_set_output (NULL);
+    arena_free (arena);
+    arena_stats_set_output (stderr);
+}
+#endif
+
 TEST (string, test_string_creation)
 {
     Arena* arena = arena_create (2 * MAX_STRING_SIZE);
@@ -183,6 +239,129 @@ TEST (string, test_string_compare)
     arena_free (arena);
 }
 
+TEST (string, test_string_equal)
+{
+    Arena* arena = arena_create (1028);
+
+    const String* abc = string_create (arena, "abc");
+    const String* abc_2 = string_create (arena, "abc");
+    const String* abd = string_create (arena, "abd");
+    const String* abcd = string_create (arena, "abcd");
+    const String* empty = string_create (arena, "");
+
+    EXPECT_TRUE (string_equal (abc, abc));
+    EXPECT_TRUE (string_equal (abc, abc_2));
+    EXPECT_FALSE (string_equal (abc, abd));
+    EXPECT_FALSE (string_equal (abc, abcd));
+    EXPECT_FALSE (string_equal (abc, empty));
+    EXPECT_TRUE (string_equal (empty, empty));
+
+    arena_free (arena);
+}
+
+TEST (string, test_string_find)
+{
+    Arena* arena = arena_create (1028);
+
+    const String* haystack = string_create (arena, "the quick brown fox jumps over the lazy dog");
+
+    /*
+     * Characters.
+     */
+    EXPECT_EQ (string_find_char (haystack, 't'), 0);
+    EXPECT_EQ (string_find_char (haystack, 'q'), 4);
+    EXPECT_EQ (string_find_char (haystack, 'g'), 42);
+    EXPECT_EQ (string_find_char (haystack, 'Z'), -1);
+    EXPECT_EQ (string_find_char (string_create (arena, ""), 'a'), -1);
+
+    /*
+     * Substrings.
+     */
+    EXPECT_EQ (string_find (haystack, string_create (arena, "the")), 0);
+    EXPECT_EQ (string_find (haystack, string_create (arena, "fox")), 16);
+    EXPECT_EQ (string_find (haystack, string_create (arena, "the lazy")), 31);
+    EXPECT_EQ (string_find (haystack, string_create (arena, "dog")), 40);
+    EXPECT_EQ (string_find (haystack, string_create (arena, "o")), 12);
+    EXPECT_EQ (string_find (haystack, string_create (arena, "cat")), -1);
+    EXPECT_EQ (string_find (haystack, string_create (arena, "dogs")), -1);
+    EXPECT_EQ (string_find (haystack, string_create (arena, "")), 0);
+    EXPECT_EQ (string_find (string_create (arena, "ab"), haystack), -1);
+
+    arena_free (arena);
+}
+
+TEST (string, test_string_hash)
+{
+    Arena* arena = arena_create (1028);
+
+    const String* hello = string_create (arena, "hello world, this is long");
+    const String* hello_2 = string_create (arena, "hello world, this is long");
+    const String* hello_3 = string_create (arena, "hello world, this is lone");
+    const String* empty = string_create (arena, "");
+
+    EXPECT_EQ (string_hash (hello), string_hash (hello_2));
+    EXPECT_NE (string_hash (hello), string_hash (hello_3));
+    EXPECT_NE (string_hash (hello), string_hash (empty));
+
+    /*
+     * Trailing zero bytes are not lost when packing the last word.
+     */
+    String a = { (char*)"ab\0", 3 };
+    String b = { (char*)"ab", 2 };
+    EXPECT_NE (string_hash (&a), string_hash (&b));
+
+    arena_free (arena);
+}
+
+TEST (string, test_string_simd_levels_agree)
+{
+    Arena* arena = arena_create (16 * MAX_STRING_SIZE);
+
+    /*
+     * Build strings long enough to go through the vector loops and the scalar tails.
+     */
+    char base_c_str[301];
+    for (int i = 0; i < 300; i++)
+    {
+        base_c_str[i] = (char)('a' + (i * 7) % 26);
+    }
+    base_c_str[300] = '\0';
+    const String* base = string_create (arena, base_c_str);
+    const String* needle = string_create (arena, "zgnu");
+
+    StringSimdLevel original = string_simd_level ();
+    for (int level = STRING_SIMD_SCALAR; level <= STRING_SIMD_AVX2; level++)
+    {
+        StringSimdLevel applied = string_simd_level_set ((StringSimdLevel)level);
+        EXPECT_LE (applied, level);
+
+        for (int position : { 0, 15, 16, 31, 32, 33, 100, 299 })
+        {
+            char changed_c_str[301];
+            memcpy (changed_c_str, base_c_str, sizeof (changed_c_str));
+
+            /*
+             * A negative char sorts before a positive one, independent of the SIMD level.
+             */
+            changed_c_str[position] = (char)-3;
+            const String* changed = string_create (arena, changed_c_str);
+            EXPECT_EQ (string_compare (changed, base), -1);
+            EXPECT_EQ (string_compare (base, changed), 1);
+            EXPECT_FALSE (string_equal (base, changed));
+            EXPECT_EQ (string_find_char (changed, (char)-3), position);
+        }
+
+        EXPECT_EQ (string_compare (base, base), 0);
+        EXPECT_TRUE (string_equal (base, base));
+        EXPECT_EQ (string_find (base, needle), 11);
+        EXPECT_EQ (string_find (base, string_create (arena, "abc")), -1);
+    }
+    string_simd_level_set (original);
+    EXPECT_EQ (string_simd_level (), original);
+
+    arena_free (arena);
+}
+
 TEST (string, test_string_concatenate)
 {
     Arena* arena = arena_create (4 * MAX_STRING_SIZE);
@@ -14,9 +14,13 @@ public:
 
     static double radius_of_curvature(const double lattitude_rad)
     {
-        const double sin_lattitude_rad = std::sin(lattitude_rad);
-        return semi_major_axis /
-               std::sqrt(1 - eccentricity_squared * sin_lattitude_rad * sin_lattitude_rad);
+        return radius_of_curvature_from_sin(std::sin(lattitude_rad));
+    }
+
+    // For callers that already have the sine of the latitude.
+    static double radius_of_curvature_from_sin(const double sin_lattitude)
+    {
+        return semi_major_axis / std::sqrt(1 - eccentricity_squared * sin_lattitude * sin_lattitude);
     }
 };
 